@@ -75,6 +75,12 @@ void App::Render(egx::Device& dev, egx::CommandContext& context, eio::InputManag
 	// Only update target2 if in Realtime mode or if in demand mode and progress frame is true
 	if (scene_update_mode != SceneUpdateMode::OnDemand || progress_frame == true)
 	{
+		// Culled and uploaded once for all passes of the frame
+		draw_list.Build(scene.GetModels(), camera, renderer.GetShadowCamera());
+		if (scene.UploadTransforms(dev, context) > 0)
+			tlas_outdated = true;
+		renderer.UploadInstances(dev, context, draw_list.Instances());
+
 		if (aa_mode != AAMode::SSAA)
 		{
 			if (render_mode == RenderMode::Rasterizer)
@@ -186,10 +192,10 @@ void App::initializeRayTracing(egx::Device& dev, egx::CommandContext& context, c
 	if (dev.SupportsRayTracing())
 	{
 		ray_tracer = std::make_shared<RayTracer>(dev, context, window_size * upsample_denominator / upsample_numerator);
-		auto models = scene.GetModels();
-		auto meshes = scene.GetMeshes();
+		const auto& models = scene.GetModels();
+		const auto& meshes = scene.GetMeshes();
 
-		for (auto& pmesh : scene.GetMeshes())
+		for (auto& pmesh : meshes)
 		{
 			pmesh->BuildAccelerationStructure(dev, context);
 		}
@@ -302,29 +308,27 @@ void App::updateScene(float t)
 
 void App::renderRasterizer(egx::Device& dev, egx::CommandContext& context)
 {
-	auto models = scene.GetModels();
-	auto static_models = scene.GetStaticModels();
-	auto dynamic_models = scene.GetDynamicModels();
-
-	for (auto pmodel : models) pmodel->UpdateBuffer(dev, context);
 	renderer.PrepareFrame(dev, context);
-	for (auto pmodel : static_models) renderer.RenderModel(dev, context, camera, *pmodel);
-	for (auto pmodel : dynamic_models) renderer.RenderModel(dev, context, camera, *pmodel);
-	for (auto pmodel : models) renderer.RenderMotionVectors(dev, context, camera, *pmodel);
+	renderer.RenderShadows(dev, context, draw_list.ShadowDraws());
+	renderer.RenderModel(dev, context, camera, draw_list.CameraDraws());
+	renderer.RenderMotionVectors(dev, context, camera, draw_list.CameraDraws());
 	renderer.RenderLight(dev, context, camera, renderer_target);
 	renderer.PrepareFrameEnd();
 }
 void App::renderRayTracer(egx::Device& dev, egx::CommandContext& context)
 {
-	auto models = scene.GetModels();
-	auto dynamic_models = scene.GetDynamicModels();
+	const auto& models = scene.GetModels();
 
-	for (auto pmodel : models) pmodel->UpdateBuffer(dev, context);
-	ray_tracer->ReBuildTLAS(context, models);
+	// The TLAS keeps every model, rays leave the camera frustum
+	if (tlas_outdated)
+	{
+		ray_tracer->ReBuildTLAS(context, models);
+		tlas_outdated = false;
+	}
 
 	renderer.PrepareFrame(dev, context);
-	for (auto pmodel : models) renderer.RenderDepthOnly(dev, context, camera, *pmodel);
-	for (auto pmodel : dynamic_models) renderer.RenderMotionVectors(dev, context, camera, *pmodel);
+	renderer.RenderDepthOnly(dev, context, camera, draw_list.CameraDraws());
+	renderer.RenderMotionVectors(dev, context, camera, draw_list.DynamicDraws());
 	renderer.PrepareFrameEnd();
 
 	auto& trace_result = ray_tracer->Trace(dev, context);
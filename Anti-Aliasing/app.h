@@ -68,7 +68,9 @@ private:
 
 	// Renderers
 	DeferredRenderer renderer;
+	DrawList draw_list;
 	std::shared_ptr<RayTracer> ray_tracer;
+	bool tlas_outdated = false; // Models moved since the TLAS was built
 
 	// Network
 	enn::DatasetVideoRecorder dataset_recorder;
@@ -0,0 +1,22 @@
+#include <iostream>
+#include <string>
+#include "cpu/thread_pool.h"
+#include "cpu/cpu_info.h"
+#include "cpu/simd.h"
+#include "deep_learning/cpu/cpu_master_net.h"
+#include "network_benchmarks.h"
+#include "aa_benchmarks.h"
+#include "render_benchmarks.h"
+
+int main(int argc, char** argv)
+{
+	std::string weight_path = argc > 1 ? argv[1] : ecpu::MasterNet::DefaultWeightPath(4);
+
+	ecpu::ThreadPool pool;
+	std::cout << ecpu::CpuModelName() << ", " << pool.ThreadCount() << " threads, " << ecpu::CompilerName() << (ECPU_AVX2 ? " AVX2" : " scalar")
+		<< " build" << std::endl << std::endl;
+
+	NetworkBenchmarks(weight_path, pool);
+	AABenchmarks(pool);
+	RenderBenchmarks(pool);
+}
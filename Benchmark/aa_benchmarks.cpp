@@ -0,0 +1,203 @@
+#include "aa_benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include "cpu/tensor.h"
+#include "cpu/resample.h"
+#include "io/png.h"
+#include "aa/cpu/cpu_taa.h"
+#include "aa/cpu/cpu_fxaa.h"
+#include "deep_learning/cpu/dataset_reader.h"
+#include "benchmark_settings.h"
+
+namespace
+{
+	const int taa_factors[] = { 1, 2, 4 };
+	const char* dataset_root = "../DatasetGenerator/data";
+	const int fxaa_frames = 8;
+
+	// CPU TAA at the output resolutions, with all features and with none to show their cost
+	void taaBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::cout << "CPU TAA (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		ecpu::TAAFeatures none;
+		none.catmull_rom = false;
+		none.history_rectification = false;
+		none.ycocg = false;
+		none.clipping = false;
+		none.dilate_mv = false;
+
+		for (const auto& res : resolutions)
+		{
+			for (int factor : taa_factors)
+			{
+				ecpu::DLTUSFrame frame;
+				frame.color.Resize({ 1, res.height / factor, res.width / factor, 3 });
+				frame.depth.Resize({ 1, res.height / factor, res.width / factor, 1 });
+				frame.motion.Resize({ 1, res.height / factor, res.width / factor, 2 });
+				ecpu::FillInput(frame.color);
+				ecpu::FillInput(frame.depth);
+				frame.motion.Fill(0.0f);
+
+				double ms[2];
+				for (int f = 0; f < 2; f++)
+				{
+					ecpu::TAAEngine taa(factor, f == 0 ? ecpu::TAAFeatures() : none);
+					std::vector<double> times;
+					for (int i = 0; i < warmup_runs + timed_runs; i++)
+					{
+						taa.Execute(frame, pool);
+						if (i >= warmup_runs)
+							times.push_back(taa.GetLastSeconds());
+					}
+					std::sort(times.begin(), times.end());
+					ms[f] = times[times.size() / 2] * 1000.0;
+				}
+				std::cout << "  " << res.name << " from 1/" << factor << ": all features " << ms[0]
+					<< " ms, no features " << ms[1] << " ms" << std::endl;
+			}
+		}
+	}
+
+	// Aliased 1080p frames: the recorded one sample per pixel images of the dataset if present,
+	// otherwise a procedural image of hard edged circles
+	std::vector<ecpu::Tensor> fxaaFrames()
+	{
+		std::vector<ecpu::Tensor> frames;
+		const int recorded = std::min(fxaa_frames, ecpu::DatasetFrameCount(dataset_root, 1, 0));
+		for (int f = 0; f < recorded; f++)
+		{
+			frames.emplace_back();
+			ecpu::ImageToTensor(eio::LoadPng(ecpu::DatasetImagePath(dataset_root, 1, 0, f)), 3, frames.back());
+		}
+		if (!frames.empty())
+			return frames;
+
+		ecpu::Tensor image(1, 1080, 1920, 3);
+		for (int y = 0; y < 1080; y++)
+		{
+			for (int x = 0; x < 1920; x++)
+			{
+				const int cell_x = x / 120, cell_y = y / 120;
+				const float dx = x - (cell_x * 120 + 60.0f + 7.0f * (cell_y % 3));
+				const float dy = y - (cell_y * 120 + 60.0f);
+				const bool inside = dx * dx + dy * dy < (30.0f + 3.0f * (cell_x % 5)) * (30.0f + 3.0f * (cell_x % 5));
+				for (int c = 0; c < 3; c++)
+					image.At(0, y, x, c) = inside ? 0.2f + 0.3f * ((cell_x + c) % 3) : 0.1f * ((cell_y + c) % 4);
+			}
+		}
+		frames.push_back(image);
+		return frames;
+	}
+
+	// FXAA with edge compaction against the whole shader per pixel
+	void fxaaBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::vector<ecpu::Tensor> frames = fxaaFrames();
+		std::cout << "CPU FXAA on " << frames.size() << " " << frames[0].Shape().w << "x" << frames[0].Shape().h << " frames ("
+			<< pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+
+		ecpu::FXAAEngine fxaa;
+		ecpu::Tensor output;
+		for (int dense = 1; dense >= 0; dense--)
+		{
+			std::vector<double> times;
+			ecpu::FXAAEngine::Stats sum;
+			for (int i = 0; i < warmup_runs + timed_runs; i++)
+			{
+				double seconds = 0.0;
+				for (const auto& frame : frames)
+				{
+					if (dense)
+						fxaa.ExecuteDense(frame, output, pool);
+					else
+						fxaa.Execute(frame, output, pool);
+					const auto& stats = fxaa.GetLastStats();
+					seconds += stats.TotalSeconds();
+					if (i == warmup_runs)
+					{
+						sum.pixels += stats.pixels;
+						sum.edge_pixels += stats.edge_pixels;
+						sum.luma_seconds += stats.luma_seconds;
+						sum.detect_seconds += stats.detect_seconds;
+						sum.resolve_seconds += stats.resolve_seconds;
+					}
+				}
+				if (i >= warmup_runs)
+					times.push_back(seconds / frames.size());
+			}
+			std::sort(times.begin(), times.end());
+			const double ms = times[times.size() / 2] * 1000.0;
+			const double per_frame = 1000.0 / frames.size();
+			std::cout << "  " << (dense ? "per pixel" : "compacted") << ": " << ms << " ms, " << sum.pixels / frames.size() / (ms * 1000.0)
+				<< " Mpixel/s, " << 100.0 * sum.edge_pixels / sum.pixels << " % edge pixels (luma " << sum.luma_seconds * per_frame
+				<< " ms, detect " << sum.detect_seconds * per_frame << " ms, resolve " << sum.resolve_seconds * per_frame << " ms)" << std::endl;
+		}
+	}
+
+	// Warp of one RGBA texel format with every filter, against a loop over the scalar Sample
+	template <typename T>
+	void resampleFormatBenchmark(const char* format, const std::vector<T>& texels, const ecpu::Tensor& motion, ecpu::ThreadPool& pool)
+	{
+		const char* filter_names[] = { "bilinear", "bilinear border", "catmull-rom 5", "catmull-rom 9", "bicubic border" };
+		const int width = motion.Shape().w;
+		const int height = motion.Shape().h;
+		const ecpu::ImageView<T> image(texels.data(), width, height, 4);
+		ecpu::Tensor out(1, height, width, 4);
+		for (int f = 0; f < 5; f++)
+		{
+			const ecpu::ResampleFilter filter = (ecpu::ResampleFilter)f;
+			const double scalar_ms = medianMs([&]
+				{
+					pool.ParallelFor(height, [&](int y)
+						{
+							for (int x = 0; x < width; x++)
+								ecpu::Sample(image, filter, (x + 0.5f) / width + motion.At(0, y, x, 0),
+									(y + 0.5f) / height + motion.At(0, y, x, 1), &out.At(0, y, x, 0));
+						});
+				});
+			const double warp_ms = medianMs([&] { ecpu::Warp(image, motion, filter, ecpu::CubicKernel::Sharp, out, pool); });
+			std::cout << "  " << format << " " << std::left << std::setw(16) << filter_names[f] << std::right << ": scalar "
+				<< scalar_ms << " ms, warp " << warp_ms << " ms, " << width * height / (warp_ms * 1000.0) << " Mpixel/s" << std::endl;
+		}
+	}
+
+	// The reprojection kernels shared by the CPU engines on 1080p RGBA, with motion of a few pixels
+	void resampleBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::cout << "CPU resampling at 1080p (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		const int width = 1920;
+		const int height = 1080;
+		ecpu::Tensor motion(1, height, width, 2);
+		ecpu::FillInput(motion);
+		for (size_t i = 0; i < motion.ElementCount(); i++)
+			motion.Data()[i] = (motion.Data()[i] - 0.5f) * (i % 2 == 0 ? 8.0f / width : 8.0f / height);
+
+		ecpu::Tensor values(1, height, width, 4);
+		ecpu::FillInput(values);
+		std::vector<float> floats(values.Data(), values.Data() + values.ElementCount());
+		std::vector<uint8_t> bytes(floats.size());
+		std::vector<ecpu::Half> halves(floats.size());
+		for (size_t i = 0; i < floats.size(); i++)
+		{
+			bytes[i] = (uint8_t)(floats[i] * 255.0f);
+			// Exponent 14 halves, 0.5 to 1
+			halves[i] = { (uint16_t)(0x3800 | (uint16_t)(floats[i] * 1023.0f)) };
+		}
+		resampleFormatBenchmark("rgba8", bytes, motion, pool);
+		resampleFormatBenchmark("fp16 ", halves, motion, pool);
+		resampleFormatBenchmark("fp32 ", floats, motion, pool);
+	}
+}
+
+void AABenchmarks(ecpu::ThreadPool& pool)
+{
+	taaBenchmark(pool);
+	fxaaBenchmark(pool);
+	resampleBenchmark(pool);
+}
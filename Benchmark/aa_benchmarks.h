@@ -0,0 +1,5 @@
+#pragma once
+#include "cpu/thread_pool.h"
+
+// CPU TAA, FXAA and the reprojection kernels they share
+void AABenchmarks(ecpu::ThreadPool& pool);
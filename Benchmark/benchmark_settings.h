@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include "cpu/benchmark_helpers.h"
+
+// Run counts and frame sizes shared by the benchmark groups
+
+struct Resolution
+{
+	std::string name;
+	int width;
+	int height;
+};
+
+const Resolution resolutions[] =
+{
+	{ "1080p", 1920, 1080 },
+	{ "4K", 3840, 2160 },
+};
+const int warmup_runs = 1;
+const int timed_runs = 5;
+
+// Median milliseconds of f over the timed runs
+template <typename F>
+double medianMs(F f)
+{
+	return ecpu::MedianMs(warmup_runs, timed_runs, f);
+}
@@ -0,0 +1,550 @@
+#include "network_benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include "cpu/tensor.h"
+#include "cpu/timer.h"
+#include "cpu/layout.h"
+#include "cpu/image_metrics.h"
+#include "deep_learning/cpu/cpu_master_net.h"
+#include "deep_learning/cpu/tiled_executor.h"
+#include "deep_learning/cpu/batched_evaluator.h"
+#include "deep_learning/cpu/incremental_executor.h"
+#include "deep_learning/cpu/conv_autotuner.h"
+#include "benchmark_settings.h"
+
+namespace
+{
+	const size_t tiled_memory_cap = 64 << 20;
+	const int batch_sizes[] = { 1, 2, 4, 8 };
+	const int batched_sequences = 8;
+	const int batched_frames = 3;
+	const int incremental_frames = 20;
+	const int incremental_warmup_frames = 8;
+	const float incremental_thresholds[] = { 0.0f, 8.0f / 255.0f };
+	const int pruned_widths[] = { 24, 16, 8 };
+	const int pruning_frames = 16;
+
+	ecpu::MasterNet::ExecutionStats runSchedule(ecpu::MasterNet& net, const ecpu::Tensor& input, ecpu::Tensor& output,
+		ecpu::ThreadPool& pool, ecpu::MasterNet::Schedule schedule)
+	{
+		std::vector<double> times;
+		for (int i = 0; i < warmup_runs + timed_runs; i++)
+		{
+			net.Execute(input, output, pool, schedule);
+			if (i >= warmup_runs)
+				times.push_back(net.GetLastStats().seconds);
+		}
+		std::sort(times.begin(), times.end());
+		auto stats = net.GetLastStats();
+		stats.seconds = times[times.size() / 2];
+		return stats;
+	}
+
+	// The speedup depends on the machine, compiler and thread count, which main prints first. The
+	// traffic is modelled, counted from the full frame tensor reads and writes of each schedule with
+	// the halo reads, not measured with hardware counters, so it only shows what the fused
+	// schedule keeps out of memory and not whether memory was the bottleneck
+	void fusedResidualBenchmark(ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << "Fused residual blocks vs layer by layer (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+
+		for (const auto& res : resolutions)
+		{
+			ecpu::Tensor input(1, res.height / 4, res.width / 4, net.InputChannels());
+			ecpu::Tensor output_unfused;
+			ecpu::Tensor output_fused;
+			ecpu::FillInput(input);
+
+			auto unfused = runSchedule(net, input, output_unfused, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+			auto fused = runSchedule(net, input, output_fused, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+
+			double unfused_mb = (unfused.bytes_read + unfused.bytes_written) / (1024.0 * 1024.0);
+			double fused_mb = (fused.bytes_read + fused.bytes_written) / (1024.0 * 1024.0);
+
+			std::cout << res.name << std::endl;
+			std::cout << "  layer by layer : " << unfused.seconds * 1000.0 << " ms, " << unfused_mb << " MB modelled tensor traffic" << std::endl;
+			std::cout << "  fused          : " << fused.seconds * 1000.0 << " ms, " << fused_mb << " MB modelled tensor traffic" << std::endl;
+			std::cout << "  speedup        : " << unfused.seconds / fused.seconds << "x" << std::endl;
+			std::cout << "  modelled saved : " << 100.0 * (1.0 - fused_mb / unfused_mb) << " % of the tensor traffic" << std::endl;
+			std::cout << "  extra MACs     : " << 100.0 * ((double)fused.macs / unfused.macs - 1.0) << " % (halo recomputation)" << std::endl;
+			std::cout << "  buffer memory  : " << unfused.buffer_bytes / (1024.0 * 1024.0) << " MB -> " << fused.buffer_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+			std::cout << "  max difference : " << std::setprecision(8) << ecpu::MaxAbsDifference(output_unfused, output_fused) << std::setprecision(2) << std::endl;
+		}
+	}
+
+	double megabytes(unsigned long long bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	// Deterministic input value of a pixel, so streamed tiles do not need a full frame in memory
+	float hashInput(int y, int x, int c)
+	{
+		unsigned int h = (unsigned int)y * 73856093u ^ (unsigned int)x * 19349663u ^ (unsigned int)c * 83492791u;
+		h = (h ^ (h >> 13)) * 0x5bd1e995u;
+		return (float)(h >> 8) / (float)(1 << 24);
+	}
+
+	void tiledBenchmark(ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << "Tiled execution with a " << megabytes(tiled_memory_cap) << " MB cap vs full frame (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+
+		ecpu::TiledExecutor tiled(net, tiled_memory_cap);
+		for (const auto& res : resolutions)
+		{
+			ecpu::Tensor input(1, res.height / 4, res.width / 4, net.InputChannels());
+			ecpu::Tensor output_full;
+			ecpu::Tensor output_tiled;
+			ecpu::FillInput(input);
+
+			auto full = runSchedule(net, input, output_full, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+
+			std::vector<double> times;
+			for (int i = 0; i < warmup_runs + timed_runs; i++)
+			{
+				ecpu::Timer timer;
+				tiled.Execute(input, output_tiled, pool);
+				if (i >= warmup_runs)
+					times.push_back(timer.Elapsed());
+			}
+			std::sort(times.begin(), times.end());
+
+			std::cout << res.name << std::endl;
+			std::cout << "  full frame     : " << full.seconds * 1000.0 << " ms, " << megabytes(full.buffer_bytes) << " MB intermediates" << std::endl;
+			std::cout << "  tiled          : " << times[times.size() / 2] * 1000.0 << " ms, " << megabytes(tiled.WorkingSetBytes()) << " MB tile buffers, "
+				<< tiled.TileCount() << " tiles of " << tiled.TileSize() << " px, halo " << tiled.Halo() << " px" << std::endl;
+			std::cout << "  max difference : " << std::setprecision(8) << ecpu::MaxAbsDifference(output_full, output_tiled) << std::setprecision(2) << std::endl;
+		}
+
+		// 8K streams its input and output tile by tile, the full input tensor alone would be 1 GB
+		ecpu::TensorShape shape(1, 4320 / 4, 7680 / 4, net.InputChannels());
+		double checksum = 0.0;
+		std::mutex checksum_mutex;
+		ecpu::Timer timer;
+		tiled.Execute(shape,
+			[](int, const ecpu::PlaneView& window)
+			{
+				for (int y = window.y0; y < window.y0 + window.height; y++)
+					for (int x = window.x0; x < window.x0 + window.width; x++)
+						for (int c = 0; c < window.channels; c++)
+							window.At(y, x)[c] = hashInput(y, x, c);
+			},
+			[&](int, const ecpu::PlaneView& tile)
+			{
+				double sum = 0.0;
+				for (int y = tile.y0; y < tile.y0 + tile.height; y++)
+					for (int x = tile.x0; x < tile.x0 + tile.width; x++)
+						sum += tile.At(y, x)[0];
+				std::lock_guard<std::mutex> lock(checksum_mutex);
+				checksum += sum;
+			},
+			pool);
+		std::cout << "8K streamed" << std::endl;
+		std::cout << "  tiled          : " << timer.Elapsed() * 1000.0 << " ms, " << megabytes(tiled.WorkingSetBytes()) << " MB tile buffers, "
+			<< tiled.TileCount() << " tiles of " << tiled.TileSize() << " px, checksum " << checksum << std::endl;
+	}
+
+	// Camera pan over a procedural pattern at 540p output, each sequence with its own offset
+	void panningFrame(int sequence, int frame, ecpu::DLTUSFrame& out)
+	{
+		const int width = 960 / 4;
+		const int height = 540 / 4;
+		const int pan = 3;
+		out.color.Resize(ecpu::TensorShape(1, height, width, 3));
+		out.depth.Resize(ecpu::TensorShape(1, height, width, 1));
+		out.motion.Resize(ecpu::TensorShape(1, height, width, 2));
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int wx = x + frame * pan + sequence * 17;
+				for (int c = 0; c < 3; c++)
+					out.color.At(0, y, x, c) = 0.5f + 0.5f * std::sin(0.15f * wx * (c + 1) + 0.1f * y);
+				out.depth.At(0, y, x, 0) = 0.9f + 0.0005f * y;
+				out.motion.At(0, y, x, 0) = (float)pan / width;
+				out.motion.At(0, y, x, 1) = 0.0f;
+			}
+		}
+		out.jitter_x = 0.125f + 0.25f * (frame % 4);
+		out.jitter_y = 0.125f + 0.25f * ((frame / 4) % 4);
+	}
+
+	void batchedBenchmark(ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << "Batched sequence evaluation at 540p (" << pool.ThreadCount() << " threads, "
+			<< batched_sequences << " sequences of " << batched_frames << " frames)" << std::endl;
+
+		double base_fps = 0.0;
+		for (int batch_size : batch_sizes)
+		{
+			ecpu::BatchedEvaluator evaluator(net, 4, batch_size);
+			auto stats = evaluator.Run(batched_sequences, batched_frames, panningFrame, [](int, int, const ecpu::Tensor&) {}, pool);
+			if (base_fps == 0.0)
+				base_fps = stats.FramesPerSecond();
+			std::cout << "  batch " << std::setw(2) << batch_size << " : " << stats.FramesPerSecond() << " fps, "
+				<< 100.0 * stats.stages.network_seconds / stats.seconds << " % in the network, "
+				<< stats.FramesPerSecond() / base_fps << "x batch 1" << std::endl;
+		}
+	}
+
+	// Fixed camera on a static pattern with a small square moving across it at 540p output
+	void staticFrame(int frame, bool jitter, ecpu::DLTUSFrame& out)
+	{
+		const int width = 960 / 4;
+		const int height = 540 / 4;
+		const int square = 12;
+		const int step = 2;
+		const int square_x = 40 + frame * step;
+		const int square_y = 60;
+		out.color.Resize(ecpu::TensorShape(1, height, width, 3));
+		out.depth.Resize(ecpu::TensorShape(1, height, width, 1));
+		out.motion.Resize(ecpu::TensorShape(1, height, width, 2));
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				bool inside = x >= square_x && x < square_x + square && y >= square_y && y < square_y + square;
+				for (int c = 0; c < 3; c++)
+					out.color.At(0, y, x, c) = inside ? 0.9f : 0.5f + 0.5f * std::sin(0.15f * x * (c + 1) + 0.1f * y);
+				out.depth.At(0, y, x, 0) = inside ? 0.5f : 0.9f + 0.0005f * y;
+				out.motion.At(0, y, x, 0) = inside ? -(float)step / width : 0.0f;
+				out.motion.At(0, y, x, 1) = 0.0f;
+			}
+		}
+		out.jitter_x = jitter ? 0.125f + 0.25f * (frame % 4) : 0.5f;
+		out.jitter_y = jitter ? 0.125f + 0.25f * ((frame / 4) % 4) : 0.5f;
+	}
+
+	void incrementalBenchmark(ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Incremental inference at 540p, stats over frames " << incremental_warmup_frames << " to " << incremental_frames << std::endl;
+
+		// Network input that only changes under a moving square, the best case
+		{
+			ecpu::Tensor input(1, 540 / 4, 960 / 4, net.InputChannels());
+			ecpu::FillInput(input);
+			ecpu::Tensor reference;
+			ecpu::IncrementalExecutor incremental(net);
+			double full_ms = 0.0;
+			double ms = 0.0;
+			double skipped = 0.0;
+			float max_error = 0.0f;
+			for (int f = 0; f < incremental_frames; f++)
+			{
+				for (int y = 60; y < 72; y++)
+					for (int x = 40 + 2 * f; x < 52 + 2 * f; x++)
+						for (int c = 0; c < input.Shape().c; c++)
+							input.At(0, y, x, c) = 0.01f * ((f + c) % 100);
+				net.Execute(input, reference, pool);
+				const ecpu::Tensor& output = incremental.Execute(input, pool);
+				max_error = std::max(max_error, ecpu::MaxAbsDifference(output, reference));
+				if (f >= incremental_warmup_frames)
+				{
+					const double n = incremental_frames - incremental_warmup_frames;
+					full_ms += net.GetLastStats().seconds * 1000.0 / n;
+					ms += incremental.GetLastStats().seconds * 1000.0 / n;
+					skipped += incremental.GetLastStats().SkippedRatio() / n;
+				}
+			}
+			std::cout << "  moving square input : full " << full_ms << " ms, incremental " << ms << " ms, " << 100.0 * skipped
+				<< " % skipped, max error " << max_error << std::endl;
+		}
+
+		// Whole DLTUS frames of a static scene, where the history keeps refining under the network
+		for (bool jitter : { false, true })
+		{
+			std::vector<ecpu::Tensor> reference(incremental_frames);
+			ecpu::DLTUSPipeline full(net, 4);
+			ecpu::DLTUSFrame frame;
+			double full_ms = 0.0;
+			for (int f = 0; f < incremental_frames; f++)
+			{
+				staticFrame(f, jitter, frame);
+				full.Execute(&frame, 1, pool);
+				reference[f] = full.GetOutput(0);
+				if (f >= incremental_warmup_frames)
+					full_ms += full.GetLastStats().network_seconds * 1000.0 / (incremental_frames - incremental_warmup_frames);
+			}
+			std::cout << "  static scene, " << (jitter ? "jittered" : "fixed jitter") << " : full " << full_ms << " ms" << std::endl;
+
+			for (float threshold : incremental_thresholds)
+			{
+				ecpu::DLTUSPipeline incremental(net, 4);
+				incremental.SetIncremental(threshold);
+				double ms = 0.0;
+				double skipped = 0.0;
+				float max_error = 0.0f;
+				double min_psnr = INFINITY;
+				for (int f = 0; f < incremental_frames; f++)
+				{
+					staticFrame(f, jitter, frame);
+					incremental.Execute(&frame, 1, pool);
+					max_error = std::max(max_error, ecpu::MaxAbsDifference(incremental.GetOutput(0), reference[f]));
+					min_psnr = std::min(min_psnr, ecpu::PSNR(incremental.GetOutput(0), reference[f], pool));
+					if (f >= incremental_warmup_frames)
+					{
+						const double n = incremental_frames - incremental_warmup_frames;
+						ms += incremental.GetLastStats().network_seconds * 1000.0 / n;
+						skipped += incremental.GetLastStats().skipped_ratio / n;
+					}
+				}
+				std::cout << "    threshold " << threshold * 255.0f << "/255 : " << ms << " ms, " << 100.0 * skipped
+					<< " % skipped, max error " << max_error << ", min PSNR " << min_psnr << " dB" << std::endl;
+			}
+		}
+	}
+
+	void autotuneBenchmark(ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << "Convolution autotuning, layer by layer (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		const auto& layers = net.GetGraph().Layers();
+
+		for (const auto& res : resolutions)
+		{
+			ecpu::Tensor input(1, res.height / 4, res.width / 4, net.InputChannels());
+			ecpu::Tensor output_default;
+			ecpu::Tensor output_tuned;
+			ecpu::FillInput(input);
+
+			net.SetAutotuner(nullptr);
+			auto untuned = runSchedule(net, input, output_default, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+
+			// The first autotuner measures whatever the cache misses, the second starts from the saved
+			// cache. Both first runs include planning, which is where the tuning happens
+			ecpu::Timer tune_timer;
+			ecpu::ConvAutotuner tuner;
+			net.SetAutotuner(&tuner);
+			net.Execute(input, output_tuned, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+			double tune_seconds = tune_timer.Elapsed();
+
+			ecpu::Timer startup_timer;
+			ecpu::ConvAutotuner cached;
+			net.SetAutotuner(&cached);
+			net.Execute(input, output_tuned, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+			double startup_seconds = startup_timer.Elapsed();
+			auto tuned = runSchedule(net, input, output_tuned, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+
+			std::cout << res.name << std::endl;
+			std::cout << "  first run      : " << tune_seconds << " s, tuned " << tuner.TunedShapes() << " new shapes (" << cached.CachePath() << ")" << std::endl;
+			std::cout << "  cached run     : " << startup_seconds * 1000.0 << " ms, " << cached.CacheHits() << " cache hits" << std::endl;
+			for (size_t i = 0; i < layers.size(); i++)
+			{
+				if (layers[i].type != ecpu::GraphLayer::Type::Conv)
+					continue;
+				const ecpu::ConvWeights& w = net.GetLayerWeights((int)i);
+				ecpu::ConvConfig config = cached.Tune(w, layers[i].relu, ecpu::TensorShape(1, res.height / 4, res.width / 4, w.InputChannels()), pool);
+				std::cout << "  " << std::left << std::setw(15) << net.GetGraph().Tensors()[layers[i].output].name << std::right << ": "
+					<< ecpu::ConvAlgorithmName(config.algorithm) << ", " << config.rows_per_task << " rows per task" << std::endl;
+			}
+			std::cout << "  default        : " << untuned.seconds * 1000.0 << " ms" << std::endl;
+			std::cout << "  tuned          : " << tuned.seconds * 1000.0 << " ms" << std::endl;
+			std::cout << "  speedup        : " << untuned.seconds / tuned.seconds << "x" << std::endl;
+			std::cout << "  max difference : " << std::setprecision(8) << ecpu::MaxAbsDifference(output_default, output_tuned) << std::setprecision(2) << std::endl;
+		}
+		net.SetAutotuner(nullptr);
+	}
+
+	// Removes the channels between the two convolutions of every residual block down to inner, ranked
+	// like utils.residualChannelImportance. Stands in for utils.PruneMasterModel when no pruned
+	// weights were exported, without the fine tuning that recovers most of the quality
+	std::unique_ptr<ecpu::MasterNet> pruneNet(const ecpu::NetworkGraph& graph, ecpu::WeightMap weights, int inner)
+	{
+		const auto& layers = graph.Layers();
+		const auto& tensors = graph.Tensors();
+		std::ostringstream text;
+		text << "input " << tensors[graph.InputTensor()].name << " channels=" << tensors[graph.InputTensor()].channels << "\n";
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			const ecpu::GraphLayer& l = layers[i];
+			if (l.type == ecpu::GraphLayer::Type::Add)
+			{
+				text << "add " << tensors[l.output].name << " " << tensors[l.inputs[0]].name << " " << tensors[l.inputs[1]].name << "\n";
+				continue;
+			}
+
+			int channels = tensors[l.output].channels;
+			if (l.relu && l.unshuffle == 1 && i + 1 < layers.size() && layers[i + 1].inputs[0] == l.output)
+			{
+				const ecpu::GraphLayer& next = layers[i + 1];
+				auto& w1 = weights[l.weights + ".weight"];
+				auto& b1 = weights[l.weights + ".bias"];
+				auto& w2 = weights[next.weights + ".weight"];
+				const int cin = tensors[l.inputs[0]].channels;
+				const int taps1 = (int)w1.size() / (channels * cin);
+				const int cout2 = tensors[next.output].channels;
+				const int taps2 = (int)w2.size() / (cout2 * channels);
+
+				std::vector<std::pair<double, int>> importance(channels);
+				for (int c = 0; c < channels; c++)
+				{
+					double produced = std::abs(b1[c]);
+					for (int k = 0; k < cin * taps1; k++)
+						produced += std::abs(w1[(size_t)c * cin * taps1 + k]);
+					double read = 0.0;
+					for (int o = 0; o < cout2; o++)
+						for (int k = 0; k < taps2; k++)
+							read += std::abs(w2[((size_t)o * channels + c) * taps2 + k]);
+					importance[c] = { -produced * read, c };
+				}
+				std::sort(importance.begin(), importance.end());
+				std::vector<int> kept;
+				for (int c = 0; c < std::min(inner, channels); c++)
+					kept.push_back(importance[c].second);
+				std::sort(kept.begin(), kept.end());
+
+				std::vector<float> pw1, pb1, pw2;
+				for (int c : kept)
+				{
+					pw1.insert(pw1.end(), w1.begin() + (size_t)c * cin * taps1, w1.begin() + (size_t)(c + 1) * cin * taps1);
+					pb1.push_back(b1[c]);
+				}
+				for (int o = 0; o < cout2; o++)
+					for (int c : kept)
+						pw2.insert(pw2.end(), w2.begin() + ((size_t)o * channels + c) * taps2, w2.begin() + ((size_t)o * channels + c + 1) * taps2);
+				w1 = pw1;
+				b1 = pb1;
+				w2 = pw2;
+				channels = (int)kept.size();
+			}
+
+			text << "conv " << tensors[l.output].name << " " << tensors[l.inputs[0]].name << " weights=" << l.weights
+				<< " channels=" << channels << " size=" << l.filter_size;
+			if (l.unshuffle != 1)
+				text << " unshuffle=" << l.unshuffle;
+			if (l.stride != 1)
+				text << " stride=" << l.stride;
+			if (l.relu)
+				text << " relu";
+			text << "\n";
+		}
+		text << "output " << tensors[graph.OutputTensor()].name << "\n";
+
+		std::istringstream stream(text.str());
+		return std::unique_ptr<ecpu::MasterNet>(new ecpu::MasterNet(ecpu::NetworkGraph::Parse(stream), weights));
+	}
+
+	void pruningBenchmark(const std::string& weight_path, ecpu::MasterNet& net, ecpu::ThreadPool& pool)
+	{
+		std::cout << "Residual block channel pruning at 1080p, fused schedule (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << "  PSNR is against the unpruned network over " << pruning_frames << " frames of a 540p camera pan" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+
+		ecpu::Tensor input(1, 1080 / 4, 1920 / 4, net.InputChannels());
+		ecpu::Tensor output;
+		ecpu::FillInput(input);
+		auto base = runSchedule(net, input, output, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+
+		// Reference history of the unpruned network
+		std::vector<ecpu::Tensor> reference(pruning_frames);
+		{
+			ecpu::DLTUSPipeline pipeline(net, 4);
+			ecpu::DLTUSFrame frame;
+			for (int f = 0; f < pruning_frames; f++)
+			{
+				panningFrame(0, f, frame);
+				pipeline.Execute(&frame, 1, pool);
+				reference[f] = pipeline.GetOutput(0);
+			}
+		}
+		std::cout << "  32 channels : " << base.seconds * 1000.0 << " ms" << std::endl;
+
+		const std::string folder = weight_path.substr(0, weight_path.find_last_of('/') + 1);
+		const auto weights = ecpu::LoadWeightFile(weight_path);
+		for (int inner : pruned_widths)
+		{
+			// Pruned and fine tuned weights from utils.TestPrunedModels are used when they exist
+			const std::string pruned_path = folder + "nn_weights_pruned_" + std::to_string(inner) + ".bin";
+			const bool trained = (bool)std::ifstream(pruned_path);
+			std::unique_ptr<ecpu::MasterNet> pruned = trained ? std::unique_ptr<ecpu::MasterNet>(new ecpu::MasterNet(pruned_path)) : pruneNet(net.GetGraph(), weights, inner);
+
+			auto stats = runSchedule(*pruned, input, output, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+			ecpu::DLTUSPipeline pipeline(*pruned, 4);
+			ecpu::DLTUSFrame frame;
+			double mean_psnr = 0.0;
+			for (int f = 0; f < pruning_frames; f++)
+			{
+				panningFrame(0, f, frame);
+				pipeline.Execute(&frame, 1, pool);
+				mean_psnr += ecpu::PSNR(pipeline.GetOutput(0), reference[f], pool) / pruning_frames;
+			}
+			std::cout << "  " << std::setw(2) << inner << " channels : " << stats.seconds * 1000.0 << " ms, " << base.seconds / stats.seconds
+				<< "x, " << 100.0 * stats.macs / base.macs << " % of the MACs, PSNR " << mean_psnr << " dB"
+				<< (trained ? " (" + pruned_path + ")" : " (pruned without fine tuning)") << std::endl;
+		}
+	}
+
+	// Layout changes at the shapes of the 1080p network: element by element through the view
+	// against the blocked copies, and the first convolution on a copied pixel unshuffle against
+	// the pixel shuffled filter reading the image in place
+	void layoutBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::cout << "CPU layout transforms at 1080p (" << pool.ThreadCount() << " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		auto elementwise = [&](const ecpu::LayoutView& view, ecpu::Tensor& out)
+		{
+			const ecpu::TensorShape& s = view.shape;
+			out.Resize(s);
+			pool.ParallelFor(s.n * s.h, [&](int row)
+				{
+					float* dst = out.Data() + (size_t)row * s.w * s.c;
+					for (int x = 0; x < s.w; x++)
+						for (int c = 0; c < s.c; c++)
+							dst[x * s.c + c] = view.At(row / s.h, row % s.h, x, c);
+				});
+		};
+
+		ecpu::Tensor activations(1, 270, 480, 32);
+		ecpu::FillInput(activations);
+		std::vector<float> nchw(activations.ElementCount());
+		ecpu::StoreNCHW(activations, nchw.data(), pool);
+		const ecpu::LayoutView nchw_view = ecpu::NCHWView(nchw.data(), activations.Shape());
+		ecpu::Tensor out;
+		std::cout << "  NCHW to NHWC { 270, 480, 32 }: element wise " << medianMs([&] { elementwise(nchw_view, out); })
+			<< " ms, blocked " << medianMs([&] { ecpu::Materialize(nchw_view, out, pool); }) << " ms" << std::endl;
+		std::cout << "  NHWC to NCHW { 270, 480, 32 }: blocked " << medianMs([&] { ecpu::StoreNCHW(activations, nchw.data(), pool); })
+			<< " ms" << std::endl;
+
+		ecpu::Tensor frame(1, 1080, 1920, 8);
+		ecpu::FillInput(frame);
+		const ecpu::LayoutView unshuffled = ecpu::PixelUnshuffleView(ecpu::NHWCView(frame), 4);
+		ecpu::Tensor unshuffled_copy;
+		std::cout << "  pixel unshuffle { 1080, 1920, 8 } by 4: element wise " << medianMs([&] { elementwise(unshuffled, unshuffled_copy); })
+			<< " ms, blocked " << medianMs([&] { ecpu::Materialize(unshuffled, unshuffled_copy, pool); }) << " ms" << std::endl;
+		ecpu::Tensor shuffled;
+		const ecpu::LayoutView shuffle_view = ecpu::PixelShuffleView(ecpu::NHWCView(unshuffled_copy), 4);
+		std::cout << "  pixel shuffle { 270, 480, 128 } by 4: element wise " << medianMs([&] { elementwise(shuffle_view, shuffled); })
+			<< " ms, blocked " << medianMs([&] { ecpu::Materialize(shuffle_view, shuffled, pool); }) << " ms" << std::endl;
+
+		std::vector<float> weights((size_t)32 * 128), bias(32, 0.0f);
+		for (size_t i = 0; i < weights.size(); i++)
+			weights[i] = (float)((i * 7919) % 1000) / 1000.0f - 0.5f;
+		const ecpu::ConvWeights unshuffled_weights(weights, bias, 32, 128, 1);
+		const ecpu::ConvWeights shuffled_weights(ecpu::PixelShuffleFilter(weights, 32, 128, 1, 4), bias, 32, 8, 4, 4, 0);
+		std::cout << "  1x1 convolution 128 -> 32 over the unshuffle: copy and convolve "
+			<< medianMs([&] { ecpu::Convolve(unshuffled, unshuffled_weights, false, out, pool); }) << " ms, in place "
+			<< medianMs([&] { ecpu::Convolve(frame, shuffled_weights, false, out, pool); }) << " ms" << std::endl;
+	}
+}
+
+void NetworkBenchmarks(const std::string& weight_path, ecpu::ThreadPool& pool)
+{
+	ecpu::MasterNet net(weight_path);
+	fusedResidualBenchmark(net, pool);
+	tiledBenchmark(net, pool);
+	batchedBenchmark(net, pool);
+	incrementalBenchmark(net, pool);
+	autotuneBenchmark(net, pool);
+	pruningBenchmark(weight_path, net, pool);
+	layoutBenchmark(pool);
+}
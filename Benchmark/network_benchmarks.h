@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include "cpu/thread_pool.h"
+
+// MasterNet schedules, tiling, batching, incremental updates, autotuning, pruning and the layout
+// transforms of the network, on the weights at weight_path
+void NetworkBenchmarks(const std::string& weight_path, ecpu::ThreadPool& pool);
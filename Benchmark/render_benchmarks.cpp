@@ -0,0 +1,741 @@
+#include "render_benchmarks.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include "cpu/tensor.h"
+#include "cpu/timer.h"
+#include "cpu/frustum.h"
+#include "cpu/transform_hierarchy.h"
+#include "cpu/image_metrics.h"
+#include "io/objb.h"
+#include "deferred_rendering/cpu/cpu_rasterizer.h"
+#include "deferred_rendering/cpu/draw_batcher.h"
+#include "ray_tracer/cpu/cpu_ray_tracer.h"
+#include "scenes/cpu/cpu_scene.h"
+#include "scenes/cpu/stress_scene.h"
+#include "benchmark_settings.h"
+
+namespace
+{
+	const char* raster_model = "../Rendering/models/knight";
+	const int raster_grid = 8;
+	const int trace_width = 960;
+	const int trace_height = 540;
+	// Sponza is only measured when its .objb has been baked by the GPU renderer
+	const char* bvh_models[] = { "../Rendering/models/sponza", raster_model };
+	const int adaptive_average_samples = 64;
+	const int adaptive_max_factors[] = { 1, 4 };
+	const float adaptive_thresholds[] = { 4.0f / 255.0f, 1.0f / 255.0f };
+	const int occlusion_width = 256;
+	const int occlusion_height = 144;
+	const int occlusion_frames = 16;
+	const char* camera_folder = "../DatasetGenerator/camera_positions/";
+	const int frustum_boxes = 100000;
+	const int transform_nodes = 100000;
+	const float transform_dynamic_fractions[] = { 0.0f, 0.01f, 0.1f, 1.0f };
+	// Synthetic scenes of the draw batching benchmark, each mesh with one of the materials
+	struct BatchScene
+	{
+		int meshes;
+		int materials;
+	};
+	const int batch_draws = 100000;
+	const BatchScene batch_scenes[] = { { 10, 4 }, { 100, 20 }, { 1000, 100 }, { 10000, 1000 } };
+	// Props are the baked models found, the curves are written for plotting
+	const char* stress_props[] = { raster_model, "../Rendering/models/good-well", "../Rendering/models/sponza" };
+	const int stress_instance_counts[] = { 10, 100, 1000, 10000, 100000 };
+	const int stress_materials = 16;
+	const float stress_dynamic_fraction = 0.1f;
+	const char* stress_curve_file = "stress_scaling.csv";
+
+	// Grid of untextured knights filling a 1080p view, from the front rows covering many tiles
+	// to the back rows of small triangles
+	void rasterBenchmark(ecpu::ThreadPool& pool)
+	{
+		const std::vector<eio::ObjbMesh> meshes = eio::LoadObjb(raster_model);
+		const std::vector<eio::ObjbMaterial> mtl = eio::LoadMtl(raster_model);
+		std::vector<ecpu::RasterMaterial> materials(mtl.size());
+		for (size_t i = 0; i < mtl.size(); i++)
+			std::copy(mtl[i].diffuse_color, mtl[i].diffuse_color + 3, materials[i].diffuse_color);
+
+		std::vector<ecpu::RasterDraw> draws;
+		for (int z = 0; z < raster_grid; z++)
+			for (int x = 0; x < raster_grid; x++)
+				for (const auto& mesh : meshes)
+				{
+					ecpu::RasterDraw draw;
+					draw.mesh = &mesh;
+					draw.material = &materials.at(mesh.material_index);
+					draw.world = ecpu::Matrix4::World(ecpu::Vector3(1.2f * x - 0.6f * raster_grid, -0.8f - 0.1f * z, 3.0f + 1.5f * z),
+						ecpu::Vector3(0.0f, 0.0f, 3.14159265f), ecpu::Vector3(1.0f, 1.0f, 1.0f));
+					draw.last_world = draw.world;
+					draws.push_back(draw);
+				}
+
+		ecpu::RasterCamera camera(1920, 1080, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.Update();
+		ecpu::SoftwareRasterizer rasterizer(1920, 1080);
+		std::cout << "CPU rasterizer, " << raster_grid * raster_grid << " knights at 1080p (" << pool.ThreadCount()
+			<< " threads, median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+
+		std::vector<double> times;
+		ecpu::SoftwareRasterizer::Stats sum;
+		for (int i = 0; i < warmup_runs + timed_runs; i++)
+		{
+			rasterizer.Render(draws, camera, pool);
+			const auto& stats = rasterizer.GetLastStats();
+			if (i < warmup_runs)
+				continue;
+			times.push_back(stats.TotalSeconds());
+			sum.triangles = stats.triangles;
+			sum.rasterized_triangles = stats.rasterized_triangles;
+			sum.bin_entries = stats.bin_entries;
+			sum.vertex_seconds += stats.vertex_seconds;
+			sum.setup_seconds += stats.setup_seconds;
+			sum.raster_seconds += stats.raster_seconds;
+			sum.resolve_seconds += stats.resolve_seconds;
+		}
+		std::sort(times.begin(), times.end());
+		const double ms = times[times.size() / 2] * 1000.0;
+		const double per_run = 1000.0 / timed_runs;
+		std::cout << "  " << ms << " ms, " << sum.triangles / (ms * 1000.0) << " Mtri/s, " << sum.rasterized_triangles
+			<< " of " << sum.triangles << " triangles rasterized, " << (double)sum.bin_entries / std::max<size_t>(sum.rasterized_triangles, 1)
+			<< " tiles per triangle (vertex " << sum.vertex_seconds * per_run << " ms, setup " << sum.setup_seconds * per_run
+			<< " ms, raster " << sum.raster_seconds * per_run << " ms, resolve " << sum.resolve_seconds * per_run << " ms)" << std::endl;
+	}
+
+	// The knight grid of the rasterizer benchmark with textures
+	std::vector<ecpu::RasterDraw> knightGrid(const ecpu::CPUModel& knight)
+	{
+		std::vector<ecpu::RasterDraw> draws;
+		for (int z = 0; z < raster_grid; z++)
+			for (int x = 0; x < raster_grid; x++)
+				for (size_t i = 0; i < knight.Meshes().size(); i++)
+				{
+					ecpu::RasterDraw draw;
+					draw.mesh = &knight.Meshes()[i];
+					draw.material = &knight.Materials()[i];
+					draw.world = ecpu::Matrix4::World(ecpu::Vector3(1.2f * x - 0.6f * raster_grid, -0.8f - 0.1f * z, 3.0f + 1.5f * z),
+						ecpu::Vector3(0.0f, 0.0f, 3.14159265f), ecpu::Vector3(1.0f, 1.0f, 1.0f));
+					draw.last_world = draw.world;
+					draw.bounds = &knight.MeshBounds()[i];
+					draws.push_back(draw);
+				}
+		return draws;
+	}
+
+	// The textured knight grid, one sample per pixel
+	void rayTraceBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::map<std::string, eio::PngImage> textures;
+		const ecpu::CPUModel knight(raster_model, textures);
+		std::vector<ecpu::RasterDraw> draws = knightGrid(knight);
+
+		ecpu::RasterCamera camera(trace_width, trace_height, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.Update();
+		ecpu::CPURayTracer tracer(trace_width, trace_height);
+		tracer.Build(draws, pool);
+		std::cout << "CPU ray tracer, " << raster_grid * raster_grid << " knights at " << trace_width << "x" << trace_height
+			<< " (median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		const auto& build = tracer.GetLastStats();
+		std::cout << "  First build " << build.build_seconds * 1000.0 << " ms, " << build.bottom_level_builds << " bottom levels, "
+			<< build.instances << " instances, " << build.triangles << " triangles" << std::endl;
+
+		// Later frames where the first row of knights moves, like the knights of the Sponza scene
+		std::vector<double> update_times;
+		for (int i = 0; i < warmup_runs + timed_runs; i++)
+		{
+			for (int d = 0; d < raster_grid * (int)knight.Meshes().size(); d++)
+				draws[d].world = draws[d].world * ecpu::Matrix4::Translation(ecpu::Vector3(0.0f, 0.0f, 0.01f));
+			tracer.Build(draws, pool);
+			if (i >= warmup_runs)
+				update_times.push_back(tracer.GetLastStats().build_seconds);
+		}
+		std::sort(update_times.begin(), update_times.end());
+		std::cout << "  Frame update " << update_times[update_times.size() / 2] * 1000.0 << " ms, top level "
+			<< (tracer.GetLastStats().top_level_refit ? "refit" : "rebuilt") << std::endl;
+
+		const std::vector<JitterPoint> jitter = { { 0.5f, 0.5f } };
+		ecpu::ThreadPool single(1);
+		double single_ms = 0.0;
+		for (ecpu::ThreadPool* p : { &single, &pool })
+		{
+			std::vector<double> times;
+			for (int i = 0; i < warmup_runs + timed_runs; i++)
+			{
+				tracer.Render(camera, jitter, 1, *p);
+				if (i >= warmup_runs)
+					times.push_back(tracer.GetLastStats().trace_seconds);
+			}
+			std::sort(times.begin(), times.end());
+			const double ms = times[times.size() / 2] * 1000.0;
+			if (p == &single)
+				single_ms = ms;
+			const auto& stats = tracer.GetLastStats();
+			std::cout << "  " << p->ThreadCount() << " threads: " << ms << " ms, " << stats.Rays() / (ms * 1000.0) << " Mrays/s ("
+				<< stats.primary_rays << " primary, " << stats.shadow_rays << " shadow, " << stats.reflection_rays << " reflection), "
+				<< single_ms / ms << "x" << std::endl;
+		}
+	}
+
+	// Reference quality renders of the knight grid: the fixed sample count of SSAA against
+	// adaptive sampling with the same average budget, capped at the fixed count or spending up to
+	// four times as many samples on a pixel. The saved samples are mostly cheap sky misses, the
+	// knight edges they move to cost several times as much per sample. The errors are against
+	// the fixed render, not the converged image
+	void adaptiveSamplingBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::map<std::string, eio::PngImage> textures;
+		const ecpu::CPUModel knight(raster_model, textures);
+		ecpu::RasterCamera camera(trace_width, trace_height, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.Update();
+		ecpu::CPURayTracer tracer(trace_width, trace_height);
+		tracer.Build(knightGrid(knight), pool);
+		const double pixels = (double)trace_width * trace_height;
+
+		std::cout << "Adaptive sampling, " << raster_grid * raster_grid << " knights at " << trace_width << "x" << trace_height << " ("
+			<< pool.ThreadCount() << " threads)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		tracer.Render(camera, HaltonJitterPoints(2, 3, adaptive_average_samples), adaptive_average_samples, pool);
+		const ecpu::Tensor fixed = tracer.GetColor();
+		const double fixed_ms = tracer.GetLastStats().trace_seconds * 1000.0;
+		std::cout << "  fixed " << adaptive_average_samples << " spp : " << fixed_ms << " ms" << std::endl;
+
+		ecpu::AdaptiveSamplingSettings settings;
+		settings.average_samples = adaptive_average_samples;
+		for (int max_factor : adaptive_max_factors)
+		{
+			settings.max_samples = max_factor * adaptive_average_samples;
+			const auto jitter = HaltonJitterPoints(2, 3, settings.max_samples);
+			for (float threshold : adaptive_thresholds)
+			{
+				settings.threshold = threshold;
+				tracer.RenderAdaptive(camera, jitter, settings, pool);
+				const auto& stats = tracer.GetLastStats();
+				const double ms = stats.trace_seconds * 1000.0;
+				std::cout << "  at most " << settings.max_samples << " spp, threshold " << threshold * 255.0f << "/255 : " << ms << " ms, "
+					<< fixed_ms / ms << "x, " << stats.primary_rays / pixels << " spp, " << 100.0 * (1.0 - (double)stats.primary_rays / stats.budget_samples)
+					<< " % of the samples saved, " << 100.0 * stats.converged_pixels / pixels << " % of the pixels converged, max error "
+					<< ecpu::MaxAbsDifference(tracer.GetColor(), fixed) << ", PSNR " << ecpu::PSNR(tracer.GetColor(), fixed, pool) << " dB" << std::endl;
+			}
+		}
+	}
+
+	// Builds over all triangles of a model in one mesh, like a bottom level of the ray tracer
+	void bvhBenchmarkModel(const std::string& name, const std::vector<eio::ObjbMesh>& meshes, ecpu::ThreadPool& pool)
+	{
+		std::vector<ecpu::Vector3> vertices;
+		std::vector<uint32_t> indices;
+		for (const auto& mesh : meshes)
+		{
+			const uint32_t offset = (uint32_t)vertices.size();
+			for (const auto& v : mesh.vertices)
+				vertices.push_back(ecpu::Vector3(v.position[0], v.position[1], v.position[2]));
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+				for (int k = 0; k < 3; k++)
+					indices.push_back(offset + mesh.indices[i + k]);
+		}
+		std::cout << "  " << name << ", " << indices.size() / 3 << " triangles" << std::endl;
+
+		std::vector<int> thread_counts;
+		for (int t = 1; t < pool.ThreadCount(); t *= 2)
+			thread_counts.push_back(t);
+		thread_counts.push_back(pool.ThreadCount());
+		for (bool spatial : { false, true })
+		{
+			ecpu::BvhBuildSettings settings;
+			settings.spatial_splits = spatial;
+			ecpu::Bvh8 bvh;
+			double single_ms = 0.0;
+			for (int threads : thread_counts)
+			{
+				ecpu::ThreadPool build_pool(threads);
+				std::vector<double> times;
+				for (int i = 0; i < warmup_runs + timed_runs; i++)
+				{
+					bvh.BuildTriangles(vertices, indices, settings, build_pool);
+					if (i >= warmup_runs)
+						times.push_back(bvh.GetBuildStats().seconds);
+				}
+				std::sort(times.begin(), times.end());
+				const double ms = times[times.size() / 2] * 1000.0;
+				if (threads == 1)
+					single_ms = ms;
+				std::cout << "    " << (spatial ? "spatial" : "object ") << " splits, " << threads << " threads: " << ms << " ms, "
+					<< single_ms / ms << "x" << std::endl;
+			}
+			const auto& stats = bvh.GetBuildStats();
+			std::cout << "    " << (spatial ? "spatial" : "object ") << " splits: SAH cost " << stats.sah_cost << ", " << stats.nodes << " nodes, "
+				<< stats.leaves << " leaves, " << stats.binary_nodes << " binary nodes, depth " << stats.depth << ", " << stats.references
+				<< " references (" << stats.spatial_splits << " spatial splits)" << std::endl;
+		}
+	}
+
+	// Binned SAH builds with and without spatial splits on the baked models and the flattened
+	// knight grid of the ray tracer benchmark, across thread counts
+	void bvhBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::cout << "CPU BVH builder (median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		for (const char* model : bvh_models)
+		{
+			if (!std::ifstream(std::string(model) + ".objb"))
+			{
+				std::cout << "  " << model << ".objb not found, skipped" << std::endl;
+				continue;
+			}
+			bvhBenchmarkModel(model, eio::LoadObjb(model), pool);
+		}
+
+		// Every knight of the grid placed in world space, one flat tree without instancing
+		const auto knight = eio::LoadObjb(raster_model);
+		std::vector<eio::ObjbMesh> grid;
+		for (int z = 0; z < raster_grid; z++)
+			for (int x = 0; x < raster_grid; x++)
+				for (auto mesh : knight)
+				{
+					for (auto& v : mesh.vertices)
+					{
+						v.position[0] += 1.2f * x;
+						v.position[2] += 1.5f * z;
+					}
+					grid.push_back(mesh);
+				}
+		bvhBenchmarkModel(std::to_string(raster_grid * raster_grid) + " knights", grid, pool);
+	}
+
+	// Frustum culling of random mesh bounds scattered around the camera: moving them to world
+	// space into the SoA array, then the float8 test against the scalar test of one box at a time
+	void frustumBenchmark()
+	{
+		unsigned int state = 4321u;
+		auto random = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) / (float)(1 << 24); };
+		std::vector<ecpu::Aabb> boxes(frustum_boxes);
+		std::vector<ecpu::Matrix4> worlds(frustum_boxes);
+		for (int i = 0; i < frustum_boxes; i++)
+		{
+			const ecpu::Vector3 extent(random(), random(), random());
+			boxes[i].Grow(extent * -1.0f);
+			boxes[i].Grow(extent);
+			worlds[i] = ecpu::Matrix4::World(ecpu::Vector3((random() - 0.5f) * 200.0f, (random() - 0.5f) * 20.0f, (random() - 0.5f) * 200.0f),
+				ecpu::Vector3(0.0f, 0.0f, random() * 6.28f), ecpu::Vector3(1.0f, 1.0f, 1.0f));
+		}
+		ecpu::RasterCamera camera(1920, 1080, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.Update();
+		const ecpu::Frustum frustum = ecpu::Frustum::FromMatrix(camera.ViewMatrix() * camera.ProjectionMatrixNoJitter());
+
+		std::cout << "Frustum culling, " << frustum_boxes << " boxes (median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		ecpu::BoundsSoA bounds;
+		std::vector<ecpu::Aabb> world_boxes(frustum_boxes);
+		std::vector<uint32_t> visible;
+		std::vector<double> transform_times, soa_times, scalar_times;
+		size_t scalar_visible = 0;
+		for (int run = 0; run < warmup_runs + timed_runs; run++)
+		{
+			ecpu::Timer timer;
+			bounds.Clear();
+			for (int i = 0; i < frustum_boxes; i++)
+				bounds.PushTransformed(boxes[i], worlds[i]);
+			const double transform_seconds = timer.Elapsed();
+			for (int i = 0; i < frustum_boxes; i++)
+				world_boxes[i] = bounds.Get(i);
+
+			timer.Reset();
+			visible.clear();
+			bounds.Cull(frustum, visible);
+			const double soa_seconds = timer.Elapsed();
+
+			timer.Reset();
+			scalar_visible = 0;
+			for (const auto& b : world_boxes)
+			{
+				bool inside = true;
+				for (int p = 0; p < 6 && inside; p++)
+				{
+					const float* f = frustum.planes[p];
+					inside = f[0] * (f[0] >= 0.0f ? b.max.x : b.min.x) + f[1] * (f[1] >= 0.0f ? b.max.y : b.min.y) +
+						f[2] * (f[2] >= 0.0f ? b.max.z : b.min.z) + f[3] >= 0.0f;
+				}
+				scalar_visible += inside ? 1 : 0;
+			}
+			const double scalar_seconds = timer.Elapsed();
+			if (run < warmup_runs)
+				continue;
+			transform_times.push_back(transform_seconds);
+			soa_times.push_back(soa_seconds);
+			scalar_times.push_back(scalar_seconds);
+		}
+		for (auto* times : { &transform_times, &soa_times, &scalar_times })
+			std::sort(times->begin(), times->end());
+		const double transform_ms = transform_times[timed_runs / 2] * 1000.0;
+		const double soa_ms = soa_times[timed_runs / 2] * 1000.0;
+		const double scalar_ms = scalar_times[timed_runs / 2] * 1000.0;
+		std::cout << "  to world space " << transform_ms << " ms, SoA float8 test " << soa_ms << " ms (" << soa_ms * 1e6 / frustum_boxes
+			<< " ns per box), scalar test " << scalar_ms << " ms, " << scalar_ms / soa_ms << "x, " << visible.size() << " visible ("
+			<< (visible.size() == scalar_visible ? "same as scalar" : "DIFFERS from scalar") << ")" << std::endl;
+	}
+
+	// World matrices of a scene of models, a quarter of them children of another model, with a
+	// fraction of the roots moving every frame. Recomputing every matrix with Matrix4::World,
+	// what the models did before, against the hierarchy updating only the dirty nodes
+	void transformBenchmark()
+	{
+		unsigned int state = 8765u;
+		auto random = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) / (float)(1 << 24); };
+		ecpu::TransformHierarchy transforms;
+		std::vector<ecpu::Vector3> positions(transform_nodes), rotations(transform_nodes), scales(transform_nodes);
+		std::vector<uint32_t> roots;
+		for (int i = 0; i < transform_nodes; i++)
+		{
+			const bool child = !roots.empty() && random() < 0.25f;
+			const uint32_t node = transforms.Add(child ? roots[(size_t)(random() * roots.size()) % roots.size()] : ecpu::TransformHierarchy::no_parent);
+			if (!child)
+				roots.push_back(node);
+			positions[i] = ecpu::Vector3(random() * 100.0f, 0.0f, random() * 100.0f);
+			rotations[i] = ecpu::Vector3(0.0f, 0.0f, random() * 6.28f);
+			scales[i] = ecpu::Vector3(1.0f, 1.0f, 1.0f);
+			transforms.SetPosition(node, positions[i]);
+			transforms.SetRotation(node, rotations[i]);
+		}
+		transforms.Update();
+		transforms.ClearChanged();
+
+		std::cout << "Transform hierarchy, " << transform_nodes << " nodes (median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(3);
+		std::vector<ecpu::Matrix4> worlds(transform_nodes);
+		std::vector<double> full_times;
+		for (int run = 0; run < warmup_runs + timed_runs; run++)
+		{
+			ecpu::Timer timer;
+			for (int i = 0; i < transform_nodes; i++)
+			{
+				worlds[i] = ecpu::Matrix4::World(positions[i], rotations[i], scales[i]);
+				const uint32_t parent = transforms.Parent(i);
+				if (parent != ecpu::TransformHierarchy::no_parent)
+					worlds[i] = worlds[i] * worlds[parent];
+			}
+			if (run >= warmup_runs)
+				full_times.push_back(timer.Elapsed());
+		}
+		std::sort(full_times.begin(), full_times.end());
+		const double full_ms = full_times[timed_runs / 2] * 1000.0;
+		std::cout << "  every matrix with Matrix4::World " << full_ms << " ms, " << transform_nodes << " uploads" << std::endl;
+
+		float time = 0.0f;
+		for (float fraction : transform_dynamic_fractions)
+		{
+			const size_t moving = (size_t)(fraction * roots.size());
+			std::vector<double> times;
+			size_t updated = 0, uploads = 0;
+			for (int run = 0; run < warmup_runs + timed_runs; run++)
+			{
+				time += 0.016f;
+				ecpu::Timer timer;
+				for (size_t i = 0; i < moving; i++)
+					transforms.SetRotation(roots[i], ecpu::Vector3(0.0f, 0.0f, time + (float)i));
+				transforms.Update();
+				uploads = transforms.Changed().size();
+				transforms.ClearChanged();
+				if (run < warmup_runs)
+					continue;
+				times.push_back(timer.Elapsed());
+				updated = transforms.GetLastStats().updated;
+			}
+			std::sort(times.begin(), times.end());
+			const double ms = times[timed_runs / 2] * 1000.0;
+			std::cout << "  " << std::setw(7) << fraction * 100.0f << "% of roots moving: " << ms << " ms, " << updated << " matrices, " << uploads << " uploads";
+			if (moving > 0)
+				std::cout << ", " << std::setprecision(1) << full_ms / ms << "x" << std::setprecision(3);
+			std::cout << std::endl;
+		}
+	}
+
+	void drawBatchBenchmark()
+	{
+		std::cout << "Draw batching, " << batch_draws << " draws in random order (median of " << timed_runs << " runs)" << std::endl;
+		std::cout << std::fixed << std::setprecision(3);
+		for (const auto& scene : batch_scenes)
+		{
+			// A tenth of the materials are alpha tested, a fifth of the draws are also in the dynamic pass
+			unsigned int state = 4321u;
+			auto random = [&]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+			ecpu::DrawBatcher batcher;
+			std::vector<ecpu::DrawItem> items;
+			for (uint32_t i = 0; i < (uint32_t)batch_draws; i++)
+			{
+				const uint32_t mesh = random() % scene.meshes;
+				const uint32_t material = mesh % scene.materials;
+				const uint32_t pipeline = material % 10 == 0 ? 1 : 0;
+				const float depth = (float)(random() % 1000) / 1000.0f;
+				items.push_back({ ecpu::DrawKey::Make(0, pipeline, material, mesh, depth), i });
+				if (random() % 5 == 0)
+					items.push_back({ ecpu::DrawKey::Make(1, pipeline, material, mesh, depth), i });
+			}
+
+			std::vector<double> times, sort_times, std_times;
+			for (int run = 0; run < warmup_runs + timed_runs; run++)
+			{
+				ecpu::Timer timer;
+				batcher.Clear();
+				for (const auto& item : items)
+					batcher.Add(item.key, item.instance);
+				batcher.Build();
+				const double seconds = timer.Elapsed();
+
+				auto sorted = items;
+				timer.Reset();
+				std::stable_sort(sorted.begin(), sorted.end(), [](const ecpu::DrawItem& a, const ecpu::DrawItem& b) { return a.key < b.key; });
+				if (run < warmup_runs)
+					continue;
+				std_times.push_back(timer.Elapsed());
+				times.push_back(seconds);
+				sort_times.push_back(batcher.GetLastStats().sort_seconds);
+			}
+			std::sort(times.begin(), times.end());
+			std::sort(sort_times.begin(), sort_times.end());
+			std::sort(std_times.begin(), std_times.end());
+			const auto& stats = batcher.GetLastStats();
+			std::cout << "  " << std::setw(5) << scene.meshes << " meshes, " << std::setw(4) << scene.materials << " materials: " << stats.draws << " draws -> "
+				<< stats.batches << " instanced draws, build " << times[timed_runs / 2] * 1000.0 << " ms (radix sort " << sort_times[timed_runs / 2] * 1000.0
+				<< " ms, std::stable_sort " << std_times[timed_runs / 2] * 1000.0 << " ms)" << std::endl;
+			std::cout << "    state changes unsorted -> sorted: pipeline " << stats.unsorted_pipeline_changes << " -> " << stats.pipeline_changes
+				<< ", material " << stats.unsorted_material_changes << " -> " << stats.material_changes << ", mesh " << stats.unsorted_mesh_changes
+				<< " -> " << stats.mesh_changes << std::endl;
+		}
+	}
+
+	void stressSceneBenchmark()
+	{
+		std::vector<ecpu::StressProp> props;
+		std::cout << "Stress scene frame preparation, " << stress_materials << " material variants, " << stress_dynamic_fraction * 100.0f
+			<< " % dynamic (median of " << timed_runs << " frames)" << std::endl;
+		for (const char* model : stress_props)
+		{
+			if (!std::ifstream(std::string(model) + ".objb"))
+			{
+				std::cout << "  " << model << ".objb not found, skipped" << std::endl;
+				continue;
+			}
+			props.push_back(ecpu::LoadStressProp(model));
+		}
+		if (props.empty())
+			return;
+
+		// A player's view from the middle of the grid and the shadow map camera of LightManager
+		ecpu::RasterCamera camera(1920, 1080, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.SetPosition(ecpu::Vector3(0.0f, 1.7f, 0.0f));
+		camera.Update();
+		const ecpu::Matrix4 view_projection = camera.ViewMatrix() * camera.ProjectionMatrixNoJitter();
+		const ecpu::Vector3 light_direction = ecpu::Vector3(0.15f, -1.0f, 0.15f).Normalized();
+		const ecpu::Matrix4 shadow_view_projection = ecpu::Matrix4::LookAt(light_direction * -50.0f, ecpu::Vector3(), ecpu::Vector3(0.0f, 0.0f, 1.0f)) *
+			ecpu::Matrix4::Orthographic(40.0f, 40.0f, 1.0f, 100.0f);
+
+		std::ofstream curves(stress_curve_file);
+		curves << "instances,meshes,camera_meshes,shadow_meshes,instanced_draws,uploads,setup_ms,transform_ms,gather_ms,cull_ms,batch_ms,total_ms" << std::endl;
+		std::cout << std::fixed << std::setprecision(3);
+		double last_total = 0.0;
+		int last_count = 0;
+		for (int count : stress_instance_counts)
+		{
+			ecpu::StressSceneDesc desc;
+			desc.instances = count;
+			desc.materials = stress_materials;
+			desc.dynamic_fraction = stress_dynamic_fraction;
+			ecpu::Timer timer;
+			ecpu::CPUStressScene scene(desc, props);
+			const double setup_ms = timer.Elapsed() * 1000.0;
+
+			std::vector<double> transform_times, gather_times, cull_times, batch_times, total_times;
+			float time = 0.0f;
+			for (int run = 0; run < warmup_runs + timed_runs; run++)
+			{
+				time += 0.016f;
+				scene.Update(time);
+				scene.PrepareFrame(view_projection, shadow_view_projection);
+				if (run < warmup_runs)
+					continue;
+				const auto& stats = scene.GetLastStats();
+				transform_times.push_back(stats.transform_seconds);
+				gather_times.push_back(stats.gather_seconds);
+				cull_times.push_back(stats.cull_seconds);
+				batch_times.push_back(stats.batch_seconds);
+				total_times.push_back(stats.TotalSeconds());
+			}
+			const auto& culled = scene.GetDrawCuller().GetLastStats();
+			const size_t draws = scene.GetDrawCuller().Batches().size();
+			const size_t uploads = scene.GetLastStats().uploads;
+			const double total = ecpu::MedianMs(total_times);
+			std::cout << "  " << std::setw(6) << count << " instances: " << total << " ms, " << total * 1000.0 / count << " us per instance (transforms "
+				<< ecpu::MedianMs(transform_times) << ", gather " << ecpu::MedianMs(gather_times) << ", culling " << ecpu::MedianMs(cull_times) << ", batching "
+				<< ecpu::MedianMs(batch_times) << " ms)" << std::endl;
+			std::cout << "    " << culled.meshes << " meshes, " << culled.camera_meshes << " in view, " << culled.shadow_meshes << " in the shadow map, "
+				<< draws << " instanced draws, " << uploads << " uploads, setup " << setup_ms << " ms";
+			// Slope of the log-log curve, 1 is linear scaling
+			if (last_count > 0 && last_total > 0.0)
+				std::cout << ", scaling exponent " << std::setprecision(2) << std::log(total / last_total) / std::log((double)count / last_count) << std::setprecision(3);
+			std::cout << std::endl;
+			curves << count << "," << culled.meshes << "," << culled.camera_meshes << "," << culled.shadow_meshes << "," << draws << "," << uploads << ","
+				<< setup_ms << "," << ecpu::MedianMs(transform_times) << "," << ecpu::MedianMs(gather_times) << "," << ecpu::MedianMs(cull_times) << ","
+				<< ecpu::MedianMs(batch_times) << "," << total << std::endl;
+			last_total = total;
+			last_count = count;
+		}
+		std::cout << "  Curves written to " << stress_curve_file << std::endl;
+	}
+
+	// Sums of the per frame results of the occlusion culling benchmark
+	struct OcclusionTotals
+	{
+		int frames = 0;
+		size_t draws = 0;
+		size_t culled = 0;
+		double min_reject = 1.0;
+		double max_reject = 0.0;
+		double cull_seconds = 0.0;
+		double max_cull_seconds = 0.0;
+		double raster_seconds = 0.0;
+		double culled_raster_seconds = 0.0;
+		size_t changed_pixels = 0;
+	};
+
+	// Culls one frame and rasterizes it at full resolution with and without the culled draws
+	void occlusionFrame(const std::vector<ecpu::RasterDraw>& draws, const ecpu::RasterCamera& camera, ecpu::MaskedOcclusionCuller& culler,
+		ecpu::SoftwareRasterizer& rasterizer, ecpu::ThreadPool& pool, OcclusionTotals& totals)
+	{
+		const std::vector<ecpu::RasterDraw> visible = ecpu::CullOccludedDraws(draws, camera, culler);
+		const auto& stats = culler.GetStats();
+		const double cull_seconds = stats.raster_seconds + stats.test_seconds;
+		const double reject = (double)(draws.size() - visible.size()) / std::max<size_t>(draws.size(), 1);
+		totals.frames++;
+		totals.draws += draws.size();
+		totals.culled += draws.size() - visible.size();
+		totals.min_reject = std::min(totals.min_reject, reject);
+		totals.max_reject = std::max(totals.max_reject, reject);
+		totals.cull_seconds += cull_seconds;
+		totals.max_cull_seconds = std::max(totals.max_cull_seconds, cull_seconds);
+		rasterizer.Render(draws, camera, pool);
+		totals.raster_seconds += rasterizer.GetLastStats().TotalSeconds();
+		const ecpu::Tensor depth = rasterizer.GetDepth();
+		rasterizer.Render(visible, camera, pool);
+		totals.culled_raster_seconds += rasterizer.GetLastStats().TotalSeconds();
+		// Culling only ever drops hidden draws, so the depth buffer should not change
+		size_t changed = 0;
+		for (size_t i = 0; i < depth.ElementCount(); i++)
+			changed += depth.Data()[i] != rasterizer.GetDepth().Data()[i] ? 1 : 0;
+		totals.changed_pixels += changed;
+		std::cout << "    frame " << totals.frames - 1 << ": " << draws.size() - visible.size() << " of " << draws.size() << " draws culled, "
+			<< stats.rasterized_triangles << " occluder triangles, " << cull_seconds * 1000.0 << " ms, " << changed << " pixels changed" << std::endl;
+	}
+
+	void printOcclusionTotals(const OcclusionTotals& totals)
+	{
+		const double frames = std::max(totals.frames, 1);
+		std::cout << "  reject rate " << 100.0 * totals.culled / std::max<size_t>(totals.draws, 1) << " % (" << 100.0 * totals.min_reject << " to "
+			<< 100.0 * totals.max_reject << " %), culling " << totals.cull_seconds * 1000.0 / frames << " ms per frame (max "
+			<< totals.max_cull_seconds * 1000.0 << " ms), rasterizer " << totals.raster_seconds * 1000.0 / frames << " ms -> "
+			<< totals.culled_raster_seconds * 1000.0 / frames << " ms per frame, " << totals.changed_pixels << " pixels changed" << std::endl;
+	}
+
+	// Quad facing the camera at depth z, wound for the rasterizer
+	eio::ObjbMesh wallMesh(float x0, float x1, float y0, float y1, float z)
+	{
+		const float corners[4][3] = { { x0, y1, z }, { x1, y1, z }, { x1, y0, z }, { x0, y0, z } };
+		eio::ObjbMesh mesh;
+		for (const auto& c : corners)
+		{
+			eio::ObjbVertex v = { { c[0], c[1], c[2] }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } };
+			mesh.vertices.push_back(v);
+		}
+		mesh.indices = { 0, 1, 2, 0, 2, 3 };
+		return mesh;
+	}
+
+	// Per frame reject rate and CPU cost of the masked occlusion culler. The knight grid stands
+	// behind a wall with a door in it while the camera walks past, and the Sponza camera path is
+	// measured when Sponza has been baked
+	void occlusionBenchmark(ecpu::ThreadPool& pool)
+	{
+		std::cout << "Occlusion culling, " << occlusion_width << "x" << occlusion_height << " depth buffer, rasterizer at 1080p (" << pool.ThreadCount()
+			<< " threads)" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		ecpu::MaskedOcclusionCuller culler(occlusion_width, occlusion_height);
+		ecpu::SoftwareRasterizer rasterizer(1920, 1080);
+
+		std::map<std::string, eio::PngImage> textures;
+		const ecpu::CPUModel knight(raster_model, textures);
+		std::vector<ecpu::RasterDraw> draws = knightGrid(knight);
+		const std::vector<eio::ObjbMesh> walls = { wallMesh(-8.0f, -0.6f, -2.0f, 3.0f, 7.5f), wallMesh(0.6f, 8.0f, -2.0f, 3.0f, 7.5f) };
+		std::vector<ecpu::OccluderMesh> wall_occluders(walls.size());
+		std::vector<ecpu::Aabb> wall_bounds(walls.size());
+		ecpu::RasterMaterial wall_material;
+		std::fill(wall_material.diffuse_color, wall_material.diffuse_color + 3, 0.5f);
+		for (size_t i = 0; i < walls.size(); i++)
+		{
+			for (const auto& v : walls[i].vertices)
+			{
+				wall_occluders[i].vertices.push_back(ecpu::Vector3(v.position[0], v.position[1], v.position[2]));
+				wall_bounds[i].Grow(wall_occluders[i].vertices.back());
+			}
+			wall_occluders[i].indices = walls[i].indices;
+			ecpu::RasterDraw draw;
+			draw.mesh = &walls[i];
+			draw.material = &wall_material;
+			draw.bounds = &wall_bounds[i];
+			draw.occluder = &wall_occluders[i];
+			draws.push_back(draw);
+		}
+
+		std::cout << "  " << raster_grid * raster_grid << " knights behind a wall" << std::endl;
+		ecpu::RasterCamera camera(1920, 1080, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		OcclusionTotals totals;
+		for (int f = 0; f < occlusion_frames; f++)
+		{
+			const float t = (float)f / (occlusion_frames - 1);
+			camera.SetPosition(ecpu::Vector3(-3.0f + 6.0f * t, 0.0f, 0.0f));
+			camera.SetRotation(ecpu::Vector3(0.0f, 0.0f, 0.3f - 0.6f * t));
+			camera.Update();
+			occlusionFrame(draws, camera, culler, rasterizer, pool, totals);
+		}
+		printOcclusionTotals(totals);
+
+		if (!std::ifstream("../Rendering/models/sponza.objb"))
+		{
+			std::cout << "  ../Rendering/models/sponza.objb not found, Sponza skipped" << std::endl;
+			return;
+		}
+		std::cout << "  Sponza, camera path 0" << std::endl;
+		ecpu::CPUSponzaScene scene;
+		const auto path = ecpu::LoadCameraPath(camera_folder, 0);
+		totals = OcclusionTotals();
+		for (int f = 0; f < std::min(occlusion_frames, (int)path.size()); f++)
+		{
+			camera.SetPosition(path[f].position);
+			camera.SetRotation(path[f].rotation);
+			camera.Update();
+			scene.Update((float)((double)path[f].time / 1000000.0));
+			occlusionFrame(scene.NextDraws(), camera, culler, rasterizer, pool, totals);
+		}
+		printOcclusionTotals(totals);
+	}
+}
+
+void RenderBenchmarks(ecpu::ThreadPool& pool)
+{
+	rasterBenchmark(pool);
+	rayTraceBenchmark(pool);
+	bvhBenchmark(pool);
+	adaptiveSamplingBenchmark(pool);
+	frustumBenchmark();
+	transformBenchmark();
+	drawBatchBenchmark();
+	stressSceneBenchmark();
+	occlusionBenchmark(pool);
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include "cpu/thread_pool.h"
+
+// Software rasterizer, ray tracer, BVH builds, culling, batching and the stress and occlusion
+// scenes
+void RenderBenchmarks(ecpu::ThreadPool& pool);
@@ -35,17 +35,12 @@ namespace
 
 }
 
-void renderRasterizer(egx::Device& dev, egx::CommandContext& context, Scene& scene, DeferredRenderer& renderer, egx::Camera& camera, egx::RenderTarget& target)
+void renderRasterizer(egx::Device& dev, egx::CommandContext& context, const DrawList& draw_list, DeferredRenderer& renderer, egx::Camera& camera, egx::RenderTarget& target)
 {
-	auto models = scene.GetModels();
-	auto static_models = scene.GetStaticModels();
-	auto dynamic_models = scene.GetDynamicModels();
-
-	for (auto pmodel : models) pmodel->UpdateBuffer(dev, context);
 	renderer.PrepareFrame(dev, context);
-	for (auto pmodel : static_models) renderer.RenderModel(dev, context, camera, *pmodel);
-	for (auto pmodel : dynamic_models) renderer.RenderModel(dev, context, camera, *pmodel);
-	for (auto pmodel : models) renderer.RenderMotionVectors(dev, context, camera, *pmodel); // Need static motion vectors
+	renderer.RenderShadows(dev, context, draw_list.ShadowDraws());
+	renderer.RenderModel(dev, context, camera, draw_list.CameraDraws());
+	renderer.RenderMotionVectors(dev, context, camera, draw_list.CameraDraws()); // Need static motion vectors
 	renderer.RenderLight(dev, context, camera, target);
 	renderer.PrepareFrameEnd();
 }
@@ -96,6 +91,7 @@ int main()
 
 		// Create resolution dependent resources
 		DeferredRenderer renderer(device, context, output_size, far_plane, mipmap_bias);
+		DrawList draw_list;
 		egx::FPCamera camera(device, context, (ema::vec2)output_size, near_plane, far_plane, 3.141592f / 3.0f, 0.0f, 0.0f);
 		egx::RenderTarget target1(device, egx::TextureFormat::UNORM8x4, output_size);
 		egx::RenderTarget target2(device, egx::TextureFormat::UNORM8x4, output_size);
@@ -139,6 +135,9 @@ int main()
 					float time = (float)((double)frame.time / 1000000.0);
 					scene.Update(time);
 					renderer.UpdateLight(camera);
+					draw_list.Build(scene.GetModels(), camera, renderer.GetShadowCamera());
+					scene.UploadTransforms(device, context);
+					renderer.UploadInstances(device, context, draw_list.Instances());
 
 					eio::Console::LogProgress("Processing frame " + emisc::ToString(frame_index + video_index * frame_count) + "/" + emisc::ToString(video_count * frame_count));
 					ssaa.PrepareForRender(context);
@@ -147,7 +146,7 @@ int main()
 						camera.SetJitter(ssaa.GetJitter());
 						camera.Update();
 						camera.UpdateBuffer(device, context);
-						renderRasterizer(device, context, scene, renderer, camera, target1);
+						renderRasterizer(device, context, draw_list, renderer, camera, target1);
 						ssaa.AddSample(context, target1);
 					}
 					ssaa.Finish(context, target2);
@@ -173,6 +172,7 @@ int main()
 		ema::point2D input_resolution = output_size / upsampling_factor;
 		// Create resolution dependent resources
 		DeferredRenderer renderer(device, context, input_resolution, far_plane, - 0.5f * std::log2(upsampling_factor * upsampling_factor) + mipmap_bias);
+		DrawList draw_list;
 		renderer.SetSampler(DeferredRenderer::TextureSampler::TAABias);
 		egx::FPCamera camera(device, context, (ema::vec2)input_resolution, near_plane, far_plane, 3.141592f / 3.0f, 0.0f, 0.0f);
 		egx::RenderTarget target1(device, egx::TextureFormat::UNORM8x4, input_resolution);
@@ -229,11 +229,14 @@ int main()
 				float time = (float)((double)frame.time / 1000000.0);
 				scene.Update(time);
 				renderer.UpdateLight(camera);
+				draw_list.Build(scene.GetModels(), camera, renderer.GetShadowCamera());
+				scene.UploadTransforms(device, context);
+				renderer.UploadInstances(device, context, draw_list.Instances());
 
 				eio::Console::LogProgress("Processing frame " + emisc::ToString(frame_index + video_index * frame_count) + "/" + emisc::ToString(video_count * frame_count));
 				
 				camera.UpdateBuffer(device, context);
-				renderRasterizer(device, context, scene, renderer, camera, target1);
+				renderRasterizer(device, context, draw_list, renderer, camera, target1);
 				
 				renderer.ApplyToneMapping(device, context, target1, target2);
 
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace ecpu
+{
+	// Allocator that aligns every allocation to a cache line so SIMD loads never split lines
+	template <typename T, size_t Alignment = 64>
+	class AlignedAllocator
+	{
+	public:
+		using value_type = T;
+		template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+		AlignedAllocator() = default;
+		template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {};
+
+		T* allocate(size_t count)
+		{
+			size_t size = ((count * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+#ifdef _WIN32
+			void* p = _aligned_malloc(size, Alignment);
+#else
+			void* p = nullptr;
+			if (posix_memalign(&p, Alignment, size == 0 ? Alignment : size) != 0)
+				p = nullptr;
+#endif
+			if (!p)
+				throw std::bad_alloc();
+			return static_cast<T*>(p);
+		}
+		void deallocate(T* p, size_t)
+		{
+#ifdef _WIN32
+			_aligned_free(p);
+#else
+			std::free(p);
+#endif
+		}
+
+		template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; };
+		template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; };
+	};
+
+	template <typename T>
+	using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+}
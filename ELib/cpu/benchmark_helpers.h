@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "tensor.h"
+#include "timer.h"
+
+namespace ecpu
+{
+	// Small helpers shared by the Benchmark and Profiler tools
+
+	// Deterministic values in [0, 1) so runs are comparable between machines
+	inline void FillInput(Tensor& tensor)
+	{
+		unsigned int state = 12345u;
+		float* data = tensor.Data();
+		for (size_t i = 0; i < tensor.ElementCount(); i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			data[i] = (float)(state >> 8) / (float)(1 << 24);
+		}
+	}
+
+	// Largest element wise difference of two tensors with the same element count
+	inline float MaxAbsDifference(const Tensor& a, const Tensor& b)
+	{
+		float out = 0.0f;
+		for (size_t i = 0; i < a.ElementCount(); i++)
+			out = std::max(out, std::abs(a.Data()[i] - b.Data()[i]));
+		return out;
+	}
+
+	// Median of run times in seconds, in milliseconds
+	inline double MedianMs(std::vector<double> seconds)
+	{
+		std::sort(seconds.begin(), seconds.end());
+		return seconds[seconds.size() / 2] * 1000.0;
+	}
+
+	// Median milliseconds of f over runs calls, after warmup_runs calls that are not timed
+	template <typename F>
+	double MedianMs(int warmup_runs, int runs, F f)
+	{
+		std::vector<double> seconds;
+		for (int i = 0; i < warmup_runs + runs; i++)
+		{
+			Timer timer;
+			f();
+			if (i >= warmup_runs)
+				seconds.push_back(timer.Elapsed());
+		}
+		return MedianMs(seconds);
+	}
+}
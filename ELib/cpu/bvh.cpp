@@ -0,0 +1,641 @@
+#include "bvh.h"
+#include <stdexcept>
+#include <memory>
+#include <numeric>
+#include "timer.h"
+
+namespace
+{
+	// Deeper binary trees could overflow the traversal stack, their nodes become leaves
+	const int max_binary_depth = 64;
+	// References of large nodes are binned in parallel chunks of this size
+	const size_t parallel_chunk = 16384;
+	// Smallest subtree built as its own parallel task
+	const size_t min_task_size = 1024;
+
+	struct BinaryNode
+	{
+		ecpu::Aabb bounds;
+		int left = -1;
+		int right = -1;
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// A primitive, or the part of a triangle between spatial split planes. References are
+	// split by value, so every pass of the build reads them in order
+	struct Reference
+	{
+		ecpu::Aabb bounds;
+		ecpu::Vector3 center;
+		uint32_t index;
+	};
+
+	inline float axisValue(const ecpu::Vector3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	inline void setAxis(ecpu::Vector3& v, int axis, float value)
+	{
+		(axis == 0 ? v.x : (axis == 1 ? v.y : v.z)) = value;
+	}
+
+	ecpu::Aabb intersection(const ecpu::Aabb& a, const ecpu::Aabb& b)
+	{
+		ecpu::Aabb out;
+		out.min = ecpu::Vector3(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y), std::max(a.min.z, b.min.z));
+		out.max = ecpu::Vector3(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y), std::min(a.max.z, b.max.z));
+		return out;
+	}
+
+	// Boxes of the parts of a triangle inside box on either side of an axis aligned plane
+	void splitReference(const ecpu::Vector3* triangle, ecpu::Aabb box, int axis, float position, ecpu::Aabb& left, ecpu::Aabb& right)
+	{
+		left = ecpu::Aabb();
+		right = ecpu::Aabb();
+		for (int i = 0; i < 3; i++)
+		{
+			const ecpu::Vector3& v0 = triangle[i];
+			const ecpu::Vector3& v1 = triangle[(i + 1) % 3];
+			const float a0 = axisValue(v0, axis);
+			const float a1 = axisValue(v1, axis);
+			if (a0 <= position)
+				left.Grow(v0);
+			if (a0 >= position)
+				right.Grow(v0);
+			if ((a0 < position && a1 > position) || (a0 > position && a1 < position))
+			{
+				ecpu::Vector3 p = v0 + (v1 - v0) * ((position - a0) / (a1 - a0));
+				setAxis(p, axis, position);
+				left.Grow(p);
+				right.Grow(p);
+			}
+		}
+		ecpu::Aabb left_box = box;
+		ecpu::Aabb right_box = box;
+		setAxis(left_box.max, axis, std::min(axisValue(box.max, axis), position));
+		setAxis(right_box.min, axis, std::max(axisValue(box.min, axis), position));
+		left = intersection(left, left_box);
+		right = intersection(right, right_box);
+	}
+
+	// Bin boxes with the references starting and, for spatial bins, ending in each bin
+	struct Bins
+	{
+		std::vector<ecpu::Aabb> bounds;
+		std::vector<uint32_t> enter;
+		std::vector<uint32_t> exit;
+
+		explicit Bins(int count) : bounds(count), enter(count, 0), exit(count, 0) {};
+
+		void Reset()
+		{
+			std::fill(bounds.begin(), bounds.end(), ecpu::Aabb());
+			std::fill(enter.begin(), enter.end(), 0);
+			std::fill(exit.begin(), exit.end(), 0);
+		}
+		void Merge(const Bins& other)
+		{
+			for (size_t i = 0; i < bounds.size(); i++)
+			{
+				bounds[i].Grow(other.bounds[i]);
+				enter[i] += other.enter[i];
+				exit[i] += other.exit[i];
+			}
+		}
+	};
+
+	struct Split
+	{
+		float cost = std::numeric_limits<float>::infinity();
+		int axis = -1;
+		int bin = 0;			// Object splits send the centers of lower bins to the left
+		bool spatial = false;
+		float position = 0.0f;	// Spatial splits clip the references at this plane
+		// Children of the best object split, whose overlap decides if spatial splits are tried
+		ecpu::Aabb left;
+		ecpu::Aabb right;
+	};
+
+	class BinaryBuilder
+	{
+	public:
+		// A subtree left for a parallel task
+		struct Task
+		{
+			int node;
+			std::vector<Reference> references;
+			size_t budget;
+			int depth;
+		};
+
+	public:
+		BinaryBuilder(const ecpu::BvhBuildSettings& settings, const std::vector<ecpu::Vector3>* triangles, float root_area, ecpu::ThreadPool* pool)
+			: settings(settings), triangles(triangles), root_area(root_area), pool(pool),
+			extent_bins(2), object_bins(3 * settings.bins), spatial_bins(3 * settings.bins), right_areas(settings.bins), right_counts(settings.bins)
+		{
+		}
+
+		// Builds a subtree over the references, which are consumed. budget is the most references
+		// the subtree may hold, the ones above the reference count are for the duplicates of
+		// spatial splits. Subtrees of at most task_size references are only added to tasks
+		int Build(std::vector<Reference>& references, size_t budget, int depth, size_t task_size)
+		{
+			const int index = (int)nodes.size();
+			nodes.emplace_back();
+			if (references.size() <= task_size)
+			{
+				tasks.push_back({ index, std::move(references), budget, depth });
+				return index;
+			}
+
+			bin(references, extent_bins, [](const Reference& r, Bins& bins)
+				{
+					bins.bounds[0].Grow(r.bounds);
+					bins.bounds[1].Grow(r.center);
+				});
+			const ecpu::Aabb node_bounds = extent_bins.bounds[0];
+			const ecpu::Aabb center_bounds = extent_bins.bounds[1];
+			const size_t count = references.size();
+			nodes[index].bounds = node_bounds;
+			max_depth = std::max(max_depth, depth);
+
+			// Costs are relative to a primitive intersection, so a leaf costs its count
+			Split split;
+			if (count > 1 && depth < max_binary_depth)
+				split = findSplit(references, node_bounds, center_bounds, budget);
+			std::vector<Reference> left;
+			std::vector<Reference> right;
+			if (split.axis >= 0 && (split.cost < (float)count || (int)count > settings.max_leaf_size))
+				performSplit(references, split, left, right);
+			if ((left.empty() || right.empty()) && (int)count > settings.max_leaf_size && depth < max_binary_depth)
+			{
+				// All centers coincide, split the range in half
+				split.spatial = false;
+				left.assign(references.begin(), references.begin() + count / 2);
+				right.assign(references.begin() + count / 2, references.end());
+			}
+			if (left.empty() || right.empty())
+			{
+				nodes[index].first = (uint32_t)leaf_primitives.size();
+				nodes[index].count = (uint32_t)count;
+				for (const auto& r : references)
+					leaf_primitives.push_back(r.index);
+				return index;
+			}
+			std::vector<Reference>().swap(references);
+			spatial_splits += split.spatial ? 1 : 0;
+
+			// The children share what is left of the budget by their reference counts
+			const size_t left_count = left.size();
+			const size_t right_count = right.size();
+			const size_t spare = budget > left_count + right_count ? budget - left_count - right_count : 0;
+			const size_t left_spare = (size_t)((double)spare * left_count / (left_count + right_count));
+			const int left_child = Build(left, left_count + left_spare, depth + 1, task_size);
+			const int right_child = Build(right, right_count + spare - left_spare, depth + 1, task_size);
+			nodes[index].left = left_child;
+			nodes[index].right = right_child;
+			return index;
+		}
+
+		std::vector<BinaryNode> nodes;
+		std::vector<uint32_t> leaf_primitives;	// Leaves are ranges of these
+		std::vector<Task> tasks;
+		int max_depth = 0;
+		size_t spatial_splits = 0;
+
+	private:
+		inline int binIndex(float v, float lo, float scale) const
+		{
+			return std::min(settings.bins - 1, std::max(0, (int)((v - lo) * scale)));
+		}
+
+		// Calls add(reference, bins) for every reference, with a pool in parallel chunks. The
+		// chunks are merged in order and only take minimums, maximums and counts, so the bins
+		// are the same for any thread count
+		template <typename F>
+		void bin(const std::vector<Reference>& references, Bins& out, F&& add)
+		{
+			out.Reset();
+			const size_t chunks = (references.size() + parallel_chunk - 1) / parallel_chunk;
+			if (pool == nullptr || chunks <= 1)
+			{
+				for (const auto& r : references)
+					add(r, out);
+				return;
+			}
+			std::vector<Bins> partial(chunks, Bins((int)out.bounds.size()));
+			pool->ParallelFor((int)chunks, [&](int c)
+				{
+					const size_t end = std::min(references.size(), (c + 1) * parallel_chunk);
+					for (size_t i = c * parallel_chunk; i < end; i++)
+						add(references[i], partial[c]);
+				});
+			for (const auto& p : partial)
+				out.Merge(p);
+		}
+
+		// Sweeps the bins of an axis and keeps the cheapest split within the budget in best.
+		// Spatial bins count references by the bins they start and end in, and split at the
+		// plane lo + bin * width
+		void sweep(const Bins& bins, int axis, bool spatial, float lo, float width, float parent_area, size_t budget, Split& best)
+		{
+			const int bin_count = settings.bins;
+			const ecpu::Aabb* axis_bounds = bins.bounds.data() + axis * bin_count;
+			const uint32_t* axis_enter = bins.enter.data() + axis * bin_count;
+			const uint32_t* axis_exit = (spatial ? bins.exit.data() : bins.enter.data()) + axis * bin_count;
+			ecpu::Aabb right;
+			uint32_t right_count = 0;
+			for (int b = bin_count - 1; b > 0; b--)
+			{
+				right.Grow(axis_bounds[b]);
+				right_count += axis_exit[b];
+				right_areas[b] = right.Area();
+				right_counts[b] = right_count;
+			}
+			ecpu::Aabb left;
+			uint32_t left_count = 0;
+			int best_bin = -1;
+			for (int b = 1; b < bin_count; b++)
+			{
+				left.Grow(axis_bounds[b - 1]);
+				left_count += axis_enter[b - 1];
+				if (left_count == 0 || right_counts[b] == 0 || left_count + right_counts[b] > budget)
+					continue;
+				const float cost = settings.traversal_cost + (left.Area() * left_count + right_areas[b] * right_counts[b]) / parent_area;
+				if (cost < best.cost)
+				{
+					best.cost = cost;
+					best_bin = b;
+				}
+			}
+			if (best_bin < 0)
+				return;
+			best.axis = axis;
+			best.bin = best_bin;
+			best.spatial = spatial;
+			best.position = lo + best_bin * width;
+			best.left = ecpu::Aabb();
+			best.right = ecpu::Aabb();
+			for (int b = 0; b < bin_count; b++)
+				(b < best_bin ? best.left : best.right).Grow(axis_bounds[b]);
+		}
+
+		Split findSplit(const std::vector<Reference>& references, const ecpu::Aabb& node_bounds, const ecpu::Aabb& center_bounds, size_t budget)
+		{
+			// Binned SAH over the centers, all three axes in one pass over the references
+			const int bin_count = settings.bins;
+			const float parent_area = node_bounds.Area();
+			float lo[3];
+			float scale[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				lo[axis] = axisValue(center_bounds.min, axis);
+				const float extent = axisValue(center_bounds.max, axis) - lo[axis];
+				scale[axis] = extent > 0.0f ? bin_count / extent : 0.0f;
+			}
+			bin(references, object_bins, [&](const Reference& r, Bins& bins)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						const int b = axis * bin_count + binIndex(axisValue(r.center, axis), lo[axis], scale[axis]);
+						bins.bounds[b].Grow(r.bounds);
+						bins.enter[b]++;
+					}
+				});
+			Split best;
+			for (int axis = 0; axis < 3; axis++)
+				if (scale[axis] > 0.0f)
+					sweep(object_bins, axis, false, lo[axis], 1.0f / scale[axis], parent_area, budget, best);
+			object_lo = best.axis >= 0 ? lo[best.axis] : 0.0f;
+			object_scale = best.axis >= 0 ? scale[best.axis] : 0.0f;
+
+			// Spatial splits over equal bins of the node's box, where the object split's children
+			// overlap and the budget has room for duplicates
+			if (triangles == nullptr || !settings.spatial_splits || references.size() >= budget || best.axis < 0 ||
+				!(intersection(best.left, best.right).Area() > settings.spatial_split_overlap * root_area))
+				return best;
+			float spatial_lo[3];
+			float width[3];
+			float inv_width[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				spatial_lo[axis] = axisValue(node_bounds.min, axis);
+				width[axis] = (axisValue(node_bounds.max, axis) - spatial_lo[axis]) / bin_count;
+				inv_width[axis] = width[axis] > 0.0f ? 1.0f / width[axis] : 0.0f;
+			}
+			bin(references, spatial_bins, [&](const Reference& r, Bins& bins)
+				{
+					const ecpu::Vector3* triangle = triangles->data() + (size_t)r.index * 3;
+					for (int axis = 0; axis < 3; axis++)
+					{
+						if (!(inv_width[axis] > 0.0f))
+							continue;
+						const int first = binIndex(axisValue(r.bounds.min, axis), spatial_lo[axis], inv_width[axis]);
+						const int last = binIndex(axisValue(r.bounds.max, axis), spatial_lo[axis], inv_width[axis]);
+						// Chop the reference at every bin boundary it crosses
+						ecpu::Aabb rest = r.bounds;
+						for (int b = first; b < last; b++)
+						{
+							ecpu::Aabb part;
+							splitReference(triangle, rest, axis, spatial_lo[axis] + (b + 1) * width[axis], part, rest);
+							bins.bounds[axis * bin_count + b].Grow(part);
+						}
+						bins.bounds[axis * bin_count + last].Grow(rest);
+						bins.enter[axis * bin_count + first]++;
+						bins.exit[axis * bin_count + last]++;
+					}
+				});
+			for (int axis = 0; axis < 3; axis++)
+				if (inv_width[axis] > 0.0f)
+					sweep(spatial_bins, axis, true, spatial_lo[axis], width[axis], parent_area, budget, best);
+			return best;
+		}
+
+		void performSplit(const std::vector<Reference>& references, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right) const
+		{
+			if (!split.spatial)
+			{
+				for (const auto& r : references)
+					(binIndex(axisValue(r.center, split.axis), object_lo, object_scale) < split.bin ? left : right).push_back(r);
+				return;
+			}
+			for (const auto& r : references)
+			{
+				if (axisValue(r.bounds.max, split.axis) <= split.position)
+				{
+					left.push_back(r);
+				}
+				else if (axisValue(r.bounds.min, split.axis) >= split.position)
+				{
+					right.push_back(r);
+				}
+				else
+				{
+					Reference l = r;
+					Reference rr = r;
+					splitReference(triangles->data() + (size_t)r.index * 3, r.bounds, split.axis, split.position, l.bounds, rr.bounds);
+					l.center = l.bounds.Center();
+					rr.center = rr.bounds.Center();
+					if (!l.bounds.Empty())
+						left.push_back(l);
+					if (!rr.bounds.Empty())
+						right.push_back(rr);
+				}
+			}
+		}
+
+		const ecpu::BvhBuildSettings& settings;
+		const std::vector<ecpu::Vector3>* triangles;
+		const float root_area;
+		ecpu::ThreadPool* pool;
+		// The object bins of the last findSplit
+		float object_lo = 0.0f;
+		float object_scale = 0.0f;
+		// Only used before the recursion, so one set serves every node
+		Bins extent_bins;
+		Bins object_bins;
+		Bins spatial_bins;
+		std::vector<float> right_areas;
+		std::vector<uint32_t> right_counts;
+	};
+
+	void setChild(ecpu::Bvh8::Node& node, int i, const ecpu::Aabb& b)
+	{
+		node.bounds[0][i] = b.min.x;
+		node.bounds[1][i] = b.max.x;
+		node.bounds[2][i] = b.min.y;
+		node.bounds[3][i] = b.max.y;
+		node.bounds[4][i] = b.min.z;
+		node.bounds[5][i] = b.max.z;
+	}
+
+	ecpu::Aabb childBounds(const ecpu::Bvh8::Node& node, int i)
+	{
+		ecpu::Aabb b;
+		b.min = ecpu::Vector3(node.bounds[0][i], node.bounds[2][i], node.bounds[4][i]);
+		b.max = ecpu::Vector3(node.bounds[1][i], node.bounds[3][i], node.bounds[5][i]);
+		return b;
+	}
+
+	ecpu::Aabb nodeBounds(const ecpu::Bvh8::Node& node)
+	{
+		ecpu::Aabb b;
+		for (int i = 0; i < ecpu::Bvh8::width; i++)
+			b.Grow(childBounds(node, i));
+		return b;
+	}
+
+	// Pulls the largest grandchildren up into one wide node until it has eight children. Leaf
+	// references are appended to primitives in traversal order, so the wide tree only depends
+	// on the shape of the binary tree and not on the order its nodes were built in
+	int collapse(const BinaryBuilder& binary, int index, std::vector<ecpu::Bvh8::Node>& nodes, std::vector<uint32_t>& primitives)
+	{
+		const std::vector<BinaryNode>& tree = binary.nodes;
+		int children[ecpu::Bvh8::width];
+		int child_count = 0;
+		if (tree[index].left < 0)
+		{
+			children[child_count++] = index;
+		}
+		else
+		{
+			children[child_count++] = tree[index].left;
+			children[child_count++] = tree[index].right;
+		}
+		while (child_count < ecpu::Bvh8::width)
+		{
+			int largest = -1;
+			float largest_area = -1.0f;
+			for (int i = 0; i < child_count; i++)
+			{
+				const BinaryNode& c = tree[children[i]];
+				if (c.left >= 0 && c.bounds.Area() > largest_area)
+				{
+					largest = i;
+					largest_area = c.bounds.Area();
+				}
+			}
+			if (largest < 0)
+				break;
+			const BinaryNode& c = tree[children[largest]];
+			children[largest] = c.left;
+			children[child_count++] = c.right;
+		}
+
+		const int out = (int)nodes.size();
+		nodes.emplace_back();
+		int32_t child_index[ecpu::Bvh8::width];
+		for (int i = 0; i < ecpu::Bvh8::width; i++)
+		{
+			if (i >= child_count)
+			{
+				child_index[i] = ecpu::Bvh8::empty_child;
+			}
+			else if (tree[children[i]].left < 0)
+			{
+				const BinaryNode& leaf = tree[children[i]];
+				child_index[i] = ~(int32_t)primitives.size();
+				primitives.insert(primitives.end(), binary.leaf_primitives.begin() + leaf.first, binary.leaf_primitives.begin() + leaf.first + leaf.count);
+			}
+			else
+			{
+				child_index[i] = collapse(binary, children[i], nodes, primitives);
+			}
+		}
+
+		ecpu::Bvh8::Node& node = nodes[out];
+		for (int i = 0; i < ecpu::Bvh8::width; i++)
+		{
+			setChild(node, i, i < child_count ? tree[children[i]].bounds : ecpu::Aabb());
+			node.child[i] = child_index[i];
+			node.count[i] = i < child_count && tree[children[i]].left < 0 ? tree[children[i]].count : 0;
+		}
+		return out;
+	}
+}
+
+void ecpu::Bvh8::Build(const std::vector<Aabb>& primitive_bounds, const BvhBuildSettings& settings)
+{
+	build(primitive_bounds, nullptr, settings, nullptr);
+}
+
+void ecpu::Bvh8::Build(const std::vector<Aabb>& primitive_bounds, const BvhBuildSettings& settings, ThreadPool& pool)
+{
+	build(primitive_bounds, nullptr, settings, &pool);
+}
+
+void ecpu::Bvh8::BuildTriangles(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings, ThreadPool& pool)
+{
+	if (indices.size() % 3 != 0)
+		throw std::runtime_error("Triangle indices must come in threes");
+	std::vector<Vector3> triangles(indices.size());
+	std::vector<Aabb> primitive_bounds(indices.size() / 3);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= vertices.size())
+			throw std::runtime_error("Triangle index out of range");
+		triangles[i] = vertices[indices[i]];
+		primitive_bounds[i / 3].Grow(triangles[i]);
+	}
+	build(primitive_bounds, &triangles, settings, &pool);
+}
+
+void ecpu::Bvh8::build(const std::vector<Aabb>& primitive_bounds, const std::vector<Vector3>* triangles, const BvhBuildSettings& settings, ThreadPool* pool)
+{
+	if (settings.bins < 2 || settings.max_leaf_size < 1)
+		throw std::runtime_error("The BVH needs at least two bins and one primitive per leaf");
+	if (settings.spatial_splits && (triangles == nullptr || !(settings.max_duplication >= 0.0f)))
+		throw std::runtime_error("Spatial splits need triangles and a duplication budget of at least zero");
+	Timer timer;
+	nodes.clear();
+	primitives.clear();
+	bounds = Aabb();
+	stats = BvhBuildStats();
+	stats.primitives = primitive_bounds.size();
+	if (primitive_bounds.empty())
+		return;
+
+	std::vector<Reference> references(primitive_bounds.size());
+	for (size_t i = 0; i < primitive_bounds.size(); i++)
+	{
+		references[i] = { primitive_bounds[i], primitive_bounds[i].Center(), (uint32_t)i };
+		bounds.Grow(primitive_bounds[i]);
+	}
+	const size_t budget = references.size() + (settings.spatial_splits ? (size_t)(settings.max_duplication * references.size()) : 0);
+
+	// The top of the tree is built with parallel binning until the nodes are small enough to
+	// give every thread several subtrees, which are then built in parallel, largest first
+	const size_t task_size = pool == nullptr ? 0 : std::max(min_task_size, references.size() / (8 * (size_t)pool->ThreadCount()));
+	BinaryBuilder top(settings, triangles, bounds.Area(), pool);
+	top.Build(references, budget, 0, task_size);
+
+	std::vector<std::unique_ptr<BinaryBuilder>> subtrees(top.tasks.size());
+	std::vector<int> order(top.tasks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return top.tasks[a].references.size() > top.tasks[b].references.size(); });
+	if (!order.empty())
+	{
+		pool->ParallelFor((int)order.size(), [&](int i)
+			{
+				auto& task = top.tasks[order[i]];
+				auto& subtree = subtrees[order[i]];
+				subtree.reset(new BinaryBuilder(settings, triangles, bounds.Area(), nullptr));
+				subtree->Build(task.references, task.budget, task.depth, 0);
+			});
+	}
+
+	// Append the subtrees to the top tree, their roots replacing the task nodes
+	stats.depth = top.max_depth;
+	stats.spatial_splits = top.spatial_splits;
+	for (size_t t = 0; t < subtrees.size(); t++)
+	{
+		const BinaryBuilder& subtree = *subtrees[t];
+		const int node_offset = (int)top.nodes.size();
+		const uint32_t primitive_offset = (uint32_t)top.leaf_primitives.size();
+		for (BinaryNode node : subtree.nodes)
+		{
+			if (node.left >= 0)
+			{
+				node.left += node_offset;
+				node.right += node_offset;
+			}
+			node.first += primitive_offset;
+			top.nodes.push_back(node);
+		}
+		top.leaf_primitives.insert(top.leaf_primitives.end(), subtree.leaf_primitives.begin(), subtree.leaf_primitives.end());
+		top.nodes[top.tasks[t].node] = top.nodes[node_offset];
+		stats.depth = std::max(stats.depth, subtree.max_depth);
+		stats.spatial_splits += subtree.spatial_splits;
+	}
+	stats.binary_nodes = top.nodes.size() - subtrees.size();
+
+	collapse(top, 0, nodes, primitives);
+	stats.nodes = nodes.size();
+	stats.references = primitives.size();
+	const float root_area = bounds.Area();
+	for (const auto& node : nodes)
+	{
+		if (root_area > 0.0f)
+			stats.sah_cost += settings.traversal_cost * nodeBounds(node).Area() / root_area;
+		for (int i = 0; i < width; i++)
+		{
+			if (node.count[i] == 0)
+				continue;
+			stats.leaves++;
+			if (root_area > 0.0f)
+				stats.sah_cost += node.count[i] * childBounds(node, i).Area() / root_area;
+		}
+	}
+	stats.seconds = timer.Elapsed();
+}
+
+void ecpu::Bvh8::Refit(const std::vector<Aabb>& primitive_bounds)
+{
+	if (primitive_bounds.size() != stats.primitives)
+		throw std::runtime_error("Refitting needs the bounds of the primitives the BVH was built over");
+
+	// collapse stores children after their parents, so a reverse pass updates them first. The
+	// parts of spatially split primitives grow to the whole primitive
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		Node& node = nodes[n];
+		for (int i = 0; i < width; i++)
+		{
+			Aabb b;
+			if (node.count[i] > 0)
+			{
+				const uint32_t first = (uint32_t)~node.child[i];
+				for (uint32_t k = first; k < first + node.count[i]; k++)
+					b.Grow(primitive_bounds[primitives[k]]);
+			}
+			else if (node.child[i] != empty_child)
+			{
+				b = nodeBounds(nodes[node.child[i]]);
+			}
+			setChild(node, i, b);
+		}
+	}
+	bounds = nodes.empty() ? Aabb() : nodeBounds(nodes[0]);
+}
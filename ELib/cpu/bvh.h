@@ -0,0 +1,217 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "matrix4.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace ecpu
+{
+	struct Aabb
+	{
+		Vector3 min = Vector3(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
+		Vector3 max = Vector3(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+
+		inline void Grow(const Vector3& p)
+		{
+			min = Vector3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = Vector3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+		// Componentwise, so growing by an empty box leaves the box unchanged
+		inline void Grow(const Aabb& b)
+		{
+			min = Vector3(std::min(min.x, b.min.x), std::min(min.y, b.min.y), std::min(min.z, b.min.z));
+			max = Vector3(std::max(max.x, b.max.x), std::max(max.y, b.max.y), std::max(max.z, b.max.z));
+		}
+		inline bool Empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; };
+		inline Vector3 Center() const { return (min + max) * 0.5f; };
+		// Surface area, zero for empty boxes
+		inline float Area() const
+		{
+			if (Empty())
+				return 0.0f;
+			const Vector3 e = max - min;
+			return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+	};
+
+	// Ray with the interval of RayDesc, hits are searched in [t_min, t_max]
+	struct Ray
+	{
+		Vector3 origin;
+		Vector3 direction;
+		float t_min = 0.0f;
+		float t_max = std::numeric_limits<float>::infinity();
+	};
+
+	struct BvhBuildSettings
+	{
+		int bins = 16;
+		int max_leaf_size = 4;
+		float traversal_cost = 1.0f;	// Relative to one primitive intersection
+		// SBVH: nodes may also split at planes that clip triangles into both children, which
+		// helps long diagonal triangles at the cost of referencing them more than once. Only
+		// tried where the children of the best object split overlap by more than
+		// spatial_split_overlap of the root's surface area
+		bool spatial_splits = false;
+		float spatial_split_overlap = 1e-5f;
+		float max_duplication = 0.3f;	// Extra references allowed, relative to the primitive count
+	};
+
+	struct BvhBuildStats
+	{
+		size_t primitives = 0;
+		size_t references = 0;		// Primitives().size(), above primitives with spatial splits
+		size_t spatial_splits = 0;
+		size_t binary_nodes = 0;
+		size_t nodes = 0;
+		size_t leaves = 0;
+		int depth = 0;				// Of the binary tree before collapsing
+		// Expected cost of a ray through the root: a box test for every node entered and the
+		// primitives of every leaf entered, weighted by surface area relative to the root
+		float sah_cost = 0.0f;
+		double seconds = 0.0;
+	};
+
+	// Bounding volume hierarchy with eight children per node, built over primitive bounds with
+	// binned SAH splits. The binary tree of the build is collapsed into wide nodes storing the
+	// child boxes as planes of eight floats, so a ray tests all children of a node with one
+	// float8 slab test. Leaves are ranges of Primitives(), which callers use to reorder their
+	// primitive data. Refit keeps the tree and only updates the boxes, for primitives that
+	// move without changing much relative to each other. Builds with a pool bin the large nodes
+	// at the top of the tree in parallel and then build the subtrees below as parallel tasks,
+	// giving the same tree for any thread count
+	class Bvh8
+	{
+	public:
+		static const int width = 8;
+		static const int32_t empty_child = 0x7fffffff;
+
+		struct Node
+		{
+			// min x, max x, min y, max y, min z and max z of the children. Empty slots hold
+			// inverted infinite boxes that no ray enters
+			float bounds[6][width];
+			// Inner node index, or ~first primitive of a leaf
+			int32_t child[width];
+			uint32_t count[width];	// Primitives of a leaf, 0 for inner nodes and empty slots
+		};
+
+	public:
+		void Build(const std::vector<Aabb>& primitive_bounds, const BvhBuildSettings& settings = BvhBuildSettings());
+		void Build(const std::vector<Aabb>& primitive_bounds, const BvhBuildSettings& settings, ThreadPool& pool);
+		// Builds over the triangles of an index buffer, primitive i being indices 3i to 3i + 2.
+		// The only build that can do spatial splits, which may list a primitive in several leaves
+		void BuildTriangles(const std::vector<Vector3>& vertices, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings, ThreadPool& pool);
+		// New bounds of the primitives of the last Build, in their original order
+		void Refit(const std::vector<Aabb>& primitive_bounds);
+
+		const std::vector<Node>& Nodes() const { return nodes; };
+		const std::vector<uint32_t>& Primitives() const { return primitives; };
+		const Aabb& Bounds() const { return bounds; };
+		const BvhBuildStats& GetBuildStats() const { return stats; };
+
+		// Visits the leaves the ray enters, nearest child first. leaf(first, count, ray) gets a
+		// range of Primitives() and may shorten ray.t_max to the closest hit so far, which prunes
+		// the remaining children. Returning true ends the traversal, for any hit rays
+		template <typename F>
+		void Traverse(Ray& ray, F&& leaf) const;
+
+	private:
+		// triangles holds three vertices per primitive for spatial splits, or is null
+		void build(const std::vector<Aabb>& primitive_bounds, const std::vector<Vector3>* triangles, const BvhBuildSettings& settings, ThreadPool* pool);
+
+	private:
+		std::vector<Node> nodes;
+		std::vector<uint32_t> primitives;
+		Aabb bounds;
+		BvhBuildStats stats;
+	};
+
+	template <typename F>
+	void Bvh8::Traverse(Ray& ray, F&& leaf) const
+	{
+		if (nodes.empty())
+			return;
+
+		// Directions parallel to an axis get a tiny component, so the slab distances stay
+		// infinite instead of NaN
+		const float tiny = 1e-20f;
+		const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+		const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		float8 inv[3];
+		float8 offset[3];
+		int near_plane[3];
+		for (int a = 0; a < 3; a++)
+		{
+			const float da = std::abs(d[a]) < tiny ? (d[a] < 0.0f ? -tiny : tiny) : d[a];
+			const float ia = 1.0f / da;
+			inv[a] = float8::Set(ia);
+			offset[a] = float8::Set(-o[a] * ia);
+			near_plane[a] = 2 * a + (ia < 0.0f ? 1 : 0);
+		}
+		const float8 t_min = float8::Set(ray.t_min);
+
+		struct Entry
+		{
+			int32_t child;
+			uint32_t count;
+			float t;
+		};
+		// The binary build depth is capped, and each wide level adds at most seven entries
+		Entry stack[width * 72];
+		int stack_size = 1;
+		stack[0] = { 0, 0, ray.t_min };
+
+		while (stack_size > 0)
+		{
+			const Entry entry = stack[--stack_size];
+			if (entry.t > ray.t_max)
+				continue;
+			if (entry.count > 0)
+			{
+				if (leaf((uint32_t)~entry.child, entry.count, ray))
+					return;
+				continue;
+			}
+
+			const Node& node = nodes[entry.child];
+			const float8 t_max = float8::Set(ray.t_max);
+			float8 t_near = t_min;
+			float8 t_far = t_max;
+			for (int a = 0; a < 3; a++)
+			{
+				const float8 near_t = float8::MulAdd(float8::Load(node.bounds[near_plane[a]]), inv[a], offset[a]);
+				const float8 far_t = float8::MulAdd(float8::Load(node.bounds[near_plane[a] ^ 1]), inv[a], offset[a]);
+				t_near = float8::Max(t_near, near_t);
+				t_far = float8::Min(t_far, far_t);
+			}
+			int mask = float8::GreaterEqualMask(t_far, t_near);
+			if (mask == 0)
+				continue;
+
+			// Push the hit children farthest first so the nearest is popped next
+			float distances[width];
+			t_near.Store(distances);
+			const int first = stack_size;
+			while (mask != 0)
+			{
+				int i = 0;
+				while (((mask >> i) & 1) == 0)
+					i++;
+				mask &= mask - 1;
+				Entry e = { node.child[i], node.count[i], distances[i] };
+				int j = stack_size++;
+				while (j > first && stack[j - 1].t < e.t)
+				{
+					stack[j] = stack[j - 1];
+					j--;
+				}
+				stack[j] = e;
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#include "cpu_info.h"
+#include <cstring>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ECPU_CPUID 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define ECPU_CPUID 1
+#else
+#define ECPU_CPUID 0
+#endif
+
+namespace
+{
+#if ECPU_CPUID
+	void cpuid(unsigned int leaf, unsigned int regs[4])
+	{
+#if defined(_MSC_VER)
+		__cpuid((int*)regs, (int)leaf);
+#else
+		__cpuid(leaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+#endif
+}
+
+std::string ecpu::CpuModelName()
+{
+#if ECPU_CPUID
+	unsigned int regs[4];
+	cpuid(0x80000000u, regs);
+	if (regs[0] < 0x80000004u)
+		return "unknown";
+
+	// The brand string is spread over the registers of three extended leaves
+	char brand[49] = {};
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		cpuid(0x80000002u + i, regs);
+		std::memcpy(brand + 16 * i, regs, 16);
+	}
+
+	std::string name(brand);
+	size_t first = name.find_first_not_of(' ');
+	size_t last = name.find_last_not_of(' ');
+	return first == std::string::npos ? "unknown" : name.substr(first, last - first + 1);
+#else
+	return "unknown";
+#endif
+}
+
+std::string ecpu::CompilerName()
+{
+#if defined(__clang__)
+	return "clang " + std::to_string(__clang_major__) + "." + std::to_string(__clang_minor__);
+#elif defined(_MSC_VER)
+	return "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__GNUC__)
+	return "GCC " + std::to_string(__GNUC__) + "." + std::to_string(__GNUC_MINOR__);
+#else
+	return "unknown";
+#endif
+}
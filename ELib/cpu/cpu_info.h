@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+namespace ecpu
+{
+	// Processor brand string, for example "Intel(R) Core(TM) i7-9700K CPU @ 3.60GHz".
+	// Returns "unknown" where it can not be queried
+	std::string CpuModelName();
+	// Compiler and version this code was built with, for example "MSVC 1929"
+	std::string CompilerName();
+}
@@ -0,0 +1,112 @@
+#include "frustum.h"
+
+ecpu::Frustum ecpu::Frustum::FromMatrix(const Matrix4& view_projection, float margin)
+{
+	// Row vectors, so clip coordinate j is the dot product with column j
+	float column[4][4];
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 4; i++)
+			column[j][i] = view_projection.m[i][j];
+
+	const float side = 1.0f + margin;
+	Frustum frustum;
+	for (int i = 0; i < 4; i++)
+	{
+		frustum.planes[0][i] = side * column[3][i] + column[0][i];	// Left, -w <= x
+		frustum.planes[1][i] = side * column[3][i] - column[0][i];	// Right
+		frustum.planes[2][i] = side * column[3][i] + column[1][i];	// Bottom
+		frustum.planes[3][i] = side * column[3][i] - column[1][i];	// Top
+		frustum.planes[4][i] = column[2][i];						// Near, 0 <= z
+		frustum.planes[5][i] = column[3][i] - column[2][i];			// Far
+	}
+	return frustum;
+}
+
+void ecpu::BoundsSoA::Clear()
+{
+	count = 0;
+	for (auto* v : { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z })
+		v->clear();
+}
+
+void ecpu::BoundsSoA::Push(const Aabb& box)
+{
+	if (count % 8 == 0)
+	{
+		// Padding lanes hold empty boxes
+		const Aabb empty;
+		min_x.resize(count + 8, empty.min.x);
+		min_y.resize(count + 8, empty.min.y);
+		min_z.resize(count + 8, empty.min.z);
+		max_x.resize(count + 8, empty.max.x);
+		max_y.resize(count + 8, empty.max.y);
+		max_z.resize(count + 8, empty.max.z);
+	}
+	min_x[count] = box.min.x;
+	min_y[count] = box.min.y;
+	min_z[count] = box.min.z;
+	max_x[count] = box.max.x;
+	max_y[count] = box.max.y;
+	max_z[count] = box.max.z;
+	count++;
+}
+
+void ecpu::BoundsSoA::PushTransformed(const Aabb& box, const Matrix4& world)
+{
+	if (box.Empty())
+	{
+		Push(box);
+		return;
+	}
+	// The center moves with the matrix and each world axis extent sums the absolute
+	// contributions of the model axes
+	const Vector3 center = box.Center();
+	const Vector3 extent = (box.max - box.min) * 0.5f;
+	const Vector4 c = world.Transform(center);
+	float e[3];
+	for (int i = 0; i < 3; i++)
+		e[i] = std::abs(world.m[0][i]) * extent.x + std::abs(world.m[1][i]) * extent.y + std::abs(world.m[2][i]) * extent.z;
+	Aabb out;
+	out.min = Vector3(c.x - e[0], c.y - e[1], c.z - e[2]);
+	out.max = Vector3(c.x + e[0], c.y + e[1], c.z + e[2]);
+	Push(out);
+}
+
+ecpu::Aabb ecpu::BoundsSoA::Get(size_t i) const
+{
+	Aabb box;
+	box.min = Vector3(min_x[i], min_y[i], min_z[i]);
+	box.max = Vector3(max_x[i], max_y[i], max_z[i]);
+	return box;
+}
+
+void ecpu::BoundsSoA::Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	// The arrays holding each plane's farthest corner, and the plane as float8s
+	const float* corner[6][3];
+	float8 plane[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		const float* f = frustum.planes[p];
+		corner[p][0] = f[0] >= 0.0f ? max_x.data() : min_x.data();
+		corner[p][1] = f[1] >= 0.0f ? max_y.data() : min_y.data();
+		corner[p][2] = f[2] >= 0.0f ? max_z.data() : min_z.data();
+		for (int i = 0; i < 4; i++)
+			plane[p][i] = float8::Set(f[i]);
+	}
+
+	const float8 zero = float8::Zero();
+	for (size_t first = 0; first < count; first += 8)
+	{
+		int inside = count - first >= 8 ? 0xff : (1 << (count - first)) - 1;
+		for (int p = 0; p < 6 && inside != 0; p++)
+		{
+			const float8 distance = float8::MulAdd(plane[p][0], float8::Load(corner[p][0] + first),
+				float8::MulAdd(plane[p][1], float8::Load(corner[p][1] + first), float8::MulAdd(plane[p][2], float8::Load(corner[p][2] + first), plane[p][3])));
+			inside &= float8::GreaterEqualMask(distance, zero);
+		}
+		for (int lane = 0; inside != 0; lane++, inside >>= 1)
+			if (inside & 1)
+				visible.push_back((uint32_t)(first + lane));
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "bvh.h"
+
+namespace ecpu
+{
+	// The six planes a x + b y + c z + d >= 0 bounding the space a view projection matrix takes
+	// into the D3D clip volume, for perspective and orthographic cameras alike. The planes are
+	// not normalized, only the sign of the distance is used
+	struct Frustum
+	{
+		float planes[6][4];
+
+		// margin widens the side planes by that much of the ndc range, so jittered projections
+		// of the same camera stay inside
+		static Frustum FromMatrix(const Matrix4& view_projection, float margin = 0.0f);
+	};
+
+	// Boxes in structure of arrays layout for culling eight at a time. A box is tested against a
+	// plane by its corner farthest along the plane normal, which per plane always comes from the
+	// same three of the six arrays, so the test needs no per box selects
+	class BoundsSoA
+	{
+	public:
+		void Clear();
+		void Push(const Aabb& box);
+		// The box around the corners of a model space box moved to world space
+		void PushTransformed(const Aabb& box, const Matrix4& world);
+
+		size_t Size() const { return count; };
+		Aabb Get(size_t i) const;
+
+		// Appends the indices of the boxes at least partly inside the frustum, in order. Empty
+		// boxes are never inside
+		void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	private:
+		size_t count = 0;
+		// Rounded up to whole float8s
+		std::vector<float> min_x, min_y, min_z;
+		std::vector<float> max_x, max_y, max_z;
+	};
+}
@@ -0,0 +1,258 @@
+#include "image_metrics.h"
+#include "simd.h"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	const int window_size = 11;
+	const int window_radius = window_size / 2;
+	const float window_sigma = 1.5f;
+	const float c1 = 0.01f * 0.01f;
+	const float c2 = 0.03f * 0.03f;
+	// Output rows per SSIM task. Every task filters window_size - 1 extra rows horizontally
+	const int ssim_rows_per_task = 32;
+	const int rows_per_task = 16;
+
+	// Local means of the two images, their squares and their product, the five maps of _ssim
+	const int ssim_maps = 5;
+
+	void checkShapes(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		if (a.Shape() != b.Shape() || a.Shape().n != 1)
+			throw std::runtime_error("Image metrics need two single images of the same shape");
+	}
+
+	// metrics.gaussian
+	std::vector<float> gaussianWindow()
+	{
+		std::vector<float> window(window_size);
+		float sum = 0.0f;
+		for (int i = 0; i < window_size; i++)
+		{
+			window[i] = std::exp(-(float)((i - window_radius) * (i - window_radius)) / (2.0f * window_sigma * window_sigma));
+			sum += window[i];
+		}
+		for (float& w : window)
+			w /= sum;
+		return window;
+	}
+
+	// Sum over rows of f(row, first value, value count), split over the pool
+	template <typename F>
+	double sumRows(const ecpu::Tensor& image, ecpu::ThreadPool& pool, F f)
+	{
+		const int height = image.Shape().h;
+		const int row_values = image.Shape().w * image.Shape().c;
+		const int tasks = (height + rows_per_task - 1) / rows_per_task;
+		std::vector<double> sums(tasks, 0.0);
+		pool.ParallelFor(tasks, [&](int task)
+			{
+				for (int y = task * rows_per_task; y < std::min(height, (task + 1) * rows_per_task); y++)
+					sums[task] += f((size_t)y * row_values, row_values);
+			});
+		double sum = 0.0;
+		for (double s : sums)
+			sum += s;
+		return sum;
+	}
+
+	double psnrOf(double mse)
+	{
+		return 20.0 * std::log10(1.0 / std::sqrt(mse));
+	}
+}
+
+double ecpu::MeanSquaredError(const Tensor& a, const Tensor& b, ThreadPool& pool)
+{
+	checkShapes(a, b);
+	const double sum = sumRows(a, pool, [&](size_t first, int count)
+		{
+			const float* pa = a.Data() + first;
+			const float* pb = b.Data() + first;
+			float8 acc = float8::Zero();
+			int i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const float8 d = float8::Load(pa + i) - float8::Load(pb + i);
+				acc = float8::MulAdd(d, d, acc);
+			}
+			double row = acc.Sum();
+			for (; i < count; i++)
+				row += (double)(pa[i] - pb[i]) * (pa[i] - pb[i]);
+			return row;
+		});
+	return sum / a.ElementCount();
+}
+
+double ecpu::PSNR(const Tensor& a, const Tensor& b, ThreadPool& pool)
+{
+	return psnrOf(MeanSquaredError(a, b, pool));
+}
+
+double ecpu::TemporalPSNR(const Tensor& a, const Tensor& prev_a, const Tensor& target, const Tensor& prev_target, ThreadPool& pool)
+{
+	checkShapes(a, prev_a);
+	checkShapes(a, target);
+	checkShapes(a, prev_target);
+	const double sum = sumRows(a, pool, [&](size_t first, int count)
+		{
+			double row = 0.0;
+			for (int i = 0; i < count; i++)
+			{
+				const size_t j = first + i;
+				const float d = (a.Data()[j] - prev_a.Data()[j]) - (target.Data()[j] - prev_target.Data()[j]);
+				row += (double)d * d;
+			}
+			return row;
+		});
+	return psnrOf(sum / a.ElementCount());
+}
+
+double ecpu::SpatioTemporalError(const Tensor& a, const Tensor& prev_a, const Tensor& target, const Tensor& prev_target,
+	float theta, ThreadPool& pool)
+{
+	checkShapes(a, prev_a);
+	checkShapes(a, target);
+	checkShapes(a, prev_target);
+	const double sum = sumRows(a, pool, [&](size_t first, int count)
+		{
+			double row = 0.0;
+			for (int i = 0; i < count; i++)
+			{
+				const size_t j = first + i;
+				const float d1 = a.Data()[j] - target.Data()[j];
+				const float d0 = prev_a.Data()[j] - prev_target.Data()[j];
+				row += (std::abs(d1 - d0) - std::abs(d1) - std::abs(d0)) * theta + std::abs(d1) + std::abs(d0);
+			}
+			return row;
+		});
+	return sum / a.ElementCount();
+}
+
+double ecpu::SSIM(const Tensor& a, const Tensor& b, ThreadPool& pool)
+{
+	checkShapes(a, b);
+	const int width = a.Shape().w;
+	const int height = a.Shape().h;
+	const int channels = a.Shape().c;
+	const int row_values = width * channels;
+	const std::vector<float> window = gaussianWindow();
+
+	// Rows are filtered as flat arrays of interleaved channels, where horizontal neighbors are
+	// channels values apart. Input rows get zero padding on both sides and slack for the vector
+	// tail, filtered rows are kept in a ring of window_size rows per map
+	const int pad = window_radius * channels;
+	const int padded_values = row_values + 2 * pad + 8;
+	const int ring_values = row_values + 8;
+
+	const int tasks = (height + ssim_rows_per_task - 1) / ssim_rows_per_task;
+	std::vector<double> sums(tasks, 0.0);
+	pool.ParallelFor(tasks, [&](int task)
+		{
+			const int y0 = task * ssim_rows_per_task;
+			const int y1 = std::min(height, y0 + ssim_rows_per_task);
+			std::vector<float> products((size_t)ssim_maps * padded_values, 0.0f);
+			std::vector<float> ring((size_t)ssim_maps * window_size * ring_values, 0.0f);
+			auto ringRow = [&](int map, int y) { return ring.data() + ((size_t)map * window_size + (y + window_size) % window_size) * ring_values; };
+
+			// Horizontal pass of row y of the five maps into the ring, zero outside the image
+			auto filterRow = [&](int y)
+			{
+				if (y < 0 || y >= height)
+				{
+					for (int m = 0; m < ssim_maps; m++)
+						std::fill(ringRow(m, y), ringRow(m, y) + ring_values, 0.0f);
+					return;
+				}
+				const float* pa = a.Data() + (size_t)y * row_values;
+				const float* pb = b.Data() + (size_t)y * row_values;
+				for (int i = 0; i < row_values; i++)
+				{
+					products[0 * (size_t)padded_values + pad + i] = pa[i];
+					products[1 * (size_t)padded_values + pad + i] = pb[i];
+					products[2 * (size_t)padded_values + pad + i] = pa[i] * pa[i];
+					products[3 * (size_t)padded_values + pad + i] = pb[i] * pb[i];
+					products[4 * (size_t)padded_values + pad + i] = pa[i] * pb[i];
+				}
+				for (int m = 0; m < ssim_maps; m++)
+				{
+					const float* src = products.data() + (size_t)m * padded_values;
+					float* dst = ringRow(m, y);
+					for (int i = 0; i < row_values; i += 8)
+					{
+						float8 acc = float8::Zero();
+						for (int k = 0; k < window_size; k++)
+							acc = float8::MulAdd(float8::Load(src + i + k * channels), float8::Set(window[k]), acc);
+						acc.Store(dst + i);
+					}
+				}
+			};
+
+			for (int y = y0 - window_radius; y < y0 + window_radius; y++)
+				filterRow(y);
+
+			std::vector<float> filtered((size_t)ssim_maps * ring_values);
+			double sum = 0.0;
+			for (int y = y0; y < y1; y++)
+			{
+				filterRow(y + window_radius);
+
+				// Vertical pass, then the SSIM map of the row
+				for (int m = 0; m < ssim_maps; m++)
+				{
+					float* dst = filtered.data() + (size_t)m * ring_values;
+					for (int i = 0; i < row_values; i += 8)
+					{
+						float8 acc = float8::Zero();
+						for (int k = 0; k < window_size; k++)
+							acc = float8::MulAdd(float8::Load(ringRow(m, y + k - window_radius) + i), float8::Set(window[k]), acc);
+						acc.Store(dst + i);
+					}
+				}
+
+				const float* mu1 = filtered.data();
+				const float* mu2 = mu1 + ring_values;
+				const float* e11 = mu2 + ring_values;
+				const float* e22 = e11 + ring_values;
+				const float* e12 = e22 + ring_values;
+				float8 acc = float8::Zero();
+				int i = 0;
+				for (; i + 8 <= row_values; i += 8)
+				{
+					const float8 m1 = float8::Load(mu1 + i);
+					const float8 m2 = float8::Load(mu2 + i);
+					const float8 mu1_sq = m1 * m1;
+					const float8 mu2_sq = m2 * m2;
+					const float8 mu1_mu2 = m1 * m2;
+					const float8 sigma1_sq = float8::Load(e11 + i) - mu1_sq;
+					const float8 sigma2_sq = float8::Load(e22 + i) - mu2_sq;
+					const float8 sigma12 = float8::Load(e12 + i) - mu1_mu2;
+					const float8 two = float8::Set(2.0f);
+					const float8 numerator = float8::MulAdd(two, mu1_mu2, float8::Set(c1)) * float8::MulAdd(two, sigma12, float8::Set(c2));
+					const float8 denominator = (mu1_sq + mu2_sq + float8::Set(c1)) * (sigma1_sq + sigma2_sq + float8::Set(c2));
+					acc += numerator / denominator;
+				}
+				double row = acc.Sum();
+				for (; i < row_values; i++)
+				{
+					const float mu1_sq = mu1[i] * mu1[i];
+					const float mu2_sq = mu2[i] * mu2[i];
+					const float mu1_mu2 = mu1[i] * mu2[i];
+					const float sigma1_sq = e11[i] - mu1_sq;
+					const float sigma2_sq = e22[i] - mu2_sq;
+					const float sigma12 = e12[i] - mu1_mu2;
+					row += ((2.0f * mu1_mu2 + c1) * (2.0f * sigma12 + c2)) / ((mu1_sq + mu2_sq + c1) * (sigma1_sq + sigma2_sq + c2));
+				}
+				sum += row;
+			}
+			sums[task] = sum;
+		});
+
+	double sum = 0.0;
+	for (double s : sums)
+		sum += s;
+	return sum / a.ElementCount();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "tensor.h"
+#include "thread_pool.h"
+
+namespace ecpu
+{
+	// Image quality metrics of Network/metrics.py for { 1, h, w, c } images in [0, 1], so results
+	// can be computed without PyTorch. Sums are accumulated in double, results match the PyTorch
+	// versions to float precision. Images of different shapes throw.
+
+	double MeanSquaredError(const Tensor& a, const Tensor& b, ThreadPool& pool);
+
+	// metrics.PSNR, 20 log10(1 / sqrt(mse))
+	double PSNR(const Tensor& a, const Tensor& b, ThreadPool& pool);
+
+	// metrics.SSIM with its defaults: an 11x11 Gaussian window with sigma 1.5 applied per channel
+	// with zero padding, averaged over every pixel and channel. The window is applied as two
+	// separable passes
+	double SSIM(const Tensor& a, const Tensor& b, ThreadPool& pool);
+
+	// metrics.TPSNR, the PSNR of the frame to frame change of a sequence against the change of
+	// its targets
+	double TemporalPSNR(const Tensor& a, const Tensor& prev_a, const Tensor& target, const Tensor& prev_target, ThreadPool& pool);
+
+	// metrics.SpatioTemporalLoss for one frame, without motion compensation. theta moves the error
+	// from the per frame differences to their change between frames
+	double SpatioTemporalError(const Tensor& a, const Tensor& prev_a, const Tensor& target, const Tensor& prev_target,
+		float theta, ThreadPool& pool);
+}
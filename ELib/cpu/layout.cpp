@@ -0,0 +1,230 @@
+#include "layout.h"
+#include "simd.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	// Rows of the output handed to one task of the thread pool
+	const int rows_per_task = 4;
+	// Side of the square tiles Transpose works through, 4 KB of source and destination each
+	const int transpose_tile = 32;
+
+	void transposeBlock8(const float* src, ptrdiff_t src_stride, float* dst, ptrdiff_t dst_stride)
+	{
+		ecpu::float8 rows[8];
+		for (int i = 0; i < 8; i++)
+			rows[i] = ecpu::float8::Load(src + i * src_stride);
+		ecpu::Transpose8x8(rows);
+		for (int i = 0; i < 8; i++)
+			rows[i].Store(dst + i * dst_stride);
+	}
+
+	// Calls f(n, y) for every output row of an { n, h } grid of rows, split over the pool
+	template <typename F>
+	void forEachRow(int n, int h, ecpu::ThreadPool& pool, F f)
+	{
+		const int bands = (h + rows_per_task - 1) / rows_per_task;
+		pool.ParallelFor(n * bands, [&](int task)
+			{
+				const int image = task / bands;
+				const int y0 = (task % bands) * rows_per_task;
+				for (int y = y0; y < std::min(h, y0 + rows_per_task); y++)
+					f(image, y);
+			});
+	}
+
+	// Rows of a view without a block rearrangement
+	void materializePlain(const ecpu::LayoutView& view, float* dst, int n, int y)
+	{
+		const ecpu::TensorShape& s = view.shape;
+		const float* src = view.data + n * view.n_stride + y * view.y_stride;
+		if (view.c_stride == 1)
+		{
+			if (view.x_stride == s.c)
+			{
+				std::memcpy(dst, src, sizeof(float) * s.w * s.c);
+				return;
+			}
+			for (int x = 0; x < s.w; x++)
+				std::memcpy(dst + x * s.c, src + x * view.x_stride, sizeof(float) * s.c);
+		}
+		else if (view.x_stride == 1)
+		{
+			// A row of channel planes is a C x W matrix
+			ecpu::Transpose(src, view.c_stride, dst, s.c, s.c, s.w);
+		}
+		else
+		{
+			for (int x = 0; x < s.w; x++)
+				for (int c = 0; c < s.c; c++)
+					dst[x * s.c + c] = src[x * view.x_stride + c * view.c_stride];
+		}
+	}
+
+	void materializeUnshuffle(const ecpu::LayoutView& view, float* dst, int n, int y)
+	{
+		const ecpu::TensorShape& s = view.shape;
+		const int r = view.r;
+		const int channels = s.c / (r * r);
+		const float* image = view.data + n * view.n_stride;
+		for (int dy = 0; dy < r; dy++)
+		{
+			const float* src = image + (y * r + dy) * view.y_stride;
+			if (view.c_stride == 1)
+			{
+				// The r source pixels of a block row are an r x C matrix, stored as C x r
+				for (int x = 0; x < s.w; x++)
+					ecpu::Transpose(src + x * r * view.x_stride, view.x_stride, dst + x * s.c + dy * r, r * r, r, channels);
+			}
+			else if (view.x_stride == 1)
+			{
+				for (int x = 0; x < s.w; x++)
+					for (int c = 0; c < channels; c++)
+						std::memcpy(dst + x * s.c + ecpu::PixelUnshuffleChannel(c, 0, dy, r), src + x * r + c * view.c_stride, sizeof(float) * r);
+			}
+			else
+			{
+				for (int x = 0; x < s.w; x++)
+					for (int c = 0; c < channels; c++)
+						for (int dx = 0; dx < r; dx++)
+							dst[x * s.c + ecpu::PixelUnshuffleChannel(c, dx, dy, r)] = src[(x * r + dx) * view.x_stride + c * view.c_stride];
+			}
+		}
+	}
+
+	void materializeShuffle(const ecpu::LayoutView& view, float* dst, int n, int y)
+	{
+		const ecpu::TensorShape& s = view.shape;
+		const int r = view.r;
+		const float* src = view.data + n * view.n_stride + y / r * view.y_stride;
+		const int dy = y % r;
+		if (view.c_stride == 1)
+		{
+			// The C x r channels of a block row become r pixels of C channels
+			for (int x = 0; x < s.w / r; x++)
+				ecpu::Transpose(src + x * view.x_stride + dy * r, r * r, dst + x * r * s.c, s.c, s.c, r);
+			return;
+		}
+		for (int x = 0; x < s.w; x++)
+			for (int c = 0; c < s.c; c++)
+				dst[x * s.c + c] = src[x / r * view.x_stride + ecpu::PixelUnshuffleChannel(c, x % r, dy, r) * view.c_stride];
+	}
+}
+
+ecpu::PlaneView ecpu::LayoutView::Plane(int n) const
+{
+	if (!IsPlane())
+		throw std::runtime_error("Only unshuffled views with adjacent channels can be read as planes");
+	PlaneView view;
+	view.data = const_cast<float*>(data) + n * n_stride;
+	view.height = shape.h;
+	view.width = shape.w;
+	view.channels = shape.c;
+	view.row_stride = y_stride;
+	view.pixel_stride = x_stride;
+	return view;
+}
+
+ecpu::LayoutView ecpu::NHWCView(const Tensor& tensor)
+{
+	const TensorShape& s = tensor.Shape();
+	LayoutView view;
+	view.data = tensor.Data();
+	view.shape = s;
+	view.c_stride = 1;
+	view.x_stride = s.c;
+	view.y_stride = (ptrdiff_t)s.w * s.c;
+	view.n_stride = (ptrdiff_t)s.h * s.w * s.c;
+	return view;
+}
+
+ecpu::LayoutView ecpu::NCHWView(const float* data, const TensorShape& shape)
+{
+	LayoutView view;
+	view.data = data;
+	view.shape = shape;
+	view.x_stride = 1;
+	view.y_stride = shape.w;
+	view.c_stride = (ptrdiff_t)shape.h * shape.w;
+	view.n_stride = (ptrdiff_t)shape.c * shape.h * shape.w;
+	return view;
+}
+
+ecpu::LayoutView ecpu::PixelUnshuffleView(const LayoutView& view, int r)
+{
+	if (view.block != LayoutView::Block::None || r < 1)
+		throw std::runtime_error("Pixel unshuffle needs a view without a block rearrangement");
+	if (view.shape.h % r != 0 || view.shape.w % r != 0)
+		throw std::runtime_error("Pixel unshuffle needs a size divisible by the factor");
+	LayoutView out = view;
+	out.shape = TensorShape(view.shape.n, view.shape.h / r, view.shape.w / r, view.shape.c * r * r);
+	out.block = LayoutView::Block::Unshuffle;
+	out.r = r;
+	return out;
+}
+
+ecpu::LayoutView ecpu::PixelShuffleView(const LayoutView& view, int r)
+{
+	if (view.block != LayoutView::Block::None || r < 1)
+		throw std::runtime_error("Pixel shuffle needs a view without a block rearrangement");
+	if (view.shape.c % (r * r) != 0)
+		throw std::runtime_error("Pixel shuffle needs a channel count divisible by the factor squared");
+	LayoutView out = view;
+	out.shape = TensorShape(view.shape.n, view.shape.h * r, view.shape.w * r, view.shape.c / (r * r));
+	out.block = LayoutView::Block::Shuffle;
+	out.r = r;
+	return out;
+}
+
+void ecpu::Materialize(const LayoutView& view, Tensor& out, ThreadPool& pool)
+{
+	out.Resize(view.shape);
+	const TensorShape& s = view.shape;
+	forEachRow(s.n, s.h, pool, [&](int n, int y)
+		{
+			float* dst = out.Data() + ((size_t)n * s.h + y) * s.w * s.c;
+			switch (view.block)
+			{
+			case LayoutView::Block::Unshuffle: materializeUnshuffle(view, dst, n, y); break;
+			case LayoutView::Block::Shuffle: materializeShuffle(view, dst, n, y); break;
+			default: materializePlain(view, dst, n, y); break;
+			}
+		});
+}
+
+void ecpu::StoreNCHW(const Tensor& in, float* out, ThreadPool& pool)
+{
+	const TensorShape& s = in.Shape();
+	const ptrdiff_t plane = (ptrdiff_t)s.h * s.w;
+	forEachRow(s.n, s.h, pool, [&](int n, int y)
+		{
+			const float* src = in.Data() + ((size_t)n * s.h + y) * s.w * s.c;
+			Transpose(src, s.c, out + n * plane * s.c + (ptrdiff_t)y * s.w, plane, s.w, s.c);
+		});
+}
+
+void ecpu::Transpose(const float* src, ptrdiff_t src_stride, float* dst, ptrdiff_t dst_stride, int rows, int cols)
+{
+	for (int i0 = 0; i0 < rows; i0 += transpose_tile)
+	{
+		const int i1 = std::min(rows, i0 + transpose_tile);
+		for (int j0 = 0; j0 < cols; j0 += transpose_tile)
+		{
+			const int j1 = std::min(cols, j0 + transpose_tile);
+			int i = i0;
+			for (; i + 8 <= i1; i += 8)
+			{
+				int j = j0;
+				for (; j + 8 <= j1; j += 8)
+					transposeBlock8(src + i * src_stride + j, src_stride, dst + j * dst_stride + i, dst_stride);
+				for (; j < j1; j++)
+					for (int k = 0; k < 8; k++)
+						dst[j * dst_stride + i + k] = src[(i + k) * src_stride + j];
+			}
+			for (; i < i1; i++)
+				for (int j = j0; j < j1; j++)
+					dst[j * dst_stride + i] = src[i * src_stride + j];
+		}
+	}
+}
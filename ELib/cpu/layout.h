@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include "tensor.h"
+#include "thread_pool.h"
+
+namespace ecpu
+{
+	// Channel of a pixel-unshuffled image holding channel c of pixel (dx, dy) in an r x r block.
+	// The order of pixelShuffleWeights in master_net.cpp, get_pixel_shuffle_index in the shaders
+	// and pixel_unshuffle in models.py
+	inline int PixelUnshuffleChannel(int c, int dx, int dy, int r)
+	{
+		return (c * r + dy) * r + dx;
+	}
+
+	// Read only view of memory in some layout as a logical NHWC tensor of the given shape, so
+	// kernels can take NCHW data, pixel-shuffled and pixel-unshuffled images without a copy.
+	// Element (n, y, x, c) of a plain view is at data + n * n_stride + y * y_stride + x * x_stride
+	// + c * c_stride. Shuffle views apply the block rearrangement first and keep the strides of
+	// the view they were made from
+	struct LayoutView
+	{
+		enum class Block
+		{
+			None,
+			Unshuffle,	// { N, H / r, W / r, C * r * r } view of a { N, H, W, C } image
+			Shuffle,	// { N, H * r, W * r, C / (r * r) } view of a { N, H, W, C } image
+		};
+
+		const float* data = nullptr;
+		TensorShape shape;
+		ptrdiff_t n_stride = 0;
+		ptrdiff_t y_stride = 0;
+		ptrdiff_t x_stride = 0;
+		ptrdiff_t c_stride = 0;
+		Block block = Block::None;
+		int r = 1;
+
+		inline float At(int n, int y, int x, int c) const
+		{
+			const float* image = data + n * n_stride;
+			switch (block)
+			{
+			case Block::Unshuffle:
+				return image[(y * r + (c / r) % r) * y_stride + (x * r + c % r) * x_stride + c / (r * r) * c_stride];
+			case Block::Shuffle:
+				return image[y / r * y_stride + x / r * x_stride + PixelUnshuffleChannel(c, x % r, y % r, r) * c_stride];
+			default:
+				return image[y * y_stride + x * x_stride + c * c_stride];
+			}
+		}
+
+		// Plane views are what the convolution kernels read in place: unshuffled, with the
+		// channels of a pixel next to each other
+		inline bool IsPlane() const { return block == Block::None && c_stride == 1; };
+		PlaneView Plane(int n = 0) const;
+	};
+
+	LayoutView NHWCView(const Tensor& tensor);
+	// data holds shape.n images of shape.c planes of shape.h rows, the layout of PyTorch and DirectML NCHW
+	LayoutView NCHWView(const float* data, const TensorShape& shape);
+	// Pixel (un)shuffle of a view without a block rearrangement. Throws if the sizes are not
+	// divisible by the factor
+	LayoutView PixelUnshuffleView(const LayoutView& view, int r);
+	LayoutView PixelShuffleView(const LayoutView& view, int r);
+
+	// Copies the view into an NHWC tensor, resized to the view shape. NCHW views and pixel
+	// shuffles go through the blocked transpose below
+	void Materialize(const LayoutView& view, Tensor& out, ThreadPool& pool);
+	// Writes an NHWC tensor as NCHW, the inverse of Materialize(NCHWView(out, shape))
+	void StoreNCHW(const Tensor& in, float* out, ThreadPool& pool);
+
+	// dst[j * dst_stride + i] = src[i * src_stride + j] for the rows x cols matrix at src. Tiles
+	// small enough for L1 are transposed in 8x8 SIMD blocks, the edges element by element
+	void Transpose(const float* src, ptrdiff_t src_stride, float* dst, ptrdiff_t dst_stride, int rows, int cols);
+}
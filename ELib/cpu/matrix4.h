@@ -0,0 +1,162 @@
+#pragma once
+#include <cmath>
+
+namespace ecpu
+{
+	struct Vector3
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+
+		Vector3() {};
+		Vector3(float x, float y, float z) : x(x), y(y), z(z) {};
+
+		inline Vector3 operator+(const Vector3& rhs) const { return Vector3(x + rhs.x, y + rhs.y, z + rhs.z); };
+		inline Vector3 operator-(const Vector3& rhs) const { return Vector3(x - rhs.x, y - rhs.y, z - rhs.z); };
+		inline Vector3 operator*(float s) const { return Vector3(x * s, y * s, z * s); };
+		inline float Dot(const Vector3& rhs) const { return x * rhs.x + y * rhs.y + z * rhs.z; };
+		inline Vector3 Cross(const Vector3& rhs) const { return Vector3(y * rhs.z - z * rhs.y, z * rhs.x - x * rhs.z, x * rhs.y - y * rhs.x); };
+		inline Vector3 Normalized() const { float l = std::sqrt(Dot(*this)); return l > 0.0f ? *this * (1.0f / l) : *this; };
+	};
+
+	struct Vector4
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+		float w = 0.0f;
+	};
+
+	// Portable 4x4 matrix with the conventions of ema::mat4, which wraps DirectXMath: row vectors
+	// transformed as v * M, left handed, and the same factory functions, so the CPU renderers
+	// build the matrices of egx::Camera and egx::Model without DirectXMath
+	struct Matrix4
+	{
+		float m[4][4];
+
+		static Matrix4 Identity()
+		{
+			return Rows(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		static Matrix4 Rows(float m00, float m01, float m02, float m03, float m10, float m11, float m12, float m13,
+			float m20, float m21, float m22, float m23, float m30, float m31, float m32, float m33)
+		{
+			Matrix4 out = { { { m00, m01, m02, m03 }, { m10, m11, m12, m13 }, { m20, m21, m22, m23 }, { m30, m31, m32, m33 } } };
+			return out;
+		}
+		static Matrix4 Translation(const Vector3& offset)
+		{
+			Matrix4 out = Identity();
+			out.m[3][0] = offset.x;
+			out.m[3][1] = offset.y;
+			out.m[3][2] = offset.z;
+			return out;
+		}
+		static Matrix4 Scale(const Vector3& scale)
+		{
+			Matrix4 out = Identity();
+			out.m[0][0] = scale.x;
+			out.m[1][1] = scale.y;
+			out.m[2][2] = scale.z;
+			return out;
+		}
+		// ema::mat4::RollPitchYaw: x is the roll around z, y the pitch around x and z the yaw
+		// around y, applied in that order
+		static Matrix4 RollPitchYaw(const Vector3& roll_pitch_yaw)
+		{
+			const float cr = std::cos(roll_pitch_yaw.x), sr = std::sin(roll_pitch_yaw.x);
+			const float cp = std::cos(roll_pitch_yaw.y), sp = std::sin(roll_pitch_yaw.y);
+			const float cy = std::cos(roll_pitch_yaw.z), sy = std::sin(roll_pitch_yaw.z);
+			const Matrix4 roll = Rows(cr, sr, 0.0f, 0.0f, -sr, cr, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			const Matrix4 pitch = Rows(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, cp, sp, 0.0f, 0.0f, -sp, cp, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			const Matrix4 yaw = Rows(cy, 0.0f, -sy, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, sy, 0.0f, cy, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			return roll * pitch * yaw;
+		}
+		static Matrix4 LookAt(const Vector3& position, const Vector3& look_at, const Vector3& up)
+		{
+			const Vector3 z = (look_at - position).Normalized();
+			const Vector3 x = up.Cross(z).Normalized();
+			const Vector3 y = z.Cross(x);
+			return Rows(x.x, y.x, z.x, 0.0f, x.y, y.y, z.y, 0.0f, x.z, y.z, z.z, 0.0f,
+				-x.Dot(position), -y.Dot(position), -z.Dot(position), 1.0f);
+		}
+		// ema::mat4::ProjectionOffset: dims is half the near plane rectangle and offset the jitter
+		// in normalized device coordinates. A zero offset gives ema::mat4::Projection
+		static Matrix4 ProjectionOffset(float near_plane, float far_plane, float dims_x, float dims_y, float offset_x, float offset_y)
+		{
+			const float r = far_plane / (far_plane - near_plane);
+			return Rows(near_plane / dims_x, 0.0f, 0.0f, 0.0f, 0.0f, near_plane / dims_y, 0.0f, 0.0f,
+				-offset_x, -offset_y, r, 1.0f, 0.0f, 0.0f, -r * near_plane, 0.0f);
+		}
+		// ema::mat4::Orthographic, for the shadow map camera
+		static Matrix4 Orthographic(float width, float height, float near_plane, float far_plane)
+		{
+			const float r = 1.0f / (far_plane - near_plane);
+			return Rows(2.0f / width, 0.0f, 0.0f, 0.0f, 0.0f, 2.0f / height, 0.0f, 0.0f,
+				0.0f, 0.0f, r, 0.0f, 0.0f, 0.0f, -r * near_plane, 1.0f);
+		}
+		// Local matrix of a TransformHierarchy node, the world matrix of a model without parent
+		static Matrix4 World(const Vector3& position, const Vector3& rotation, const Vector3& scale)
+		{
+			return Scale(scale) * RollPitchYaw(rotation) * Translation(position);
+		}
+
+		inline Matrix4 operator*(const Matrix4& rhs) const
+		{
+			Matrix4 out;
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++)
+					out.m[i][j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] + m[i][2] * rhs.m[2][j] + m[i][3] * rhs.m[3][j];
+			return out;
+		}
+
+		// General inverse by cofactors, for the inverse camera matrices of the ray generation.
+		// Singular matrices give non finite values
+		inline Matrix4 Inverse() const
+		{
+			const float* a = &m[0][0];
+			float inv[16];
+			inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+			inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+			inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+			inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+			inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+			inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+			inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+			inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+			inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+			inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+			inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+			inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+			inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+			inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+			inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+			inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+			const float det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+			const float inv_det = 1.0f / det;
+			Matrix4 out;
+			for (int i = 0; i < 16; i++)
+				(&out.m[0][0])[i] = inv[i] * inv_det;
+			return out;
+		}
+
+		// (p, w) * M
+		inline Vector4 Transform(const Vector3& p, float w = 1.0f) const
+		{
+			Vector4 out;
+			out.x = p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + w * m[3][0];
+			out.y = p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + w * m[3][1];
+			out.z = p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + w * m[3][2];
+			out.w = p.x * m[0][3] + p.y * m[1][3] + p.z * m[2][3] + w * m[3][3];
+			return out;
+		}
+		// Direction through the upper 3x3, the (float3x3) casts of the shaders
+		inline Vector3 TransformDirection(const Vector3& d) const
+		{
+			return Vector3(d.x * m[0][0] + d.y * m[1][0] + d.z * m[2][0], d.x * m[0][1] + d.y * m[1][1] + d.z * m[2][1],
+				d.x * m[0][2] + d.y * m[1][2] + d.z * m[2][2]);
+		}
+	};
+}
@@ -0,0 +1,266 @@
+#include "occlusion_culler.h"
+#include <stdexcept>
+#include <cmath>
+#include "timer.h"
+
+namespace
+{
+	const int tile_size = 8;
+	const uint64_t full_mask = ~uint64_t(0);
+
+	// D3D clip space, in front of the near plane
+	inline bool inFrontOfNearPlane(const ecpu::Vector4& c)
+	{
+		return c.w > 0.0f && c.z >= 0.0f;
+	}
+
+	// Pixel centres of a tile row relative to the tile's left edge
+	inline ecpu::float8 laneCenters()
+	{
+		const float centers[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+		return ecpu::float8::Load(centers);
+	}
+
+	float triangleArea(const ecpu::OccluderSource& mesh, size_t first_index)
+	{
+		const ecpu::Vector3& p0 = mesh.positions[mesh.indices[first_index]];
+		const ecpu::Vector3 e1 = mesh.positions[mesh.indices[first_index + 1]] - p0;
+		const ecpu::Vector3 e2 = mesh.positions[mesh.indices[first_index + 2]] - p0;
+		const ecpu::Vector3 c = e1.Cross(e2);
+		return 0.5f * std::sqrt(c.Dot(c));
+	}
+
+	// The triangles of at least min_area with their vertices
+	ecpu::OccluderMesh occluderMesh(const ecpu::OccluderSource& mesh, float min_area)
+	{
+		ecpu::OccluderMesh occluder;
+		std::vector<uint32_t> remap(mesh.positions.size(), UINT32_MAX);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			if (triangleArea(mesh, i) < min_area)
+				continue;
+			for (size_t j = i; j < i + 3; j++)
+			{
+				uint32_t& index = remap[mesh.indices[j]];
+				if (index == UINT32_MAX)
+				{
+					index = (uint32_t)occluder.vertices.size();
+					occluder.vertices.push_back(mesh.positions[mesh.indices[j]]);
+				}
+				occluder.indices.push_back(index);
+			}
+		}
+		return occluder;
+	}
+}
+
+float ecpu::SurfaceArea(const OccluderSource& mesh)
+{
+	float area = 0.0f;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		area += triangleArea(mesh, i);
+	return area;
+}
+
+std::vector<ecpu::OccluderMesh> ecpu::MakeOccluders(const std::vector<OccluderSource>& meshes, const std::vector<int>& tagged)
+{
+	float total_area = 0.0f;
+	for (const auto& mesh : meshes)
+		total_area += SurfaceArea(mesh);
+	std::vector<OccluderMesh> occluders(meshes.size());
+	for (int i : tagged)
+	{
+		if (i < 0 || i >= (int)meshes.size())
+			throw std::runtime_error("Occluder tag of a missing mesh");
+		occluders[i] = occluderMesh(meshes[i], min_occluder_triangle_share * total_area);
+	}
+	return occluders;
+}
+
+ecpu::MaskedOcclusionCuller::MaskedOcclusionCuller(int width, int height)
+	: width(width), height(height), tiles_x(width / tile_size), tiles_y(height / tile_size)
+{
+	if (width <= 0 || height <= 0 || width % tile_size != 0 || height % tile_size != 0)
+		throw std::runtime_error("Occlusion culler resolution must be a positive multiple of 8");
+	tile_stride = (tiles_x + 7) / 8 * 8;
+	// Tests load 8 tiles from any tile of a row
+	reference_depth.resize(tile_stride * tiles_y + 8);
+	working_depth.resize(tile_stride * tiles_y);
+	working_mask.resize(tile_stride * tiles_y);
+	Clear();
+}
+
+void ecpu::MaskedOcclusionCuller::Clear()
+{
+	std::fill(reference_depth.begin(), reference_depth.end(), 1.0f);
+	std::fill(working_depth.begin(), working_depth.end(), 0.0f);
+	std::fill(working_mask.begin(), working_mask.end(), 0);
+	stats = Stats();
+}
+
+void ecpu::MaskedOcclusionCuller::RenderOccluder(const OccluderMesh& occluder, const Matrix4& clip_matrix)
+{
+	Timer timer;
+	std::vector<Vector4> clip(occluder.vertices.size());
+	for (size_t i = 0; i < clip.size(); i++)
+		clip[i] = clip_matrix.Transform(occluder.vertices[i]);
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+	{
+		const Vector4& c0 = clip[occluder.indices[i]];
+		const Vector4& c1 = clip[occluder.indices[i + 1]];
+		const Vector4& c2 = clip[occluder.indices[i + 2]];
+		stats.occluder_triangles++;
+		if (inFrontOfNearPlane(c0) && inFrontOfNearPlane(c1) && inFrontOfNearPlane(c2))
+			renderTriangle(c0, c1, c2);
+	}
+	stats.raster_seconds += timer.Elapsed();
+}
+
+void ecpu::MaskedOcclusionCuller::renderTriangle(const Vector4& c0, const Vector4& c1, const Vector4& c2)
+{
+	const Vector4* c[3] = { &c0, &c1, &c2 };
+	float sx[3], sy[3], sz[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const float inv_w = 1.0f / c[i]->w;
+		sx[i] = (c[i]->x * inv_w * 0.5f + 0.5f) * width;
+		sy[i] = (0.5f - c[i]->y * inv_w * 0.5f) * height;
+		sz[i] = c[i]->z * inv_w;
+	}
+	const float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (!(std::abs(area) > 0.0f))
+		return;
+
+	const float min_x = std::min(sx[0], std::min(sx[1], sx[2]));
+	const float max_x = std::max(sx[0], std::max(sx[1], sx[2]));
+	const float min_y = std::min(sy[0], std::min(sy[1], sy[2]));
+	const float max_y = std::max(sy[0], std::max(sy[1], sy[2]));
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height)
+		return;
+	stats.rasterized_triangles++;
+	const int tx0 = int(std::max(min_x, 0.0f)) / tile_size;
+	const int ty0 = int(std::max(min_y, 0.0f)) / tile_size;
+	const int tx1 = int(std::min(max_x, width - 1.0f)) / tile_size;
+	const int ty1 = int(std::min(max_y, height - 1.0f)) / tile_size;
+
+	// Edge functions a x + b y + c, positive inside for either winding
+	const float sign = area > 0.0f ? 1.0f : -1.0f;
+	float a[3], b[3], e[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+		a[i] = -(sy[j] - sy[i]) * sign;
+		b[i] = (sx[j] - sx[i]) * sign;
+		e[i] = -(a[i] * sx[i] + b[i] * sy[i]);
+	}
+	// Depth is linear in screen space
+	const float dzdx = ((sz[1] - sz[0]) * (sy[2] - sy[0]) - (sz[2] - sz[0]) * (sy[1] - sy[0])) / area;
+	const float dzdy = ((sz[2] - sz[0]) * (sx[1] - sx[0]) - (sz[1] - sz[0]) * (sx[2] - sx[0])) / area;
+	const float max_z = std::max(sz[0], std::max(sz[1], sz[2]));
+	auto depthAt = [&](float x, float y) { return sz[0] + dzdx * (x - sx[0]) + dzdy * (y - sy[0]); };
+
+	const float8 zero = float8::Zero();
+	const float8 centers = laneCenters();
+	for (int ty = ty0; ty <= ty1; ty++)
+	{
+		const float y0 = float(ty * tile_size);
+		for (int tx = tx0; tx <= tx1; tx++)
+		{
+			const float x0 = float(tx * tile_size);
+			const float8 x = centers + float8::Set(x0);
+			float8 edge[3];
+			for (int i = 0; i < 3; i++)
+				edge[i] = float8::MulAdd(float8::Set(a[i]), x, float8::Set(b[i] * (y0 + 0.5f) + e[i]));
+			uint64_t coverage = 0;
+			for (int row = 0; row < tile_size; row++)
+			{
+				const int inside = float8::GreaterEqualMask(edge[0], zero) & float8::GreaterEqualMask(edge[1], zero) &
+					float8::GreaterEqualMask(edge[2], zero);
+				coverage |= uint64_t(inside) << (row * tile_size);
+				for (int i = 0; i < 3; i++)
+					edge[i] += float8::Set(b[i]);
+			}
+			if (coverage == 0)
+				continue;
+
+			// Farthest depth of the triangle in the part of the tile its bounds overlap
+			const float rx0 = std::max(x0, min_x), rx1 = std::min(x0 + tile_size, max_x);
+			const float ry0 = std::max(y0, min_y), ry1 = std::min(y0 + tile_size, max_y);
+			const float corner_z = std::max(std::max(depthAt(rx0, ry0), depthAt(rx1, ry0)), std::max(depthAt(rx0, ry1), depthAt(rx1, ry1)));
+			updateTile(ty * tile_stride + tx, coverage, std::min(corner_z, max_z));
+		}
+	}
+}
+
+void ecpu::MaskedOcclusionCuller::updateTile(int tile, uint64_t coverage, float depth)
+{
+	float& reference = reference_depth[tile];
+	float& working = working_depth[tile];
+	uint64_t& mask = working_mask[tile];
+	if (!(depth < reference))
+		return;
+	// A triangle much nearer than the working layer starts a new layer, the old one would
+	// only ever give a far reference depth
+	if (mask != 0 && working - depth > reference - working)
+	{
+		mask = 0;
+		working = 0.0f;
+	}
+	mask |= coverage;
+	working = std::max(working, depth);
+	if (mask == full_mask)
+	{
+		reference = working;
+		mask = 0;
+		working = 0.0f;
+	}
+}
+
+bool ecpu::MaskedOcclusionCuller::IsOccluded(const Aabb& bounds, const Matrix4& clip_matrix)
+{
+	Timer timer;
+	stats.tests++;
+	auto visible = [&]() { stats.test_seconds += timer.Elapsed(); return false; };
+	if (bounds.Empty())
+		return visible();
+
+	float min_x = std::numeric_limits<float>::infinity(), max_x = -min_x;
+	float min_y = min_x, max_y = max_x;
+	float min_z = min_x;
+	for (int i = 0; i < 8; i++)
+	{
+		const Vector3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+		const Vector4 c = clip_matrix.Transform(corner);
+		if (!inFrontOfNearPlane(c))
+			return visible();
+		const float inv_w = 1.0f / c.w;
+		const float x = (c.x * inv_w * 0.5f + 0.5f) * width;
+		const float y = (0.5f - c.y * inv_w * 0.5f) * height;
+		min_x = std::min(min_x, x);
+		max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y);
+		max_y = std::max(max_y, y);
+		min_z = std::min(min_z, c.z * inv_w);
+	}
+	if (!(max_x >= 0.0f && max_y >= 0.0f && min_x < width && min_y < height))
+		return visible();
+
+	const int tx0 = int(std::max(min_x, 0.0f)) / tile_size;
+	const int ty0 = int(std::max(min_y, 0.0f)) / tile_size;
+	const int tx1 = int(std::min(max_x, width - 1.0f)) / tile_size;
+	const int ty1 = int(std::min(max_y, height - 1.0f)) / tile_size;
+	const float8 box_z = float8::Set(min_z);
+	for (int ty = ty0; ty <= ty1; ty++)
+	{
+		const float* row = &reference_depth[ty * tile_stride];
+		for (int tx = tx0; tx <= tx1; tx += 8)
+		{
+			const int lanes = (1 << std::min(8, tx1 - tx + 1)) - 1;
+			if (float8::GreaterEqualMask(float8::Load(row + tx), box_z) & lanes)
+				return visible();
+		}
+	}
+	stats.occluded++;
+	stats.test_seconds += timer.Elapsed();
+	return true;
+}
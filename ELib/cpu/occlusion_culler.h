@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "bvh.h"
+
+namespace ecpu
+{
+	// Occluder triangles of one mesh in model space, only the vertices they use
+	struct OccluderMesh
+	{
+		std::vector<Vector3> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// Share of a model's surface area an occluder triangle needs, smaller ones cost more to
+	// rasterize than they hide
+	const float min_occluder_triangle_share = 1e-5f;
+
+	// Mesh positions and triangle indices, as both renderers load them
+	struct OccluderSource
+	{
+		std::vector<Vector3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	float SurfaceArea(const OccluderSource& mesh);
+	// Occluders of a model, one per mesh: the tagged meshes keep their triangles of at least
+	// min_occluder_triangle_share of the model's area, the others get none. Tags of missing
+	// meshes throw
+	std::vector<OccluderMesh> MakeOccluders(const std::vector<OccluderSource>& meshes, const std::vector<int>& tagged);
+
+	// Low resolution software occlusion culling with a masked hierarchical depth buffer. The
+	// buffer is split into 8x8 pixel tiles, and instead of per pixel depths every tile keeps
+	// the farthest depth of the occluders covering all of it, the reference layer, plus a
+	// working layer of the pixels covered so far with their farthest depth. Occluders merge
+	// into the working layer a coverage mask at a time, eight pixels of a row per float8, and
+	// when the mask fills up it becomes the new reference depth. Tests only read the
+	// reference depths, so a box is occluded when its nearest depth is behind every tile it
+	// touches. Depths are the z / w of the projection, 1 being the far plane. Occluder
+	// triangles that cross the near plane are skipped and boxes that cross it are never
+	// occluded, so culling only errs on the side of drawing
+	class MaskedOcclusionCuller
+	{
+	public:
+		struct Stats
+		{
+			size_t occluder_triangles = 0;
+			size_t rasterized_triangles = 0;	// In front of the near plane and on screen
+			size_t tests = 0;
+			size_t occluded = 0;
+			double raster_seconds = 0.0;
+			double test_seconds = 0.0;
+		};
+
+	public:
+		// The resolution must be a multiple of the 8x8 tiles
+		MaskedOcclusionCuller(int width, int height);
+
+		// Empties the depth buffer and resets the stats
+		void Clear();
+		// Draws the triangles with the clip matrix world * view * projection of the occluder
+		void RenderOccluder(const OccluderMesh& occluder, const Matrix4& clip_matrix);
+		// True if the box, in the space the clip matrix takes to clip space, is hidden. Empty
+		// boxes and boxes partly behind the camera or off screen are never hidden
+		bool IsOccluded(const Aabb& bounds, const Matrix4& clip_matrix);
+
+		int Width() const { return width; };
+		int Height() const { return height; };
+		int TilesX() const { return tiles_x; };
+		int TilesY() const { return tiles_y; };
+		// Reference depth of a tile, 1 until occluders cover all of it
+		float TileDepth(int tile_x, int tile_y) const { return reference_depth[tile_y * tile_stride + tile_x]; };
+		const Stats& GetStats() const { return stats; };
+
+	private:
+		void renderTriangle(const Vector4& c0, const Vector4& c1, const Vector4& c2);
+		void updateTile(int tile, uint64_t coverage, float depth);
+
+	private:
+		int width;
+		int height;
+		int tiles_x;
+		int tiles_y;
+		int tile_stride;	// tiles_x rounded up to whole float8s
+		std::vector<float> reference_depth;
+		std::vector<float> working_depth;
+		std::vector<uint64_t> working_mask;
+		Stats stats;
+	};
+}
@@ -0,0 +1,183 @@
+#include "resample.h"
+#include "simd.h"
+#include <stdexcept>
+
+namespace
+{
+	using namespace ecpu::resample_internal;
+	const int rows_per_task = 8;
+	const float lane_offsets[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+	// cubicWeights on eight fractions
+	void cubicWeights8(const ecpu::float8& f, float a, ecpu::float8* w)
+	{
+		using ecpu::float8;
+		const float8 f2 = f * f;
+		const float8 f3 = f2 * f;
+		w[0] = float8::Set(a) * (f3 - float8::Set(2.0f) * f2 + f);
+		w[1] = float8::Set(a + 2.0f) * f3 - float8::Set(a + 3.0f) * f2 + float8::Set(1.0f);
+		w[2] = float8::Set(2.0f * a + 3.0f) * f2 - float8::Set(a + 2.0f) * f3 - float8::Set(a) * f;
+		w[3] = float8::Set(a) * (f2 - f3);
+	}
+
+	// Warp of the output rows [y0, y1) with the footprint size, addressing and channel count fixed
+	template <ecpu::ResampleFilter F, typename T, int C>
+	void warpRows(const ecpu::ImageView<T>& image, const ecpu::Tensor& motion, float a, ecpu::Tensor& out, int y0, int y1)
+	{
+		using ecpu::float8;
+		const int n = F == ecpu::ResampleFilter::Bilinear || F == ecpu::ResampleFilter::BilinearBorder ? 2 : 4;
+		const bool border = F == ecpu::ResampleFilter::BilinearBorder || F == ecpu::ResampleFilter::BicubicBorder;
+		const bool corners = F != ecpu::ResampleFilter::CatmullRom5;
+		const int width = out.Shape().w;
+		const int height = out.Shape().h;
+
+		for (int y = y0; y < y1; y++)
+		{
+			const float* motion_row = motion.Data() + (size_t)y * width * 2;
+			float* out_row = out.Data() + (size_t)y * width * C;
+			const float v = (0.5f + y) / height;
+
+			for (int x0 = 0; x0 < width; x0 += 8)
+			{
+				const int lanes = std::min(8, width - x0);
+				float mu[8], mv[8];
+				for (int i = 0; i < 8; i++)
+				{
+					const int x = x0 + std::min(i, lanes - 1);
+					mu[i] = motion_row[x * 2];
+					mv[i] = motion_row[x * 2 + 1];
+				}
+
+				// Footprint positions and weights of the eight pixels
+				const float8 u = (float8::Set(0.5f + x0) + float8::Load(lane_offsets)) * float8::Set(1.0f / width) + float8::Load(mu);
+				const float8 px = u * float8::Set((float)image.width) - float8::Set(0.5f);
+				const float8 py = (float8::Set(v) + float8::Load(mv)) * float8::Set((float)image.height) - float8::Set(0.5f);
+				const float8 fx0 = float8::Floor(px);
+				const float8 fy0 = float8::Floor(py);
+				float8 wx[4], wy[4];
+				if (n == 2)
+				{
+					wx[1] = px - fx0;
+					wx[0] = float8::Set(1.0f) - wx[1];
+					wy[1] = py - fy0;
+					wy[0] = float8::Set(1.0f) - wy[1];
+				}
+				else
+				{
+					cubicWeights8(px - fx0, a, wx);
+					cubicWeights8(py - fy0, a, wy);
+				}
+				float base_x[8], base_y[8];
+				fx0.Store(base_x);
+				fy0.Store(base_y);
+
+				// Texels of every lane's footprint, one source row at a time. Footprints inside the
+				// image are read without any address checks
+				float texels[16][C][8];
+				for (int i = 0; i < 8; i++)
+				{
+					const int bx = (int)base_x[i] - (n == 4 ? 1 : 0);
+					const int by = (int)base_y[i] - (n == 4 ? 1 : 0);
+					const bool inside = bx >= 0 && by >= 0 && bx + n <= image.width && by + n <= image.height;
+					for (int j = 0; j < n; j++)
+					{
+						int ty = by + j;
+						const bool row_outside = ty < 0 || ty >= image.height;
+						ty = std::min(std::max(ty, 0), image.height - 1);
+						const T* row = image.Texel(0, ty);
+						for (int k = 0; k < n; k++)
+						{
+							if (!corners && (k == 0 || k == 3) && (j == 0 || j == 3))
+								continue;
+							int tx = bx + k;
+							if (inside)
+							{
+								for (int c = 0; c < C; c++)
+									texels[j * n + k][c][i] = texelValue(row[tx * C + c]);
+								continue;
+							}
+							const bool outside = row_outside || tx < 0 || tx >= image.width;
+							tx = std::min(std::max(tx, 0), image.width - 1);
+							for (int c = 0; c < C; c++)
+								texels[j * n + k][c][i] = border && outside ? 0.0f : texelValue(row[tx * C + c]);
+						}
+					}
+				}
+
+				float8 acc[C];
+				for (int c = 0; c < C; c++)
+					acc[c] = float8::Zero();
+				float8 weight_sum = float8::Zero();
+				for (int j = 0; j < n; j++)
+				{
+					for (int k = 0; k < n; k++)
+					{
+						if (!corners && (k == 0 || k == 3) && (j == 0 || j == 3))
+							continue;
+						const float8 w = wx[k] * wy[j];
+						weight_sum += w;
+						for (int c = 0; c < C; c++)
+							acc[c] = float8::MulAdd(float8::Load(texels[j * n + k][c]), w, acc[c]);
+					}
+				}
+				if (!corners)
+				{
+					const float8 inv_weight = float8::Set(1.0f) / weight_sum;
+					for (int c = 0; c < C; c++)
+						acc[c] = acc[c] * inv_weight;
+				}
+
+				float result[C][8];
+				for (int c = 0; c < C; c++)
+					acc[c].Store(result[c]);
+				for (int i = 0; i < lanes; i++)
+					for (int c = 0; c < C; c++)
+						out_row[(x0 + i) * C + c] = result[c][i];
+			}
+		}
+	}
+
+	template <typename T, int C>
+	void warpRowsOf(ecpu::ResampleFilter filter, const ecpu::ImageView<T>& image, const ecpu::Tensor& motion, float a,
+		ecpu::Tensor& out, int y0, int y1)
+	{
+		switch (filter)
+		{
+		case ecpu::ResampleFilter::Bilinear: warpRows<ecpu::ResampleFilter::Bilinear, T, C>(image, motion, a, out, y0, y1); break;
+		case ecpu::ResampleFilter::BilinearBorder: warpRows<ecpu::ResampleFilter::BilinearBorder, T, C>(image, motion, a, out, y0, y1); break;
+		case ecpu::ResampleFilter::CatmullRom5: warpRows<ecpu::ResampleFilter::CatmullRom5, T, C>(image, motion, a, out, y0, y1); break;
+		case ecpu::ResampleFilter::CatmullRom9: warpRows<ecpu::ResampleFilter::CatmullRom9, T, C>(image, motion, a, out, y0, y1); break;
+		case ecpu::ResampleFilter::BicubicBorder: warpRows<ecpu::ResampleFilter::BicubicBorder, T, C>(image, motion, a, out, y0, y1); break;
+		}
+	}
+}
+
+template <typename T>
+void ecpu::Warp(const ImageView<T>& image, const Tensor& motion, ResampleFilter filter, CubicKernel kernel, Tensor& out, ThreadPool& pool)
+{
+	if (image.channels < 1 || image.channels > 4)
+		throw std::runtime_error("Warp supports images of 1 to 4 channels");
+	if (motion.Shape().n != 1 || motion.Shape().c != 2)
+		throw std::runtime_error("Warp needs a { 1, h, w, 2 } motion vector image");
+	const int height = motion.Shape().h;
+	out.Resize(TensorShape(1, height, motion.Shape().w, image.channels));
+
+	const float a = CubicParameter(kernel);
+	const int tasks = (height + rows_per_task - 1) / rows_per_task;
+	pool.ParallelFor(tasks, [&](int task)
+		{
+			const int y0 = task * rows_per_task;
+			const int y1 = std::min(height, y0 + rows_per_task);
+			switch (image.channels)
+			{
+			case 1: warpRowsOf<T, 1>(filter, image, motion, a, out, y0, y1); break;
+			case 2: warpRowsOf<T, 2>(filter, image, motion, a, out, y0, y1); break;
+			case 3: warpRowsOf<T, 3>(filter, image, motion, a, out, y0, y1); break;
+			case 4: warpRowsOf<T, 4>(filter, image, motion, a, out, y0, y1); break;
+			}
+		});
+}
+
+template void ecpu::Warp<uint8_t>(const ImageView<uint8_t>&, const Tensor&, ResampleFilter, CubicKernel, Tensor&, ThreadPool&);
+template void ecpu::Warp<ecpu::Half>(const ImageView<Half>&, const Tensor&, ResampleFilter, CubicKernel, Tensor&, ThreadPool&);
+template void ecpu::Warp<float>(const ImageView<float>&, const Tensor&, ResampleFilter, CubicKernel, Tensor&, ThreadPool&);
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "tensor.h"
+#include "thread_pool.h"
+
+namespace ecpu
+{
+	// Bits of an IEEE half, the storage of the FLOAT16 history and accumulation textures
+	struct Half
+	{
+		uint16_t bits;
+	};
+
+	// Exact conversion with one rebias of the exponent and rare branches, cheap enough for the
+	// per texel reads of the resampling kernels
+	inline float HalfToFloat(Half h)
+	{
+		uint32_t bits = (uint32_t)(h.bits & 0x7fff) << 13;
+		const uint32_t exponent = bits & 0x0f800000;
+		bits += (127 - 15) << 23;
+		float out;
+		if (exponent == 0x0f800000)
+		{
+			// Infinity and NaN keep an all ones exponent
+			bits += (128 - 16) << 23;
+			std::memcpy(&out, &bits, sizeof(out));
+		}
+		else if (exponent == 0)
+		{
+			// Subnormal halves, renormalized by the float subtraction
+			bits += 1 << 23;
+			std::memcpy(&out, &bits, sizeof(out));
+			out -= 6.103515625e-05f;
+		}
+		else
+		{
+			std::memcpy(&out, &bits, sizeof(out));
+		}
+		return (h.bits & 0x8000) ? -out : out;
+	}
+
+	// Interleaved image of 1 to 4 channels of uint8_t (UNORM8), Half or float texels.
+	// row_stride is in texels and defaults to the width
+	template <typename T>
+	struct ImageView
+	{
+		const T* data = nullptr;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		int row_stride = 0;
+
+		ImageView() {};
+		ImageView(const T* data, int width, int height, int channels, int row_stride = 0)
+			: data(data), width(width), height(height), channels(channels), row_stride(row_stride > 0 ? row_stride : width) {};
+
+		inline const T* Texel(int x, int y) const { return data + ((size_t)y * row_stride + x) * channels; };
+	};
+
+	// View of a { 1, h, w, c } tensor
+	inline ImageView<float> ViewOf(const Tensor& image)
+	{
+		return ImageView<float>(image.Data(), image.Shape().w, image.Shape().h, image.Shape().c);
+	}
+
+	// The resampling filters of the shaders and models.py. Clamp variants address like the linear
+	// clamp sampler, Border variants like Load and operator[], which return zero outside
+	enum class ResampleFilter
+	{
+		Bilinear,			// SampleLevel with linear_clamp
+		BilinearBorder,		// manualBilinear of finalize_network_ps.hlsl
+		CatmullRom5,		// catmullRomAppx of init_network_cs.hlsl and catmullRom of taa_ps.hlsl, the 4x4 cubic without its corners
+		CatmullRom9,		// catmullRom of init_network_cs.hlsl, the full 4x4 cubic from nine bilinear taps
+		BicubicBorder,		// bicConv of init_network_cs.hlsl and BiCubicConv of models.py, sixteen Loads
+	};
+
+	// Sharpness of the cubic filters. taa_ps.hlsl uses the Catmull-Rom spline, the network
+	// shaders and models.py the sharper cubic convolution kernel
+	enum class CubicKernel
+	{
+		CatmullRom,	// a = -0.5
+		Sharp,		// a = -0.75
+	};
+
+	inline float CubicParameter(CubicKernel kernel)
+	{
+		return kernel == CubicKernel::CatmullRom ? -0.5f : -0.75f;
+	}
+
+	namespace resample_internal
+	{
+		inline float texelValue(float v) { return v; };
+		inline float texelValue(uint8_t v) { return v * (1.0f / 255.0f); };
+		inline float texelValue(Half v) { return HalfToFloat(v); };
+
+		// Cubic convolution weights of the four texels around a sample at fraction f
+		inline void cubicWeights(float f, float a, float* w)
+		{
+			const float f2 = f * f;
+			const float f3 = f2 * f;
+			w[0] = a * (f3 - 2.0f * f2 + f);
+			w[1] = (a + 2.0f) * f3 - (a + 3.0f) * f2 + 1.0f;
+			w[2] = -(a + 2.0f) * f3 + (2.0f * a + 3.0f) * f2 - a * f;
+			w[3] = a * (f2 - f3);
+		}
+	}
+
+	// Samples image at uv into out[0, channels). Every filter is a separable footprint of 2x2 or
+	// 4x4 texels, so the bilinear tap formulations of the shaders are evaluated texel by texel.
+	// The kernel only matters for the cubic filters
+	template <ResampleFilter F, typename T>
+	void Sample(const ImageView<T>& image, float u, float v, float* out, CubicKernel kernel = CubicKernel::Sharp)
+	{
+		using namespace resample_internal;
+		const int n = F == ResampleFilter::Bilinear || F == ResampleFilter::BilinearBorder ? 2 : 4;
+		const bool border = F == ResampleFilter::BilinearBorder || F == ResampleFilter::BicubicBorder;
+
+		const float px = u * image.width - 0.5f;
+		const float py = v * image.height - 0.5f;
+		const float fx0 = std::floor(px);
+		const float fy0 = std::floor(py);
+		const int x0 = (int)fx0 - (n == 4 ? 1 : 0);
+		const int y0 = (int)fy0 - (n == 4 ? 1 : 0);
+
+		float wx[4], wy[4];
+		if (n == 2)
+		{
+			wx[1] = px - fx0;
+			wx[0] = 1.0f - wx[1];
+			wy[1] = py - fy0;
+			wy[0] = 1.0f - wy[1];
+		}
+		else
+		{
+			cubicWeights(px - fx0, CubicParameter(kernel), wx);
+			cubicWeights(py - fy0, CubicParameter(kernel), wy);
+		}
+
+		for (int c = 0; c < image.channels; c++)
+			out[c] = 0.0f;
+		float weight_sum = 0.0f;
+		for (int j = 0; j < n; j++)
+		{
+			int y = y0 + j;
+			if (border && (y < 0 || y >= image.height))
+				continue;
+			y = std::min(std::max(y, 0), image.height - 1);
+			for (int i = 0; i < n; i++)
+			{
+				if (F == ResampleFilter::CatmullRom5 && (i == 0 || i == 3) && (j == 0 || j == 3))
+					continue;
+				const float w = wx[i] * wy[j];
+				weight_sum += w;
+				int x = x0 + i;
+				if (border && (x < 0 || x >= image.width))
+					continue;
+				x = std::min(std::max(x, 0), image.width - 1);
+				const T* texel = image.Texel(x, y);
+				for (int c = 0; c < image.channels; c++)
+					out[c] += w * texelValue(texel[c]);
+			}
+		}
+
+		// The five tap approximation divides by the weight it kept
+		if (F == ResampleFilter::CatmullRom5)
+			for (int c = 0; c < image.channels; c++)
+				out[c] /= weight_sum;
+	}
+
+	// Motion vector driven warp: pixel (x, y) of out samples image at its own uv plus the motion
+	// vector of the pixel, the way history is reprojected. motion is { 1, H, W, 2 } in uv units and
+	// out becomes { 1, H, W, channels }. Eight pixels are processed at a time: positions, fractions
+	// and filter weights are computed on float8, the texels are read row by row from each lane's
+	// footprint without gather instructions, and the weighted sums run on float8 again
+	template <typename T>
+	void Warp(const ImageView<T>& image, const Tensor& motion, ResampleFilter filter, CubicKernel kernel, Tensor& out, ThreadPool& pool);
+
+	// Sample for a runtime filter, for tests and tools. Kernels should use the template
+	template <typename T>
+	void Sample(const ImageView<T>& image, ResampleFilter filter, float u, float v, float* out, CubicKernel kernel = CubicKernel::Sharp)
+	{
+		switch (filter)
+		{
+		case ResampleFilter::Bilinear: Sample<ResampleFilter::Bilinear>(image, u, v, out, kernel); break;
+		case ResampleFilter::BilinearBorder: Sample<ResampleFilter::BilinearBorder>(image, u, v, out, kernel); break;
+		case ResampleFilter::CatmullRom5: Sample<ResampleFilter::CatmullRom5>(image, u, v, out, kernel); break;
+		case ResampleFilter::CatmullRom9: Sample<ResampleFilter::CatmullRom9>(image, u, v, out, kernel); break;
+		case ResampleFilter::BicubicBorder: Sample<ResampleFilter::BicubicBorder>(image, u, v, out, kernel); break;
+		}
+	}
+}
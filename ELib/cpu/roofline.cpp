@@ -0,0 +1,87 @@
+#include "roofline.h"
+#include "aligned_vector.h"
+#include "simd.h"
+#include "timer.h"
+#include <vector>
+
+namespace
+{
+	const int trials = 5;
+	// Independent FMA chains per thread, enough to cover the FMA latency of current cores
+	const int fma_chains = 12;
+	const int fma_iterations = 1 << 22;
+	// Floats in each of the three streaming buffers, 64 MB apiece
+	const size_t stream_floats = (size_t)16 << 20;
+
+	volatile float sink;
+
+	float fmaKernel(float seed)
+	{
+		ecpu::float8 acc[fma_chains];
+		for (int i = 0; i < fma_chains; i++)
+			acc[i] = ecpu::float8::Set(seed + i);
+		const ecpu::float8 a = ecpu::float8::Set(0.999999f);
+		const ecpu::float8 b = ecpu::float8::Set(1e-7f);
+		for (int it = 0; it < fma_iterations; it++)
+		{
+			for (int i = 0; i < fma_chains; i++)
+				acc[i] = ecpu::float8::MulAdd(acc[i], a, b);
+		}
+
+		ecpu::float8 sum = acc[0];
+		for (int i = 1; i < fma_chains; i++)
+			sum += acc[i];
+		return sum.Sum();
+	}
+
+	// Two read streams and one write stream, the access pattern of the element wise layers. A
+	// single read stream does not saturate memory on some machines
+	void addKernel(const float* a, const float* b, float* dst, size_t count)
+	{
+		for (size_t i = 0; i + 8 <= count; i += 8)
+			(ecpu::float8::Load(a + i) + ecpu::float8::Load(b + i)).Store(dst + i);
+	}
+}
+
+ecpu::Roofline ecpu::MeasureRoofline(ThreadPool& pool)
+{
+	Roofline roofline;
+	const int threads = pool.ThreadCount();
+
+	for (int t = 0; t < trials; t++)
+	{
+		std::vector<float> results(threads);
+		Timer timer;
+		pool.ParallelFor(threads, [&](int i) { results[i] = fmaKernel((float)i); });
+		double seconds = timer.Elapsed();
+		sink = results[0];
+
+		double flops = 2.0 * 8.0 * fma_chains * fma_iterations * threads;
+		roofline.peak_gflops = std::max(roofline.peak_gflops, flops / seconds * 1e-9);
+	}
+
+	// Each thread streams its own slice, touched first by that thread
+	AlignedVector<float> a(stream_floats);
+	AlignedVector<float> b(stream_floats);
+	AlignedVector<float> dst(stream_floats);
+	const size_t slice = (stream_floats / threads) & ~(size_t)7;
+	pool.ParallelFor(threads, [&](int i)
+		{
+			std::fill(a.begin() + i * slice, a.begin() + (i + 1) * slice, 1.0f);
+			std::fill(b.begin() + i * slice, b.begin() + (i + 1) * slice, 2.0f);
+			std::fill(dst.begin() + i * slice, dst.begin() + (i + 1) * slice, 0.0f);
+		});
+
+	for (int t = 0; t < trials; t++)
+	{
+		Timer timer;
+		pool.ParallelFor(threads, [&](int i) { addKernel(a.data() + i * slice, b.data() + i * slice, dst.data() + i * slice, slice); });
+		double seconds = timer.Elapsed();
+		sink = dst[0];
+
+		double bytes = 3.0 * sizeof(float) * slice * threads;
+		roofline.bandwidth_gbs = std::max(roofline.bandwidth_gbs, bytes / seconds * 1e-9);
+	}
+
+	return roofline;
+}
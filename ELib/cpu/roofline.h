@@ -0,0 +1,24 @@
+#pragma once
+#include <algorithm>
+#include "thread_pool.h"
+
+namespace ecpu
+{
+	// Peak arithmetic throughput and memory bandwidth of the machine, used to judge how close a
+	// kernel gets to what the hardware allows
+	struct Roofline
+	{
+		double peak_gflops = 0.0;		// Fused multiply-adds on float8 over all threads, counted as 2 flops
+		double bandwidth_gbs = 0.0;	// Streaming two reads and a write over buffers far larger than the caches
+
+		// Attainable GFLOP/s of a kernel doing the given flops per byte of memory traffic
+		double Bound(double intensity) const { return std::min(peak_gflops, intensity * bandwidth_gbs); };
+		// Intensity where a kernel stops being memory bound
+		double RidgeIntensity() const { return peak_gflops / bandwidth_gbs; };
+	};
+
+	// Measures both roofs with microkernels on every thread of the pool, takes about a second.
+	// The streaming buffers total 192 MB, so on machines with a larger last level cache the
+	// bandwidth roof is that of the cache
+	Roofline MeasureRoofline(ThreadPool& pool);
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ECPU_AVX2 1
+#else
+#define ECPU_AVX2 0
+#endif
+
+// Thin 8-wide float wrapper used by the CPU kernels.
+// Builds with /arch:AVX2 (MSVC) or -mavx2 -mfma (GCC/Clang) use AVX2 and FMA,
+// everything else falls back to plain loops the compiler can auto-vectorize.
+// float8 changes layout with the ISA, so every project of the solution must build with the same
+// instruction set, all of them set /arch:AVX2 in every configuration.
+namespace ecpu
+{
+#if ECPU_AVX2
+	struct float8
+	{
+		__m256 v;
+
+		static inline float8 Zero() { return { _mm256_setzero_ps() }; };
+		static inline float8 Set(float s) { return { _mm256_set1_ps(s) }; };
+		static inline float8 Load(const float* p) { return { _mm256_loadu_ps(p) }; };
+		inline void Store(float* p) const { _mm256_storeu_ps(p, v); };
+
+		inline float8 operator+(const float8& rhs) const { return { _mm256_add_ps(v, rhs.v) }; };
+		inline float8 operator-(const float8& rhs) const { return { _mm256_sub_ps(v, rhs.v) }; };
+		inline float8 operator*(const float8& rhs) const { return { _mm256_mul_ps(v, rhs.v) }; };
+		inline float8 operator/(const float8& rhs) const { return { _mm256_div_ps(v, rhs.v) }; };
+		inline float8& operator+=(const float8& rhs) { v = _mm256_add_ps(v, rhs.v); return *this; };
+
+		// Returns a * b + c
+		static inline float8 MulAdd(const float8& a, const float8& b, const float8& c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; };
+		static inline float8 Max(const float8& a, const float8& b) { return { _mm256_max_ps(a.v, b.v) }; };
+		static inline float8 Min(const float8& a, const float8& b) { return { _mm256_min_ps(a.v, b.v) }; };
+		static inline float8 Abs(const float8& a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; };
+		static inline float8 Floor(const float8& a) { return { _mm256_floor_ps(a.v) }; };
+		// a > b ? x : y per element
+		static inline float8 IfGreater(const float8& a, const float8& b, const float8& x, const float8& y) { return { _mm256_blendv_ps(y.v, x.v, _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)) }; };
+		// Bit i is set where lane i of a is at least lane i of b
+		static inline int GreaterEqualMask(const float8& a, const float8& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); };
+
+		inline float Sum() const
+		{
+			__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+			s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+			s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+			return _mm_cvtss_f32(s);
+		}
+		inline float MaxElement() const
+		{
+			__m128 s = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+			s = _mm_max_ps(s, _mm_movehl_ps(s, s));
+			s = _mm_max_ss(s, _mm_shuffle_ps(s, s, 0x55));
+			return _mm_cvtss_f32(s);
+		}
+	};
+
+	// Transposes the 8x8 block held in rows, lane j of row i becomes lane i of row j
+	inline void Transpose8x8(float8(&rows)[8])
+	{
+		__m256 t[8], u[8];
+		for (int i = 0; i < 8; i += 2)
+		{
+			t[i] = _mm256_unpacklo_ps(rows[i].v, rows[i + 1].v);
+			t[i + 1] = _mm256_unpackhi_ps(rows[i].v, rows[i + 1].v);
+		}
+		for (int i = 0; i < 8; i += 4)
+		{
+			u[i] = _mm256_shuffle_ps(t[i], t[i + 2], 0x44);
+			u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], 0xee);
+			u[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+			u[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0xee);
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i].v = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+			rows[i + 4].v = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+		}
+	}
+#else
+	struct float8
+	{
+		float v[8];
+
+		static inline float8 Zero() { return Set(0.0f); };
+		static inline float8 Set(float s) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = s; return out; };
+		static inline float8 Load(const float* p) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = p[i]; return out; };
+		inline void Store(float* p) const { for (int i = 0; i < 8; i++) p[i] = v[i]; };
+
+		inline float8 operator+(const float8& rhs) const { float8 out; for (int i = 0; i < 8; i++) out.v[i] = v[i] + rhs.v[i]; return out; };
+		inline float8 operator-(const float8& rhs) const { float8 out; for (int i = 0; i < 8; i++) out.v[i] = v[i] - rhs.v[i]; return out; };
+		inline float8 operator*(const float8& rhs) const { float8 out; for (int i = 0; i < 8; i++) out.v[i] = v[i] * rhs.v[i]; return out; };
+		inline float8 operator/(const float8& rhs) const { float8 out; for (int i = 0; i < 8; i++) out.v[i] = v[i] / rhs.v[i]; return out; };
+		inline float8& operator+=(const float8& rhs) { for (int i = 0; i < 8; i++) v[i] += rhs.v[i]; return *this; };
+
+		// Returns a * b + c
+		static inline float8 MulAdd(const float8& a, const float8& b, const float8& c) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = std::fma(a.v[i], b.v[i], c.v[i]); return out; };
+		static inline float8 Max(const float8& a, const float8& b) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = std::max(a.v[i], b.v[i]); return out; };
+		static inline float8 Min(const float8& a, const float8& b) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = std::min(a.v[i], b.v[i]); return out; };
+		static inline float8 Abs(const float8& a) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = std::abs(a.v[i]); return out; };
+		static inline float8 Floor(const float8& a) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = std::floor(a.v[i]); return out; };
+		static inline float8 IfGreater(const float8& a, const float8& b, const float8& x, const float8& y) { float8 out; for (int i = 0; i < 8; i++) out.v[i] = a.v[i] > b.v[i] ? x.v[i] : y.v[i]; return out; };
+		static inline int GreaterEqualMask(const float8& a, const float8& b) { int out = 0; for (int i = 0; i < 8; i++) out |= (a.v[i] >= b.v[i] ? 1 : 0) << i; return out; };
+
+		inline float Sum() const { float s = 0.0f; for (int i = 0; i < 8; i++) s += v[i]; return s; };
+		inline float MaxElement() const { float s = v[0]; for (int i = 1; i < 8; i++) s = std::max(s, v[i]); return s; };
+	};
+
+	inline void Transpose8x8(float8(&rows)[8])
+	{
+		for (int i = 0; i < 8; i++)
+			for (int j = i + 1; j < 8; j++)
+				std::swap(rows[i].v[j], rows[j].v[i]);
+	}
+#endif
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "aligned_vector.h"
+
+namespace ecpu
+{
+	// Dimensions of a tensor stored in NHWC order, the same layout the DirectML network uses
+	struct TensorShape
+	{
+		int n = 0;
+		int h = 0;
+		int w = 0;
+		int c = 0;
+
+		TensorShape() {};
+		TensorShape(int n, int h, int w, int c) : n(n), h(h), w(w), c(c) {};
+
+		inline size_t ElementCount() const { return (size_t)n * h * w * c; };
+		inline size_t ByteSize() const { return ElementCount() * sizeof(float); };
+		inline bool operator==(const TensorShape& rhs) const { return n == rhs.n && h == rhs.h && w == rhs.w && c == rhs.c; };
+		inline bool operator!=(const TensorShape& rhs) const { return !(*this == rhs); };
+	};
+
+	// Window into one image of an NHWC tensor.
+	// (y0, x0) is the image coordinate of the first stored pixel. Convolutions treat pixels
+	// outside the stored window as padding, zeros or the nearest stored pixel, for both full
+	// frames and tiles.
+	struct PlaneView
+	{
+		float* data = nullptr;
+		int y0 = 0;
+		int x0 = 0;
+		int height = 0;
+		int width = 0;
+		int channels = 0;
+		ptrdiff_t row_stride = 0;		// Floats between two rows
+		ptrdiff_t pixel_stride = 0;	// Floats between two pixels
+
+		inline bool Contains(int y, int x) const
+		{
+			return y >= y0 && y < y0 + height && x >= x0 && x < x0 + width;
+		}
+		inline float* At(int y, int x) const
+		{
+			return data + (y - y0) * row_stride + (x - x0) * pixel_stride;
+		}
+		// Returns a view of the sub-window [y, y + h) x [x, x + w), clipped to this view
+		inline PlaneView Window(int y, int x, int h, int w) const
+		{
+			int ny0 = std::max(y, y0);
+			int nx0 = std::max(x, x0);
+			int ny1 = std::min(y + h, y0 + height);
+			int nx1 = std::min(x + w, x0 + width);
+			PlaneView out = *this;
+			out.y0 = ny0;
+			out.x0 = nx0;
+			out.height = std::max(0, ny1 - ny0);
+			out.width = std::max(0, nx1 - nx0);
+			out.data = out.height > 0 && out.width > 0 ? At(ny0, nx0) : data;
+			return out;
+		}
+	};
+
+	class Tensor
+	{
+	public:
+		Tensor() {};
+		explicit Tensor(const TensorShape& shape)
+			: shape(shape), values(shape.ElementCount(), 0.0f) {};
+		Tensor(int n, int h, int w, int c)
+			: Tensor(TensorShape(n, h, w, c)) {};
+
+		// Reallocates only if the element count grows
+		void Resize(const TensorShape& new_shape)
+		{
+			shape = new_shape;
+			if (values.size() < shape.ElementCount())
+				values.resize(shape.ElementCount());
+		}
+		void Fill(float v) { std::fill(values.begin(), values.begin() + shape.ElementCount(), v); };
+
+		inline const TensorShape& Shape() const { return shape; };
+		inline float* Data() { return values.data(); };
+		inline const float* Data() const { return values.data(); };
+		inline size_t ElementCount() const { return shape.ElementCount(); };
+
+		inline float& At(int n, int y, int x, int c) { return values[(((size_t)n * shape.h + y) * shape.w + x) * shape.c + c]; };
+		inline float At(int n, int y, int x, int c) const { return values[(((size_t)n * shape.h + y) * shape.w + x) * shape.c + c]; };
+
+		// View over image n of the batch covering the full frame
+		inline PlaneView Plane(int n = 0) const
+		{
+			PlaneView view;
+			view.data = const_cast<float*>(values.data()) + (size_t)n * shape.h * shape.w * shape.c;
+			view.height = shape.h;
+			view.width = shape.w;
+			view.channels = shape.c;
+			view.row_stride = (ptrdiff_t)shape.w * shape.c;
+			view.pixel_stride = shape.c;
+			return view;
+		}
+
+	private:
+		TensorShape shape;
+		AlignedVector<float> values;
+	};
+}
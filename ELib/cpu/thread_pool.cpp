@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ecpu::ThreadPool::ThreadPool(int thread_count)
+	: next_index(0)
+{
+	if (thread_count <= 0)
+		thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 1; i < thread_count; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ecpu::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_condition.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ecpu::ThreadPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+	std::function<void(int, int)> wrapped = [&task](int index, int) { task(index); };
+	ParallelFor(count, wrapped);
+}
+
+void ecpu::ThreadPool::ParallelFor(int count, const std::function<void(int, int)>& task)
+{
+	if (count <= 0)
+		return;
+
+	// Small jobs or single threaded pools run inline
+	if (count == 1 || workers.empty())
+	{
+		for (int i = 0; i < count; i++)
+			task(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current_task = &task;
+		task_count = count;
+		next_index = 0;
+		active_workers = (int)workers.size();
+		generation++;
+	}
+	start_condition.notify_all();
+
+	runTasks(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_condition.wait(lock, [this] { return active_workers == 0; });
+	current_task = nullptr;
+}
+
+void ecpu::ThreadPool::workerLoop(int thread_index)
+{
+	unsigned long long seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			start_condition.wait(lock, [&] { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+
+		runTasks(thread_index);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			active_workers--;
+		}
+		done_condition.notify_one();
+	}
+}
+
+void ecpu::ThreadPool::runTasks(int thread_index)
+{
+	while (true)
+	{
+		int index = next_index.fetch_add(1);
+		if (index >= task_count)
+			break;
+		(*current_task)(index, thread_index);
+	}
+}
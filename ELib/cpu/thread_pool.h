@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace ecpu
+{
+	// Fixed set of worker threads used by all CPU kernels.
+	// The calling thread takes part in the work, so a pool of size 1 runs everything inline.
+	class ThreadPool
+	{
+	public:
+		// A thread count of 0 uses every hardware thread
+		explicit ThreadPool(int thread_count = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		int ThreadCount() const { return (int)workers.size() + 1; };
+
+		// Runs task(index) for every index in [0, count) and returns when all are done.
+		// Not reentrant: tasks must not call ParallelFor on the same pool
+		void ParallelFor(int count, const std::function<void(int)>& task);
+
+		// Same as above, but also passes the index of the executing thread in [0, ThreadCount())
+		// so tasks can use per-thread scratch memory
+		void ParallelFor(int count, const std::function<void(int index, int thread_index)>& task);
+
+	private:
+		void workerLoop(int thread_index);
+		void runTasks(int thread_index);
+
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable start_condition;
+		std::condition_variable done_condition;
+
+		const std::function<void(int, int)>* current_task = nullptr;
+		int task_count = 0;
+		std::atomic<int> next_index;
+		int active_workers = 0;
+		unsigned long long generation = 0;
+		bool stopping = false;
+	};
+}
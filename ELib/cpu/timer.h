@@ -0,0 +1,23 @@
+#pragma once
+#include <chrono>
+
+namespace ecpu
+{
+	// Portable stopwatch for headless tools where eio::GameClock is not available
+	class Timer
+	{
+	public:
+		Timer() : start(std::chrono::steady_clock::now()) {};
+
+		void Reset() { start = std::chrono::steady_clock::now(); };
+
+		// Returns elapsed time in seconds
+		double Elapsed() const
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		};
+
+	private:
+		std::chrono::steady_clock::time_point start;
+	};
+}
@@ -0,0 +1,239 @@
+#include "transform_hierarchy.h"
+#include <stdexcept>
+#include <algorithm>
+#include "simd.h"
+#include "timer.h"
+
+namespace
+{
+	using ecpu::float8;
+
+	// Value of quadrant q in [0, 4) of the sine, from the sine and cosine of the remainder
+	inline float8 quadrantSine(const float8& sine, const float8& cosine, const float8& q)
+	{
+		const float8 half = float8::Set(0.5f);
+		const float8 odd = q - float8::Floor(q * half) * float8::Set(2.0f);
+		const float8 value = float8::IfGreater(odd, half, cosine, sine);
+		return float8::IfGreater(q, float8::Set(1.5f), float8::Zero() - value, value);
+	}
+
+	// Sine and cosine by reduction to [-pi / 4, pi / 4] with pi / 2 split in three parts, and
+	// the minimax polynomials of Cephes' sinf and cosf, within a few float ulps of std::sin
+	// for the angles of a scene
+	void sinCos(const float8& x, float8& sine, float8& cosine)
+	{
+		const float8 quadrant = float8::Floor(float8::MulAdd(x, float8::Set(0.63661977f), float8::Set(0.5f)));
+		float8 r = float8::MulAdd(quadrant, float8::Set(-1.5703125f), x);
+		r = float8::MulAdd(quadrant, float8::Set(-4.837512969970703125e-4f), r);
+		r = float8::MulAdd(quadrant, float8::Set(-7.54978995489188216e-8f), r);
+		const float8 r2 = r * r;
+
+		float8 s = float8::MulAdd(r2, float8::Set(-1.9515295891e-4f), float8::Set(8.3321608736e-3f));
+		s = float8::MulAdd(r2, s, float8::Set(-1.6666654611e-1f));
+		s = float8::MulAdd(r2 * r, s, r);
+		float8 c = float8::MulAdd(r2, float8::Set(2.443315711809948e-5f), float8::Set(-1.388731625493765e-3f));
+		c = float8::MulAdd(r2, c, float8::Set(4.166664568298827e-2f));
+		c = float8::MulAdd(r2 * r2, c, float8::MulAdd(r2, float8::Set(-0.5f), float8::Set(1.0f)));
+
+		// sin(x) takes the quadrant, cos(x) = sin(x + pi / 2) the next one
+		const float8 four = float8::Set(4.0f), quarter = float8::Set(0.25f);
+		const float8 q = quadrant - float8::Floor(quadrant * quarter) * four;
+		const float8 next = q + float8::Set(1.0f);
+		sine = quadrantSine(s, c, q);
+		cosine = quadrantSine(s, c, next - float8::Floor(next * quarter) * four);
+	}
+}
+
+uint32_t ecpu::TransformHierarchy::Add(uint32_t parent)
+{
+	const uint32_t node = (uint32_t)parents.size();
+	if (parent != no_parent && parent >= node)
+		throw std::runtime_error("Transform parent must be added before its children");
+	position_x.push_back(0.0f); position_y.push_back(0.0f); position_z.push_back(0.0f);
+	rotation_x.push_back(0.0f); rotation_y.push_back(0.0f); rotation_z.push_back(0.0f);
+	scale_x.push_back(1.0f); scale_y.push_back(1.0f); scale_z.push_back(1.0f);
+	parents.push_back(parent);
+	dirty.push_back(0);
+	fresh.push_back(1);
+	changed_flags.push_back(0);
+	world.push_back(Matrix4::Identity());
+	last_world.push_back(Matrix4::Identity());
+	if (parent != no_parent)
+		child_count++;
+	setDirty(node);
+	return node;
+}
+
+void ecpu::TransformHierarchy::SetPosition(uint32_t node, const Vector3& position)
+{
+	if (position.x == position_x[node] && position.y == position_y[node] && position.z == position_z[node])
+		return;
+	position_x[node] = position.x;
+	position_y[node] = position.y;
+	position_z[node] = position.z;
+	setDirty(node);
+}
+
+void ecpu::TransformHierarchy::SetRotation(uint32_t node, const Vector3& roll_pitch_yaw)
+{
+	if (roll_pitch_yaw.x == rotation_x[node] && roll_pitch_yaw.y == rotation_y[node] && roll_pitch_yaw.z == rotation_z[node])
+		return;
+	rotation_x[node] = roll_pitch_yaw.x;
+	rotation_y[node] = roll_pitch_yaw.y;
+	rotation_z[node] = roll_pitch_yaw.z;
+	setDirty(node);
+}
+
+void ecpu::TransformHierarchy::SetScale(uint32_t node, const Vector3& scale)
+{
+	if (scale.x == scale_x[node] && scale.y == scale_y[node] && scale.z == scale_z[node])
+		return;
+	scale_x[node] = scale.x;
+	scale_y[node] = scale.y;
+	scale_z[node] = scale.z;
+	setDirty(node);
+}
+
+void ecpu::TransformHierarchy::Update()
+{
+	Timer timer;
+	// The last world matrices of the nodes moved by the previous update catch up
+	const size_t earlier_changes = changed.size();
+	for (uint32_t node : moved)
+	{
+		last_world[node] = world[node];
+		setChanged(node);
+	}
+	mergeChanged(earlier_changes);
+
+	// Descendants of dirty nodes are dirty. Parents come first, so one pass from the first
+	// dirty node reaches every level and lists the nodes in order
+	moved.clear();
+	if (child_count > 0 || dirty_nodes.size() * 16 > parents.size())
+	{
+		const uint32_t first = dirty_nodes.empty() ? (uint32_t)parents.size() : *std::min_element(dirty_nodes.begin(), dirty_nodes.end());
+		for (uint32_t node = first; node < (uint32_t)parents.size(); node++)
+		{
+			if (!dirty[node] && parents[node] != no_parent && dirty[parents[node]])
+				dirty[node] = 1;
+			if (dirty[node])
+				moved.push_back(node);
+		}
+	}
+	else
+	{
+		moved.swap(dirty_nodes);
+		std::sort(moved.begin(), moved.end());
+	}
+	dirty_nodes.clear();
+
+	for (size_t first = 0; first < moved.size(); first += 8)
+		computeLocal(&moved[first], (int)std::min<size_t>(8, moved.size() - first));
+
+	// Parents are final before their children. New nodes have no motion and need no second
+	// change when their last world matrix catches up
+	const size_t caught_up_changes = changed.size();
+	size_t kept = 0;
+	for (uint32_t node : moved)
+	{
+		if (parents[node] != no_parent)
+			world[node] = world[node] * world[parents[node]];
+		dirty[node] = 0;
+		setChanged(node);
+		if (fresh[node])
+		{
+			last_world[node] = world[node];
+			fresh[node] = 0;
+		}
+		else
+			moved[kept++] = node;
+	}
+	mergeChanged(caught_up_changes);
+	stats.updated = moved.size();
+	moved.resize(kept);
+	stats.seconds = timer.Elapsed();
+}
+
+void ecpu::TransformHierarchy::ClearChanged()
+{
+	for (uint32_t node : changed)
+		changed_flags[node] = 0;
+	changed.clear();
+}
+
+void ecpu::TransformHierarchy::setDirty(uint32_t node)
+{
+	if (dirty[node])
+		return;
+	dirty[node] = 1;
+	dirty_nodes.push_back(node);
+}
+
+void ecpu::TransformHierarchy::setChanged(uint32_t node)
+{
+	if (changed_flags[node])
+		return;
+	changed_flags[node] = 1;
+	changed.push_back(node);
+}
+
+void ecpu::TransformHierarchy::mergeChanged(size_t first_new)
+{
+	// Both parts are in node order
+	if (first_new > 0 && first_new < changed.size() && changed[first_new - 1] > changed[first_new])
+		std::inplace_merge(changed.begin(), changed.begin() + first_new, changed.end());
+}
+
+void ecpu::TransformHierarchy::computeLocal(const uint32_t* nodes, int count)
+{
+	// Gathers the nodes into lanes, the unused lanes repeat the last node
+	float position[3][8], scale[3][8], angles[3][8];
+	for (int lane = 0; lane < 8; lane++)
+	{
+		const uint32_t node = nodes[std::min(lane, count - 1)];
+		position[0][lane] = position_x[node];
+		position[1][lane] = position_y[node];
+		position[2][lane] = position_z[node];
+		scale[0][lane] = scale_x[node];
+		scale[1][lane] = scale_y[node];
+		scale[2][lane] = scale_z[node];
+		angles[0][lane] = rotation_x[node];
+		angles[1][lane] = rotation_y[node];
+		angles[2][lane] = rotation_z[node];
+	}
+
+	// Matrix4::RollPitchYaw multiplied out, with row i scaled by scale i
+	float8 sr, cr, sp, cp, sy, cy;
+	sinCos(float8::Load(angles[0]), sr, cr);
+	sinCos(float8::Load(angles[1]), sp, cp);
+	sinCos(float8::Load(angles[2]), sy, cy);
+	const float8 sx0 = float8::Load(scale[0]), sx1 = float8::Load(scale[1]), sx2 = float8::Load(scale[2]);
+	const float8 sr_sp = sr * sp, cr_sp = cr * sp;
+	float8 rows[3][3];
+	rows[0][0] = float8::MulAdd(sr_sp, sy, cr * cy) * sx0;
+	rows[0][1] = sr * cp * sx0;
+	rows[0][2] = (sr_sp * cy - cr * sy) * sx0;
+	rows[1][0] = (cr_sp * sy - sr * cy) * sx1;
+	rows[1][1] = cr * cp * sx1;
+	rows[1][2] = float8::MulAdd(cr_sp, cy, sr * sy) * sx1;
+	rows[2][0] = cp * sy * sx2;
+	rows[2][1] = (float8::Zero() - sp) * sx2;
+	rows[2][2] = cp * cy * sx2;
+
+	float elements[3][3][8];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			rows[i][j].Store(elements[i][j]);
+	for (int lane = 0; lane < count; lane++)
+	{
+		Matrix4& m = world[nodes[lane]];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				m.m[i][j] = elements[i][j][lane];
+			m.m[i][3] = 0.0f;
+			m.m[3][i] = position[i][lane];
+		}
+		m.m[3][3] = 1.0f;
+	}
+}
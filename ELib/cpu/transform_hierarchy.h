@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "matrix4.h"
+
+namespace ecpu
+{
+	// Positions, rotations and scales of a scene's objects in structure of arrays layout, with
+	// parent and child links and dirty tracking. Setting a value only marks the node dirty, and
+	// Update recomputes the world matrices of the dirty nodes and their descendants: the local
+	// matrices of Matrix4::World eight nodes per float8, then the parent matrices in node order.
+	// The world matrix of the previous Update is kept for the motion vectors, so a node that
+	// stops moving changes once more when its last world matrix catches up. The nodes whose
+	// matrices changed are collected until ClearChanged, so the GPU uploads only touch those
+	class TransformHierarchy
+	{
+	public:
+		static const uint32_t no_parent = 0xffffffffu;
+
+		struct Stats
+		{
+			size_t updated = 0;	// World matrices recomputed by the last Update
+			double seconds = 0.0;
+		};
+
+	public:
+		// Adds an identity node, children are always added after their parent
+		uint32_t Add(uint32_t parent = no_parent);
+		size_t Size() const { return parents.size(); };
+		uint32_t Parent(uint32_t node) const { return parents[node]; };
+
+		// Setting the current value leaves the node clean
+		void SetPosition(uint32_t node, const Vector3& position);
+		void SetRotation(uint32_t node, const Vector3& roll_pitch_yaw);
+		void SetScale(uint32_t node, const Vector3& scale);
+		Vector3 Position(uint32_t node) const { return Vector3(position_x[node], position_y[node], position_z[node]); };
+		Vector3 Rotation(uint32_t node) const { return Vector3(rotation_x[node], rotation_y[node], rotation_z[node]); };
+		Vector3 Scale(uint32_t node) const { return Vector3(scale_x[node], scale_y[node], scale_z[node]); };
+
+		// Once a frame, moves the world matrices to the last world matrices and recomputes the
+		// dirty ones. New nodes start with their last world matrix equal to the world matrix
+		void Update();
+
+		const Matrix4& World(uint32_t node) const { return world[node]; };
+		const Matrix4& LastWorld(uint32_t node) const { return last_world[node]; };
+		// Nodes whose world or last world matrix changed since ClearChanged, in node order
+		const std::vector<uint32_t>& Changed() const { return changed; };
+		void ClearChanged();
+		const Stats& GetLastStats() const { return stats; };
+
+	private:
+		void setDirty(uint32_t node);
+		void setChanged(uint32_t node);
+		void mergeChanged(size_t first_new);
+		void computeLocal(const uint32_t* nodes, int count);
+
+	private:
+		std::vector<float> position_x, position_y, position_z;
+		std::vector<float> rotation_x, rotation_y, rotation_z;
+		std::vector<float> scale_x, scale_y, scale_z;
+		std::vector<uint32_t> parents;
+		std::vector<uint8_t> dirty;
+		std::vector<uint8_t> fresh;		// Not updated yet
+		std::vector<uint8_t> changed_flags;
+		std::vector<Matrix4> world;
+		std::vector<Matrix4> last_world;
+
+		std::vector<uint32_t> dirty_nodes;	// Set since the last Update, in any order
+		std::vector<uint32_t> moved;		// Recomputed by the last Update, in node order
+		std::vector<uint32_t> changed;
+		size_t child_count = 0;
+		Stats stats;
+	};
+}
@@ -8,6 +8,7 @@
 #include "depth_buffer.h"
 #include "root_signature.h"
 #include "constant_buffer.h"
+#include "structured_buffer.h"
 #include "pipeline_state.h"
 #include "vertex_buffer.h"
 #include "index_buffer.h"
@@ -198,6 +199,10 @@ void egx::CommandContext::SetRootDescriptorTable(int root_index, const Unordered
 {
 	command_list->SetGraphicsRootDescriptorTable(root_index, first_buffer.srv_gpu);
 }
+void egx::CommandContext::SetRootShaderResource(int root_index, const StructuredBuffer& buffer)
+{
+	command_list->SetGraphicsRootShaderResourceView(root_index, buffer.buffer->GetGPUVirtualAddress());
+}
 
 void egx::CommandContext::SetComputeRootConstant(int root_index, int num_constants, void* constant_data)
 {
@@ -236,6 +241,10 @@ void egx::CommandContext::DrawIndexed(int index_count)
 {
 	command_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
 }
+void egx::CommandContext::DrawIndexedInstanced(int index_count, int instance_count)
+{
+	command_list->DrawIndexedInstanced(index_count, instance_count, 0, 0, 0);
+}
 
 
 void egx::CommandContext::Dispatch(int block_x, int block_y, int block_z)
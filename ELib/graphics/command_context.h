@@ -43,6 +43,7 @@ namespace egx
 		void SetRootConstantBuffer(int root_index, const ConstantBuffer& texture);
 		void SetRootDescriptorTable(int root_index, const Texture2D& first_texture);
 		void SetRootDescriptorTable(int root_index, const UnorderedAccessBuffer& first_buffer);
+		void SetRootShaderResource(int root_index, const StructuredBuffer& buffer);
 
 		void SetComputeRootConstant(int root_index, int num_constants, void* constant_data);
 		void SetComputeRootDescriptorTable(int root_index, const Texture2D& first_texture);
@@ -55,6 +56,7 @@ namespace egx
 
 		void Draw(int vertex_count);
 		void DrawIndexed(int index_count);
+		void DrawIndexedInstanced(int index_count, int instance_count);
 
 		void Dispatch(int block_x, int block_y, int block_z);
 		void DispatchRays(const ema::point2D& dims, ShaderTable& shader_table);
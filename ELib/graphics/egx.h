@@ -9,6 +9,7 @@
 #include "texture2d.h"
 #include "render_target.h"
 #include "depth_buffer.h"
+#include "structured_buffer.h"
 
 #include "materials.h"
 #include "mesh.h"
\ No newline at end of file
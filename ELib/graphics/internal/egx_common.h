@@ -36,6 +36,7 @@ namespace egx
 	class ShaderLibrary;
 	class ShaderTable;
 	class UnorderedAccessBuffer;
+	class StructuredBuffer;
 	class MasterNet;
 	class ConvLayer;
 	class PixelShuffle;
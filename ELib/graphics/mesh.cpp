@@ -18,6 +18,9 @@ egx::Mesh::Mesh(
 	material(material)
 
 {
+	for (const auto& vertex : vertices)
+		bounds.Grow(ecpu::Vector3(vertex.position.x, vertex.position.y, vertex.position.z));
+
 	CPUBuffer cpu_vertex_buffer(vertices.data(), (int)vertices.size() * (int)sizeof(MeshVertex));
 	dev.ScheduleUpload(context, cpu_vertex_buffer, vertex_buffer);
 	context.SetTransitionBuffer(vertex_buffer, GPUBufferState::VertexBuffer);
@@ -7,6 +7,8 @@
 #include <vector>
 #include "materials.h"
 #include "../io/texture_io.h"
+#include "../cpu/frustum.h"
+#include "../cpu/occlusion_culler.h"
 
 namespace egx
 {
@@ -45,6 +47,11 @@ namespace egx
 		inline const IndexBuffer& GetIndexBuffer() const { return index_buffer; };
 		inline IndexBuffer& GetIndexBuffer() { return index_buffer; };
 		inline const Material& GetMaterial() const { return material; };
+		// Model space bounds of the vertices, computed at load for culling
+		inline const ecpu::Aabb& GetBounds() const { return bounds; };
+		// Model space occluder triangles for occlusion culling, empty unless the model tags the mesh
+		inline const ecpu::OccluderMesh& GetOccluder() const { return occluder; };
+		inline void SetOccluder(ecpu::OccluderMesh mesh_occluder) { occluder = std::move(mesh_occluder); };
 
 		void BuildAccelerationStructure(Device& dev, CommandContext& context);
 		inline int GetInstanceID() const { return instance_id; };
@@ -54,6 +61,8 @@ namespace egx
 		IndexBuffer index_buffer;
 		std::string name;
 		const Material& material;
+		ecpu::Aabb bounds;
+		ecpu::OccluderMesh occluder;
 
 		// Ray tracing
 		std::unique_ptr<GPUBuffer> blas_scratch;
@@ -5,30 +5,26 @@
 
 namespace
 {
-	struct ModelBufferType
+	// The shaders read column major matrices
+	void storeTransposed(float(&out)[4][4], const ecpu::Matrix4& matrix)
 	{
-		ema::mat4 world_matrix;
-		ema::mat4 last_world_matrix;
-	};
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				out[i][j] = matrix.m[j][i];
+	}
 }
 
-egx::Model::Model(Device& dev, const std::vector<std::shared_ptr<Mesh>>& meshes)
+egx::Model::Model(Device& dev, ecpu::TransformHierarchy& transforms, const std::vector<std::shared_ptr<Mesh>>& meshes, const Model* parent)
 	: meshes(meshes),
-	model_buffer(dev, (int)sizeof(ModelBufferType)),
+	model_buffer(dev, (int)sizeof(BufferType)),
 	is_static(false),
-	position(0.0f),
-	rotation(0.0f),
-	scale(1.0f)
+	transforms(&transforms),
+	node(transforms.Add(parent ? parent->node : ecpu::TransformHierarchy::no_parent))
 {
 }
 void egx::Model::UpdateBuffer(Device& dev, CommandContext& context)
 {
-	ModelBufferType mbt;
-	mbt.world_matrix = CalculateWorldMatrix();
-	mbt.world_matrix = mbt.world_matrix.Transpose();
-	mbt.last_world_matrix = last_world_matrix;
-	last_world_matrix = mbt.world_matrix;
-
+	BufferType mbt = GetBufferData();
 	CPUBuffer cpu_buffer(&mbt, (int)sizeof(mbt));
 	context.SetTransitionBuffer(model_buffer, GPUBufferState::CopyDest);
 	dev.ScheduleUpload(context, cpu_buffer, model_buffer);
@@ -36,7 +32,10 @@ void egx::Model::UpdateBuffer(Device& dev, CommandContext& context)
 
 }
 
-ema::mat4 egx::Model::CalculateWorldMatrix()
+egx::Model::BufferType egx::Model::GetBufferData() const
 {
-	return ema::mat4::Scale(scale) * ema::mat4::RollPitchYaw(rotation) * ema::mat4::Translation(position);
+	BufferType data;
+	storeTransposed(data.world_matrix, WorldMatrix());
+	storeTransposed(data.last_world_matrix, LastWorldMatrix());
+	return data;
 }
\ No newline at end of file
@@ -4,30 +4,52 @@
 #include <vector>
 #include <memory>
 #include "../math/mat4.h"
+#include "../cpu/transform_hierarchy.h"
 
 namespace egx
 {
+	// Meshes drawn with the transform of a node in the scene's transform hierarchy. Setting the
+	// position, rotation or scale marks the node dirty, the world matrices are computed by
+	// the hierarchy's Update and UpdateBuffer is only needed for the nodes it reports changed
 	class Model
 	{
 	public:
-		Model(Device& dev, const std::vector<std::shared_ptr<Mesh>>& meshes);
+		// ModelBufferType of model.hlsli, the matrices transposed for the shaders
+		struct BufferType
+		{
+			float world_matrix[4][4];
+			float last_world_matrix[4][4];
+		};
+
+	public:
+		Model(Device& dev, ecpu::TransformHierarchy& transforms, const std::vector<std::shared_ptr<Mesh>>& meshes, const Model* parent = nullptr);
+		// Uploads the world matrix and the world matrix of the previous update
 		void UpdateBuffer(Device& dev, CommandContext& context);
+		// What UpdateBuffer uploads, for the instance arrays of instanced draws
+		BufferType GetBufferData() const;
 
 		inline std::vector<std::shared_ptr<Mesh>>& GetMeshes() { return meshes; };
 		inline ConstantBuffer& GetModelBuffer() { return model_buffer; };
+		inline uint32_t GetTransformNode() const { return node; };
 
 		inline bool IsStatic() const { return is_static; };
-		inline const ema::vec3& Position() const { return position; };
-		inline const ema::vec3& Rotation() const { return rotation; };
-		inline const ema::vec3& Scale() const { return scale; };
+		inline ema::vec3 Position() const { return toVec3(transforms->Position(node)); };
+		inline ema::vec3 Rotation() const { return toVec3(transforms->Rotation(node)); };
+		inline ema::vec3 Scale() const { return toVec3(transforms->Scale(node)); };
 
 		inline void SetStatic(bool new_static_val) { is_static = new_static_val; };
-		inline void SetPosition(const ema::vec3& new_pos) { position = new_pos; };
-		inline void SetRotation(const ema::vec3& new_rot) { rotation = new_rot; };
-		inline void SetScale(const ema::vec3& new_scale) { scale = new_scale; };
-		inline void SetScale(float new_scale) { scale = ema::vec3(new_scale); };
+		inline void SetPosition(const ema::vec3& new_pos) { transforms->SetPosition(node, toVector3(new_pos)); };
+		inline void SetRotation(const ema::vec3& new_rot) { transforms->SetRotation(node, toVector3(new_rot)); };
+		inline void SetScale(const ema::vec3& new_scale) { transforms->SetScale(node, toVector3(new_scale)); };
+		inline void SetScale(float new_scale) { SetScale(ema::vec3(new_scale)); };
 
-		ema::mat4 CalculateWorldMatrix();
+		// As of the hierarchy's last Update
+		inline const ecpu::Matrix4& WorldMatrix() const { return transforms->World(node); };
+		inline const ecpu::Matrix4& LastWorldMatrix() const { return transforms->LastWorld(node); };
+
+	private:
+		static inline ecpu::Vector3 toVector3(const ema::vec3& v) { return ecpu::Vector3(v.x, v.y, v.z); };
+		static inline ema::vec3 toVec3(const ecpu::Vector3& v) { return ema::vec3(v.x, v.y, v.z); };
 
 	private:
 		std::vector<std::shared_ptr<Mesh>> meshes;
@@ -35,10 +57,8 @@ namespace egx
 
 		bool is_static;
 
-		ema::vec3 position;
-		ema::vec3 rotation;
-		ema::vec3 scale;
-		ema::mat4 last_world_matrix;
+		ecpu::TransformHierarchy* transforms;
+		uint32_t node;
 
 	};
 }
\ No newline at end of file
@@ -5,7 +5,18 @@
 #include "../../math/mat4.h"
 #include "../mesh.h"
 
-void egx::TLAS::Build(Device& dev, CommandContext& context, std::vector<std::shared_ptr<Model>>& models)
+namespace
+{
+    // The 3x4 row major instance transform takes column vectors
+    void storeTransform(float(&out)[3][4], const ecpu::Matrix4& world)
+    {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 4; j++)
+                out[i][j] = world.m[j][i];
+    }
+}
+
+void egx::TLAS::Build(Device& dev, CommandContext& context, const std::vector<std::shared_ptr<Model>>& models)
 {
     // Count instances
     int instance_count = 0;
@@ -51,7 +62,8 @@ void egx::TLAS::Build(Device& dev, CommandContext& context, std::vector<std::sha
     int next_instance_id = 0;
     for (auto pmodel : models)
     {
-        ema::mat4 m = pmodel->CalculateWorldMatrix().Transpose();
+        float transform[3][4];
+        storeTransform(transform, pmodel->WorldMatrix());
         for (auto pmesh : pmodel->GetMeshes())
         {
             // Get instance id
@@ -67,7 +79,7 @@ void egx::TLAS::Build(Device& dev, CommandContext& context, std::vector<std::sha
             pInstance_buffer[index].InstanceContributionToHitGroupIndex = instance_id * 2;
             pInstance_buffer[index].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
 
-            memcpy(pInstance_buffer[index].Transform, &m, sizeof(pInstance_buffer[index].Transform));
+            memcpy(pInstance_buffer[index].Transform, transform, sizeof(pInstance_buffer[index].Transform));
             pInstance_buffer[index].AccelerationStructure = pmesh->blas_result->buffer->GetGPUVirtualAddress();
             pInstance_buffer[index].InstanceMask = 0xFF;
             index++;
@@ -98,16 +110,17 @@ void egx::TLAS::Build(Device& dev, CommandContext& context, std::vector<std::sha
 }
 
 
-void egx::TLAS::ReBuild(CommandContext& context, std::vector<std::shared_ptr<Model>>& models)
+void egx::TLAS::ReBuild(CommandContext& context, const std::vector<std::shared_ptr<Model>>& models)
 {
     D3D12_RAYTRACING_INSTANCE_DESC* pInstance_buffer = (D3D12_RAYTRACING_INSTANCE_DESC*)instances_buffer->Map();
     int index = 0;
     for (auto pmodel : models)
     {
-        ema::mat4 m = pmodel->CalculateWorldMatrix().Transpose();
+        float transform[3][4];
+        storeTransform(transform, pmodel->WorldMatrix());
         for (auto pmesh : pmodel->GetMeshes())
         {
-            memcpy(pInstance_buffer[index].Transform, &m, sizeof(pInstance_buffer[index].Transform));
+            memcpy(pInstance_buffer[index].Transform, transform, sizeof(pInstance_buffer[index].Transform));
             index++;
         }
     }
@@ -11,8 +11,8 @@ namespace egx
 	public:
 		TLAS() : srv_cpu(), srv_gpu() {};
 
-		void Build(Device& dev, CommandContext& context, std::vector<std::shared_ptr<Model>>& models);
-		void ReBuild(CommandContext& context, std::vector<std::shared_ptr<Model>>& models);
+		void Build(Device& dev, CommandContext& context, const std::vector<std::shared_ptr<Model>>& models);
+		void ReBuild(CommandContext& context, const std::vector<std::shared_ptr<Model>>& models);
 
 	private:
 		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC as_desc;
@@ -0,0 +1,15 @@
+#include "structured_buffer.h"
+#include "internal/egx_internal.h"
+#include "device.h"
+
+egx::StructuredBuffer::StructuredBuffer(Device& dev, int element_size, int element_count)
+	: GPUBuffer(
+		dev,
+		D3D12_RESOURCE_DIMENSION_BUFFER,
+		DXGI_FORMAT_UNKNOWN,
+		element_count, 1, 1, element_size,
+		D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+		D3D12_RESOURCE_FLAG_NONE,
+		nullptr)
+{
+}
\ No newline at end of file
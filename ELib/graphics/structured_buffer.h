@@ -0,0 +1,12 @@
+#pragma once
+#include "internal/gpu_buffer.h"
+
+namespace egx
+{
+	// Array of elements read by shaders through a root shader resource view
+	class StructuredBuffer : public GPUBuffer
+	{
+	public:
+		StructuredBuffer(Device& dev, int element_size, int element_count);
+	};
+}
\ No newline at end of file
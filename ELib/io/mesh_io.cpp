@@ -1,6 +1,7 @@
 #include "mesh_io.h"
 #include "../misc/string_helpers.h"
 #include "console.h"
+#include "objb.h"
 #include <fstream>
 #include <stdexcept>
 #include <sstream>
@@ -347,7 +348,8 @@ namespace
 		const std::string& obj_name,
 		const egx::MaterialManager& mat_manager, int material_start_index,
 		const std::vector<std::vector<egx::MeshVertex>>& vertex_arrays,
-		const std::vector<std::vector<unsigned long>>& index_arrays
+		const std::vector<std::vector<unsigned long>>& index_arrays,
+		std::vector<ecpu::OccluderMesh> occluders = {}
 	)
 	{
 		// Create meshes
@@ -359,6 +361,8 @@ namespace
 			{
 				auto& material = mat_manager.GetMaterial(i + material_start_index);
 				meshes.push_back(std::make_shared<egx::Mesh>(dev, context, obj_name + emisc::ToString(i), vertex_arrays[i], index_arrays[i], material));
+				if (i < (int)occluders.size())
+					meshes.back()->SetOccluder(std::move(occluders[i]));
 			}
 		}
 
@@ -483,7 +487,22 @@ std::vector<std::shared_ptr<egx::Mesh>> eio::LoadMeshFromOBJB(egx::Device& dev,
 		file.read(reinterpret_cast<char*>(index_arrays[i].data()), sizeof(unsigned long) * index_count);
 	}
 
-	auto meshes = createMeshesFromData(dev, context, obj_name, mat_manager, material_start_index, vertex_arrays, index_arrays);
+	// Occluders of the meshes tagged by BakeOccluders, for the occlusion culling of DrawList
+	std::vector<ecpu::OccluderMesh> occluders;
+	std::vector<int> occluder_meshes;
+	if (eio::LoadOccluders(obj_name, occluder_meshes))
+	{
+		std::vector<ecpu::OccluderSource> sources(mesh_count);
+		for (int i = 0; i < mesh_count; i++)
+		{
+			for (const auto& vertex : vertex_arrays[i])
+				sources[i].positions.push_back(ecpu::Vector3(vertex.position.x, vertex.position.y, vertex.position.z));
+			sources[i].indices.assign(index_arrays[i].begin(), index_arrays[i].end());
+		}
+		occluders = ecpu::MakeOccluders(sources, occluder_meshes);
+	}
+
+	auto meshes = createMeshesFromData(dev, context, obj_name, mat_manager, material_start_index, vertex_arrays, index_arrays, std::move(occluders));
 
 	Console::Log(obj_name + ": Load finished");
 	Console::SetColor(15);
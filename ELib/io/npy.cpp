@@ -0,0 +1,86 @@
+#include "npy.h"
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const char magic[] = "\x93NUMPY";
+	const size_t magic_size = 6;
+	// Magic, version and header length come before the header text
+	const size_t preamble_size = magic_size + 4;
+
+	// Value of key in the header dictionary, up to the next comma or closing brace
+	std::string headerValue(const std::string& header, const std::string& key)
+	{
+		size_t start = header.find("'" + key + "':");
+		if (start == std::string::npos)
+			throw std::runtime_error("NPY: header has no " + key);
+		start = header.find_first_not_of(' ', start + key.size() + 3);
+		size_t end = header[start] == '(' ? header.find(')', start) + 1 : header.find_first_of(",}", start);
+		return header.substr(start, end - start);
+	}
+}
+
+void eio::SaveNpy(const std::string& file_name, const std::vector<double>& values)
+{
+	// The header is padded with spaces so the data starts 64 byte aligned, like np.save does
+	std::string header = "{'descr': '<f8', 'fortran_order': False, 'shape': (" + std::to_string(values.size()) + ",), }";
+	const size_t padding = 64 - (preamble_size + header.size() + 1) % 64;
+	header += std::string(padding % 64, ' ') + "\n";
+
+	std::ofstream file(file_name, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open file " + file_name);
+	const uint8_t version_and_length[4] = { 1, 0, (uint8_t)(header.size() & 0xff), (uint8_t)(header.size() >> 8) };
+	file.write(magic, magic_size);
+	file.write((const char*)version_and_length, 4);
+	file.write(header.data(), header.size());
+	file.write((const char*)values.data(), values.size() * sizeof(double));
+}
+
+std::vector<double> eio::LoadNpy(const std::string& file_name)
+{
+	std::ifstream file(file_name, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to load file " + file_name);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (bytes.size() < preamble_size || std::memcmp(bytes.data(), magic, magic_size) != 0 || bytes[6] != 1)
+		throw std::runtime_error("NPY: " + file_name + " is not a version 1 npy file");
+
+	const size_t header_size = bytes[8] | (bytes[9] << 8);
+	if (bytes.size() < preamble_size + header_size)
+		throw std::runtime_error("NPY: header ends early");
+	const std::string header(bytes.begin() + preamble_size, bytes.begin() + preamble_size + header_size);
+	const std::string descr = headerValue(header, "descr");
+	const std::string shape = headerValue(header, "shape");
+	if (headerValue(header, "fortran_order") != "False" || shape.find(',') == std::string::npos ||
+		shape.find_first_of("0123456789", shape.find(',')) != std::string::npos)
+		throw std::runtime_error("NPY: only one dimensional arrays are supported");
+
+	const size_t count = std::stoull(shape.substr(1));
+	const uint8_t* data = bytes.data() + preamble_size + header_size;
+	const size_t value_size = descr == "'<f8'" ? 8 : descr == "'<f4'" ? 4 : 0;
+	if (value_size == 0)
+		throw std::runtime_error("NPY: unsupported type " + descr);
+	if (bytes.size() < preamble_size + header_size + count * value_size)
+		throw std::runtime_error("NPY: data ends early");
+
+	std::vector<double> values(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (value_size == 8)
+		{
+			std::memcpy(&values[i], data + i * 8, 8);
+		}
+		else
+		{
+			float v;
+			std::memcpy(&v, data + i * 4, 4);
+			values[i] = v;
+		}
+	}
+	return values;
+}
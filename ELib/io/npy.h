@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace eio
+{
+	// NumPy .npy files of one dimensional float64 arrays, the format np.save writes for the result
+	// and training curves under Network. Loading also accepts float32 arrays
+	void SaveNpy(const std::string& file_name, const std::vector<double>& values);
+	std::vector<double> LoadNpy(const std::string& file_name);
+}
@@ -0,0 +1,169 @@
+#include "objb.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	static_assert(sizeof(eio::ObjbVertex) == 48, "ObjbVertex must match egx::MeshVertex");
+
+	template <typename T>
+	void readValues(std::ifstream& file, T* values, size_t count, const std::string& file_name)
+	{
+		file.read(reinterpret_cast<char*>(values), sizeof(T) * count);
+		if (!file)
+			throw std::runtime_error("Unexpected end of file " + file_name);
+	}
+
+	template <typename T>
+	void writeValues(std::ofstream& file, const T* values, size_t count)
+	{
+		file.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+	}
+
+	// The .mtl files are written on Windows with backslashes
+	std::string portablePath(std::string path)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+		return path;
+	}
+}
+
+std::vector<eio::ObjbMesh> eio::LoadObjb(const std::string& obj_name)
+{
+	const std::string file_name = obj_name + ".objb";
+	std::ifstream file(file_name, std::ios::in | std::ios::binary);
+	if (file.fail())
+		throw std::runtime_error("Failed to open file " + file_name);
+
+	int mesh_count = 0;
+	readValues(file, &mesh_count, 1, file_name);
+	if (mesh_count < 0)
+		throw std::runtime_error("Invalid mesh count in " + file_name);
+
+	std::vector<ObjbMesh> meshes(mesh_count);
+	for (auto& mesh : meshes)
+	{
+		int counts[3] = {};
+		readValues(file, counts, 3, file_name);
+		if (counts[0] < 0 || counts[1] < 0 || counts[1] % 3 != 0)
+			throw std::runtime_error("Invalid mesh in " + file_name);
+		mesh.vertices.resize(counts[0]);
+		mesh.indices.resize(counts[1]);
+		mesh.material_index = counts[2];
+		readValues(file, mesh.vertices.data(), mesh.vertices.size(), file_name);
+		readValues(file, mesh.indices.data(), mesh.indices.size(), file_name);
+		for (uint32_t index : mesh.indices)
+			if (index >= mesh.vertices.size())
+				throw std::runtime_error("Vertex index out of range in " + file_name);
+	}
+	return meshes;
+}
+
+void eio::SaveObjb(const std::string& obj_name, const std::vector<ObjbMesh>& meshes)
+{
+	const std::string file_name = obj_name + ".objb";
+	std::ofstream file(file_name, std::ios::out | std::ios::binary);
+	if (file.fail())
+		throw std::runtime_error("Failed to open file " + file_name);
+
+	const int mesh_count = (int)meshes.size();
+	writeValues(file, &mesh_count, 1);
+	for (const auto& mesh : meshes)
+	{
+		const int counts[3] = { (int)mesh.vertices.size(), (int)mesh.indices.size(), mesh.material_index };
+		writeValues(file, counts, 3);
+		writeValues(file, mesh.vertices.data(), mesh.vertices.size());
+		writeValues(file, mesh.indices.data(), mesh.indices.size());
+	}
+}
+
+std::vector<eio::ObjbMaterial> eio::LoadMtl(const std::string& obj_name)
+{
+	const std::string file_name = obj_name + ".mtl";
+	std::ifstream file(file_name);
+	if (file.fail())
+		throw std::runtime_error("Failed to load file " + file_name);
+
+	std::vector<ObjbMaterial> materials;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::stringstream ss(line);
+		std::string identifier;
+		ss >> identifier;
+		if (identifier == "newmtl")
+		{
+			materials.emplace_back();
+			ss >> materials.back().name;
+			continue;
+		}
+		if (materials.empty())
+			continue;
+
+		auto& material = materials.back();
+		if (identifier == "Kd")
+		{
+			ss >> material.diffuse_color[0] >> material.diffuse_color[1] >> material.diffuse_color[2];
+		}
+		else if (identifier == "r")
+		{
+			ss >> material.reflectance;
+		}
+		else if (identifier == "map_Kd")
+		{
+			ss >> material.diffuse_map;
+			material.diffuse_map = portablePath(material.diffuse_map);
+		}
+		else if (identifier == "map_bump")
+		{
+			ss >> material.normal_map;
+			material.normal_map = portablePath(material.normal_map);
+		}
+		else if (identifier == "map_spec")
+		{
+			ss >> material.specular_map;
+			material.specular_map = portablePath(material.specular_map);
+		}
+		else if (identifier == "map_d")
+		{
+			ss >> material.mask_map;
+			material.mask_map = portablePath(material.mask_map);
+		}
+	}
+	return materials;
+}
+
+bool eio::LoadOccluders(const std::string& obj_name, std::vector<int>& mesh_indices)
+{
+	const std::string file_name = obj_name + ".occluders";
+	std::ifstream file(file_name);
+	if (file.fail())
+		return false;
+
+	int count = 0;
+	file >> count;
+	if (!file || count < 0)
+		throw std::runtime_error("Invalid occluder count in " + file_name);
+	mesh_indices.resize(count);
+	for (int& index : mesh_indices)
+	{
+		file >> index;
+		if (!file || index < 0)
+			throw std::runtime_error("Invalid occluder mesh in " + file_name);
+	}
+	return true;
+}
+
+void eio::SaveOccluders(const std::string& obj_name, const std::vector<int>& mesh_indices)
+{
+	const std::string file_name = obj_name + ".occluders";
+	std::ofstream file(file_name);
+	if (file.fail())
+		throw std::runtime_error("Failed to open file " + file_name);
+
+	file << mesh_indices.size() << std::endl;
+	for (int index : mesh_indices)
+		file << index << std::endl;
+}
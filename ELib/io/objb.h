@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace eio
+{
+	// Vertex with the layout of egx::MeshVertex, as stored in .objb files
+	struct ObjbVertex
+	{
+		float position[3];
+		float normal[3];
+		float tangent[4];	// w is the handedness of the bitangent
+		float uv[2];
+	};
+
+	// One mesh per material of the .mtl file, empty if no face uses the material
+	struct ObjbMesh
+	{
+		std::vector<ObjbVertex> vertices;
+		std::vector<uint32_t> indices;
+		int material_index = 0;
+	};
+
+	// The parts of an .mtl material the G-buffer pass and the ray tracing shaders read, what
+	// LoadMaterialsFromMTL keeps. Texture paths are as written in the file, with forward slashes,
+	// relative to the working directory of the tools
+	struct ObjbMaterial
+	{
+		std::string name;
+		float diffuse_color[3] = { 0.0f, 0.0f, 0.0f };
+		float reflectance = 0.0f;
+		std::string diffuse_map;
+		std::string normal_map;
+		std::string specular_map;
+		std::string mask_map;
+	};
+
+	// Portable reading of the baked models LoadMeshFromOBJB uploads, for the CPU renderers.
+	// The functions take the model name without an extension, like the loaders in mesh_io.h
+	std::vector<ObjbMesh> LoadObjb(const std::string& obj_name);
+	void SaveObjb(const std::string& obj_name, const std::vector<ObjbMesh>& meshes);
+	std::vector<ObjbMaterial> LoadMtl(const std::string& obj_name);
+	// Indices of the meshes tagged as occluders when the model was baked, kept in an
+	// .occluders text file next to the .objb file. Load returns false if there is no such file
+	bool LoadOccluders(const std::string& obj_name, std::vector<int>& mesh_indices);
+	void SaveOccluders(const std::string& obj_name, const std::vector<int>& mesh_indices);
+}
@@ -0,0 +1,657 @@
+#include "png.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	const uint8_t signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+
+	uint32_t readU32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	void writeU32(std::vector<uint8_t>& out, uint32_t v)
+	{
+		out.push_back((uint8_t)(v >> 24));
+		out.push_back((uint8_t)(v >> 16));
+		out.push_back((uint8_t)(v >> 8));
+		out.push_back((uint8_t)v);
+	}
+
+	struct CrcTable
+	{
+		uint32_t values[256];
+
+		CrcTable()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				values[i] = c;
+			}
+		}
+	};
+
+	uint32_t crc32(const uint8_t* data, size_t size)
+	{
+		// Function local so the table is built once even when images are decoded on several threads
+		static const CrcTable table;
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; i++)
+			crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t adler32(const uint8_t* data, size_t size)
+	{
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < size; i++)
+		{
+			a = (a + data[i]) % 65521u;
+			b = (b + a) % 65521u;
+		}
+		return (b << 16) | a;
+	}
+
+	// Base values and extra bits of the deflate length and distance codes
+	const short length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const short length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const short distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const short distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Inflate of a zlib stream, following the structure of zlib's puff.c
+	class Inflater
+	{
+	public:
+		Inflater(const uint8_t* data, size_t size) : data(data), size(size) {};
+
+		std::vector<uint8_t> Run()
+		{
+			if (size < 2 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[0] & 0x0F) != 8)
+				throw std::runtime_error("PNG: invalid zlib header");
+			pos = 2;
+
+			bool last = false;
+			while (!last)
+			{
+				last = bits(1) == 1;
+				int type = bits(2);
+				if (type == 0)
+					stored();
+				else if (type == 1)
+					fixed();
+				else if (type == 2)
+					dynamic();
+				else
+					throw std::runtime_error("PNG: invalid deflate block");
+			}
+			return std::move(out);
+		}
+
+	private:
+		struct Huffman
+		{
+			short counts[16];
+			short symbols[288];
+		};
+
+		int bits(int n)
+		{
+			while (bit_count < n)
+			{
+				if (pos >= size)
+					throw std::runtime_error("PNG: compressed data ends early");
+				bit_buffer |= (uint32_t)data[pos++] << bit_count;
+				bit_count += 8;
+			}
+			int v = (int)(bit_buffer & ((1u << n) - 1));
+			bit_buffer >>= n;
+			bit_count -= n;
+			return v;
+		}
+
+		void stored()
+		{
+			bit_buffer = 0;
+			bit_count = 0;
+			if (pos + 4 > size)
+				throw std::runtime_error("PNG: compressed data ends early");
+			unsigned int length = data[pos] | (data[pos + 1] << 8);
+			unsigned int complement = data[pos + 2] | (data[pos + 3] << 8);
+			pos += 4;
+			if (length != (~complement & 0xFFFF) || pos + length > size)
+				throw std::runtime_error("PNG: invalid stored block");
+			out.insert(out.end(), data + pos, data + pos + length);
+			pos += length;
+		}
+
+		static void build(Huffman& h, const short* lengths, int count)
+		{
+			std::memset(h.counts, 0, sizeof(h.counts));
+			for (int i = 0; i < count; i++)
+				h.counts[lengths[i]]++;
+
+			short offsets[16];
+			offsets[1] = 0;
+			for (int len = 1; len < 15; len++)
+				offsets[len + 1] = offsets[len] + h.counts[len];
+			for (int i = 0; i < count; i++)
+			{
+				if (lengths[i] != 0)
+					h.symbols[offsets[lengths[i]]++] = (short)i;
+			}
+		}
+
+		int decode(const Huffman& h)
+		{
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int len = 1; len < 16; len++)
+			{
+				code |= bits(1);
+				int count = h.counts[len];
+				if (code - count < first)
+					return h.symbols[index + (code - first)];
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			throw std::runtime_error("PNG: invalid Huffman code");
+		}
+
+		void codes(const Huffman& lengths, const Huffman& distances)
+		{
+			while (true)
+			{
+				int symbol = decode(lengths);
+				if (symbol < 256)
+				{
+					out.push_back((uint8_t)symbol);
+					continue;
+				}
+				if (symbol == 256)
+					return;
+
+				symbol -= 257;
+				if (symbol >= 29)
+					throw std::runtime_error("PNG: invalid length code");
+				int length = length_base[symbol] + bits(length_extra[symbol]);
+
+				int d = decode(distances);
+				if (d >= 30)
+					throw std::runtime_error("PNG: invalid distance code");
+				size_t distance = distance_base[d] + bits(distance_extra[d]);
+				if (distance > out.size())
+					throw std::runtime_error("PNG: distance too far back");
+
+				size_t from = out.size() - distance;
+				for (int i = 0; i < length; i++)
+					out.push_back(out[from + i]);
+			}
+		}
+
+		void fixed()
+		{
+			short lengths[288];
+			for (int i = 0; i < 144; i++) lengths[i] = 8;
+			for (int i = 144; i < 256; i++) lengths[i] = 9;
+			for (int i = 256; i < 280; i++) lengths[i] = 7;
+			for (int i = 280; i < 288; i++) lengths[i] = 8;
+			Huffman length_codes;
+			build(length_codes, lengths, 288);
+
+			for (int i = 0; i < 30; i++) lengths[i] = 5;
+			Huffman distance_codes;
+			build(distance_codes, lengths, 30);
+
+			codes(length_codes, distance_codes);
+		}
+
+		void dynamic()
+		{
+			static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			int length_count = bits(5) + 257;
+			int distance_count = bits(5) + 1;
+			int code_count = bits(4) + 4;
+			if (length_count > 286 || distance_count > 30)
+				throw std::runtime_error("PNG: invalid dynamic block");
+
+			short lengths[320] = {};
+			for (int i = 0; i < code_count; i++)
+				lengths[order[i]] = (short)bits(3);
+			Huffman code_lengths;
+			build(code_lengths, lengths, 19);
+
+			int index = 0;
+			while (index < length_count + distance_count)
+			{
+				int symbol = decode(code_lengths);
+				if (symbol < 16)
+				{
+					lengths[index++] = (short)symbol;
+					continue;
+				}
+
+				short repeat_value = 0;
+				int repeat = 0;
+				if (symbol == 16)
+				{
+					if (index == 0)
+						throw std::runtime_error("PNG: repeat without a previous length");
+					repeat_value = lengths[index - 1];
+					repeat = 3 + bits(2);
+				}
+				else if (symbol == 17)
+				{
+					repeat = 3 + bits(3);
+				}
+				else
+				{
+					repeat = 11 + bits(7);
+				}
+				if (index + repeat > length_count + distance_count)
+					throw std::runtime_error("PNG: too many code lengths");
+				while (repeat--)
+					lengths[index++] = repeat_value;
+			}
+
+			Huffman length_codes;
+			Huffman distance_codes;
+			build(length_codes, lengths, length_count);
+			build(distance_codes, lengths + length_count, distance_count);
+			codes(length_codes, distance_codes);
+		}
+
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t pos = 0;
+		uint32_t bit_buffer = 0;
+		int bit_count = 0;
+		std::vector<uint8_t> out;
+	};
+
+	// Deflate into a zlib stream with one block of the fixed Huffman codes. LZ77 matches are
+	// found through hash chains of three byte prefixes over the 32 KB window, taking the longest
+	// of the first max_chain candidates. Dynamic codes would compress further, the fixed ones keep
+	// the encoder small and already remove most of the redundancy of filtered image rows
+	class Deflater
+	{
+	public:
+		std::vector<uint8_t> Run(const uint8_t* data, size_t size)
+		{
+			out = { 0x78, 0x01 };
+			put(1, 1);	// Final block
+			put(1, 2);	// Fixed codes
+
+			std::vector<int> head(hash_size, -1);
+			std::vector<int> prev(window_size, -1);
+			auto insert = [&](size_t p)
+			{
+				if (p + min_match > size)
+					return;
+				const uint32_t h = hash(data + p);
+				prev[p & (window_size - 1)] = head[h];
+				head[h] = (int)p;
+			};
+
+			size_t pos = 0;
+			while (pos < size)
+			{
+				int best_length = 0;
+				size_t best_distance = 0;
+				if (pos + min_match <= size)
+				{
+					const int max_length = (int)std::min(size - pos, (size_t)max_match);
+					int candidate = head[hash(data + pos)];
+					for (int chain = 0; chain < max_chain && candidate >= 0 && pos - candidate <= window_size; chain++)
+					{
+						const uint8_t* a = data + candidate;
+						const uint8_t* b = data + pos;
+						if (a[best_length] == b[best_length])
+						{
+							int length = 0;
+							while (length < max_length && a[length] == b[length])
+								length++;
+							if (length > best_length)
+							{
+								best_length = length;
+								best_distance = pos - candidate;
+								if (length == max_length)
+									break;
+							}
+						}
+						const int next = prev[candidate & (window_size - 1)];
+						if (next >= candidate)
+							break;
+						candidate = next;
+					}
+				}
+
+				if (best_length >= min_match)
+				{
+					match(best_length, best_distance);
+					for (int i = 0; i < best_length; i++)
+						insert(pos + i);
+					pos += best_length;
+				}
+				else
+				{
+					literal(data[pos]);
+					insert(pos);
+					pos++;
+				}
+			}
+			literal(256);
+			if (bit_count > 0)
+				out.push_back((uint8_t)bit_buffer);
+			writeU32(out, adler32(data, size));
+			return std::move(out);
+		}
+
+	private:
+		static const int min_match = 3;
+		static const int max_match = 258;
+		static const int max_chain = 32;
+		static const size_t window_size = 32768;
+		static const uint32_t hash_size = 1 << 15;
+
+		static uint32_t hash(const uint8_t* p)
+		{
+			return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> 17;
+		}
+
+		// Bits go out from the least significant end
+		void put(uint32_t value, int count)
+		{
+			bit_buffer |= value << bit_count;
+			bit_count += count;
+			while (bit_count >= 8)
+			{
+				out.push_back((uint8_t)bit_buffer);
+				bit_buffer >>= 8;
+				bit_count -= 8;
+			}
+		}
+
+		// Huffman codes go out from their most significant bit
+		void code(uint32_t value, int length)
+		{
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; i++)
+				reversed |= ((value >> i) & 1) << (length - 1 - i);
+			put(reversed, length);
+		}
+
+		// Fixed literal/length code of RFC 1951 section 3.2.6
+		void literal(int symbol)
+		{
+			if (symbol < 144)
+				code(0x30 + symbol, 8);
+			else if (symbol < 256)
+				code(0x190 + symbol - 144, 9);
+			else if (symbol < 280)
+				code(symbol - 256, 7);
+			else
+				code(0xC0 + symbol - 280, 8);
+		}
+
+		void match(int length, size_t distance)
+		{
+			const int l = (int)(std::upper_bound(length_base, length_base + 29, length) - length_base) - 1;
+			literal(257 + l);
+			put(length - length_base[l], length_extra[l]);
+			const int d = (int)(std::upper_bound(distance_base, distance_base + 30, (int)distance) - distance_base) - 1;
+			code(d, 5);
+			put((uint32_t)distance - distance_base[d], distance_extra[d]);
+		}
+
+	private:
+		std::vector<uint8_t> out;
+		uint32_t bit_buffer = 0;
+		int bit_count = 0;
+	};
+
+	uint8_t paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = std::abs(p - a);
+		int pb = std::abs(p - b);
+		int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return (uint8_t)a;
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	void appendChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& payload)
+	{
+		writeU32(out, (uint32_t)payload.size());
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), payload.begin(), payload.end());
+		writeU32(out, crc32(out.data() + start, out.size() - start));
+	}
+}
+
+eio::PngImage eio::DecodePng(const std::vector<uint8_t>& file)
+{
+	if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0)
+		throw std::runtime_error("PNG: missing signature");
+
+	PngImage image;
+	int bit_depth = 8;
+	int color_type = 0;
+	std::vector<uint8_t> palette;
+	std::vector<uint8_t> compressed;
+	size_t pos = 8;
+	bool ended = false;
+	while (!ended)
+	{
+		if (pos + 12 > file.size())
+			throw std::runtime_error("PNG: file ends early");
+		uint32_t length = readU32(&file[pos]);
+		const uint8_t* type = &file[pos + 4];
+		const uint8_t* payload = &file[pos + 8];
+		if (pos + 12 + (size_t)length > file.size())
+			throw std::runtime_error("PNG: chunk exceeds the file");
+		if (readU32(payload + length) != crc32(type, length + 4))
+			throw std::runtime_error("PNG: chunk checksum mismatch");
+
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			image.width = (int)readU32(payload);
+			image.height = (int)readU32(payload + 4);
+			bit_depth = payload[8];
+			color_type = payload[9];
+			int interlace = payload[12];
+			if (interlace != 0)
+				throw std::runtime_error("PNG: only non-interlaced images are supported");
+			const bool packed = color_type == 0 || color_type == 3;
+			if (bit_depth != 8 && !(packed && (bit_depth == 1 || bit_depth == 2 || bit_depth == 4)))
+				throw std::runtime_error("PNG: unsupported bit depth " + std::to_string(bit_depth));
+			switch (color_type)
+			{
+			case 0: image.channels = 1; break;
+			case 2: image.channels = 3; break;
+			case 3: image.channels = 3; break;
+			case 4: image.channels = 2; break;
+			case 6: image.channels = 4; break;
+			default: throw std::runtime_error("PNG: unsupported color type " + std::to_string(color_type));
+			}
+		}
+		else if (std::memcmp(type, "PLTE", 4) == 0)
+		{
+			palette.assign(payload, payload + length);
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), payload, payload + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			ended = true;
+		}
+		pos += 12 + length;
+	}
+	if (image.channels == 0)
+		throw std::runtime_error("PNG: missing header");
+
+	std::vector<uint8_t> filtered = Inflater(compressed.data(), compressed.size()).Run();
+	// Palette indices and gray values are stored with one sample per pixel, packed below 8 bits
+	const int samples = color_type == 3 ? 1 : image.channels;
+	const size_t stride = ((size_t)image.width * samples * bit_depth + 7) / 8;
+	if (filtered.size() < (stride + 1) * image.height)
+		throw std::runtime_error("PNG: image data too short");
+
+	// Undo the per row filters, bpp is the byte distance to the pixel on the left
+	const int bpp = std::max(1, samples * bit_depth / 8);
+	std::vector<uint8_t> rows(stride * image.height);
+	for (int y = 0; y < image.height; y++)
+	{
+		const uint8_t filter = filtered[y * (stride + 1)];
+		const uint8_t* src = &filtered[y * (stride + 1) + 1];
+		uint8_t* row = &rows[y * stride];
+		const uint8_t* prev = y > 0 ? row - stride : nullptr;
+		for (size_t i = 0; i < stride; i++)
+		{
+			int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = prev && i >= (size_t)bpp ? prev[i - bpp] : 0;
+			switch (filter)
+			{
+			case 0: row[i] = src[i]; break;
+			case 1: row[i] = (uint8_t)(src[i] + a); break;
+			case 2: row[i] = (uint8_t)(src[i] + b); break;
+			case 3: row[i] = (uint8_t)(src[i] + ((a + b) >> 1)); break;
+			case 4: row[i] = (uint8_t)(src[i] + paeth(a, b, c)); break;
+			default: throw std::runtime_error("PNG: invalid row filter");
+			}
+		}
+	}
+	if (bit_depth == 8 && color_type != 3)
+	{
+		image.pixels.swap(rows);
+		return image;
+	}
+
+	// Expand packed gray to 8 bits and palette indices to RGB
+	image.pixels.resize((size_t)image.width * image.height * image.channels);
+	const int max_value = (1 << bit_depth) - 1;
+	for (int y = 0; y < image.height; y++)
+	{
+		const uint8_t* row = &rows[y * stride];
+		for (int x = 0; x < image.width; x++)
+		{
+			const int bit = x * bit_depth;
+			const int value = (row[bit / 8] >> (8 - bit_depth - bit % 8)) & max_value;
+			uint8_t* dst = image.Pixel(x, y);
+			if (color_type == 0)
+			{
+				dst[0] = (uint8_t)(value * 255 / max_value);
+				continue;
+			}
+			if ((size_t)value * 3 + 3 > palette.size())
+				throw std::runtime_error("PNG: palette index out of range");
+			for (int c = 0; c < 3; c++)
+				dst[c] = palette[value * 3 + c];
+		}
+	}
+	return image;
+}
+
+std::vector<uint8_t> eio::EncodePng(const PngImage& image)
+{
+	static const uint8_t color_types[5] = { 0, 0, 4, 2, 6 };
+	if (image.channels < 1 || image.channels > 4 || image.pixels.size() != (size_t)image.width * image.height * image.channels)
+		throw std::runtime_error("PNG: invalid image");
+
+	std::vector<uint8_t> out(signature, signature + 8);
+
+	std::vector<uint8_t> header;
+	writeU32(header, (uint32_t)image.width);
+	writeU32(header, (uint32_t)image.height);
+	header.push_back(8);
+	header.push_back(color_types[image.channels]);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	appendChunk(out, "IHDR", header);
+
+	// Every row takes the filter with the smallest sum of absolute differences, the usual
+	// heuristic of PNG encoders, before deflate
+	const size_t stride = (size_t)image.width * image.channels;
+	const int bpp = image.channels;
+	std::vector<uint8_t> filtered;
+	filtered.reserve((stride + 1) * image.height);
+	std::vector<uint8_t> candidate(stride);
+	std::vector<uint8_t> best(stride);
+	for (int y = 0; y < image.height; y++)
+	{
+		const uint8_t* row = image.pixels.data() + y * stride;
+		const uint8_t* prev = y > 0 ? row - stride : nullptr;
+		long long best_sum = -1;
+		uint8_t best_filter = 0;
+		for (uint8_t filter = 0; filter < 5; filter++)
+		{
+			long long sum = 0;
+			for (size_t i = 0; i < stride; i++)
+			{
+				int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+				int b = prev ? prev[i] : 0;
+				int c = prev && i >= (size_t)bpp ? prev[i - bpp] : 0;
+				int predicted = 0;
+				switch (filter)
+				{
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) >> 1; break;
+				case 4: predicted = paeth(a, b, c); break;
+				}
+				candidate[i] = (uint8_t)(row[i] - predicted);
+				sum += std::abs((int)(int8_t)candidate[i]);
+			}
+			if (best_sum < 0 || sum < best_sum)
+			{
+				best_sum = sum;
+				best_filter = filter;
+				best.swap(candidate);
+			}
+		}
+		filtered.push_back(best_filter);
+		filtered.insert(filtered.end(), best.begin(), best.end());
+	}
+	std::vector<uint8_t> zlib = Deflater().Run(filtered.data(), filtered.size());
+	appendChunk(out, "IDAT", zlib);
+
+	appendChunk(out, "IEND", {});
+	return out;
+}
+
+eio::PngImage eio::LoadPng(const std::string& file_name)
+{
+	std::ifstream file(file_name, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to load file " + file_name);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return DecodePng(bytes);
+}
+
+void eio::SavePng(const std::string& file_name, const PngImage& image)
+{
+	std::vector<uint8_t> bytes = EncodePng(image);
+	std::ofstream file(file_name, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open file " + file_name);
+	file.write((const char*)bytes.data(), bytes.size());
+}
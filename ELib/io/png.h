@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace eio
+{
+	// 8 bit image with interleaved channels, 1 = gray, 2 = gray alpha, 3 = RGB, 4 = RGBA
+	struct PngImage
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		std::vector<uint8_t> pixels;
+
+		inline uint8_t* Pixel(int x, int y) { return pixels.data() + ((size_t)y * width + x) * channels; };
+		inline const uint8_t* Pixel(int x, int y) const { return pixels.data() + ((size_t)y * width + x) * channels; };
+	};
+
+	// Portable PNG reading and writing for the headless tools, where the WIC based texture
+	// functions are not available. Reads non-interlaced 8 bit gray, gray alpha, RGB and RGBA
+	// images, which covers everything SaveTextureToFile writes for the dataset, as well as 1, 2
+	// and 4 bit gray and palette images, decoded to 8 bit gray and RGB, which some of the scene
+	// textures use. Writes filter the rows and deflate them with the fixed Huffman codes, a
+	// small encoder that still compresses rendered frames several times.
+	PngImage DecodePng(const std::vector<uint8_t>& file);
+	std::vector<uint8_t> EncodePng(const PngImage& image);
+
+	PngImage LoadPng(const std::string& file_name);
+	void SavePng(const std::string& file_name, const PngImage& image);
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iterator>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "cpu/thread_pool.h"
+#include "cpu/timer.h"
+#include "io/png.h"
+#include "aa/taa/jitter_points.h"
+#include "deep_learning/cpu/dataset_reader.h"
+#include "deferred_rendering/cpu/cpu_rasterizer.h"
+#include "scenes/cpu/cpu_scene.h"
+
+// Renders the recorded camera paths through the Sponza scene of DatasetGenerator with the CPU
+// rasterizer, without a GPU, and writes the jittered depth, motion vectors and jitter of every
+// frame in the dataset layout, next to albedo and normal images of the G-buffer. The lit and
+// tone mapped color images still come from DatasetGenerator, reference targets from TargetTracer.
+// Usage: GBufferGenerator <output root> [upsample factor] [video count]
+namespace
+{
+	const char* usage = "Usage: GBufferGenerator <output root> [upsample factor] [video count]";
+
+	// The settings of DatasetGenerator
+	const int output_width = 1920;
+	const int output_height = 1080;
+	const float near_plane = 0.1f;
+	const float far_plane = 100.0f;
+	const float field_of_view = 3.141592f / 3.0f;
+	const int upsample_factor_options[] = { 2, 4 };
+
+	const std::string camera_folder = "../DatasetGenerator/camera_positions/";
+
+	void makeDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	std::string framePath(const std::string& root, const std::string& kind, int upsample_factor, int video, int frame)
+	{
+		const std::string us = std::to_string(upsample_factor);
+		const std::string v = std::to_string(video);
+		return root + "/us" + us + "/" + kind + "/video" + v + "/" + kind + "_us" + us + "_v" + v + "_f" + std::to_string(frame) + ".png";
+	}
+
+	eio::PngImage normalImage(const ecpu::Tensor& normals)
+	{
+		const ecpu::TensorShape& s = normals.Shape();
+		ecpu::Tensor encoded(1, s.h, s.w, 3);
+		for (size_t i = 0; i < (size_t)s.h * s.w; i++)
+			for (int c = 0; c < 3; c++)
+				encoded.Data()[i * 3 + c] = normals.Data()[i * 4 + c] * 0.5f + 0.5f;
+		return ecpu::TensorToImage(encoded);
+	}
+
+	void renderSequences(const std::string& root, ecpu::CPUSponzaScene& scene, int upsample_factor, int video_count, ecpu::ThreadPool& pool)
+	{
+		const int width = output_width / upsample_factor;
+		const int height = output_height / upsample_factor;
+		ecpu::SoftwareRasterizer rasterizer(width, height);
+		const auto jitter = CustomJitterPoints(upsample_factor);
+
+		const std::string directory = root + "/us" + std::to_string(upsample_factor);
+		const char* kinds[] = { "depth", "motion_vectors", "jitter", "albedo", "normals" };
+		makeDirectory(directory);
+		for (const char* kind : kinds)
+		{
+			makeDirectory(directory + "/" + kind);
+			for (int v = 0; v < video_count; v++)
+				makeDirectory(directory + "/" + kind + "/video" + std::to_string(v));
+		}
+
+		std::cout << "Rendering " << video_count << " videos at " << width << "x" << height << " on " << pool.ThreadCount() << " threads" << std::endl;
+		ecpu::SoftwareRasterizer::Stats total;
+		int frames = 0;
+		ecpu::Timer timer;
+		for (int v = 0; v < video_count; v++)
+		{
+			const auto path = ecpu::LoadCameraPath(camera_folder, v);
+			ecpu::RasterCamera camera(width, height, near_plane, far_plane, field_of_view);
+			scene.ResetMotion();
+			for (int f = 0; f < (int)path.size(); f++)
+			{
+				const JitterPoint& j = jitter[f % jitter.size()];
+				camera.SetPosition(path[f].position);
+				camera.SetRotation(path[f].rotation);
+				camera.SetJitter(j.x, j.y);
+				camera.Update();
+				scene.Update((float)((double)path[f].time / 1000000.0));
+				rasterizer.Render(scene.NextDraws(), camera, pool);
+
+				eio::SavePng(ecpu::DatasetDepthPath(root, upsample_factor, v, f), ecpu::EncodeDepth(rasterizer.GetDepth()));
+				eio::SavePng(ecpu::DatasetMotionPath(root, upsample_factor, v, f), ecpu::EncodeMotion(rasterizer.GetMotionVectors()));
+				eio::SavePng(framePath(root, "albedo", upsample_factor, v, f), ecpu::TensorToImage(rasterizer.GetAlbedo()));
+				eio::SavePng(framePath(root, "normals", upsample_factor, v, f), normalImage(rasterizer.GetNormals()));
+				std::ofstream(ecpu::DatasetJitterPath(root, upsample_factor, v, f)) << j.x << " " << j.y;
+
+				const auto& stats = rasterizer.GetLastStats();
+				total.triangles += stats.triangles;
+				total.rasterized_triangles += stats.rasterized_triangles;
+				total.vertex_seconds += stats.vertex_seconds;
+				total.setup_seconds += stats.setup_seconds;
+				total.raster_seconds += stats.raster_seconds;
+				total.resolve_seconds += stats.resolve_seconds;
+				frames++;
+			}
+		}
+
+		if (frames == 0)
+			return;
+		const double seconds = timer.Elapsed();
+		const double per_frame = 1000.0 / frames;
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "  " << frames << " frames in " << seconds << " s, " << frames / seconds << " fps, "
+			<< total.rasterized_triangles / frames << " of " << total.triangles / frames << " triangles rasterized per frame" << std::endl;
+		std::cout << "  per frame: vertex " << total.vertex_seconds * per_frame << " ms, setup " << total.setup_seconds * per_frame
+			<< " ms, raster " << total.raster_seconds * per_frame << " ms, resolve " << total.resolve_seconds * per_frame << " ms" << std::endl;
+		std::cout << "  writing: " << (seconds - total.TotalSeconds()) * per_frame << " ms" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << usage << std::endl;
+		return 1;
+	}
+	const std::string root = argv[1];
+	const int upsample_factor = argc > 2 ? std::atoi(argv[2]) : 0;
+	const int recorded_videos = ecpu::LoadCameraVideoCount(camera_folder);
+	const int video_count = argc > 3 ? std::min(recorded_videos, std::max(0, std::atoi(argv[3]))) : recorded_videos;
+
+	std::vector<int> factors;
+	if (upsample_factor > 0)
+		factors.push_back(upsample_factor);
+	else
+		factors.assign(std::begin(upsample_factor_options), std::end(upsample_factor_options));
+
+	std::cout << "Loading the scene" << std::endl;
+	ecpu::CPUSponzaScene scene;
+	ecpu::ThreadPool pool;
+	makeDirectory(root);
+	for (int factor : factors)
+		renderSequences(root, scene, factor, video_count, pool);
+}
@@ -0,0 +1,138 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+#include "cpu/thread_pool.h"
+#include "cpu/timer.h"
+#include "cpu/image_metrics.h"
+#include "io/png.h"
+#include "io/npy.h"
+#include "deep_learning/cpu/dataset_reader.h"
+
+// Computes PSNR, SSIM and temporal PSNR of upsampled sequences against the dataset targets, the
+// numbers utils.TestMasterModel produces, without PyTorch. Frames are read from the folders the
+// Upscaler writes and results are saved as <result name>PSNR.npy, SSIM.npy and TPSNR.npy with
+// one value per frame, in the format of Network/Results. TPSNR is 0 for the first frame of
+// every video, which has no previous frame.
+// Usage: Metrics <dataset root> <image folder> <result name> [upsample factor] [video count] [image prefix] [target spp]
+namespace
+{
+	std::string framePath(const std::string& folder, const std::string& prefix, int upsample_factor, int video, int frame)
+	{
+		return folder + "/video" + std::to_string(video) + "/" + prefix + "_us" + std::to_string(upsample_factor) +
+			"_v" + std::to_string(video) + "_f" + std::to_string(frame) + ".png";
+	}
+
+	bool fileExists(const std::string& path)
+	{
+		return (bool)std::ifstream(path);
+	}
+
+	double average(const std::vector<double>& values, size_t first = 0)
+	{
+		double sum = 0.0;
+		for (size_t i = first; i < values.size(); i++)
+			sum += values[i];
+		return values.size() > first ? sum / (values.size() - first) : 0.0;
+	}
+
+	struct FramePair
+	{
+		ecpu::Tensor image;
+		ecpu::Tensor target;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		std::cout << "Usage: Metrics <dataset root> <image folder> <result name> [upsample factor] [video count] [image prefix] [target spp]" << std::endl;
+		return 1;
+	}
+	const std::string root = argv[1];
+	const std::string folder = argv[2];
+	const std::string result_name = argv[3];
+	const int upsample_factor = argc > 4 ? std::max(1, std::atoi(argv[4])) : 4;
+	int video_count = argc > 5 ? std::atoi(argv[5]) : 0;
+	const std::string prefix = argc > 6 ? argv[6] : "upscaled";
+	const int target_spp = argc > 7 ? std::max(1, std::atoi(argv[7])) : 64;
+
+	if (video_count <= 0)
+	{
+		video_count = 0;
+		while (fileExists(framePath(folder, prefix, upsample_factor, video_count, 0)))
+			video_count++;
+	}
+	if (video_count == 0)
+	{
+		std::cout << "No frames found at " << framePath(folder, prefix, upsample_factor, 0, 0) << std::endl;
+		return 1;
+	}
+
+	// Frames of a video are loaded and measured a batch at a time, one frame per thread. The last
+	// frame of a batch is kept for the temporal metric of the next
+	ecpu::ThreadPool pool;
+	const int batch_size = pool.ThreadCount();
+	std::vector<FramePair> frames(batch_size + 1);
+	std::vector<double> psnr, ssim, tpsnr;
+	ecpu::Timer timer;
+	std::cout << "Measuring " << video_count << " videos of " << folder << " against spp" << target_spp << " on "
+		<< pool.ThreadCount() << " threads" << std::endl;
+	std::cout << std::fixed << std::setprecision(4);
+
+	for (int v = 0; v < video_count; v++)
+	{
+		ecpu::Timer video_timer;
+		int frame_count = 0;
+		while (fileExists(framePath(folder, prefix, upsample_factor, v, frame_count)))
+			frame_count++;
+
+		for (int first = 0; first < frame_count; first += batch_size)
+		{
+			const int count = std::min(batch_size, frame_count - first);
+			std::vector<double> batch_psnr(count), batch_ssim(count), batch_tpsnr(count, 0.0);
+			pool.ParallelFor(count, [&](int i)
+				{
+					const int f = first + i;
+					FramePair& pair = frames[i + 1];
+					ecpu::ImageToTensor(eio::LoadPng(framePath(folder, prefix, upsample_factor, v, f)), 3, pair.image);
+					ecpu::ImageToTensor(eio::LoadPng(ecpu::DatasetTargetPath(root, target_spp, v, f)), 3, pair.target);
+
+					// Each thread measures its own frame, the pool is busy with the batch
+					ecpu::ThreadPool serial(1);
+					batch_psnr[i] = ecpu::PSNR(pair.image, pair.target, serial);
+					batch_ssim[i] = ecpu::SSIM(pair.image, pair.target, serial);
+				});
+			pool.ParallelFor(count, [&](int i)
+				{
+					if (first + i > 0)
+					{
+						ecpu::ThreadPool serial(1);
+						batch_tpsnr[i] = ecpu::TemporalPSNR(frames[i + 1].image, frames[i].image, frames[i + 1].target, frames[i].target, serial);
+					}
+				});
+			std::swap(frames[0], frames[count]);
+
+			psnr.insert(psnr.end(), batch_psnr.begin(), batch_psnr.end());
+			ssim.insert(ssim.end(), batch_ssim.begin(), batch_ssim.end());
+			tpsnr.insert(tpsnr.end(), batch_tpsnr.begin(), batch_tpsnr.end());
+		}
+
+		const size_t video_first = psnr.size() - frame_count;
+		const std::vector<double> video_tpsnr(tpsnr.begin() + video_first + 1, tpsnr.end());
+		std::cout << "  video " << v << ": " << frame_count << " frames, PSNR " << average(std::vector<double>(psnr.begin() + video_first, psnr.end()))
+			<< " dB, SSIM " << average(std::vector<double>(ssim.begin() + video_first, ssim.end())) << ", TPSNR " << average(video_tpsnr)
+			<< " dB in " << video_timer.Elapsed() << " s" << std::endl;
+	}
+
+	eio::SaveNpy(result_name + "PSNR.npy", psnr);
+	eio::SaveNpy(result_name + "SSIM.npy", ssim);
+	eio::SaveNpy(result_name + "TPSNR.npy", tpsnr);
+	std::cout << "PSNR average: " << average(psnr) << std::endl;
+	std::cout << "SSIM average: " << average(ssim) << std::endl;
+	std::cout << "Wrote " << psnr.size() << " frames to " << result_name << "*.npy in " << timer.Elapsed() << " s" << std::endl;
+}
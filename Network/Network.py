@@ -77,6 +77,10 @@ if(__name__ == '__main__'):
 
 
     #utils.SaveModelWeights(model)
+    #utils.SaveGoldenTensors(model, model_name + "/nn_weights_golden.bin")
+    # Pruning cost without fine tuning, then pruned, fine tuned and exported for the C++ benchmark
+    #utils.TestPrunedModels(model, loader_test, [24, 16, 8])
+    #utils.TestPrunedModels(model, loader_test, [24, 16, 8], lambda m: utils.FineTunePrunedModel(m, loader_train, loss_function, 10), model_name + "/nn_weights_pruned")
     #for g in optimizer.param_groups:
     #    print(g['lr'])
     #    g['lr'] = 1e-4
@@ -0,0 +1,107 @@
+import numpy as np
+import os
+import shutil
+import struct
+import sys
+
+# Writes the golden tensors of Testing/network_testing.cpp without PyTorch. It has the same
+# output as utils.SaveGoldenTensors: the parameters of a weight file, a fixed input and the
+# output of every layer in the NHWC layout of ecpu::Tensor, with the graph copied next to it.
+# The layers are computed in double precision with numpy from the exported weights, so this
+# is an independent reference for the C++ inference path, not the PyTorch model itself. The
+# input comes from numpy's generator and not torch.rand, so the files differ from what
+# SaveGoldenTensors writes for the same seed.
+#
+#   python golden_reference.py MasterNet2x2/nn_weights_bias4-200.bin MasterNet2x2/nn_weights_golden.bin
+#   python golden_reference.py MasterNet4x4/nn_weights_200.bin MasterNet4x4/nn_weights_golden.bin
+
+# The MasterNet layout: a strided down convolution of the 8 input channels, residual blocks of
+# two 3x3 convolutions that pad with replicate, and a pixel shuffle of the sum
+input_channels = 8
+shuffle_factor = 4
+
+def LoadWeights(file_path):
+    # The format of utils.SaveModelWeights, a count then name length, name, value count, values
+    data = open(file_path, "rb").read()
+    offset = 0
+    def readUint():
+        nonlocal offset
+        value = struct.unpack_from("<I", data, offset)[0]
+        offset += 4
+        return value
+    entries = []
+    for _ in range(readUint()):
+        length = readUint()
+        name = data[offset:offset + length].decode("ascii")
+        offset += length
+        count = readUint()
+        entries.append((name, np.frombuffer(data, dtype="<f4", count=count, offset=offset).astype(np.float64)))
+        offset += 4 * count
+    return entries
+
+def SaveWeights(entries, file_path):
+    with open(file_path, "wb") as f:
+        f.write(struct.pack("<I", len(entries)))
+        for name, values in entries:
+            f.write(struct.pack("<I", len(name)))
+            f.write(name.encode("ascii"))
+            values = np.asarray(values, dtype="<f4").ravel()
+            f.write(struct.pack("<I", values.size))
+            f.write(values.tobytes())
+
+def conv2d(x, weight, bias, kernel, stride, pad):
+    # x is CHW and weight OIHW, the padding replicates the border
+    if pad > 0:
+        x = np.pad(x, ((0, 0), (pad, pad), (pad, pad)), mode="edge")
+    _, height, width = x.shape
+    out_height = (height - kernel) // stride + 1
+    out_width = (width - kernel) // stride + 1
+    out = np.zeros((weight.shape[0], out_height, out_width))
+    for ky in range(kernel):
+        for kx in range(kernel):
+            patch = x[:, ky:ky + stride * (out_height - 1) + 1:stride, kx:kx + stride * (out_width - 1) + 1:stride]
+            out += np.einsum("oc,chw->ohw", weight[:, :, ky, kx], patch)
+    return out + bias[:, None, None]
+
+def nhwc(t):
+    return np.transpose(t, (1, 2, 0))[None]
+
+def GoldenTensors(params, height=32, width=48, seed=0):
+    down_bias = params["down.0.bias"]
+    channels = down_bias.size
+    r = int(round(np.sqrt(params["down.0.weight"].size / (channels * input_channels))))
+
+    rng = np.random.default_rng(seed)
+    x = rng.random((input_channels, height, width)).astype(np.float32).astype(np.float64)
+    # The down convolution reads the pixel-unshuffled input of init_network_cs.hlsl
+    unshuffled = x.reshape(1, input_channels, height // r, r, width // r, r).transpose(0, 2, 4, 1, 3, 5)
+    unshuffled = unshuffled.reshape(1, height // r, width // r, input_channels * r * r)
+    golden = [("golden.input", unshuffled), ("golden.input.shape", np.array(unshuffled.shape, dtype=np.float64))]
+
+    y = conv2d(x, params["down.0.weight"].reshape(channels, input_channels, r, r), down_bias, r, r, 0)
+    golden.append(("golden.down", nhwc(y)))
+    i = 1
+    while "cnn%d.0.weight" % i in params:
+        name = "cnn%d" % i
+        t = conv2d(y, params[name + ".0.weight"].reshape(channels, channels, 3, 3), params[name + ".0.bias"], 3, 1, 1)
+        t = np.maximum(t, 0.0)
+        golden.append(("golden.%s_0" % name, nhwc(t)))
+        t = conv2d(t, params[name + ".2.weight"].reshape(channels, channels, 3, 3), params[name + ".2.bias"], 3, 1, 1)
+        golden.append(("golden.%s_2" % name, nhwc(t)))
+        y = y + t
+        golden.append(("golden." + name, nhwc(y)))
+        i += 1
+
+    # The pixel-shuffled output finalize_network_ps.hlsl reads
+    f = shuffle_factor
+    c, h, w = y.shape
+    shuffled = y.reshape(c // (f * f), f, f, h, w).transpose(0, 3, 1, 4, 2).reshape(c // (f * f), h * f, w * f)
+    golden.append(("golden.shuffled", nhwc(shuffled)))
+    return golden
+
+if __name__ == "__main__":
+    source, destination = sys.argv[1], sys.argv[2]
+    params = LoadWeights(source)
+    SaveWeights(params + GoldenTensors(dict(params)), destination)
+    shutil.copy(os.path.splitext(source)[0] + ".graph", os.path.splitext(destination)[0] + ".graph")
+    print("Saved golden tensors to " + destination)
@@ -8,6 +8,7 @@ import cv2
 import numpy as np
 import matplotlib.pyplot as plt
 import time
+import os
 
 class Evaluator():
     def __init__(self, metrics):
@@ -895,8 +896,8 @@ def SaveTestImageFB(model, loader, image_nr, model_name, epoch):
         cv2.imwrite(model_name + "/temp_img" + str(epoch) + ".png", res) 
 
 import struct
-def SaveModelWeights(model):
-    f = open("nn_weights.bin", "wb")
+def SaveModelWeights(model, file_path="nn_weights.bin"):
+    f = open(file_path, "wb")
     print("Saving model weights")
     num_named = 0
     for name, param in model.named_parameters():
@@ -918,6 +919,193 @@ def SaveModelWeights(model):
         f.write(struct.pack('f'*len(param_list), *param_list))
     f.close()
 
+    if hasattr(model, "down"):
+        SaveNetworkGraph(model, os.path.splitext(file_path)[0] + ".graph")
+
+def SaveNetworkGraph(model, file_path):
+    # Writes the layer graph read by ecpu::NetworkGraph (Rendering/deep_learning/cpu/network_graph.h).
+    # The down convolution is stored as a 1x1 convolution over the pixel-unshuffled input written by
+    # init_network_cs.hlsl, followed by the residual blocks cnn1, cnn2, ... in order
+    down = model.down[0]
+    r = down.stride[0]
+    lines = ["# " + type(model).__name__ + ", factor " + str(model.factor)]
+    lines.append("input x channels=" + str(down.in_channels * r * r))
+    lines.append("conv down x weights=down.0 channels=" + str(down.out_channels) + " size=" + str(down.kernel_size[0] // r) + " unshuffle=" + str(r))
+    x = "down"
+
+    i = 1
+    while hasattr(model, "cnn" + str(i)):
+        name = "cnn" + str(i)
+        block = getattr(model, name)
+        y = x
+        for j, layer in enumerate(block):
+            if not isinstance(layer, torch.nn.Conv2d):
+                continue
+            relu = j + 1 < len(block) and isinstance(block[j + 1], torch.nn.ReLU)
+            out = name + "_" + str(j)
+            line = "conv " + out + " " + y + " weights=" + name + "." + str(j) + " channels=" + str(layer.out_channels) + " size=" + str(layer.kernel_size[0])
+            if layer.stride[0] != 1:
+                line += " stride=" + str(layer.stride[0])
+            if relu:
+                line += " relu"
+            if layer.padding_mode == 'replicate' and layer.padding[0] > 0:
+                line += " replicate"
+            lines.append(line)
+            y = out
+        lines.append("add " + name + " " + x + " " + y)
+        x = name
+        i += 1
+    lines.append("output " + x)
+
+    print("Saving network graph")
+    with open(file_path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+def SaveGoldenTensors(model, file_path, height=32, width=48, seed=0):
+    # Writes a regression file for the C++ inference path (Testing/network_testing.cpp). The file has
+    # the format of SaveModelWeights and holds the model parameters, a fixed input and the output of
+    # every layer under "golden.<tensor name of SaveNetworkGraph>", all in the NHWC layout of
+    # ecpu::Tensor, and the graph is saved next to it. The reference is the model as trained, the
+    # residual blocks pad with replicate like the CPU path does. The default size keeps the file
+    # small enough to commit next to the weights. golden_reference.py writes the same file from a
+    # weight file with numpy alone, which is how the committed golden files were made.
+    import copy
+    net = copy.deepcopy(model).cpu().float().eval()
+
+    down = net.down[0]
+    r = down.stride[0]
+    generator = torch.Generator().manual_seed(seed)
+    x = torch.rand(size=(1, down.in_channels, height, width), generator=generator)
+
+    def nhwc(t):
+        return t.permute(0, 2, 3, 1).contiguous()
+
+    # The down convolution reads the pixel-unshuffled input of init_network_cs.hlsl, where channel
+    # c * r * r + i * r + j of a pixel holds channel c of high resolution pixel (r * x + j, r * y + i)
+    n, c, h, w = x.shape
+    unshuffled = x.reshape(n, c, h // r, r, w // r, r).permute(0, 2, 4, 1, 3, 5).reshape(n, h // r, w // r, c * r * r)
+
+    golden = [("golden.input", unshuffled), ("golden.input.shape", torch.tensor(unshuffled.shape, dtype=torch.float32))]
+    with torch.no_grad():
+        y = down(x)
+        golden.append(("golden.down", nhwc(y)))
+        i = 1
+        while hasattr(net, "cnn" + str(i)):
+            name = "cnn" + str(i)
+            block = getattr(net, name)
+            t = y
+            for j, layer in enumerate(block):
+                t = layer(t)
+                # Graph convolutions include the ReLU after them, so those are recorded after it
+                if isinstance(layer, torch.nn.ReLU):
+                    golden.append(("golden." + name + "_" + str(j - 1), nhwc(t)))
+                elif not (j + 1 < len(block) and isinstance(block[j + 1], torch.nn.ReLU)):
+                    golden.append(("golden." + name + "_" + str(j), nhwc(t)))
+            y = y + t
+            golden.append(("golden." + name, nhwc(y)))
+            i += 1
+        # The pixel-shuffled output finalize_network_ps.hlsl reads, channel k holds channels k * 16 + ...
+        golden.append(("golden.shuffled", nhwc(net.up(y))))
+
+    entries = [(name, param.data.cpu().float()) for name, param in net.named_parameters()] + golden
+    print("Saving golden tensors")
+    with open(file_path, "wb") as f:
+        f.write(len(entries).to_bytes(4, byteorder='little', signed=False))
+        for name, values in entries:
+            f.write(len(name).to_bytes(4, byteorder='little', signed=False))
+            f.write(name.encode('ascii'))
+            value_list = values.flatten().tolist()
+            f.write(len(value_list).to_bytes(4, byteorder='little', signed=False))
+            f.write(struct.pack('f'*len(value_list), *value_list))
+
+    SaveNetworkGraph(net, os.path.splitext(file_path)[0] + ".graph")
+
+def residualChannelImportance(first, second):
+    # Importance of the channels between the two convolutions of a residual block, the L1 norm of the
+    # filter producing a channel times the L1 norm of the weights reading it. A channel with a small
+    # filter or one the second convolution barely uses contributes little to the block output
+    produced = first.weight.detach().abs().sum(dim=(1, 2, 3)) + first.bias.detach().abs()
+    read = second.weight.detach().abs().sum(dim=(0, 2, 3))
+    return produced * read
+
+def PruneMasterModel(model, keep):
+    # Structured pruning of the residual blocks of MasterNet2. The channels between the two
+    # convolutions of every block are ranked by residualChannelImportance and the least important
+    # ones removed, together with the matching filters of the first convolution and input channels
+    # of the second. The residual stream keeps its 32 channels since the output pixel shuffle needs
+    # them. keep is the channel count to keep per block, either one number or a list with one entry
+    # per block. It is rounded up to a multiple of 8: the C++ kernels compute 8 channels per vector,
+    # so 13 channels cost as much as 16 and the extra 3 are free. Returns a pruned copy that can be
+    # fine tuned and saved with SaveModelWeights, the graph written next to the weights carries the
+    # new channel counts to the C++ inference code
+    import copy
+    pruned = copy.deepcopy(model)
+
+    i = 1
+    while hasattr(pruned, "cnn" + str(i)):
+        block = getattr(pruned, "cnn" + str(i))
+        convs = [j for j, layer in enumerate(block) if isinstance(layer, torch.nn.Conv2d)]
+        first, second = block[convs[0]], block[convs[1]]
+        count = keep[i - 1] if isinstance(keep, (list, tuple)) else keep
+        count = max(1, min((count + 7) // 8 * 8, first.out_channels))
+
+        # Kept channels stay in their original order
+        importance = residualChannelImportance(first, second)
+        kept = torch.sort(torch.topk(importance, count).indices).values
+
+        new_first = torch.nn.Conv2d(first.in_channels, count, first.kernel_size, stride=first.stride,
+            padding=first.padding, padding_mode=first.padding_mode).to(first.weight.device)
+        new_second = torch.nn.Conv2d(count, second.out_channels, second.kernel_size, stride=second.stride,
+            padding=second.padding, padding_mode=second.padding_mode).to(second.weight.device)
+        with torch.no_grad():
+            new_first.weight.copy_(first.weight[kept])
+            new_first.bias.copy_(first.bias[kept])
+            new_second.weight.copy_(second.weight[:, kept])
+            new_second.bias.copy_(second.bias)
+        block[convs[0]] = new_first
+        block[convs[1]] = new_second
+        i += 1
+
+    print("Pruned model parameters:", sum(p.numel() for p in pruned.parameters() if p.requires_grad),
+        "of", sum(p.numel() for p in model.parameters() if p.requires_grad))
+    return pruned
+
+def FineTunePrunedModel(model, dataloader, loss_function, epochs, lr=1e-4):
+    # Retrains a model from PruneMasterModel on the training videos so the remaining channels take
+    # over the work of the removed ones. The pruned weights are only usable after it
+    params = [p for p in model.parameters() if p.requires_grad]
+    optimizer = torch.optim.Adam(params, lr=lr)
+    for epoch in range(epochs):
+        print('Fine tuning epoch {}'.format(epoch))
+        TrainEpoch(model, dataloader, optimizer, loss_function)
+    return model
+
+def TestPrunedModels(model, dataloader, keeps, fine_tune=None, file_path=None):
+    # PSNR and SSIM on the test videos of the unpruned model and of it pruned to each channel count
+    # in keeps. model must be the unpruned model, every width is pruned from it. fine_tune, if given,
+    # is called on every pruned model before testing, e.g.
+    # lambda m: FineTunePrunedModel(m, loader_train, loss_function, 10). Without it this is the worst
+    # case cost of pruning. If file_path is given the tested weights are saved as
+    # <file_path>_<keep>.bin for the latency measurements of the C++ benchmark
+    psnr_list, ssim_list, _ = subTestMasterModel(model, dataloader)
+    base_psnr = np.average(psnr_list)
+    print("")
+    print("Unpruned \t PSNR: {0:.2f} \t SSIM: {1:.4f}".format(base_psnr, np.average(ssim_list)))
+
+    results = []
+    for keep in keeps:
+        pruned = PruneMasterModel(model, keep)
+        if fine_tune is not None:
+            fine_tune(pruned)
+        psnr_list, ssim_list, _ = subTestMasterModel(pruned, dataloader)
+        psnr, ssim = np.average(psnr_list), np.average(ssim_list)
+        results.append((keep, psnr, ssim))
+        print("")
+        print("Keep {0} \t PSNR: {1:.2f} ({2:+.2f}) \t SSIM: {3:.4f}".format(keep, psnr, psnr - base_psnr, ssim))
+        if file_path is not None:
+            SaveModelWeights(pruned, file_path + "_" + str(keep) + ".bin")
+    return results
+
 def FilterResults(r, num_frames, frames_to_remove):
     for i in range(len(r)-1, -1, -1):
         if(i % num_frames < frames_to_remove):
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include "cpu/thread_pool.h"
+#include "cpu/tensor.h"
+#include "cpu/timer.h"
+#include "cpu/cpu_info.h"
+#include "cpu/roofline.h"
+#include "cpu/simd.h"
+#include "cpu/benchmark_helpers.h"
+#include "deep_learning/cpu/cpu_master_net.h"
+
+// Profiles every layer of the CPU MasterNet in isolation and end to end, and writes the results as
+// JSON so they can be compared between commits.
+// Usage: Profiler [weight file] [output json] [timed runs]
+namespace
+{
+	const int width = 1920;
+	const int height = 1080;
+	const int warmup_runs = 1;
+
+	struct LatencyStats
+	{
+		double min = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+		double mean = 0.0;
+	};
+
+	// Nearest rank percentiles of run times in seconds, reported in milliseconds
+	LatencyStats latencyStats(std::vector<double> seconds)
+	{
+		std::sort(seconds.begin(), seconds.end());
+		auto percentile = [&](double p)
+		{
+			int rank = (int)std::ceil(p / 100.0 * seconds.size()) - 1;
+			return seconds[std::min(std::max(rank, 0), (int)seconds.size() - 1)] * 1000.0;
+		};
+
+		LatencyStats out;
+		out.min = seconds.front() * 1000.0;
+		out.p50 = percentile(50.0);
+		out.p90 = percentile(90.0);
+		out.p99 = percentile(99.0);
+		for (double s : seconds)
+			out.mean += s * 1000.0 / seconds.size();
+		return out;
+	}
+
+	template <typename F>
+	LatencyStats timeRuns(int runs, F f)
+	{
+		std::vector<double> seconds;
+		for (int i = 0; i < warmup_runs + runs; i++)
+		{
+			ecpu::Timer timer;
+			f();
+			if (i >= warmup_runs)
+				seconds.push_back(timer.Elapsed());
+		}
+		return latencyStats(seconds);
+	}
+
+	// Minimal streaming JSON writer, keys and values are written in call order
+	class JsonWriter
+	{
+	public:
+		explicit JsonWriter(std::ostream& out) : out(out) { out << std::setprecision(6); };
+
+		void BeginObject(const std::string& key = "") { begin(key, '{'); };
+		void EndObject() { end('}'); };
+		void BeginArray(const std::string& key = "") { begin(key, '['); };
+		void EndArray() { end(']'); };
+
+		void Value(const std::string& key, const std::string& v) { name(key); out << '"' << escape(v) << '"'; };
+		void Value(const std::string& key, const char* v) { Value(key, std::string(v)); };
+		void Value(const std::string& key, double v) { name(key); out << (std::isfinite(v) ? v : 0.0); };
+		void Value(const std::string& key, long long v) { name(key); out << v; };
+		void Value(const std::string& key, int v) { name(key); out << v; };
+
+		void Shape(const std::string& key, const ecpu::TensorShape& s)
+		{
+			name(key);
+			out << '[' << s.n << ", " << s.h << ", " << s.w << ", " << s.c << ']';
+		}
+		void Latency(const std::string& key, const LatencyStats& l)
+		{
+			BeginObject(key);
+			Value("min", l.min);
+			Value("p50", l.p50);
+			Value("p90", l.p90);
+			Value("p99", l.p99);
+			Value("mean", l.mean);
+			EndObject();
+		}
+
+	private:
+		void name(const std::string& key)
+		{
+			if (!first.empty())
+			{
+				if (!first.back())
+					out << ',';
+				first.back() = false;
+				out << '\n' << std::string(2 * first.size(), ' ');
+			}
+			if (!key.empty())
+				out << '"' << escape(key) << "\": ";
+		}
+		void begin(const std::string& key, char bracket)
+		{
+			name(key);
+			out << bracket;
+			first.push_back(true);
+		}
+		void end(char bracket)
+		{
+			bool empty = first.back();
+			first.pop_back();
+			if (!empty)
+				out << '\n' << std::string(2 * first.size(), ' ');
+			out << bracket;
+			if (first.empty())
+				out << '\n';
+		}
+		static std::string escape(const std::string& s)
+		{
+			std::string r;
+			for (char c : s)
+			{
+				if (c == '"' || c == '\\')
+					r += '\\';
+				r += c;
+			}
+			return r;
+		}
+
+	private:
+		std::ostream& out;
+		std::vector<bool> first;
+	};
+
+	const char* layerType(const ecpu::GraphLayer& layer)
+	{
+		return layer.type == ecpu::GraphLayer::Type::Conv ? "conv" : "add";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string weight_path = argc > 1 ? argv[1] : ecpu::MasterNet::DefaultWeightPath(4);
+	std::string output_path = argc > 2 ? argv[2] : "profile.json";
+	int runs = argc > 3 ? std::max(1, std::atoi(argv[3])) : 10;
+
+	ecpu::ThreadPool pool;
+	ecpu::MasterNet net(weight_path);
+	const ecpu::NetworkGraph& graph = net.GetGraph();
+	const auto& layers = graph.Layers();
+	const auto& graph_tensors = graph.Tensors();
+
+	std::cout << "Measuring roofline on " << pool.ThreadCount() << " threads" << std::endl;
+	ecpu::Roofline roofline = ecpu::MeasureRoofline(pool);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  peak " << roofline.peak_gflops << " GFLOP/s, bandwidth " << roofline.bandwidth_gbs << " GB/s, ridge "
+		<< roofline.RidgeIntensity() << " flop/byte" << std::endl;
+
+	// Every tensor of the graph gets its own memory here, so layers can be rerun in isolation on
+	// the activations of a real forward pass
+	ecpu::TensorShape input_shape(1, height / 4, width / 4, net.InputChannels());
+	auto shapes = graph.InferShapes(input_shape);
+	std::vector<ecpu::Tensor> tensors;
+	for (const auto& shape : shapes)
+		tensors.emplace_back(shape);
+	ecpu::FillInput(tensors[graph.InputTensor()]);
+
+	auto runLayer = [&](int i)
+	{
+		const ecpu::GraphLayer& layer = layers[i];
+		if (layer.type == ecpu::GraphLayer::Type::Conv)
+			ecpu::Convolve(tensors[layer.inputs[0]], net.GetLayerWeights(i), layer.relu, tensors[layer.output], pool);
+		else
+			ecpu::Add(tensors[layer.inputs[0]], tensors[layer.inputs[1]], tensors[layer.output], pool);
+	};
+	for (int i = 0; i < (int)layers.size(); i++)
+		runLayer(i);
+
+	std::ofstream file(output_path);
+	if (!file)
+	{
+		std::cout << "Could not open " << output_path << std::endl;
+		return 1;
+	}
+	JsonWriter json(file);
+	json.BeginObject();
+	json.BeginObject("machine");
+	json.Value("cpu", ecpu::CpuModelName());
+	json.Value("compiler", ecpu::CompilerName());
+	json.Value("threads", pool.ThreadCount());
+	json.Value("simd", ECPU_AVX2 ? "avx2" : "scalar");
+	json.Value("peak_gflops", roofline.peak_gflops);
+	json.Value("bandwidth_gbs", roofline.bandwidth_gbs);
+	json.Value("ridge_intensity", roofline.RidgeIntensity());
+	json.EndObject();
+	json.Value("weights", weight_path);
+	json.Value("width", width);
+	json.Value("height", height);
+	json.Value("runs", runs);
+
+	std::cout << "Per layer at " << width << "x" << height << " (" << runs << " runs)" << std::endl;
+	std::cout << "  layer          p50 ms   p99 ms   GFLOP/s   GB/s   flop/B   % of roof" << std::endl;
+
+	double layer_sum_ms = 0.0;
+	json.BeginArray("layers");
+	for (int i = 0; i < (int)layers.size(); i++)
+	{
+		const ecpu::GraphLayer& layer = layers[i];
+		const ecpu::TensorShape& out_shape = shapes[layer.output];
+		const long long pixels = (long long)out_shape.n * out_shape.h * out_shape.w;
+
+		// Compulsory traffic: every input, the output and the weights cross memory once
+		long long flops = 0;
+		long long bytes = (long long)out_shape.ByteSize();
+		for (int t : layer.inputs)
+			bytes += (long long)shapes[t].ByteSize();
+		if (layer.type == ecpu::GraphLayer::Type::Conv)
+		{
+			const ecpu::ConvWeights& w = net.GetLayerWeights(i);
+			flops = 2 * w.MacsPerPixel() * pixels;
+			bytes += (long long)sizeof(float) * ((long long)w.PaddedOutputChannels() * w.InputChannels() * w.FilterSize() * w.FilterSize() + w.PaddedOutputChannels());
+		}
+		else
+		{
+			flops = (long long)out_shape.ElementCount();
+		}
+
+		LatencyStats latency = timeRuns(runs, [&] { runLayer(i); });
+		layer_sum_ms += latency.p50;
+
+		const double seconds = latency.p50 / 1000.0;
+		const double gflops = flops / seconds * 1e-9;
+		const double gbs = bytes / seconds * 1e-9;
+		const double intensity = (double)flops / bytes;
+		const double roof = roofline.Bound(intensity);
+
+		json.BeginObject();
+		json.Value("index", i);
+		json.Value("name", graph_tensors[layer.output].name);
+		json.Value("type", layerType(layer));
+		if (layer.type == ecpu::GraphLayer::Type::Conv)
+		{
+			json.Value("filter_size", layer.filter_size);
+			json.Value("stride", layer.stride);
+			json.Value("unshuffle", layer.unshuffle);
+		}
+		json.Shape("output_shape", out_shape);
+		json.Value("flops", flops);
+		json.Value("bytes", bytes);
+		json.Value("intensity", intensity);
+		json.Latency("latency_ms", latency);
+		json.Value("gflops", gflops);
+		json.Value("gbs", gbs);
+		json.Value("roofline_gflops", roof);
+		json.Value("roofline_fraction", gflops / roof);
+		json.Value("bound", intensity < roofline.RidgeIntensity() ? "memory" : "compute");
+		json.EndObject();
+
+		std::cout << "  " << std::left << std::setw(6) << graph_tensors[layer.output].name << " " << std::setw(4) << layerType(layer) << std::right
+			<< std::setw(9) << latency.p50 << std::setw(9) << latency.p99 << std::setw(10) << gflops << std::setw(7) << gbs
+			<< std::setw(9) << intensity << std::setw(12) << 100.0 * gflops / roof << std::endl;
+	}
+	json.EndArray();
+	json.Value("layer_sum_p50_ms", layer_sum_ms);
+
+	std::cout << "End to end" << std::endl;
+	json.BeginArray("end_to_end");
+	const std::pair<const char*, ecpu::MasterNet::Schedule> schedules[] =
+	{
+		{ "layer_by_layer", ecpu::MasterNet::Schedule::LayerByLayer },
+		{ "fused_residual_blocks", ecpu::MasterNet::Schedule::FusedResidualBlocks },
+	};
+	ecpu::Tensor output;
+	for (const auto& schedule : schedules)
+	{
+		LatencyStats latency = timeRuns(runs, [&] { net.Execute(tensors[graph.InputTensor()], output, pool, schedule.second); });
+		const auto& stats = net.GetLastStats();
+
+		json.BeginObject();
+		json.Value("schedule", schedule.first);
+		json.Latency("latency_ms", latency);
+		json.Value("gflops", 2.0 * stats.macs / (latency.p50 / 1000.0) * 1e-9);
+		json.Value("bytes", (long long)(stats.bytes_read + stats.bytes_written));
+		json.Value("buffer_bytes", (long long)stats.buffer_bytes);
+		json.EndObject();
+
+		std::cout << "  " << std::left << std::setw(22) << schedule.first << std::right << " p50 " << latency.p50
+			<< " ms, p99 " << latency.p99 << " ms" << std::endl;
+	}
+	json.EndArray();
+	json.EndObject();
+
+	std::cout << "  sum of layer p50  : " << layer_sum_ms << " ms" << std::endl;
+	std::cout << "Wrote " << output_path << std::endl;
+}
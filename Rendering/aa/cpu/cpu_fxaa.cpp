@@ -0,0 +1,311 @@
+#include "cpu_fxaa.h"
+#include "cpu/simd.h"
+#include "cpu/resample.h"
+#include "cpu/timer.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const int rows_per_task = 8;
+	// Edge pixels per resolve task, small enough to balance threads over uneven edge lists
+	const int edges_per_task = 4096;
+
+	// Luma image with a one pixel border, laid out as the engine stores it
+	struct LumaView
+	{
+		const float* data;
+		int width;
+		int height;
+		int stride;
+
+		// Load, zero outside the image
+		inline float At(int x, int y) const { return data[(size_t)(y + 1) * stride + x + 1]; };
+
+		// Sample with the linear clamp sampler, at a position in pixels
+		float Sample(float px, float py) const
+		{
+			float out;
+			ecpu::Sample<ecpu::ResampleFilter::Bilinear>(ecpu::ImageView<float>(data + stride + 1, width, height, 1, stride),
+				px / width, py / height, &out);
+			return out;
+		}
+	};
+
+	inline float luma(const float* rgb)
+	{
+		return rgb[0] * 0.299f + rgb[1] * 0.587f + rgb[2] * 0.114f;
+	}
+
+	// detectEdge of fxaa_ps.hlsl
+	inline bool detectEdge(const LumaView& l, int x, int y, const ecpu::FXAASettings& settings)
+	{
+		const float n = l.At(x, y - 1);
+		const float w = l.At(x - 1, y);
+		const float m = l.At(x, y);
+		const float e = l.At(x + 1, y);
+		const float s = l.At(x, y + 1);
+		const float luma_min = std::min(n, std::min(std::min(w, m), std::min(e, s)));
+		const float luma_max = std::max(n, std::max(std::max(w, m), std::max(e, s)));
+		return luma_max - luma_min >= std::max(settings.edge_threshold_min, luma_max * settings.edge_threshold);
+	}
+
+	// Bits of the pixels of row y in [x0, x0 + 8) that pass detectEdge. Reads past the row end
+	// land in the border or the next row, the caller masks those lanes
+	inline int detectEdges8(const LumaView& l, int x0, int y, const ecpu::FXAASettings& settings)
+	{
+		using ecpu::float8;
+		const float* center = l.data + (size_t)(y + 1) * l.stride + x0 + 1;
+		const float8 n = float8::Load(center - l.stride);
+		const float8 w = float8::Load(center - 1);
+		const float8 m = float8::Load(center);
+		const float8 e = float8::Load(center + 1);
+		const float8 s = float8::Load(center + l.stride);
+		const float8 luma_min = float8::Min(n, float8::Min(float8::Min(w, m), float8::Min(e, s)));
+		const float8 luma_max = float8::Max(n, float8::Max(float8::Max(w, m), float8::Max(e, s)));
+		const float8 threshold = float8::Max(float8::Set(settings.edge_threshold_min), luma_max * float8::Set(settings.edge_threshold));
+		return float8::GreaterEqualMask(luma_max - luma_min, threshold);
+	}
+
+	// The rest of fxaa_ps.hlsl PS for a pixel that passed detectEdge: findEdgeDirection, findSide,
+	// traverseEdge, calculateSubpixelOffset and the final sample. Positions are in pixels where the
+	// shader uses uv
+	void resolveEdgePixel(const ecpu::Tensor& input, const LumaView& l, int x, int y, const ecpu::FXAASettings& settings, float* out)
+	{
+		const float nw = l.At(x - 1, y - 1), n = l.At(x, y - 1), ne = l.At(x + 1, y - 1);
+		const float w = l.At(x - 1, y), m = l.At(x, y), e = l.At(x + 1, y);
+		const float sw = l.At(x - 1, y + 1), s = l.At(x, y + 1), se = l.At(x + 1, y + 1);
+		const float luma_min = std::min(n, std::min(std::min(w, m), std::min(e, s)));
+		const float luma_max = std::max(n, std::max(std::max(w, m), std::max(e, s)));
+		const float luma_range = luma_max - luma_min;
+
+		// findEdgeDirection
+		const float edge_vert =
+			std::abs(0.25f * nw - 0.50f * n + 0.25f * ne) +
+			std::abs(0.50f * w - 1.00f * m + 0.50f * e) +
+			std::abs(0.25f * sw - 0.50f * s + 0.25f * se);
+		const float edge_horz =
+			std::abs(0.25f * nw - 0.50f * w + 0.25f * sw) +
+			std::abs(0.50f * n - 1.00f * m + 0.50f * s) +
+			std::abs(0.25f * ne - 0.50f * e + 0.25f * se);
+		const bool is_horizontal = edge_horz >= edge_vert;
+
+		// findSide
+		const float luma1 = is_horizontal ? n : w;
+		const float luma2 = is_horizontal ? s : e;
+		const float grad1 = luma1 - m;
+		const float grad2 = luma2 - m;
+		const bool is_side1 = std::abs(grad1) >= std::abs(grad2);
+		const float opposite_luma = is_side1 ? luma1 : luma2;
+		const float grad = is_side1 ? grad1 : grad2;
+
+		// traverseEdge, moving to the center of the edge and walking along it both ways
+		float step_x = is_horizontal ? 0.0f : 1.0f;
+		float step_y = is_horizontal ? 1.0f : 0.0f;
+		if (is_side1)
+		{
+			step_x = -step_x;
+			step_y = -step_y;
+		}
+		const float luma_local_avg = 0.5f * (m + opposite_luma);
+		const float current_x = x + 0.5f + 0.5f * step_x;
+		const float current_y = y + 0.5f + 0.5f * step_y;
+		const float gradient_scaled = 0.25f * std::abs(grad);
+
+		const float offset_x = is_horizontal ? 1.0f : 0.0f;
+		const float offset_y = is_horizontal ? 0.0f : 1.0f;
+		float x1 = current_x + offset_x, y1 = current_y + offset_y;
+		float x2 = current_x - offset_x, y2 = current_y - offset_y;
+		bool reached1 = false;
+		bool reached2 = false;
+		float luma_end1 = 0.0f;
+		float luma_end2 = 0.0f;
+		for (int i = 0; i < settings.traversal_max_steps; i++)
+		{
+			if (!reached1)
+				luma_end1 = l.Sample(x1, y1) - luma_local_avg;
+			if (!reached2)
+				luma_end2 = l.Sample(x2, y2) - luma_local_avg;
+
+			reached1 = std::abs(luma_end1) >= gradient_scaled;
+			reached2 = std::abs(luma_end2) >= gradient_scaled;
+
+			if (!reached1)
+			{
+				x1 += offset_x;
+				y1 += offset_y;
+			}
+			if (!reached2)
+			{
+				x2 -= offset_x;
+				y2 -= offset_y;
+			}
+			if (reached1 && reached2)
+				break;
+		}
+
+		const float distance1 = is_horizontal ? x1 - current_x : y1 - current_y;
+		const float distance2 = is_horizontal ? current_x - x2 : current_y - y2;
+		const bool is_1_closest = distance1 < distance2;
+		const float shortest_dist = std::min(distance1, distance2);
+		const float total_dist = distance1 + distance2;
+		float pixel_offset = -shortest_dist / total_dist + 0.5f;
+
+		const bool luma_m_smaller = m < luma_local_avg;
+		const bool correct_variation_at_end = ((is_1_closest ? luma_end1 : luma_end2) < 0.0f) != luma_m_smaller;
+		pixel_offset = correct_variation_at_end ? pixel_offset : 0.0f;
+
+		// calculateSubpixelOffset
+		const float luma_average = (1.0f / 12.0f) * (2.0f * (n + w + e + s) + nw + ne + sw + se);
+		float sub_pixel_offset = std::min(std::max(std::abs(luma_average - m) / luma_range, 0.0f), 1.0f);
+		sub_pixel_offset = (3.0f - 2.0f * sub_pixel_offset) * sub_pixel_offset * sub_pixel_offset;
+		sub_pixel_offset = sub_pixel_offset * sub_pixel_offset * settings.subpixel_quality;
+
+		pixel_offset = std::max(sub_pixel_offset, pixel_offset);
+		ecpu::Sample<ecpu::ResampleFilter::Bilinear>(ecpu::ViewOf(input), (x + 0.5f + step_x * pixel_offset) / l.width,
+			(y + 0.5f + step_y * pixel_offset) / l.height, out);
+	}
+
+	void copyRow(const ecpu::Tensor& input, ecpu::Tensor& output, int y)
+	{
+		const float* src = input.Data() + (size_t)y * input.Shape().w * 3;
+		std::copy(src, src + (size_t)input.Shape().w * 3, &output.At(0, y, 0, 0));
+	}
+}
+
+void ecpu::FXAAEngine::computeLuma(const Tensor& input, ThreadPool& pool)
+{
+	const int width = input.Shape().w;
+	const int height = input.Shape().h;
+	const int stride = width + 2;
+
+	// Eight floats of slack for the vector loads past the end of the last row
+	luma_image.assign((size_t)(height + 2) * stride + 8, 0.0f);
+	const int bands = (height + rows_per_task - 1) / rows_per_task;
+	pool.ParallelFor(bands, [&](int band)
+		{
+			const float8 r_weight = float8::Set(0.299f);
+			const float8 g_weight = float8::Set(0.587f);
+			const float8 b_weight = float8::Set(0.114f);
+			for (int y = band * rows_per_task; y < std::min(height, (band + 1) * rows_per_task); y++)
+			{
+				const float* src = input.Data() + (size_t)y * input.Shape().w * 3;
+				float* dst = luma_image.data() + (size_t)(y + 1) * stride + 1;
+				int x = 0;
+				for (; x + 8 <= width; x += 8)
+				{
+					// De-interleave eight RGB pixels
+					float channels[3][8];
+					for (int i = 0; i < 8; i++)
+						for (int c = 0; c < 3; c++)
+							channels[c][i] = src[(x + i) * 3 + c];
+					const float8 l = float8::Load(channels[0]) * r_weight + float8::Load(channels[1]) * g_weight + float8::Load(channels[2]) * b_weight;
+					l.Store(dst + x);
+				}
+				for (; x < width; x++)
+					dst[x] = luma(src + x * 3);
+			}
+		});
+}
+
+void ecpu::FXAAEngine::Execute(const Tensor& input, Tensor& output, ThreadPool& pool)
+{
+	const int width = input.Shape().w;
+	const int height = input.Shape().h;
+	output.Resize(input.Shape());
+	stats = Stats();
+	stats.pixels = (size_t)width * height;
+
+	Timer timer;
+	computeLuma(input, pool);
+	const LumaView l = { luma_image.data(), width, height, width + 2 };
+	stats.luma_seconds = timer.Elapsed();
+
+	// Contrast test with compaction per band of rows, then the band lists are concatenated in
+	// order so the edge list is sorted like a scan over the image
+	timer.Reset();
+	const int bands = (height + rows_per_task - 1) / rows_per_task;
+	band_edges.resize(bands);
+	const FXAASettings& s = settings;
+	pool.ParallelFor(bands, [&](int band)
+		{
+			std::vector<uint32_t>& edges = band_edges[band];
+			edges.clear();
+			for (int y = band * rows_per_task; y < std::min(height, (band + 1) * rows_per_task); y++)
+			{
+				copyRow(input, output, y);
+				for (int x = 0; x < width; x += 8)
+				{
+					int mask = detectEdges8(l, x, y, s);
+					if (width - x < 8)
+						mask &= (1 << (width - x)) - 1;
+					for (int i = 0; mask != 0; i++, mask >>= 1)
+					{
+						if (mask & 1)
+							edges.push_back((uint32_t)((size_t)y * width + x + i));
+					}
+				}
+			}
+		});
+	edge_pixels.clear();
+	for (const auto& edges : band_edges)
+		edge_pixels.insert(edge_pixels.end(), edges.begin(), edges.end());
+	stats.edge_pixels = edge_pixels.size();
+	stats.detect_seconds = timer.Elapsed();
+
+	// Edge pixels only read the input, so they can be written in any order
+	timer.Reset();
+	const int tasks = (int)((edge_pixels.size() + edges_per_task - 1) / edges_per_task);
+	pool.ParallelFor(tasks, [&](int task)
+		{
+			const size_t end = std::min(edge_pixels.size(), (size_t)(task + 1) * edges_per_task);
+			for (size_t i = (size_t)task * edges_per_task; i < end; i++)
+			{
+				const int x = (int)(edge_pixels[i] % width);
+				const int y = (int)(edge_pixels[i] / width);
+				resolveEdgePixel(input, l, x, y, s, &output.At(0, y, x, 0));
+			}
+		});
+	stats.resolve_seconds = timer.Elapsed();
+}
+
+void ecpu::FXAAEngine::ExecuteDense(const Tensor& input, Tensor& output, ThreadPool& pool)
+{
+	const int width = input.Shape().w;
+	const int height = input.Shape().h;
+	output.Resize(input.Shape());
+	stats = Stats();
+	stats.pixels = (size_t)width * height;
+
+	Timer timer;
+	computeLuma(input, pool);
+	const LumaView l = { luma_image.data(), width, height, width + 2 };
+	stats.luma_seconds = timer.Elapsed();
+
+	timer.Reset();
+	const int bands = (height + rows_per_task - 1) / rows_per_task;
+	std::vector<size_t> band_edge_counts(bands, 0);
+	pool.ParallelFor(bands, [&](int band)
+		{
+			for (int y = band * rows_per_task; y < std::min(height, (band + 1) * rows_per_task); y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					float* out = &output.At(0, y, x, 0);
+					if (detectEdge(l, x, y, settings))
+					{
+						resolveEdgePixel(input, l, x, y, settings, out);
+						band_edge_counts[band]++;
+					}
+					else
+					{
+						const float* rgb = input.Data() + ((size_t)y * width + x) * 3;
+						std::copy(rgb, rgb + 3, out);
+					}
+				}
+			}
+		});
+	for (size_t count : band_edge_counts)
+		stats.edge_pixels += count;
+	stats.resolve_seconds = timer.Elapsed();
+}
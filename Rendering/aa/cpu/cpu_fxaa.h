@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "cpu/tensor.h"
+#include "cpu/thread_pool.h"
+
+namespace ecpu
+{
+	// Tuning parameters of fxaa_header.hlsli, defaulting to FXAA_SETUP 10
+	struct FXAASettings
+	{
+		float edge_threshold = 1.0f / 16.0f;
+		float edge_threshold_min = 1.0f / 32.0f;
+		int traversal_max_steps = 16;
+		float subpixel_quality = 0.75f;
+	};
+
+	// CPU version of fxaa_ps.hlsl. Instead of running the whole shader for every pixel, a
+	// vectorized pass computes luma and the contrast test for all pixels and compacts the pixels
+	// on edges into a list. Only those go through edge direction, traversal and the final
+	// sample, spread evenly over the threads. Pixels off edges are copied.
+	class FXAAEngine
+	{
+	public:
+		struct Stats
+		{
+			size_t pixels = 0;
+			size_t edge_pixels = 0;
+			double luma_seconds = 0.0;		// Luma of every pixel
+			double detect_seconds = 0.0;	// Contrast test, compaction and copying of the input
+			double resolve_seconds = 0.0;	// Edge traversal of the edge pixels
+
+			double TotalSeconds() const { return luma_seconds + detect_seconds + resolve_seconds; };
+		};
+
+	public:
+		explicit FXAAEngine(const FXAASettings& settings = FXAASettings()) : settings(settings) {};
+
+		// input and output are { 1, h, w, 3 } images, output is resized to match input
+		void Execute(const Tensor& input, Tensor& output, ThreadPool& pool);
+
+		// Runs the shader structure, every step per pixel, for checking and timing the compacted path
+		void ExecuteDense(const Tensor& input, Tensor& output, ThreadPool& pool);
+
+		void SetSettings(const FXAASettings& settings) { this->settings = settings; };
+		const FXAASettings& GetSettings() const { return settings; };
+		const Stats& GetLastStats() const { return stats; };
+		// Row major y * w + x indices of the edge pixels of the last Execute
+		const std::vector<uint32_t>& GetEdgePixels() const { return edge_pixels; };
+
+	private:
+		void computeLuma(const Tensor& input, ThreadPool& pool);
+
+	private:
+		FXAASettings settings;
+		Stats stats;
+
+		// Luma with a one pixel border of zeros, the value Load returns outside the texture
+		std::vector<float> luma_image;
+		std::vector<std::vector<uint32_t>> band_edges;
+		std::vector<uint32_t> edge_pixels;
+	};
+}
@@ -0,0 +1,370 @@
+#include "cpu_taa.h"
+#include "cpu/simd.h"
+#include "cpu/resample.h"
+#include "cpu/timer.h"
+#include <array>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+#include <stdexcept>
+
+namespace
+{
+	const int rows_per_task = 8;
+	const float min_alpha = 0.05f;
+	const float max_alpha = 0.2f;
+
+	struct TAAPass
+	{
+		const ecpu::DLTUSFrame* frame = nullptr;
+		const ecpu::Tensor* history = nullptr;	// Previous output
+		ecpu::Tensor* output = nullptr;
+		float clip_to_prev_clip[16];
+		bool has_history = false;
+	};
+
+	using RowKernel = void(*)(const TAAPass& pass, int y0, int y1);
+
+	inline float saturate(float v)
+	{
+		return std::min(std::max(v, 0.0f), 1.0f);
+	}
+
+	// Texture Load, zero outside the texture like D3D12
+	inline float loadTexel(const ecpu::Tensor& texture, int x, int y, int c)
+	{
+		const ecpu::TensorShape& s = texture.Shape();
+		if (x < 0 || y < 0 || x >= s.w || y >= s.h)
+			return 0.0f;
+		return texture.Data()[((size_t)y * s.w + x) * s.c + c];
+	}
+
+	// calculatePreviousFrameUV of taa_ps.hlsl for the high resolution pixel at uv, whose low
+	// resolution pixel is (lr_x, lr_y)
+	template <bool DILATE_MV>
+	void previousFrameUV(const TAAPass& pass, int lr_x, int lr_y, float u, float v, float* prev_uv)
+	{
+		const ecpu::DLTUSFrame& frame = *pass.frame;
+		float clip[4] = { 2.0f * u - 1.0f, 1.0f - 2.0f * v, 0.0f, 1.0f };
+		ecpu::Sample<ecpu::ResampleFilter::Bilinear>(ecpu::ViewOf(frame.depth), u, v, &clip[2]);
+
+		int offset_x = 0;
+		int offset_y = 0;
+		if (DILATE_MV)
+		{
+			// Motion of the frontmost diagonal neighbor if it is in front of the pixel
+			const float du = 1.0f / frame.depth.Shape().w;
+			const float dv = 1.0f / frame.depth.Shape().h;
+			const int offsets[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+			float frontmost = 0.0f;
+			for (int i = 0; i < 4; i++)
+			{
+				float depth;
+				ecpu::Sample<ecpu::ResampleFilter::Bilinear>(ecpu::ViewOf(frame.depth), u + offsets[i][0] * du, v + offsets[i][1] * dv, &depth);
+				if (i == 0 || frontmost > depth)
+				{
+					frontmost = depth;
+					offset_x = offsets[i][0];
+					offset_y = offsets[i][1];
+				}
+			}
+			if (frontmost > clip[2])
+			{
+				offset_x = 0;
+				offset_y = 0;
+			}
+			else
+			{
+				clip[2] = frontmost;
+			}
+		}
+
+		// Static pixels follow the camera
+		float prev[4];
+		for (int j = 0; j < 4; j++)
+			prev[j] = clip[0] * pass.clip_to_prev_clip[j] + clip[1] * pass.clip_to_prev_clip[4 + j] +
+				clip[2] * pass.clip_to_prev_clip[8 + j] + clip[3] * pass.clip_to_prev_clip[12 + j];
+		prev_uv[0] = prev[0] / prev[3] * 0.5f + 0.5f;
+		prev_uv[1] = prev[1] / prev[3] * -0.5f + 0.5f;
+
+		// Dynamic pixels follow their motion vector
+		const float mx = loadTexel(frame.motion, lr_x + offset_x, lr_y + offset_y, 0);
+		const float my = loadTexel(frame.motion, lr_x + offset_x, lr_y + offset_y, 1);
+		if (mx != 0.0f || my != 0.0f)
+		{
+			prev_uv[0] = u + mx;
+			prev_uv[1] = v + my;
+		}
+	}
+
+	// rgbToYCoCg and YCoCgTorgb of taa_ps.hlsl, mul(c, m) with the matrices written there
+	inline void toYCoCg(ecpu::float8* c)
+	{
+		using ecpu::float8;
+		const float8 y = float8::Set(0.25f) * c[0] + float8::Set(0.5f) * c[1] - float8::Set(0.25f) * c[2];
+		const float8 co = float8::Set(0.5f) * (c[0] + c[2]);
+		const float8 cg = float8::Set(0.25f) * c[0] - float8::Set(0.5f) * c[1] - float8::Set(0.25f) * c[2];
+		c[0] = y;
+		c[1] = co;
+		c[2] = cg;
+	}
+
+	inline void toRGB(ecpu::float8* c)
+	{
+		const ecpu::float8 r = c[0] + c[1] + c[2];
+		const ecpu::float8 g = c[0] - c[2];
+		const ecpu::float8 b = c[1] - c[0] - c[2];
+		c[0] = r;
+		c[1] = g;
+		c[2] = b;
+	}
+
+	// rectifyHistory and clipHistory of taa_ps.hlsl for eight pixels
+	template <bool YCOCG, bool CLIPPING>
+	void rectifyHistory(ecpu::float8* history, ecpu::float8 (&samples)[9][3])
+	{
+		using ecpu::float8;
+		if (YCOCG)
+		{
+			for (int i = 0; i < 9; i++)
+				toYCoCg(samples[i]);
+			toYCoCg(history);
+		}
+
+		float8 min_sample[3], max_sample[3];
+		for (int c = 0; c < 3; c++)
+		{
+			min_sample[c] = samples[0][c];
+			max_sample[c] = samples[0][c];
+			for (int i = 1; i < 9; i++)
+			{
+				min_sample[c] = float8::Min(min_sample[c], samples[i][c]);
+				max_sample[c] = float8::Max(max_sample[c], samples[i][c]);
+			}
+		}
+
+		if (CLIPPING)
+		{
+			// Ray from the history towards the box center, clipped where it enters the box
+			float8 end[3], enter[3];
+			for (int c = 0; c < 3; c++)
+			{
+				end[c] = float8::Set(0.5f) * (min_sample[c] + max_sample[c]);
+				const float8 rec_dir = float8::Set(1.0f) / (end[c] - history[c]);
+				enter[c] = float8::Min((min_sample[c] - history[c]) * rec_dir, (max_sample[c] - history[c]) * rec_dir);
+			}
+			float8 x = float8::Max(enter[0], float8::Max(enter[1], enter[2]));
+			x = float8::Min(float8::Max(x, float8::Zero()), float8::Set(1.0f));
+			for (int c = 0; c < 3; c++)
+				history[c] = float8::MulAdd(end[c] - history[c], x, history[c]);
+		}
+		else
+		{
+			for (int c = 0; c < 3; c++)
+				history[c] = float8::Min(float8::Max(history[c], min_sample[c]), max_sample[c]);
+		}
+
+		if (YCOCG)
+			toRGB(history);
+	}
+
+	// taa_ps.hlsl PS for the rows [y0, y1). Eight horizontally adjacent pixels are processed
+	// together: the reprojection and history sampling, which read data dependent addresses, are
+	// done per pixel into lanes, and everything after that runs on float8
+	template <int F, bool CATMULL_ROM, bool RECTIFY, bool YCOCG, bool CLIPPING, bool DILATE_MV>
+	void taaRows(const TAAPass& pass, int y0, int y1)
+	{
+		using ecpu::float8;
+		const ecpu::DLTUSFrame& frame = *pass.frame;
+		ecpu::Tensor& output = *pass.output;
+		const int width = output.Shape().w;
+		const int height = output.Shape().h;
+		const int lr_width = frame.color.Shape().w;
+		const int lr_height = frame.color.Shape().h;
+		const float8 u2 = float8::Set((float)(F * F));
+
+		for (int y = y0; y < y1; y++)
+		{
+			const int lr_y = y / F;
+			const float v = (0.5f + y) / height;
+			for (int x0 = 0; x0 < width; x0 += 8)
+			{
+				const int lanes = std::min(8, width - x0);
+				float history_lanes[3][8];
+				float sample_lanes[9][3][8];
+				float alpha_lanes[8];
+				float dx_lanes[8];
+
+				for (int i = 0; i < 8; i++)
+				{
+					// Lanes past the end of the row repeat the last pixel
+					const int x = x0 + std::min(i, lanes - 1);
+					const int lr_x = x / F;
+					const float u = (0.5f + x) / width;
+
+					float prev_uv[2];
+					previousFrameUV<DILATE_MV>(pass, lr_x, lr_y, u, v, prev_uv);
+
+					float history[3] = {};
+					bool refresh_history = true;
+					if (pass.has_history && prev_uv[0] > 0.0f && prev_uv[0] <= 1.0f && prev_uv[1] > 0.0f && prev_uv[1] <= 1.0f)
+					{
+						// catmullRom of the shader is the five tap approximation of the Catmull-Rom spline
+						const ecpu::ImageView<float> history_view = ecpu::ViewOf(*pass.history);
+						if (CATMULL_ROM)
+							ecpu::Sample<ecpu::ResampleFilter::CatmullRom5>(history_view, prev_uv[0], prev_uv[1], history, ecpu::CubicKernel::CatmullRom);
+						else
+							ecpu::Sample<ecpu::ResampleFilter::Bilinear>(history_view, prev_uv[0], prev_uv[1], history);
+						refresh_history = false;
+					}
+					for (int c = 0; c < 3; c++)
+						history_lanes[c][i] = history[c];
+
+					// calculateAlpha
+					const float vx = (prev_uv[0] - u) * width;
+					const float vy = (prev_uv[1] - v) * height;
+					const float velocity = saturate(std::sqrt(vx * vx + vy * vy) / 10.0f);
+					alpha_lanes[i] = refresh_history ? 1.0f : min_alpha + (max_alpha - min_alpha) * velocity;
+
+					// The 3x3 neighborhood, read directly away from the borders
+					if (lr_x > 0 && lr_y > 0 && lr_x < lr_width - 1 && lr_y < lr_height - 1)
+					{
+						const float* center = frame.color.Data() + ((size_t)lr_y * lr_width + lr_x) * 3;
+						for (int k = 0; k < 9; k++)
+						{
+							const float* texel = center + ((k / 3 - 1) * (ptrdiff_t)lr_width + k % 3 - 1) * 3;
+							for (int c = 0; c < 3; c++)
+								sample_lanes[k][c][i] = texel[c];
+						}
+					}
+					else
+					{
+						for (int k = 0; k < 9; k++)
+							for (int c = 0; c < 3; c++)
+								sample_lanes[k][c][i] = loadTexel(frame.color, lr_x + k % 3 - 1, lr_y + k / 3 - 1, c);
+					}
+
+					// Low resolution distance from the pixel to its jittered sample, before the 3x3 offset
+					dx_lanes[i] = lr_x + frame.jitter_x - (0.5f + x) / F;
+				}
+
+				float8 history[3], samples[9][3];
+				for (int c = 0; c < 3; c++)
+					history[c] = float8::Load(history_lanes[c]);
+				for (int k = 0; k < 9; k++)
+					for (int c = 0; c < 3; c++)
+						samples[k][c] = float8::Load(sample_lanes[k][c]);
+
+				// The new sample is the center pixel, or a filtered sample of the neighborhood when upsampling
+				float8 new_sample[3] = { samples[4][0], samples[4][1], samples[4][2] };
+				float8 beta = float8::Set(1.0f);
+				if (F > 1)
+				{
+					const float8 dx = float8::Load(dx_lanes);
+					const float dy = lr_y + frame.jitter_y - (0.5f + y) / F;
+					float8 norm_weight = float8::Zero();
+					float8 biggest_weight = float8::Zero();
+					for (int c = 0; c < 3; c++)
+						new_sample[c] = float8::Zero();
+					for (int k = 0; k < 9; k++)
+					{
+						// computePixelWeight, 1 - 1.9 x^2 + 0.905 x^4 approximating a Gaussian
+						const float8 px = dx + float8::Set((float)(k % 3 - 1));
+						const float py = dy + (float)(k / 3 - 1);
+						const float8 x2 = u2 * float8::MulAdd(px, px, float8::Set(py * py));
+						float8 r = float8::MulAdd(float8::MulAdd(float8::Set(0.905f), x2, float8::Set(-1.9f)), x2, float8::Set(1.0f));
+						r = float8::IfGreater(x2, float8::Set(1.0f), float8::Set(0.000000001f), r);
+						const float8 w = r * u2;
+
+						norm_weight += w;
+						for (int c = 0; c < 3; c++)
+							new_sample[c] = float8::MulAdd(samples[k][c], w, new_sample[c]);
+						biggest_weight = float8::Max(biggest_weight, w);
+					}
+					const float8 inv_norm_weight = float8::Set(1.0f) / norm_weight;
+					for (int c = 0; c < 3; c++)
+						new_sample[c] = new_sample[c] * inv_norm_weight;
+					beta = biggest_weight;
+				}
+
+				if (RECTIFY)
+					rectifyHistory<YCOCG, CLIPPING>(history, samples);
+
+				const float8 t = float8::Load(alpha_lanes) * beta;
+				float result[3][8];
+				for (int c = 0; c < 3; c++)
+					float8::MulAdd(new_sample[c] - history[c], t, history[c]).Store(result[c]);
+
+				float* dst = &output.At(0, y, x0, 0);
+				for (int i = 0; i < lanes; i++)
+					for (int c = 0; c < 3; c++)
+						dst[i * 3 + c] = result[c][i];
+			}
+		}
+	}
+
+	// One kernel per combination of the five feature switches, indexed by the bits of TAAFeatures
+	template <int F, int BITS>
+	void taaRowsOf(const TAAPass& pass, int y0, int y1)
+	{
+		taaRows<F, (BITS & 1) != 0, (BITS & 2) != 0, (BITS & 4) != 0, (BITS & 8) != 0, (BITS & 16) != 0>(pass, y0, y1);
+	}
+
+	template <int F, size_t... BITS>
+	std::array<RowKernel, 32> kernelTable(std::index_sequence<BITS...>)
+	{
+		return { { &taaRowsOf<F, (int)BITS>... } };
+	}
+
+	RowKernel selectKernel(int upsample_factor, const ecpu::TAAFeatures& features)
+	{
+		static const std::array<RowKernel, 32> kernels1 = kernelTable<1>(std::make_index_sequence<32>());
+		static const std::array<RowKernel, 32> kernels2 = kernelTable<2>(std::make_index_sequence<32>());
+		static const std::array<RowKernel, 32> kernels4 = kernelTable<4>(std::make_index_sequence<32>());
+
+		const int bits = (features.catmull_rom ? 1 : 0) | (features.history_rectification ? 2 : 0) |
+			(features.ycocg ? 4 : 0) | (features.clipping ? 8 : 0) | (features.dilate_mv ? 16 : 0);
+		if (upsample_factor == 1)
+			return kernels1[bits];
+		if (upsample_factor == 2)
+			return kernels2[bits];
+		return kernels4[bits];
+	}
+}
+
+ecpu::TAAEngine::TAAEngine(int upsample_factor, const TAAFeatures& features)
+	: upsample_factor(upsample_factor), features(features)
+{
+	if (upsample_factor != 1 && upsample_factor != 2 && upsample_factor != 4)
+		throw std::runtime_error("TAA supports upsample factors 1, 2 and 4");
+}
+
+void ecpu::TAAEngine::Execute(const DLTUSFrame& frame, ThreadPool& pool, const float* clip_to_prev_clip)
+{
+	Timer timer;
+	const TensorShape& lr = frame.color.Shape();
+	const TensorShape shape(1, lr.h * upsample_factor, lr.w * upsample_factor, 3);
+	if (history[current].Shape() != shape)
+		has_history = false;
+
+	TAAPass pass;
+	pass.frame = &frame;
+	pass.history = &history[current];
+	pass.output = &history[1 - current];
+	pass.has_history = has_history;
+	for (int i = 0; i < 16; i++)
+		pass.clip_to_prev_clip[i] = clip_to_prev_clip ? clip_to_prev_clip[i] : (i % 5 == 0 ? 1.0f : 0.0f);
+	pass.output->Resize(shape);
+
+	const RowKernel kernel = selectKernel(upsample_factor, features);
+	const int bands = (shape.h + rows_per_task - 1) / rows_per_task;
+	pool.ParallelFor(bands, [&](int band)
+		{
+			const int y0 = band * rows_per_task;
+			kernel(pass, y0, std::min(shape.h, y0 + rows_per_task));
+		});
+
+	current = 1 - current;
+	has_history = true;
+	last_seconds = timer.Elapsed();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "cpu/tensor.h"
+#include "cpu/thread_pool.h"
+#include "deep_learning/cpu/dltus_passes.h"
+
+namespace ecpu
+{
+	// Feature macros of taa_ps.hlsl. Every combination is compiled into its own kernel, so the
+	// switches cost nothing per pixel, like the shader permutations TAA::recompileShaders builds
+	struct TAAFeatures
+	{
+		bool catmull_rom = true;			// TAA_USE_CATMUL_ROM, bicubic instead of bilinear history samples
+		bool history_rectification = true;	// TAA_USE_HISTORY_RECTIFICATION
+		bool ycocg = true;					// TAA_USE_YCOCG, rectify in YCoCg instead of RGB
+		bool clipping = true;				// TAA_USE_CLIPPING, clip towards the neighborhood instead of clamping
+		bool dilate_mv = true;				// TAA_DILATE_MV, use the motion of the frontmost diagonal neighbor
+	};
+
+	// CPU version of taa_ps.hlsl with TAA_USE_RASTERIZER, for running recorded sequences without a
+	// GPU. Frames are the render resolution inputs the DLTUS pipeline takes and the output is the
+	// history at upsample_factor times that resolution. Upsample factor 1 is plain TAA, anything
+	// higher enables the TAA_UPSAMPLE path.
+	// Differences from the GPU version: history is float instead of half, and the first frame after
+	// construction or Reset replaces the history instead of blending with an empty buffer.
+	class TAAEngine
+	{
+	public:
+		// Upsample factors 1, 2 and 4 are supported
+		explicit TAAEngine(int upsample_factor, const TAAFeatures& features = TAAFeatures());
+
+		// Pixels with zero motion are reprojected with clip_to_prev_clip, a row major 4x4 matrix
+		// applied like mul(clip_position, clip_to_prev_frame_clip_matrix). nullptr is the identity,
+		// which fits data sets whose motion vectors already hold the camera motion
+		void Execute(const DLTUSFrame& frame, ThreadPool& pool, const float* clip_to_prev_clip = nullptr);
+
+		// { 1, H, W, 3 } result of the last Execute, valid until the next call
+		const Tensor& GetOutput() const { return history[current]; };
+		// The next frame starts a new history
+		void Reset() { has_history = false; };
+
+		void SetFeatures(const TAAFeatures& features) { this->features = features; };
+		const TAAFeatures& GetFeatures() const { return features; };
+		int UpsampleFactor() const { return upsample_factor; };
+		double GetLastSeconds() const { return last_seconds; };
+
+	private:
+		int upsample_factor;
+		TAAFeatures features;
+
+		Tensor history[2];
+		int current = 0;
+		bool has_history = false;
+		double last_seconds = 0.0;
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include "misc/sequences.h"
+
+// Sample position inside a low resolution pixel, in [0, 1)
+struct JitterPoint
+{
+	float x;
+	float y;
+};
+
+// The sequence of Jitter::Halton, as SSAA and TAA sample it
+inline std::vector<JitterPoint> HaltonJitterPoints(int base1, int base2, int count)
+{
+	const auto seq1 = emisc::HaltonSequence(base1, count);
+	const auto seq2 = emisc::HaltonSequence(base2, count);
+	std::vector<JitterPoint> out(count);
+	for (int i = 0; i < count; i++)
+		out[i] = { seq1[i], seq2[i] };
+	return out;
+}
+
+// The sequences of Jitter::Custom, kept free of DirectXMath so the CPU tools write the same
+// jitter as DatasetGenerator. Factor 4 visits every pixel of the 4x4 high resolution block,
+// factor 2 every pixel of the 2x2 block with a Halton offset inside it
+inline std::vector<JitterPoint> CustomJitterPoints(int factor)
+{
+	if (factor == 4)
+	{
+		static const int cells[16][2] =
+		{
+			{ 2, 1 }, { 0, 2 }, { 2, 3 }, { 0, 0 }, { 1, 2 }, { 3, 3 }, { 1, 0 }, { 3, 1 },
+			{ 0, 3 }, { 2, 0 }, { 0, 1 }, { 2, 2 }, { 3, 0 }, { 1, 1 }, { 3, 2 }, { 1, 3 },
+		};
+		std::vector<JitterPoint> out(16);
+		for (int i = 0; i < 16; i++)
+			out[i] = { 0.25f * ((float)cells[i][0] + 0.5f), 0.25f * ((float)cells[i][1] + 0.5f) };
+		return out;
+	}
+	else if (factor == 2)
+	{
+		static const int cells[4][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 }, { 1, 0 } };
+		auto seq1 = emisc::HaltonSequence(2, 5);
+		auto seq2 = emisc::HaltonSequence(3, 5);
+		// Each cell cycles through the Halton points 1 to 4, shifted by one every four samples
+		std::vector<JitterPoint> out(16);
+		for (int i = 0; i < 16; i++)
+		{
+			const int halton = 1 + (i % 4 + i / 4) % 4;
+			out[i] = { 0.5f * ((float)cells[i % 4][0] + seq1[halton]), 0.5f * ((float)cells[i % 4][1] + seq2[halton]) };
+		}
+		return out;
+	}
+	throw std::runtime_error("No custom jitter for upsample factor " + std::to_string(factor));
+}
@@ -0,0 +1,42 @@
+#include "batched_evaluator.h"
+#include "cpu/timer.h"
+#include <stdexcept>
+
+ecpu::BatchedEvaluator::BatchedEvaluator(MasterNet& net, int upsample_factor, int batch_size)
+	: batch_size(batch_size), pipeline(net, upsample_factor), frames(std::max(batch_size, 1))
+{
+	if (batch_size < 1)
+		throw std::runtime_error("Batch size must be at least 1");
+}
+
+ecpu::BatchedEvaluator::Stats ecpu::BatchedEvaluator::Run(int sequence_count, int frame_count, const FrameLoader& load, const FrameWriter& write, ThreadPool& pool)
+{
+	Stats stats;
+	Timer timer;
+	for (int first = 0; first < sequence_count; first += batch_size)
+		runBatch(first, std::min(batch_size, sequence_count - first), frame_count, load, write, pool, stats);
+	stats.seconds = timer.Elapsed();
+	return stats;
+}
+
+void ecpu::BatchedEvaluator::runBatch(int first_sequence, int sequences, int frame_count, const FrameLoader& load, const FrameWriter& write, ThreadPool& pool, Stats& stats)
+{
+	for (int f = 0; f < frame_count; f++)
+	{
+		pool.ParallelFor(sequences, [&](int i) { load(first_sequence + i, f, frames[i]); });
+
+		// A new batch starts from an empty history like a freshly created DLTUS
+		if (f == 0)
+			pipeline.Reset();
+		pipeline.Execute(frames.data(), sequences, pool);
+		const DLTUSPipeline::Stats& stages = pipeline.GetLastStats();
+		stats.stages.format_seconds += stages.format_seconds;
+		stats.stages.upsample_seconds += stages.upsample_seconds;
+		stats.stages.init_seconds += stages.init_seconds;
+		stats.stages.network_seconds += stages.network_seconds;
+		stats.stages.finalize_seconds += stages.finalize_seconds;
+
+		pool.ParallelFor(sequences, [&](int i) { write(first_sequence + i, f, pipeline.GetOutput(i)); });
+		stats.frames += sequences;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "cpu_dltus.h"
+
+namespace ecpu
+{
+	// Offline DLTUS evaluation of many independent video sequences. A batch of sequences advances in
+	// lockstep, one frame at a time: every sequence builds its slice of a { N, H / 4, W / 4, 128 } input
+	// from its own history, the network runs once over the whole batch, and every sequence
+	// finalizes its own history. Sequences never see each other's data, so results do not depend
+	// on the batch size.
+	class BatchedEvaluator
+	{
+	public:
+		// Loads a low resolution frame of a sequence, called from worker threads
+		using FrameLoader = std::function<void(int sequence, int frame, DLTUSFrame& out)>;
+		// Receives the { 1, H, W, 4 } upsampled frame of a sequence, called from worker threads
+		using FrameWriter = std::function<void(int sequence, int frame, const Tensor& image)>;
+
+		struct Stats
+		{
+			int frames = 0;
+			double seconds = 0.0;
+			DLTUSPipeline::Stats stages;	// Summed over all frames
+
+			double FramesPerSecond() const { return seconds > 0.0 ? frames / seconds : 0.0; };
+		};
+
+	public:
+		BatchedEvaluator(MasterNet& net, int upsample_factor, int batch_size);
+
+		// Upsamples frames [0, frame_count) of every sequence, batch_size sequences at a time.
+		// All frames must have the same size
+		Stats Run(int sequence_count, int frame_count, const FrameLoader& load, const FrameWriter& write, ThreadPool& pool);
+
+		int BatchSize() const { return batch_size; };
+
+	private:
+		void runBatch(int first_sequence, int sequences, int frame_count, const FrameLoader& load, const FrameWriter& write, ThreadPool& pool, Stats& stats);
+
+	private:
+		int batch_size;
+
+		DLTUSPipeline pipeline;
+		std::vector<DLTUSFrame> frames;
+	};
+}
@@ -0,0 +1,98 @@
+#include "buffer_planner.h"
+#include <algorithm>
+#include <stdexcept>
+
+size_t ecpu::BufferPlan::TotalBytes() const
+{
+	size_t total = 0;
+	for (size_t size : buffer_sizes)
+		total += size;
+	return total;
+}
+
+std::vector<ecpu::TensorLifetime> ecpu::ComputeLifetimes(const std::vector<PlanStep>& steps, const std::vector<size_t>& tensor_bytes)
+{
+	std::vector<TensorLifetime> lifetimes(tensor_bytes.size());
+	for (size_t t = 0; t < tensor_bytes.size(); t++)
+		lifetimes[t].bytes = tensor_bytes[t];
+
+	auto extend = [&](int tensor, int time)
+	{
+		if (tensor < 0 || tensor >= (int)lifetimes.size())
+			throw std::runtime_error("Plan step uses an unknown tensor");
+		TensorLifetime& l = lifetimes[tensor];
+		l.first = l.first < 0 ? time : std::min(l.first, time);
+		l.last = std::max(l.last, time);
+	};
+
+	for (int i = 0; i < (int)steps.size(); i++)
+	{
+		const PlanStep& step = steps[i];
+		for (int in : step.inputs)
+			extend(in, step.elementwise ? 2 * i : 2 * i + 1);
+		extend(step.output, 2 * i + 1);
+	}
+	return lifetimes;
+}
+
+ecpu::BufferPlan ecpu::PlanBuffers(const std::vector<TensorLifetime>& lifetimes)
+{
+	std::vector<int> order;
+	for (int t = 0; t < (int)lifetimes.size(); t++)
+		if (lifetimes[t].Used() && !lifetimes[t].external)
+			order.push_back(t);
+
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+		{
+			if (lifetimes[a].bytes != lifetimes[b].bytes)
+				return lifetimes[a].bytes > lifetimes[b].bytes;
+			return lifetimes[a].first < lifetimes[b].first;
+		});
+
+	BufferPlan plan;
+	plan.tensor_buffers.assign(lifetimes.size(), -1);
+	std::vector<std::vector<int>> buffer_tensors;
+
+	for (int t : order)
+	{
+		int buffer = -1;
+		for (int b = 0; b < (int)buffer_tensors.size() && buffer < 0; b++)
+		{
+			bool free = true;
+			for (int other : buffer_tensors[b])
+				free = free && !lifetimes[t].Overlaps(lifetimes[other]);
+			if (free)
+				buffer = b;
+		}
+
+		if (buffer < 0)
+		{
+			buffer = (int)buffer_tensors.size();
+			buffer_tensors.emplace_back();
+			plan.buffer_sizes.push_back(0);
+		}
+
+		buffer_tensors[buffer].push_back(t);
+		plan.buffer_sizes[buffer] = std::max(plan.buffer_sizes[buffer], lifetimes[t].bytes);
+		plan.tensor_buffers[t] = buffer;
+	}
+	return plan;
+}
+
+size_t ecpu::PeakLiveBytes(const std::vector<TensorLifetime>& lifetimes)
+{
+	int end = 0;
+	for (const auto& l : lifetimes)
+		end = std::max(end, l.last + 1);
+
+	size_t peak = 0;
+	for (int time = 0; time < end; time++)
+	{
+		size_t live = 0;
+		for (const auto& l : lifetimes)
+			if (l.Used() && !l.external && l.first <= time && time <= l.last)
+				live += l.bytes;
+		peak = std::max(peak, live);
+	}
+	return peak;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace ecpu
+{
+	// One operation of a schedule as seen by the planner
+	struct PlanStep
+	{
+		std::vector<int> inputs;	// Tensor indices
+		int output = -1;
+		bool elementwise = false;	// The output may share a buffer with an input read for the last time
+	};
+
+	// Interval of schedule time during which a tensor must stay in memory.
+	// Step i reads its inputs at time 2i and writes its output at 2i + 1. A non element wise step
+	// reads its inputs until its output is complete, so their lifetimes extend to 2i + 1
+	struct TensorLifetime
+	{
+		int first = -1;
+		int last = -1;
+		size_t bytes = 0;
+		bool external = false;		// Bound to a buffer owned by someone else, like the network input
+
+		bool Used() const { return first >= 0; };
+		bool Overlaps(const TensorLifetime& rhs) const { return first <= rhs.last && rhs.first <= last; };
+	};
+
+	struct BufferPlan
+	{
+		std::vector<int> tensor_buffers;	// Buffer of every tensor, -1 for external and unused tensors
+		std::vector<size_t> buffer_sizes;
+
+		size_t TotalBytes() const;
+	};
+
+	// tensor_bytes holds the size of every tensor, its length is the tensor count
+	std::vector<TensorLifetime> ComputeLifetimes(const std::vector<PlanStep>& steps, const std::vector<size_t>& tensor_bytes);
+
+	// Assigns tensors to as little memory as possible by interval coloring. Tensors are placed
+	// largest first into the first buffer whose tensors are all dead during their lifetime, so
+	// small tensors fill the gaps in buffers made for big ones
+	BufferPlan PlanBuffers(const std::vector<TensorLifetime>& lifetimes);
+
+	// Largest sum of live tensor sizes at any point of the schedule, no plan can use less memory
+	size_t PeakLiveBytes(const std::vector<TensorLifetime>& lifetimes);
+}
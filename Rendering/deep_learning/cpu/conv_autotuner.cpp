@@ -0,0 +1,159 @@
+#include "conv_autotuner.h"
+#include "cpu/cpu_info.h"
+#include "cpu/timer.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	const int warmup_runs = 1;
+	const int timed_runs = 2;
+	const int band_heights[] = { 2, 4, 8, 16 };
+
+	// Tabs separate the fields of a cache line, so they can not appear in the CPU name
+	std::string cacheName(std::string name)
+	{
+		std::replace(name.begin(), name.end(), '\t', ' ');
+		return name;
+	}
+
+	std::string shapeKey(const ecpu::ConvWeights& w, const ecpu::TensorShape& s, int threads)
+	{
+		std::ostringstream key;
+		key << s.n << ' ' << s.c << ' ' << s.h << ' ' << s.w << ' ' << w.OutputChannels() << ' '
+			<< w.FilterSize() << ' ' << w.FilterSize() << ' ' << w.Stride() << ' ' << threads;
+		return key.str();
+	}
+
+	bool parseAlgorithm(const std::string& name, ecpu::ConvAlgorithm& algorithm)
+	{
+		const ecpu::ConvAlgorithm all[] = { ecpu::ConvAlgorithm::Direct, ecpu::ConvAlgorithm::Im2colGemm, ecpu::ConvAlgorithm::Winograd };
+		for (auto a : all)
+		{
+			if (name == ecpu::ConvAlgorithmName(a))
+			{
+				algorithm = a;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void fillRandom(ecpu::Tensor& tensor)
+	{
+		unsigned int state = 12345u;
+		float* data = tensor.Data();
+		for (size_t i = 0; i < tensor.ElementCount(); i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			data[i] = (float)(state >> 8) / (float)(1 << 24) - 0.5f;
+		}
+	}
+}
+
+ecpu::ConvAutotuner::ConvAutotuner(const std::string& cache_path)
+	: cache_path(cache_path), cpu_model(cacheName(CpuModelName()))
+{
+	load();
+}
+
+std::vector<ecpu::ConvConfig> ecpu::ConvAutotuner::Candidates(const ConvWeights& weights)
+{
+	std::vector<ConvAlgorithm> algorithms = { ConvAlgorithm::Direct, ConvAlgorithm::Im2colGemm };
+	if (weights.SupportsWinograd())
+		algorithms.push_back(ConvAlgorithm::Winograd);
+
+	std::vector<ConvConfig> candidates;
+	for (auto algorithm : algorithms)
+	{
+		for (int rows : band_heights)
+		{
+			ConvConfig config;
+			config.algorithm = algorithm;
+			config.rows_per_task = rows;
+			candidates.push_back(config);
+		}
+	}
+	return candidates;
+}
+
+ecpu::ConvConfig ecpu::ConvAutotuner::Tune(const ConvWeights& weights, bool relu, const TensorShape& input_shape, ThreadPool& pool)
+{
+	const std::string key = shapeKey(weights, input_shape, pool.ThreadCount());
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		cache_hits++;
+		return it->second.config;
+	}
+
+	Tensor input(input_shape);
+	fillRandom(input);
+	Tensor output;
+
+	Entry best;
+	best.microseconds = std::numeric_limits<double>::max();
+	for (const auto& config : Candidates(weights))
+	{
+		double seconds = std::numeric_limits<double>::max();
+		for (int i = 0; i < warmup_runs + timed_runs; i++)
+		{
+			Timer timer;
+			Convolve(input, weights, relu, output, pool, config);
+			if (i >= warmup_runs)
+				seconds = std::min(seconds, timer.Elapsed());
+		}
+		if (seconds * 1e6 < best.microseconds)
+		{
+			best.config = config;
+			best.microseconds = seconds * 1e6;
+		}
+	}
+
+	entries[key] = best;
+	tuned_shapes++;
+	save();
+	return best.config;
+}
+
+void ecpu::ConvAutotuner::load()
+{
+	std::ifstream file(cache_path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// cpu \t shape \t algorithm rows_per_task microseconds
+		size_t tab0 = line.find('\t');
+		size_t tab1 = tab0 == std::string::npos ? tab0 : line.find('\t', tab0 + 1);
+		if (tab1 == std::string::npos)
+			continue;
+		if (line.compare(0, tab0, cpu_model) != 0)
+		{
+			foreign_lines.push_back(line);
+			continue;
+		}
+
+		std::istringstream result(line.substr(tab1 + 1));
+		std::string algorithm;
+		Entry entry;
+		if (!(result >> algorithm >> entry.config.rows_per_task >> entry.microseconds)
+			|| !parseAlgorithm(algorithm, entry.config.algorithm) || entry.config.rows_per_task < 1)
+			continue;
+		entries[line.substr(tab0 + 1, tab1 - tab0 - 1)] = entry;
+	}
+}
+
+void ecpu::ConvAutotuner::save() const
+{
+	// A cache that can not be written only costs the next run a new measurement
+	std::ofstream file(cache_path);
+	if (!file)
+		return;
+	for (const auto& line : foreign_lines)
+		file << line << '\n';
+	for (const auto& entry : entries)
+		file << cpu_model << '\t' << entry.first << '\t' << ConvAlgorithmName(entry.second.config.algorithm) << ' '
+			<< entry.second.config.rows_per_task << ' ' << entry.second.microseconds << '\n';
+}
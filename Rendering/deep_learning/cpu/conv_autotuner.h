@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include "cpu_conv.h"
+
+namespace ecpu
+{
+	// Picks the fastest ConvConfig for each convolution shape on this machine. The first time a
+	// shape is seen every candidate algorithm and band height is timed on random input, and the
+	// winner is written to a plain text cache. Entries are keyed by the CPU model and the shape
+	// (N, C, H, W, K, R, S, stride and thread count), so later runs on the same machine skip the
+	// measurements and a cache copied to another machine is ignored.
+	class ConvAutotuner
+	{
+	public:
+		// Loads the cache if it exists, a missing or unreadable file starts an empty cache
+		explicit ConvAutotuner(const std::string& cache_path = DefaultCachePath());
+
+		// Cached winner for convolving an input of input_shape with weights, timed and saved on a miss
+		ConvConfig Tune(const ConvWeights& weights, bool relu, const TensorShape& input_shape, ThreadPool& pool);
+
+		// Configurations Tune chooses between for weights
+		static std::vector<ConvConfig> Candidates(const ConvWeights& weights);
+		static std::string DefaultCachePath() { return "conv_tuning.txt"; };
+
+		int CacheHits() const { return cache_hits; };
+		int TunedShapes() const { return tuned_shapes; };
+		const std::string& CachePath() const { return cache_path; };
+
+	private:
+		struct Entry
+		{
+			ConvConfig config;
+			double microseconds = 0.0;
+		};
+
+		void load();
+		void save() const;
+
+	private:
+		std::string cache_path;
+		std::string cpu_model;
+		std::map<std::string, Entry> entries;		// Shapes tuned on this CPU
+		std::vector<std::string> foreign_lines;	// Cache lines of other CPUs, kept when saving
+		int cache_hits = 0;
+		int tuned_shapes = 0;
+	};
+}
@@ -0,0 +1,613 @@
+#include "cpu_conv.h"
+#include "cpu/simd.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// Output pixels packed into one im2col matrix
+	const int im2col_pixels = 64;
+	// Winograd tiles transformed and multiplied together
+	const int winograd_tiles = 16;
+
+	// Integer division rounding towards -inf and +inf, b must be positive
+	inline int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+	inline int ceilDiv(int a, int b) { return -floorDiv(-a, b); }
+	// Coordinate of the pixel replicate padding reads, the nearest one of [begin, begin + size)
+	inline int clampToWindow(int v, int begin, int size) { return std::min(std::max(v, begin), begin + size - 1); }
+
+	// Accumulates PX horizontally adjacent output pixels starting at (oy, ox) for the
+	// output channels [cout_offset, cout_offset + 8 * CV). CHECK_X enables per tap bounds
+	// checks in x and is only used for pixels near the edge of the input window. Taps outside the
+	// window are skipped with zero padding and read the nearest pixel with replicate padding.
+	// The accumulation order (ky, kx, input channel) is the same for every path, so a pixel
+	// gets bit identical results no matter how the frame is split into tiles.
+	template <int CV, int PX, bool CHECK_X>
+	inline void convolvePixels(const ecpu::ConvWeights& w, const ecpu::PlaneView& in, int oy, int ox, int cout_offset, ecpu::float8(&acc)[PX][CV])
+	{
+		const int k = w.FilterSize();
+		const int s = w.Stride();
+		const int cin = w.InputChannels();
+		const int cp = w.PaddedOutputChannels();
+		const ptrdiff_t px_step = (ptrdiff_t)s * in.pixel_stride;
+
+		const bool replicate = w.ReplicatePadding();
+		int iy_base = oy * s - w.Padding();
+		int ix_base = ox * s - w.Padding();
+		int ky_begin = replicate ? 0 : std::max(0, in.y0 - iy_base);
+		int ky_end = replicate ? k : std::min(k, in.y0 + in.height - iy_base);
+		int kx_begin = CHECK_X && !replicate ? std::max(0, in.x0 - ix_base) : 0;
+		int kx_end = CHECK_X && !replicate ? std::min(k, in.x0 + in.width - ix_base) : k;
+
+		for (int ky = ky_begin; ky < ky_end; ky++)
+		{
+			const int iy = replicate ? clampToWindow(iy_base + ky, in.y0, in.height) : iy_base + ky;
+			for (int kx = kx_begin; kx < kx_end; kx++)
+			{
+				const int ix = CHECK_X && replicate ? clampToWindow(ix_base + kx, in.x0, in.width) : ix_base + kx;
+				const float* px = in.At(iy, ix);
+				const float* f = w.Filter() + (size_t)(ky * k + kx) * cin * cp + cout_offset;
+				for (int ci = 0; ci < cin; ci++)
+				{
+					ecpu::float8 wv[CV];
+					for (int v = 0; v < CV; v++)
+						wv[v] = ecpu::float8::Load(f + v * 8);
+					for (int p = 0; p < PX; p++)
+					{
+						ecpu::float8 b = ecpu::float8::Set(px[p * px_step + ci]);
+						for (int v = 0; v < CV; v++)
+							acc[p][v] = ecpu::float8::MulAdd(b, wv[v], acc[p][v]);
+					}
+					f += cp;
+				}
+			}
+		}
+	}
+
+	template <int CV, int PX>
+	inline void storePixels(const ecpu::ConvWeights& w, bool relu, const ecpu::PlaneView* residual, const ecpu::PlaneView& out,
+		int oy, int ox, int cout_offset, ecpu::float8(&acc)[PX][CV])
+	{
+		int channels = std::min(CV * 8, w.OutputChannels() - cout_offset);
+		for (int p = 0; p < PX; p++)
+		{
+			if (relu)
+				for (int v = 0; v < CV; v++)
+					acc[p][v] = ecpu::float8::Max(acc[p][v], ecpu::float8::Zero());
+
+			float* dst = out.At(oy, ox + p) + cout_offset;
+			const float* res = residual ? residual->At(oy, ox + p) + cout_offset : nullptr;
+			if (channels == CV * 8)
+			{
+				for (int v = 0; v < CV; v++)
+				{
+					if (res)
+						acc[p][v] += ecpu::float8::Load(res + v * 8);
+					acc[p][v].Store(dst + v * 8);
+				}
+			}
+			else
+			{
+				// Odd channel counts go through a small buffer so we never write past the pixel
+				float temp[CV * 8];
+				for (int v = 0; v < CV; v++)
+					acc[p][v].Store(temp + v * 8);
+				for (int c = 0; c < channels; c++)
+					dst[c] = res ? temp[c] + res[c] : temp[c];
+			}
+		}
+	}
+
+	template <int CV, int PX>
+	void convolveRows(const ecpu::PlaneView& in, const ecpu::ConvWeights& w, bool relu, const ecpu::PlaneView* residual,
+		const ecpu::PlaneView& out, int oy0, int oy1, int ox0, int ox1, int cout_offset)
+	{
+		const int k = w.FilterSize();
+		const int s = w.Stride();
+		const int pad = w.Padding();
+
+		// Output columns whose taps all lie inside the input window in x
+		int fast_x0 = std::max(ceilDiv(in.x0 + pad, s), ox0);
+		int fast_x1 = std::min(floorDiv(in.x0 + in.width - k + pad, s) + 1, ox1);
+
+		ecpu::float8 bias[CV];
+		for (int v = 0; v < CV; v++)
+			bias[v] = ecpu::float8::Load(w.Bias() + cout_offset + v * 8);
+
+		for (int oy = oy0; oy < oy1; oy++)
+		{
+			int ox = ox0;
+			while (ox < ox1)
+			{
+				if (ox >= fast_x0 && ox + PX <= fast_x1)
+				{
+					ecpu::float8 acc[PX][CV];
+					for (int p = 0; p < PX; p++)
+						for (int v = 0; v < CV; v++)
+							acc[p][v] = bias[v];
+					convolvePixels<CV, PX, false>(w, in, oy, ox, cout_offset, acc);
+					storePixels<CV, PX>(w, relu, residual, out, oy, ox, cout_offset, acc);
+					ox += PX;
+				}
+				else
+				{
+					ecpu::float8 acc[1][CV];
+					for (int v = 0; v < CV; v++)
+						acc[0][v] = bias[v];
+					if (ox >= fast_x0 && ox < fast_x1)
+						convolvePixels<CV, 1, false>(w, in, oy, ox, cout_offset, acc);
+					else
+						convolvePixels<CV, 1, true>(w, in, oy, ox, cout_offset, acc);
+					storePixels<CV, 1>(w, relu, residual, out, oy, ox, cout_offset, acc);
+					ox += 1;
+				}
+			}
+		}
+	}
+
+	// acc[p] += sum over k of a[p * a_stride + k] * b[k * b_stride + 8 * v], the matrix product both
+	// im2col and Winograd reduce to
+	template <int CV, int PX>
+	inline void gemmPixels(const float* a, size_t a_stride, int depth, const float* b, size_t b_stride, ecpu::float8(&acc)[PX][CV])
+	{
+		for (int k = 0; k < depth; k++)
+		{
+			ecpu::float8 wv[CV];
+			for (int v = 0; v < CV; v++)
+				wv[v] = ecpu::float8::Load(b + v * 8);
+			for (int p = 0; p < PX; p++)
+			{
+				ecpu::float8 x = ecpu::float8::Set(a[p * a_stride + k]);
+				for (int v = 0; v < CV; v++)
+					acc[p][v] = ecpu::float8::MulAdd(x, wv[v], acc[p][v]);
+			}
+			b += b_stride;
+		}
+	}
+
+	// One row of im2col patches times the filter, written to the output row
+	template <int CV, int PX>
+	void gemmRow(const float* patches, int count, const ecpu::ConvWeights& w, bool relu, const ecpu::PlaneView& out, int oy, int ox0, int cout_offset)
+	{
+		const int depth = w.FilterSize() * w.FilterSize() * w.InputChannels();
+		const float* filter = w.Filter() + cout_offset;
+		ecpu::float8 bias[CV];
+		for (int v = 0; v < CV; v++)
+			bias[v] = ecpu::float8::Load(w.Bias() + cout_offset + v * 8);
+
+		int p = 0;
+		for (; p + PX <= count; p += PX)
+		{
+			ecpu::float8 acc[PX][CV];
+			for (int i = 0; i < PX; i++)
+				for (int v = 0; v < CV; v++)
+					acc[i][v] = bias[v];
+			gemmPixels<CV, PX>(patches + (size_t)p * depth, depth, depth, filter, w.PaddedOutputChannels(), acc);
+			storePixels<CV, PX>(w, relu, nullptr, out, oy, ox0 + p, cout_offset, acc);
+		}
+		for (; p < count; p++)
+		{
+			ecpu::float8 acc[1][CV];
+			for (int v = 0; v < CV; v++)
+				acc[0][v] = bias[v];
+			gemmPixels<CV, 1>(patches + (size_t)p * depth, depth, depth, filter, w.PaddedOutputChannels(), acc);
+			storePixels<CV, 1>(w, relu, nullptr, out, oy, ox0 + p, cout_offset, acc);
+		}
+	}
+
+	// Products of the transformed input tiles with the transformed filter at one of the 16 positions
+	template <int CV, int PX>
+	void winogradProducts(const float* v_tiles, int tiles, int cin, const float* u, int cp, float* m)
+	{
+		int t = 0;
+		for (; t < tiles; t += PX)
+		{
+			const int count = std::min(PX, tiles - t);
+			ecpu::float8 acc[PX][CV];
+			for (int i = 0; i < PX; i++)
+				for (int v = 0; v < CV; v++)
+					acc[i][v] = ecpu::float8::Zero();
+			if (count == PX)
+			{
+				gemmPixels<CV, PX>(v_tiles + (size_t)t * cin, cin, cin, u, cp, acc);
+			}
+			else
+			{
+				for (int i = 0; i < count; i++)
+				{
+					ecpu::float8 single[1][CV];
+					for (int v = 0; v < CV; v++)
+						single[0][v] = ecpu::float8::Zero();
+					gemmPixels<CV, 1>(v_tiles + (size_t)(t + i) * cin, cin, cin, u, cp, single);
+					for (int v = 0; v < CV; v++)
+						acc[i][v] = single[0][v];
+				}
+			}
+			for (int i = 0; i < count; i++)
+				for (int v = 0; v < CV; v++)
+					acc[i][v].Store(m + (size_t)(t + i) * cp + v * 8);
+		}
+	}
+
+	// Reads 8 channels of a pixel, the ones past the channels the pixel has are zero
+	inline ecpu::float8 loadChannels(const float* src, int channels)
+	{
+		if (channels >= 8)
+			return ecpu::float8::Load(src);
+		float temp[8] = {};
+		for (int c = 0; c < channels; c++)
+			temp[c] = src[c];
+		return ecpu::float8::Load(temp);
+	}
+
+	// Writes 8 output channels of a pixel, never past the channels the pixel has
+	inline void storeChannels(ecpu::float8 value, bool relu, float* dst, int channels)
+	{
+		if (relu)
+			value = ecpu::float8::Max(value, ecpu::float8::Zero());
+		if (channels >= 8)
+		{
+			value.Store(dst);
+		}
+		else
+		{
+			float temp[8];
+			value.Store(temp);
+			for (int c = 0; c < channels; c++)
+				dst[c] = temp[c];
+		}
+	}
+}
+
+const char* ecpu::ConvAlgorithmName(ConvAlgorithm algorithm)
+{
+	switch (algorithm)
+	{
+	case ConvAlgorithm::Im2colGemm: return "im2col";
+	case ConvAlgorithm::Winograd: return "winograd";
+	default: return "direct";
+	}
+}
+
+int ecpu::ConvPadding(int filter_size, int stride)
+{
+	return (int)std::ceil((filter_size / stride - 1) / 2.0f);
+}
+
+ecpu::ConvWeights::ConvWeights(const std::vector<float>& weights, const std::vector<float>& bias,
+	int output_channels, int input_channels, int filter_size, int stride, int padding, bool replicate_padding)
+	: output_channels(output_channels), input_channels(input_channels), filter_size(filter_size), stride(stride), replicate_padding(replicate_padding)
+{
+	if (weights.size() != (size_t)output_channels * input_channels * filter_size * filter_size)
+		throw std::runtime_error("Convolution weight count does not match layer shape");
+	if (bias.size() != (size_t)output_channels)
+		throw std::runtime_error("Convolution bias count does not match layer shape");
+
+	this->padding = padding >= 0 ? padding : ConvPadding(filter_size, stride);
+	padded_output_channels = (output_channels + 7) / 8 * 8;
+
+	filter.assign((size_t)filter_size * filter_size * input_channels * padded_output_channels, 0.0f);
+	for (int o = 0; o < output_channels; o++)
+		for (int i = 0; i < input_channels; i++)
+			for (int y = 0; y < filter_size; y++)
+				for (int x = 0; x < filter_size; x++)
+					filter[((size_t)(y * filter_size + x) * input_channels + i) * padded_output_channels + o] =
+						weights[(((size_t)o * input_channels + i) * filter_size + y) * filter_size + x];
+
+	this->bias.assign(padded_output_channels, 0.0f);
+	for (int o = 0; o < output_channels; o++)
+		this->bias[o] = bias[o];
+
+	if (filter_size == 3 && stride == 1 && this->padding == 1)
+	{
+		// U = G g G^T for every filter g, with zero filters for the input channels padding to a multiple of 8
+		const int winograd_channels = (input_channels + 7) & ~7;
+		const float G[4][3] = { { 1.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } };
+		winograd_filter.assign((size_t)16 * winograd_channels * padded_output_channels, 0.0f);
+		for (int o = 0; o < output_channels; o++)
+		{
+			for (int i = 0; i < input_channels; i++)
+			{
+				const float* g = &weights[((size_t)o * input_channels + i) * 9];
+				float gg[4][3];
+				for (int a = 0; a < 4; a++)
+					for (int x = 0; x < 3; x++)
+						gg[a][x] = G[a][0] * g[x] + G[a][1] * g[3 + x] + G[a][2] * g[6 + x];
+				for (int a = 0; a < 4; a++)
+					for (int b = 0; b < 4; b++)
+						winograd_filter[((size_t)(a * 4 + b) * winograd_channels + i) * padded_output_channels + o] =
+							gg[a][0] * G[b][0] + gg[a][1] * G[b][1] + gg[a][2] * G[b][2];
+			}
+		}
+	}
+}
+
+std::vector<float> ecpu::PixelUnshuffleFilter(const std::vector<float>& weights, int output_channels, int input_channels, int filter_size, int r)
+{
+	std::vector<float> out(weights.size());
+	int out_size = filter_size / r;
+	int out_channels_in = input_channels * r * r;
+	for (int o = 0; o < output_channels; o++)
+		for (int i = 0; i < input_channels; i++)
+			for (int y = 0; y < filter_size; y++)
+				for (int x = 0; x < filter_size; x++)
+				{
+					int out_i = i * r * r + (y % r) * r + (x % r);
+					out[(((size_t)o * out_channels_in + out_i) * out_size + y / r) * out_size + x / r] =
+						weights[(((size_t)o * input_channels + i) * filter_size + y) * filter_size + x];
+				}
+	return out;
+}
+
+std::vector<float> ecpu::PixelShuffleFilter(const std::vector<float>& weights, int output_channels, int input_channels, int filter_size, int r)
+{
+	std::vector<float> out(weights.size());
+	int out_size = filter_size * r;
+	int out_channels_in = input_channels / (r * r);
+	for (int o = 0; o < output_channels; o++)
+		for (int i = 0; i < out_channels_in; i++)
+			for (int y = 0; y < out_size; y++)
+				for (int x = 0; x < out_size; x++)
+				{
+					int in_i = PixelUnshuffleChannel(i, x % r, y % r, r);
+					out[(((size_t)o * out_channels_in + i) * out_size + y) * out_size + x] =
+						weights[(((size_t)o * input_channels + in_i) * filter_size + y / r) * filter_size + x / r];
+				}
+	return out;
+}
+
+void ecpu::Convolve(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView* residual,
+	const PlaneView& out, int oy0, int oy1, int ox0, int ox1)
+{
+	for (int cout_offset = 0; cout_offset < weights.PaddedOutputChannels(); cout_offset += 32)
+	{
+		switch (std::min(4, (weights.PaddedOutputChannels() - cout_offset) / 8))
+		{
+		case 1: convolveRows<1, 8>(in, weights, relu, residual, out, oy0, oy1, ox0, ox1, cout_offset); break;
+		case 2: convolveRows<2, 6>(in, weights, relu, residual, out, oy0, oy1, ox0, ox1, cout_offset); break;
+		case 3: convolveRows<3, 4>(in, weights, relu, residual, out, oy0, oy1, ox0, ox1, cout_offset); break;
+		default: convolveRows<4, 3>(in, weights, relu, residual, out, oy0, oy1, ox0, ox1, cout_offset); break;
+		}
+	}
+}
+
+void ecpu::ConvolveIm2col(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView& out, int oy0, int oy1, int ox0, int ox1)
+{
+	const int k = weights.FilterSize();
+	const int s = weights.Stride();
+	const int pad = weights.Padding();
+	const int cin = weights.InputChannels();
+	const int depth = k * k * cin;
+	std::vector<float> patches((size_t)im2col_pixels * depth);
+
+	for (int oy = oy0; oy < oy1; oy++)
+	{
+		for (int x0 = ox0; x0 < ox1; x0 += im2col_pixels)
+		{
+			// Every row holds the taps of one output pixel in the (ky, kx, channel) order of the filter
+			const int count = std::min(im2col_pixels, ox1 - x0);
+			for (int p = 0; p < count; p++)
+			{
+				for (int ky = 0; ky < k; ky++)
+				{
+					const int iy = oy * s - pad + ky;
+					for (int kx = 0; kx < k; kx++)
+					{
+						const int ix = (x0 + p) * s - pad + kx;
+						float* dst = &patches[(size_t)p * depth + (ky * k + kx) * cin];
+						if (iy >= in.y0 && iy < in.y0 + in.height && ix >= in.x0 && ix < in.x0 + in.width)
+							std::memcpy(dst, in.At(iy, ix), cin * sizeof(float));
+						else if (weights.ReplicatePadding())
+							std::memcpy(dst, in.At(clampToWindow(iy, in.y0, in.height), clampToWindow(ix, in.x0, in.width)), cin * sizeof(float));
+						else
+							std::fill(dst, dst + cin, 0.0f);
+					}
+				}
+			}
+
+			for (int cout_offset = 0; cout_offset < weights.PaddedOutputChannels(); cout_offset += 32)
+			{
+				switch (std::min(4, (weights.PaddedOutputChannels() - cout_offset) / 8))
+				{
+				case 1: gemmRow<1, 8>(patches.data(), count, weights, relu, out, oy, x0, cout_offset); break;
+				case 2: gemmRow<2, 6>(patches.data(), count, weights, relu, out, oy, x0, cout_offset); break;
+				case 3: gemmRow<3, 4>(patches.data(), count, weights, relu, out, oy, x0, cout_offset); break;
+				default: gemmRow<4, 3>(patches.data(), count, weights, relu, out, oy, x0, cout_offset); break;
+				}
+			}
+		}
+	}
+}
+
+void ecpu::ConvolveWinograd(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView& out, int oy0, int oy1, int ox0, int ox1)
+{
+	if (!weights.SupportsWinograd())
+		throw std::runtime_error("Winograd needs a 3x3 stride 1 convolution");
+
+	// Odd input channel counts are transformed as zeros up to the next multiple of 8
+	const int cin = (weights.InputChannels() + 7) & ~7;
+	const int cp = weights.PaddedOutputChannels();
+	std::vector<float> v_tiles((size_t)16 * winograd_tiles * cin);
+	std::vector<float> m_tiles((size_t)16 * winograd_tiles * cp);
+
+	for (int ty = oy0; ty < oy1; ty += 2)
+	{
+		for (int tx0 = ox0; tx0 < ox1; tx0 += 2 * winograd_tiles)
+		{
+			const int tiles = std::min(winograd_tiles, (ox1 - tx0 + 1) / 2);
+
+			// Input transform V = B^T d B of the 4x4 input patch of every 2x2 output tile
+			for (int t = 0; t < tiles; t++)
+			{
+				const int iy0 = ty - 1;
+				const int ix0 = tx0 + 2 * t - 1;
+				for (int c = 0; c < cin; c += 8)
+				{
+					float8 d[4][4];
+					for (int i = 0; i < 4; i++)
+					{
+						const int iy = iy0 + i;
+						const bool row_inside = iy >= in.y0 && iy < in.y0 + in.height;
+						for (int j = 0; j < 4; j++)
+						{
+							const int ix = ix0 + j;
+							if (row_inside && ix >= in.x0 && ix < in.x0 + in.width)
+								d[i][j] = loadChannels(in.At(iy, ix) + c, weights.InputChannels() - c);
+							else if (weights.ReplicatePadding())
+								d[i][j] = loadChannels(in.At(clampToWindow(iy, in.y0, in.height), clampToWindow(ix, in.x0, in.width)) + c, weights.InputChannels() - c);
+							else
+								d[i][j] = float8::Zero();
+						}
+					}
+
+					float8 r[4][4];
+					for (int j = 0; j < 4; j++)
+					{
+						r[0][j] = d[0][j] - d[2][j];
+						r[1][j] = d[1][j] + d[2][j];
+						r[2][j] = d[2][j] - d[1][j];
+						r[3][j] = d[1][j] - d[3][j];
+					}
+					for (int i = 0; i < 4; i++)
+					{
+						float8 v[4] = { r[i][0] - r[i][2], r[i][1] + r[i][2], r[i][2] - r[i][1], r[i][1] - r[i][3] };
+						for (int j = 0; j < 4; j++)
+							v[j].Store(&v_tiles[((size_t)(i * 4 + j) * winograd_tiles + t) * cin + c]);
+					}
+				}
+			}
+
+			// Sixteen independent products M = V U, one per position of the transformed tile
+			for (int pos = 0; pos < 16; pos++)
+			{
+				const float* v = &v_tiles[(size_t)pos * winograd_tiles * cin];
+				float* m = &m_tiles[(size_t)pos * winograd_tiles * cp];
+				for (int cout_offset = 0; cout_offset < cp; cout_offset += 32)
+				{
+					const float* u = weights.WinogradFilter() + (size_t)pos * cin * cp + cout_offset;
+					switch (std::min(4, (cp - cout_offset) / 8))
+					{
+					case 1: winogradProducts<1, 8>(v, tiles, cin, u, cp, m + cout_offset); break;
+					case 2: winogradProducts<2, 6>(v, tiles, cin, u, cp, m + cout_offset); break;
+					case 3: winogradProducts<3, 4>(v, tiles, cin, u, cp, m + cout_offset); break;
+					default: winogradProducts<4, 3>(v, tiles, cin, u, cp, m + cout_offset); break;
+					}
+				}
+			}
+
+			// Output transform Y = A^T M A plus the bias
+			for (int t = 0; t < tiles; t++)
+			{
+				const int ox = tx0 + 2 * t;
+				for (int c = 0; c < cp; c += 8)
+				{
+					float8 m[4][4];
+					for (int pos = 0; pos < 16; pos++)
+						m[pos / 4][pos % 4] = float8::Load(&m_tiles[((size_t)pos * winograd_tiles + t) * cp + c]);
+
+					float8 rows[2][4];
+					for (int j = 0; j < 4; j++)
+					{
+						rows[0][j] = m[0][j] + m[1][j] + m[2][j];
+						rows[1][j] = m[1][j] - m[2][j] - m[3][j];
+					}
+					const float8 bias = float8::Load(weights.Bias() + c);
+					const int channels = weights.OutputChannels() - c;
+					for (int a = 0; a < 2 && ty + a < oy1; a++)
+					{
+						const float8 y[2] = { rows[a][0] + rows[a][1] + rows[a][2] + bias, rows[a][1] - rows[a][2] - rows[a][3] + bias };
+						for (int b = 0; b < 2 && ox + b < ox1; b++)
+							storeChannels(y[b], relu, out.At(ty + a, ox + b) + c, channels);
+					}
+				}
+			}
+		}
+	}
+}
+
+void ecpu::Convolve(const Tensor& in, const ConvWeights& weights, bool relu, Tensor& out, ThreadPool& pool, const ConvConfig& config)
+{
+	Convolve(NHWCView(in), weights, relu, out, pool, config);
+}
+
+void ecpu::Convolve(const LayoutView& in, const ConvWeights& weights, bool relu, Tensor& out, ThreadPool& pool, const ConvConfig& config)
+{
+	if (!in.IsPlane())
+	{
+		Tensor temp;
+		Materialize(in, temp, pool);
+		Convolve(temp, weights, relu, out, pool, config);
+		return;
+	}
+	if (in.shape.c != weights.InputChannels())
+		throw std::runtime_error("Convolution input has the wrong channel count");
+	if (config.algorithm == ConvAlgorithm::Winograd && !weights.SupportsWinograd())
+		throw std::runtime_error("Winograd needs a 3x3 stride 1 convolution");
+
+	out.Resize(weights.OutputShape(in.shape));
+	const TensorShape& shape = out.Shape();
+	// Winograd tiles are two rows high
+	int rows_per_task = std::max(1, config.rows_per_task);
+	if (config.algorithm == ConvAlgorithm::Winograd)
+		rows_per_task += rows_per_task % 2;
+	int bands = (shape.h + rows_per_task - 1) / rows_per_task;
+
+	pool.ParallelFor(shape.n * bands, [&](int task)
+		{
+			int n = task / bands;
+			int oy0 = (task % bands) * rows_per_task;
+			int oy1 = std::min(shape.h, oy0 + rows_per_task);
+			switch (config.algorithm)
+			{
+			case ConvAlgorithm::Im2colGemm: ConvolveIm2col(in.Plane(n), weights, relu, out.Plane(n), oy0, oy1, 0, shape.w); break;
+			case ConvAlgorithm::Winograd: ConvolveWinograd(in.Plane(n), weights, relu, out.Plane(n), oy0, oy1, 0, shape.w); break;
+			default: Convolve(in.Plane(n), weights, relu, nullptr, out.Plane(n), oy0, oy1, 0, shape.w); break;
+			}
+		});
+}
+
+void ecpu::Add(const Tensor& a, const Tensor& b, Tensor& out, ThreadPool& pool)
+{
+	if (a.Shape() != b.Shape())
+		throw std::runtime_error("Add layer inputs have different shapes");
+
+	out.Resize(a.Shape());
+	const size_t count = a.ElementCount();
+	const size_t chunk = 1 << 16;
+	int tasks = (int)((count + chunk - 1) / chunk);
+
+	pool.ParallelFor(tasks, [&](int task)
+		{
+			size_t begin = task * chunk;
+			size_t end = std::min(count, begin + chunk);
+			const float* pa = a.Data();
+			const float* pb = b.Data();
+			float* po = out.Data();
+			size_t i = begin;
+			for (; i + 8 <= end; i += 8)
+				(float8::Load(pa + i) + float8::Load(pb + i)).Store(po + i);
+			for (; i < end; i++)
+				po[i] = pa[i] + pb[i];
+		});
+}
+
+void ecpu::Add(const PlaneView& a, const PlaneView& b, const PlaneView& out, int y0, int y1, int x0, int x1)
+{
+	const int channels = out.channels;
+	for (int y = y0; y < y1; y++)
+	{
+		for (int x = x0; x < x1; x++)
+		{
+			const float* pa = a.At(y, x);
+			const float* pb = b.At(y, x);
+			float* po = out.At(y, x);
+			int c = 0;
+			for (; c + 8 <= channels; c += 8)
+				(float8::Load(pa + c) + float8::Load(pb + c)).Store(po + c);
+			for (; c < channels; c++)
+				po[c] = pa[c] + pb[c];
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include "cpu/tensor.h"
+#include "cpu/thread_pool.h"
+#include "cpu/layout.h"
+
+namespace ecpu
+{
+	// Padding and output size of a convolution with the rule used by egx::ConvLayer
+	int ConvPadding(int filter_size, int stride);
+	inline int ConvOutputSize(int input_size, int filter_size, int stride)
+	{
+		return (input_size + 2 * ConvPadding(filter_size, stride) - filter_size) / stride + 1;
+	}
+
+	// Convolution filter and bias repacked for the CPU kernels.
+	// The filter is stored as [ky][kx][input channel][output channel] with the output
+	// channels padded to a multiple of 8, so one broadcast input value feeds whole vectors.
+	// Any channel count works, but the kernels compute whole vectors, so a layer of 13
+	// channels costs as much as one of 16. utils.PruneMasterModel rounds its widths up to match
+	class ConvWeights
+	{
+	public:
+		ConvWeights() {};
+		// weights are in PyTorch layout [output][input][ky][kx].
+		// A negative padding uses the same rule as egx::ConvLayer. With replicate_padding the border
+		// is padded with the nearest edge pixel, PyTorch's padding_mode='replicate', instead of zeros
+		ConvWeights(const std::vector<float>& weights, const std::vector<float>& bias,
+			int output_channels, int input_channels, int filter_size, int stride = 1, int padding = -1, bool replicate_padding = false);
+
+		inline int OutputChannels() const { return output_channels; };
+		inline int PaddedOutputChannels() const { return padded_output_channels; };
+		inline int InputChannels() const { return input_channels; };
+		inline int FilterSize() const { return filter_size; };
+		inline int Stride() const { return stride; };
+		inline int Padding() const { return padding; };
+		inline bool ReplicatePadding() const { return replicate_padding; };
+
+		inline const float* Filter() const { return filter.data(); };
+		inline const float* Bias() const { return bias.data(); };
+		// Winograd F(2x2, 3x3) filter G g G^T stored as [4 x 4 position][input channel][output channel]
+		// with the input channels padded to a multiple of 8, empty unless SupportsWinograd
+		inline const float* WinogradFilter() const { return winograd_filter.data(); };
+		// 3x3 stride 1 with padding 1
+		inline bool SupportsWinograd() const { return !winograd_filter.empty(); };
+
+		inline int OutputSize(int input_size) const { return (input_size + 2 * padding - filter_size) / stride + 1; };
+		inline TensorShape OutputShape(const TensorShape& input) const
+		{
+			return TensorShape(input.n, OutputSize(input.h), OutputSize(input.w), output_channels);
+		}
+		// Multiply-accumulates per output pixel
+		inline long long MacsPerPixel() const { return (long long)filter_size * filter_size * input_channels * output_channels; };
+
+	private:
+		int output_channels = 0;
+		int padded_output_channels = 0;
+		int input_channels = 0;
+		int filter_size = 0;
+		int stride = 1;
+		int padding = 0;
+		bool replicate_padding = false;
+
+		AlignedVector<float> filter;
+		AlignedVector<float> bias;
+		AlignedVector<float> winograd_filter;
+	};
+
+	// Ways of computing a full frame convolution, all giving the same result up to rounding
+	enum class ConvAlgorithm
+	{
+		Direct,		// Taps read straight from the input
+		Im2colGemm,	// Patches of 64 pixels packed into rows of a matrix, multiplied with the filter
+		Winograd	// F(2x2, 3x3), 2.25 times fewer multiplications than direct for 3x3 filters
+	};
+
+	struct ConvConfig
+	{
+		ConvAlgorithm algorithm = ConvAlgorithm::Direct;
+		int rows_per_task = 4;	// Output rows handed to one task of the thread pool
+
+		bool operator==(const ConvConfig& rhs) const { return algorithm == rhs.algorithm && rows_per_task == rhs.rows_per_task; };
+	};
+
+	const char* ConvAlgorithmName(ConvAlgorithm algorithm);
+
+	// Rearranges a k x k filter over C channels into a (k / r) x (k / r) filter over C * r * r
+	// pixel-unshuffled channels. Float version of pixelShuffleWeights in master_net.cpp
+	std::vector<float> PixelUnshuffleFilter(const std::vector<float>& weights, int output_channels, int input_channels, int filter_size, int r);
+	// Inverse of the above: a k x k filter over C * r * r pixel-unshuffled channels becomes a
+	// (k * r) x (k * r) filter over C channels. With stride r and r times the padding it runs on
+	// the image itself, so a convolution over PixelUnshuffleView(image, r) needs no copy
+	std::vector<float> PixelShuffleFilter(const std::vector<float>& weights, int output_channels, int input_channels, int filter_size, int r);
+
+	// Computes the output pixels [oy0, oy1) x [ox0, ox1), in output image coordinates, of a
+	// convolution over in and writes them to out. Input pixels outside the in window are treated
+	// as padding, zeros or the nearest pixel of the window, so callers only cut the window short
+	// of the frame where no tap reaches past it. When residual is given, its value at the same
+	// pixel is added after the activation.
+	void Convolve(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView* residual,
+		const PlaneView& out, int oy0, int oy1, int ox0, int ox1);
+
+	// Im2colGemm and Winograd versions of the above, without the residual. Winograd computes
+	// rows and columns in pairs and needs SupportsWinograd
+	void ConvolveIm2col(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView& out, int oy0, int oy1, int ox0, int ox1);
+	void ConvolveWinograd(const PlaneView& in, const ConvWeights& weights, bool relu, const PlaneView& out, int oy0, int oy1, int ox0, int ox1);
+
+	// Full frame convolution, out is resized to fit
+	void Convolve(const Tensor& in, const ConvWeights& weights, bool relu, Tensor& out, ThreadPool& pool, const ConvConfig& config = ConvConfig());
+	// Full frame convolution over a layout view. Plane views are read in place, any other layout
+	// is materialized into a temporary NHWC tensor first
+	void Convolve(const LayoutView& in, const ConvWeights& weights, bool relu, Tensor& out, ThreadPool& pool, const ConvConfig& config = ConvConfig());
+
+	// Element wise out = a + b, out may alias a or b
+	void Add(const Tensor& a, const Tensor& b, Tensor& out, ThreadPool& pool);
+
+	// Element wise out = a + b over the pixels [y0, y1) x [x0, x1), which all three views must contain
+	void Add(const PlaneView& a, const PlaneView& b, const PlaneView& out, int y0, int y1, int x0, int x1);
+}
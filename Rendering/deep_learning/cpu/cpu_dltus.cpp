@@ -0,0 +1,122 @@
+#include "cpu_dltus.h"
+#include "cpu/timer.h"
+#include <stdexcept>
+
+namespace
+{
+	// Network rows handled by one task of the passes, four high resolution rows each
+	const int rows_per_task = 4;
+
+	// Runs f(i, y0, y1) over bands of rows of every sequence
+	template <typename F>
+	double runBands(ecpu::ThreadPool& pool, int count, int rows, F f)
+	{
+		ecpu::Timer timer;
+		const int bands = (rows + rows_per_task - 1) / rows_per_task;
+		pool.ParallelFor(count * bands, [&](int task)
+			{
+				int i = task / bands;
+				int y0 = (task % bands) * rows_per_task;
+				f(i, y0, std::min(rows, y0 + rows_per_task));
+			});
+		return timer.Elapsed();
+	}
+}
+
+ecpu::DLTUSPipeline::DLTUSPipeline(MasterNet& net, int upsample_factor)
+	: net(net), upsample_factor(upsample_factor)
+{
+	if (net.InputChannels() != 128)
+		throw std::runtime_error("DLTUS passes need a network with 128 input channels");
+	if (upsample_factor < 1)
+		throw std::runtime_error("Upsample factor must be at least 1");
+}
+
+void ecpu::DLTUSPipeline::Reset()
+{
+	histories.clear();
+	if (incremental)
+		incremental->Reset();
+}
+
+void ecpu::DLTUSPipeline::SetIncremental(float threshold, int tile_size)
+{
+	if (threshold < 0.0f)
+		incremental.reset();
+	else
+		incremental = std::make_unique<IncrementalExecutor>(net, threshold, tile_size);
+}
+
+void ecpu::DLTUSPipeline::Execute(const DLTUSFrame* frames, int count, ThreadPool& pool)
+{
+	if (count < 1)
+		throw std::runtime_error("Nothing to upsample");
+	const TensorShape& lr = frames[0].color.Shape();
+	const int width = lr.w * upsample_factor;
+	const int height = lr.h * upsample_factor;
+	if (width % 4 != 0 || height % 4 != 0)
+		throw std::runtime_error("Upsampled frame size must be a multiple of 4");
+	for (int i = 0; i < count; i++)
+	{
+		const DLTUSFrame& frame = frames[i];
+		if (frame.color.Shape() != lr || frame.linear_color != frames[0].linear_color)
+			throw std::runtime_error("All frames of a batch must have the same size and color space");
+		if (frame.depth.Shape() != TensorShape(1, lr.h, lr.w, 1) || frame.motion.Shape() != TensorShape(1, lr.h, lr.w, 2))
+			throw std::runtime_error("Depth and motion must match the color size");
+	}
+
+	const TensorShape history_shape(1, height, width, 4);
+	if ((int)histories.size() != count || histories[0].Shape() != history_shape)
+	{
+		histories.assign(count, Tensor(history_shape));
+		for (auto& history : histories)
+			history.Fill(0.0f);
+	}
+
+	const int rows = height / 4;
+	last_stats = Stats();
+
+	// The renderer target is linear, the dataset images are already in the network's color space
+	const bool format = frames[0].linear_color;
+	if (format)
+	{
+		formatted.resize(count);
+		for (auto& t : formatted)
+			t.Resize(lr);
+		last_stats.format_seconds = runBands(pool, count, lr.h, [&](int i, int y0, int y1)
+			{
+				FormatInput(frames[i].color, formatted[i], y0, y1);
+			});
+	}
+	auto color = [&](int i) -> const Tensor& { return format ? formatted[i] : frames[i].color; };
+
+	jau.Resize(TensorShape(count, rows, width / 4, 64));
+	last_stats.upsample_seconds = runBands(pool, count, rows, [&](int i, int y0, int y1)
+		{
+			JitterAlignedUpsample(color(i), frames[i].jitter_x, frames[i].jitter_y, upsample_factor, jau, i, y0, y1);
+		});
+
+	input.Resize(TensorShape(count, rows, width / 4, net.InputChannels()));
+	last_stats.init_seconds = runBands(pool, count, rows, [&](int i, int y0, int y1)
+		{
+			InitializeNetworkInput(frames[i], color(i), jau, histories[i], upsample_factor, input, i, y0, y1);
+		});
+
+	const Tensor* network_output = &output;
+	if (incremental)
+	{
+		network_output = &incremental->Execute(input, pool);
+		last_stats.network_seconds = incremental->GetLastStats().seconds;
+		last_stats.skipped_ratio = incremental->GetLastStats().SkippedRatio();
+	}
+	else
+	{
+		net.Execute(input, output, pool);
+		last_stats.network_seconds = net.GetLastStats().seconds;
+	}
+
+	last_stats.finalize_seconds = runBands(pool, count, rows, [&](int i, int y0, int y1)
+		{
+			FinalizeNetworkOutput(input, *network_output, jau, i, histories[i], y0, y1);
+		});
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "cpu_master_net.h"
+#include "incremental_executor.h"
+#include "dltus_passes.h"
+
+namespace ecpu
+{
+	// Headless CPU counterpart of DLTUS::Execute. Every call upsamples one frame of each of a set of
+	// independent sequences: color formatting, jitter aligned upsample, network input, the network
+	// over all sequences at once and the finalize pass into each sequence's history. The passes are
+	// split into bands of rows over the thread pool.
+	class DLTUSPipeline
+	{
+	public:
+		// Wall clock time of each stage of the last Execute
+		struct Stats
+		{
+			double format_seconds = 0.0;
+			double upsample_seconds = 0.0;
+			double init_seconds = 0.0;
+			double network_seconds = 0.0;
+			double finalize_seconds = 0.0;
+			double skipped_ratio = 0.0;	// Network work skipped by incremental execution
+
+			double TotalSeconds() const { return format_seconds + upsample_seconds + init_seconds + network_seconds + finalize_seconds; };
+		};
+
+	public:
+		DLTUSPipeline(MasterNet& net, int upsample_factor);
+
+		// frames[i] is the next frame of sequence i. Histories start over when the sequence count or
+		// frame size changes. All frames must have the same size
+		void Execute(const DLTUSFrame* frames, int count, ThreadPool& pool);
+
+		// { 1, H, W, 4 } gamma encoded upsampled frame of sequence i, which is also its history
+		const Tensor& GetOutput(int i) const { return histories[i]; };
+		// The next Execute starts every sequence from an empty history, like a new DLTUS
+		void Reset();
+
+		// Runs the network through an IncrementalExecutor, reusing the output of tiles whose input
+		// changed by at most threshold. A negative threshold turns it off
+		void SetIncremental(float threshold, int tile_size = 32);
+
+		const Stats& GetLastStats() const { return last_stats; };
+		int UpsampleFactor() const { return upsample_factor; };
+
+	private:
+		MasterNet& net;
+		int upsample_factor;
+
+		std::vector<Tensor> formatted;
+		std::vector<Tensor> histories;
+		Tensor jau;
+		Tensor input;
+		Tensor output;
+		std::unique_ptr<IncrementalExecutor> incremental;
+		Stats last_stats;
+	};
+}
@@ -0,0 +1,215 @@
+#include "cpu_master_net.h"
+#include "conv_autotuner.h"
+#include "cpu/timer.h"
+#include <stdexcept>
+#include <algorithm>
+
+ecpu::MasterNet::MasterNet(const std::string& weight_path)
+	: MasterNet(NetworkGraph::Load(NetworkGraph::SidecarPath(weight_path)), LoadWeightFile(weight_path))
+{
+}
+
+ecpu::MasterNet::MasterNet(const NetworkGraph& graph, const WeightMap& weight_map)
+	: graph(graph)
+{
+	const auto& layers = graph.Layers();
+	const auto& tensors = graph.Tensors();
+
+	layer_weights.resize(layers.size());
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		const GraphLayer& layer = layers[i];
+		if (layer.type != GraphLayer::Type::Conv)
+			continue;
+		layer_weights[i] = ConvWeights(graph.ConvFilter(layer, weight_map), graph.ConvBias(layer, weight_map),
+			tensors[layer.output].channels, tensors[layer.inputs[0]].channels, layer.filter_size, layer.stride, -1, layer.replicate);
+	}
+
+	// The blocks keep references into layer_weights, so they are created after it is filled
+	findResidualBlocks();
+}
+
+std::string ecpu::MasterNet::DefaultWeightPath(int upsample_factor)
+{
+	// Same files as egx::MasterNet, spelled with the case of the repository folder so it also resolves on Linux
+	if (upsample_factor == 2)
+		return "../Network/MasterNet2x2/nn_weights_bias4-200.bin";
+	return "../Network/MasterNet4x4/nn_weights_200.bin";
+}
+
+void ecpu::MasterNet::findResidualBlocks()
+{
+	const auto& layers = graph.Layers();
+	auto consumers = graph.ConsumerCounts();
+
+	// Shape preserving convolutions the fused block can tile
+	auto tileable = [&](int i)
+	{
+		const GraphLayer& l = layers[i];
+		return l.type == GraphLayer::Type::Conv && l.stride == 1 && l.unshuffle == 1 && ConvOutputSize(16, l.filter_size, 1) == 16;
+	};
+
+	for (int i = 0; i < (int)layers.size(); i++)
+	{
+		Step step;
+		step.layer = i;
+		step.inputs = layers[i].inputs;
+		step.output = layers[i].output;
+		layer_schedule.steps.push_back(step);
+
+		// conv (relu) -> conv -> add with the block input, with nothing else reading the intermediates
+		bool block = i + 2 < (int)layers.size() &&
+			tileable(i) && layers[i].relu &&
+			tileable(i + 1) && !layers[i + 1].relu && layers[i + 1].inputs[0] == layers[i].output &&
+			layers[i + 2].type == GraphLayer::Type::Add &&
+			consumers[layers[i].output] == 1 && consumers[layers[i + 1].output] == 1;
+		if (block)
+		{
+			const auto& add_inputs = layers[i + 2].inputs;
+			int in = layers[i].inputs[0];
+			int conv_out = layers[i + 1].output;
+			block = (add_inputs[0] == in && add_inputs[1] == conv_out) || (add_inputs[0] == conv_out && add_inputs[1] == in);
+		}
+
+		if (block)
+		{
+			fused_blocks.push_back(std::make_unique<FusedResidualBlock>(layer_weights[i], layer_weights[i + 1]));
+			step.block = (int)fused_blocks.size() - 1;
+			step.output = layers[i + 2].output;
+			fused_schedule.steps.push_back(step);
+
+			// The two remaining layers still run one by one in the unfused schedule
+			for (int j = i + 1; j <= i + 2; j++)
+			{
+				Step single;
+				single.layer = j;
+				single.inputs = layers[j].inputs;
+				single.output = layers[j].output;
+				layer_schedule.steps.push_back(single);
+			}
+			i += 2;
+		}
+		else
+		{
+			fused_schedule.steps.push_back(step);
+		}
+	}
+}
+
+void ecpu::MasterNet::planSchedule(ScheduleState& state, const TensorShape& input_shape, ThreadPool& pool)
+{
+	state.input_shape = input_shape;
+	state.shapes = graph.InferShapes(input_shape);
+
+	const auto& layers = graph.Layers();
+	for (auto& step : state.steps)
+	{
+		step.config = ConvConfig();
+		if (autotuner && step.block < 0 && layers[step.layer].type == GraphLayer::Type::Conv)
+			step.config = autotuner->Tune(layer_weights[step.layer], layers[step.layer].relu, state.shapes[step.inputs[0]], pool);
+	}
+
+	std::vector<PlanStep> plan_steps;
+	for (const auto& step : state.steps)
+	{
+		PlanStep p;
+		p.inputs = step.inputs;
+		p.output = step.output;
+		p.elementwise = step.block < 0 && graph.Layers()[step.layer].type == GraphLayer::Type::Add;
+		plan_steps.push_back(p);
+	}
+
+	std::vector<size_t> bytes;
+	for (const auto& shape : state.shapes)
+		bytes.push_back(shape.ByteSize());
+
+	auto lifetimes = ComputeLifetimes(plan_steps, bytes);
+	lifetimes[graph.InputTensor()].external = true;
+	lifetimes[graph.OutputTensor()].external = true;
+	state.plan = PlanBuffers(lifetimes);
+	state.buffers.resize(state.plan.buffer_sizes.size());
+}
+
+void ecpu::MasterNet::SetAutotuner(ConvAutotuner* tuner)
+{
+	autotuner = tuner;
+	// Replan on the next Execute so the steps pick up the new configurations
+	layer_schedule.input_shape = TensorShape();
+	fused_schedule.input_shape = TensorShape();
+}
+
+void ecpu::MasterNet::ExecuteLayers(const Tensor& input, std::vector<Tensor>& tensors, ThreadPool& pool) const
+{
+	auto shapes = graph.InferShapes(input.Shape());
+	tensors.resize(shapes.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+		tensors[i].Resize(shapes[i]);
+	std::copy(input.Data(), input.Data() + input.ElementCount(), tensors[graph.InputTensor()].Data());
+
+	const auto& layers = graph.Layers();
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		const GraphLayer& layer = layers[i];
+		if (layer.type == GraphLayer::Type::Conv)
+			Convolve(tensors[layer.inputs[0]], layer_weights[i], layer.relu, tensors[layer.output], pool);
+		else
+			Add(tensors[layer.inputs[0]], tensors[layer.inputs[1]], tensors[layer.output], pool);
+	}
+}
+
+void ecpu::MasterNet::Execute(const Tensor& input, Tensor& output, ThreadPool& pool, Schedule schedule)
+{
+	Timer timer;
+	last_stats = ExecutionStats();
+
+	ScheduleState& state = schedule == Schedule::LayerByLayer ? layer_schedule : fused_schedule;
+	if (state.input_shape != input.Shape())
+		planSchedule(state, input.Shape(), pool);
+	last_stats.buffer_bytes = state.plan.TotalBytes();
+
+	auto tensor = [&](int t) -> Tensor&
+	{
+		if (t == graph.OutputTensor())
+			return output;
+		return state.buffers[state.plan.tensor_buffers[t]];
+	};
+	auto inputTensor = [&](int t) -> const Tensor&
+	{
+		return t == graph.InputTensor() ? input : tensor(t);
+	};
+
+	const auto& layers = graph.Layers();
+	for (const auto& step : state.steps)
+	{
+		const Tensor& in = inputTensor(step.inputs[0]);
+		Tensor& out = tensor(step.output);
+		const TensorShape& out_shape = state.shapes[step.output];
+		const unsigned long long pixels = (unsigned long long)out_shape.n * out_shape.h * out_shape.w;
+
+		if (step.block >= 0)
+		{
+			FusedResidualBlock& block = *fused_blocks[step.block];
+			block.Execute(in, out, pool);
+			last_stats.bytes_read += block.BytesRead();
+			last_stats.bytes_written += block.BytesWritten();
+			last_stats.macs += (unsigned long long)(layer_weights[step.layer].MacsPerPixel() * block.HaloOverhead() * pixels);
+			last_stats.macs += (unsigned long long)layer_weights[step.layer + 1].MacsPerPixel() * pixels;
+		}
+		else if (layers[step.layer].type == GraphLayer::Type::Conv)
+		{
+			const ConvWeights& w = layer_weights[step.layer];
+			Convolve(in, w, layers[step.layer].relu, out, pool, step.config);
+			last_stats.bytes_read += in.Shape().ByteSize();
+			last_stats.bytes_written += out_shape.ByteSize();
+			last_stats.macs += (unsigned long long)w.MacsPerPixel() * pixels;
+		}
+		else
+		{
+			Add(in, inputTensor(step.inputs[1]), out, pool);
+			last_stats.bytes_read += 2 * in.Shape().ByteSize();
+			last_stats.bytes_written += out_shape.ByteSize();
+		}
+	}
+
+	last_stats.seconds = timer.Elapsed();
+}
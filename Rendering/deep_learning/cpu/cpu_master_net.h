@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "cpu_conv.h"
+#include "fused_res_block.h"
+#include "network_graph.h"
+#include "weight_file.h"
+
+namespace ecpu
+{
+	class ConvAutotuner;
+
+	// CPU implementation of egx::MasterNet, executing the layer graph stored next to the weights.
+	// Input is the pixel-unshuffled tensor written by init_network_cs.hlsl with OPTIM 2,
+	// { N, H / 4, W / 4, 128 } in NHWC, and output is the { N, H / 4, W / 4, 32 } tensor that
+	// finalize_network_ps.hlsl reads as two pixel-shuffled channels.
+	class MasterNet
+	{
+	public:
+		enum class Schedule
+		{
+			LayerByLayer,		// One graph layer at a time, like the DirectML version
+			FusedResidualBlocks	// Residual blocks run tile by tile with cache resident intermediates
+		};
+
+		struct ExecutionStats
+		{
+			double seconds = 0.0;
+			unsigned long long bytes_read = 0;		// Full frame tensor bytes read
+			unsigned long long bytes_written = 0;	// Full frame tensor bytes written
+			unsigned long long macs = 0;			// Multiply-accumulates including halo recomputation
+			unsigned long long buffer_bytes = 0;	// Intermediate memory assigned by the buffer planner
+		};
+
+	public:
+		// Loads the weights and the .graph sidecar next to them
+		explicit MasterNet(const std::string& weight_path);
+		MasterNet(const NetworkGraph& graph, const WeightMap& weight_map);
+
+		void Execute(const Tensor& input, Tensor& output, ThreadPool& pool, Schedule schedule = Schedule::FusedResidualBlocks);
+		// Runs the graph one layer at a time and keeps every tensor, indexed like GetGraph().Tensors().
+		// Slow and memory hungry, meant for comparing layers against a reference
+		void ExecuteLayers(const Tensor& input, std::vector<Tensor>& tensors, ThreadPool& pool) const;
+
+		const ExecutionStats& GetLastStats() const { return last_stats; };
+		const NetworkGraph& GetGraph() const { return graph; };
+		// Repacked weights of a convolution layer of the graph
+		const ConvWeights& GetLayerWeights(int layer) const { return layer_weights[layer]; };
+		int InputChannels() const { return graph.Tensors()[graph.InputTensor()].channels; };
+
+		// Layers outside fused blocks use the configurations the autotuner picks for their shapes,
+		// tuned when a new input shape is planned. nullptr goes back to the default configuration.
+		// The autotuner must outlive the network
+		void SetAutotuner(ConvAutotuner* tuner);
+
+		static std::string DefaultWeightPath(int upsample_factor);
+
+	private:
+		// One unit of work of a schedule, either a single graph layer or a fused residual block
+		// covering three layers
+		struct Step
+		{
+			int layer = 0;
+			int block = -1;
+			std::vector<int> inputs;
+			int output = -1;
+			ConvConfig config;
+		};
+
+		struct ScheduleState
+		{
+			std::vector<Step> steps;
+			TensorShape input_shape;
+			std::vector<TensorShape> shapes;
+			BufferPlan plan;
+			std::vector<Tensor> buffers;
+		};
+
+		void findResidualBlocks();
+		void planSchedule(ScheduleState& state, const TensorShape& input_shape, ThreadPool& pool);
+
+	private:
+		NetworkGraph graph;
+		std::vector<ConvWeights> layer_weights; // Empty for layers without weights
+		std::vector<std::unique_ptr<FusedResidualBlock>> fused_blocks;
+
+		ScheduleState layer_schedule;
+		ScheduleState fused_schedule;
+		ConvAutotuner* autotuner = nullptr;
+
+		ExecutionStats last_stats;
+	};
+}
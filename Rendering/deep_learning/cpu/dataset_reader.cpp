@@ -0,0 +1,174 @@
+#include "dataset_reader.h"
+#include "deep_learning/float16_compressor.h"
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	std::string framePath(const std::string& root, const std::string& kind, const std::string& prefix, int upsample_factor, int video, int frame, const char* extension)
+	{
+		const std::string us = std::to_string(upsample_factor);
+		const std::string v = std::to_string(video);
+		return root + "/us" + us + "/" + kind + "/video" + v + "/" + prefix + "_us" + us + "_v" + v + "_f" + std::to_string(frame) + extension;
+	}
+
+	bool fileExists(const std::string& path)
+	{
+		return (bool)std::ifstream(path);
+	}
+
+	// Width in pixels of a gray image packing four bytes per pixel
+	int packedWidth(const eio::PngImage& image)
+	{
+		if (image.channels != 1 || image.width % 4 != 0)
+			throw std::runtime_error("Packed buffers must be gray images a multiple of 4 wide");
+		return image.width / 4;
+	}
+
+	eio::PngImage packedImage(const ecpu::TensorShape& shape)
+	{
+		eio::PngImage out;
+		out.width = shape.w * 4;
+		out.height = shape.h;
+		out.channels = 1;
+		out.pixels.resize((size_t)out.width * out.height);
+		return out;
+	}
+}
+
+std::string ecpu::DatasetImagePath(const std::string& root, int upsample_factor, int video, int frame)
+{
+	return framePath(root, "images", "image", upsample_factor, video, frame, ".png");
+}
+
+std::string ecpu::DatasetDepthPath(const std::string& root, int upsample_factor, int video, int frame)
+{
+	return framePath(root, "depth", "depth", upsample_factor, video, frame, ".png");
+}
+
+std::string ecpu::DatasetMotionPath(const std::string& root, int upsample_factor, int video, int frame)
+{
+	return framePath(root, "motion_vectors", "motion_vectors", upsample_factor, video, frame, ".png");
+}
+
+std::string ecpu::DatasetJitterPath(const std::string& root, int upsample_factor, int video, int frame)
+{
+	return framePath(root, "jitter", "jitter", upsample_factor, video, frame, ".txt");
+}
+
+std::string ecpu::DatasetTargetPath(const std::string& root, int samples_per_pixel, int video, int frame)
+{
+	const std::string spp = std::to_string(samples_per_pixel);
+	const std::string v = std::to_string(video);
+	return root + "/spp" + spp + "/video" + v + "/spp" + spp + "_v" + v + "_f" + std::to_string(frame) + ".png";
+}
+
+int ecpu::DatasetFrameCount(const std::string& root, int upsample_factor, int video)
+{
+	int count = 0;
+	while (fileExists(DatasetImagePath(root, upsample_factor, video, count)))
+		count++;
+	return count;
+}
+
+void ecpu::LoadDatasetFrame(const std::string& root, int upsample_factor, int video, int frame, DLTUSFrame& out)
+{
+	ImageToTensor(eio::LoadPng(DatasetImagePath(root, upsample_factor, video, frame)), 3, out.color);
+	DecodeDepth(eio::LoadPng(DatasetDepthPath(root, upsample_factor, video, frame)), out.depth);
+	DecodeMotion(eio::LoadPng(DatasetMotionPath(root, upsample_factor, video, frame)), out.motion);
+	out.linear_color = false;
+
+	const std::string jitter_path = DatasetJitterPath(root, upsample_factor, video, frame);
+	std::ifstream jitter(jitter_path);
+	if (!(jitter >> out.jitter_x >> out.jitter_y))
+		throw std::runtime_error("Could not read jitter from " + jitter_path);
+
+	const TensorShape& s = out.color.Shape();
+	if (out.depth.Shape() != TensorShape(1, s.h, s.w, 1) || out.motion.Shape() != TensorShape(1, s.h, s.w, 2))
+		throw std::runtime_error("Depth and motion vectors of " + DatasetImagePath(root, upsample_factor, video, frame) + " do not match the image size");
+}
+
+void ecpu::ImageToTensor(const eio::PngImage& image, int channels, Tensor& out)
+{
+	if (channels > image.channels)
+		throw std::runtime_error("Image has " + std::to_string(image.channels) + " channels, " + std::to_string(channels) + " were requested");
+	out.Resize(TensorShape(1, image.height, image.width, channels));
+	float* dst = out.Data();
+	const size_t pixels = (size_t)image.width * image.height;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		for (int c = 0; c < channels; c++)
+			dst[i * channels + c] = image.pixels[i * image.channels + c] * (1.0f / 255.0f);
+	}
+}
+
+eio::PngImage ecpu::TensorToImage(const Tensor& image)
+{
+	const TensorShape& s = image.Shape();
+	if (s.c < 3)
+		throw std::runtime_error("TensorToImage needs at least 3 channels");
+	eio::PngImage out;
+	out.width = s.w;
+	out.height = s.h;
+	out.channels = 3;
+	out.pixels.resize((size_t)s.w * s.h * 3);
+	const float* src = image.Data();
+	const size_t pixels = (size_t)s.w * s.h;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			float v = std::min(std::max(src[i * s.c + c], 0.0f), 1.0f);
+			out.pixels[i * 3 + c] = (uint8_t)std::lround(v * 255.0f);
+		}
+	}
+	return out;
+}
+
+void ecpu::DecodeDepth(const eio::PngImage& image, Tensor& out)
+{
+	const int width = packedWidth(image);
+	out.Resize(TensorShape(1, image.height, width, 1));
+	// Little endian bytes of a float32, copied so the result does not depend on alignment
+	std::memcpy(out.Data(), image.pixels.data(), (size_t)width * image.height * sizeof(float));
+}
+
+void ecpu::DecodeMotion(const eio::PngImage& image, Tensor& out)
+{
+	const int width = packedWidth(image);
+	out.Resize(TensorShape(1, image.height, width, 2));
+	float* dst = out.Data();
+	const size_t values = (size_t)width * image.height * 2;
+	for (size_t i = 0; i < values; i++)
+	{
+		const uint8_t* p = &image.pixels[i * 2];
+		dst[i] = Float16Compressor::decompress((uint16_t)(p[0] | (p[1] << 8)));
+	}
+}
+
+eio::PngImage ecpu::EncodeDepth(const Tensor& depth)
+{
+	if (depth.Shape().c != 1)
+		throw std::runtime_error("EncodeDepth needs a single channel");
+	eio::PngImage out = packedImage(depth.Shape());
+	std::memcpy(out.pixels.data(), depth.Data(), out.pixels.size());
+	return out;
+}
+
+eio::PngImage ecpu::EncodeMotion(const Tensor& motion)
+{
+	if (motion.Shape().c != 2)
+		throw std::runtime_error("EncodeMotion needs two channels");
+	eio::PngImage out = packedImage(motion.Shape());
+	const float* src = motion.Data();
+	const size_t values = motion.ElementCount();
+	for (size_t i = 0; i < values; i++)
+	{
+		const uint16_t bits = Float16Compressor::compress(src[i]);
+		out.pixels[i * 2] = (uint8_t)(bits & 0xff);
+		out.pixels[i * 2 + 1] = (uint8_t)(bits >> 8);
+	}
+	return out;
+}
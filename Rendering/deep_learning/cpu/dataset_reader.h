@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include "io/png.h"
+#include "dltus_passes.h"
+
+namespace ecpu
+{
+	// Reading of the sequences DatasetGenerator records, with the file layout of Network/dataset.py
+	// under a dataset root such as ../DatasetGenerator/data
+	std::string DatasetImagePath(const std::string& root, int upsample_factor, int video, int frame);
+	std::string DatasetDepthPath(const std::string& root, int upsample_factor, int video, int frame);
+	std::string DatasetMotionPath(const std::string& root, int upsample_factor, int video, int frame);
+	std::string DatasetJitterPath(const std::string& root, int upsample_factor, int video, int frame);
+	std::string DatasetTargetPath(const std::string& root, int samples_per_pixel, int video, int frame);
+
+	// Number of consecutive frames of a video, counted from frame 0
+	int DatasetFrameCount(const std::string& root, int upsample_factor, int video);
+
+	// Loads color, depth, motion vectors and jitter of a frame. The recorded color is the tone
+	// mapped image, so it is already in the network's color space
+	void LoadDatasetFrame(const std::string& root, int upsample_factor, int video, int frame, DLTUSFrame& out);
+
+	// Conversions between 8 bit images and { 1, h, w, c } tensors in [0, 1]. ImageToTensor keeps
+	// the first channels of the image, TensorToImage writes the first three channels as RGB
+	void ImageToTensor(const eio::PngImage& image, int channels, Tensor& out);
+	eio::PngImage TensorToImage(const Tensor& image);
+
+	// Depth and motion vectors are saved as gray images four times as wide as the frame, every
+	// four bytes holding one float32 depth or two float16 motion components
+	void DecodeDepth(const eio::PngImage& image, Tensor& out);
+	void DecodeMotion(const eio::PngImage& image, Tensor& out);
+	// The inverses, for tools that write frames in the DatasetGenerator layout
+	eio::PngImage EncodeDepth(const Tensor& depth);
+	eio::PngImage EncodeMotion(const Tensor& motion);
+}
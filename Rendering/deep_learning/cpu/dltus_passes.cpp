@@ -0,0 +1,220 @@
+#include "dltus_passes.h"
+#include "cpu/simd.h"
+#include "cpu/resample.h"
+#include "cpu/layout.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// init_network_cs.hlsl and finalize_network_ps.hlsl always shuffle by 4, whatever UPSAMPLE_FACTOR is
+	const int shuffle_factor = 4;
+
+	float clamp01(float v)
+	{
+		return std::min(std::max(v, 0.0f), 1.0f);
+	}
+
+	// Texel pair and weight of a linear clamp sample along one axis
+	struct LinearTap
+	{
+		int i0;
+		int i1;
+		float f;
+	};
+
+	LinearTap linearTap(float uv, int size)
+	{
+		const float p = uv * size - 0.5f;
+		const float p0 = std::floor(p);
+		LinearTap tap;
+		tap.i0 = std::min(std::max((int)p0, 0), size - 1);
+		tap.i1 = std::min(std::max((int)p0 + 1, 0), size - 1);
+		tap.f = p - p0;
+		return tap;
+	}
+
+	float linearDepth(float depth)
+	{
+		const float far = 100.0f;
+		const float near = 0.1f;
+		depth = near * far / (far - depth * (far - near));
+		return (depth - near) / (far - near);
+	}
+
+	// Channel of a pixel-unshuffled tensor holding channel c of a high resolution pixel
+	inline int shuffledChannel(int x, int y, int c)
+	{
+		return ecpu::PixelUnshuffleChannel(c, x % shuffle_factor, y % shuffle_factor, shuffle_factor);
+	}
+}
+
+void ecpu::FormatInput(const Tensor& color, Tensor& formatted, int y0, int y1)
+{
+	const size_t row = (size_t)color.Shape().w * color.Shape().c;
+	const float* src = color.Data();
+	float* dst = formatted.Data();
+	for (size_t i = y0 * row; i < y1 * row; i++)
+		dst[i] = std::round(clamp01(std::pow(src[i], 1.0f / 2.2f)) * 255.0f) / 255.0f;
+}
+
+void ecpu::JitterAlignedUpsample(const Tensor& color, float jitter_x, float jitter_y, int upsample_factor,
+	Tensor& jau, int n, int y0, int y1)
+{
+	const TensorShape& lr = color.Shape();
+	const int width = jau.Shape().w * shuffle_factor;
+	const int height = jau.Shape().h * shuffle_factor;
+	const PlaneView out = jau.Plane(n);
+
+	// Horizontal taps are the same for every row
+	std::vector<LinearTap> columns(width);
+	for (int x = 0; x < width; x++)
+		columns[x] = linearTap((0.5f + x + (0.5f - jitter_x) * upsample_factor) / width, lr.w);
+
+	const size_t row_floats = (size_t)lr.w * lr.c;
+	std::vector<float> blended(row_floats);
+	for (int Y = y0; Y < y1; Y++)
+	{
+		for (int ym = 0; ym < shuffle_factor; ym++)
+		{
+			const int y = Y * shuffle_factor + ym;
+			const LinearTap row = linearTap((0.5f + y + (0.5f - jitter_y) * upsample_factor) / height, lr.h);
+			const float* r0 = color.Data() + row.i0 * row_floats;
+			const float* r1 = color.Data() + row.i1 * row_floats;
+
+			// Vertical pass over a whole low resolution row, then every output pixel reads two
+			// blended texels
+			const float8 w0 = float8::Set(1.0f - row.f);
+			const float8 w1 = float8::Set(row.f);
+			size_t i = 0;
+			for (; i + 8 <= row_floats; i += 8)
+				float8::MulAdd(float8::Load(r0 + i), w0, float8::Load(r1 + i) * w1).Store(&blended[i]);
+			for (; i < row_floats; i++)
+				blended[i] = r0[i] * (1.0f - row.f) + r1[i] * row.f;
+
+			for (int x = 0; x < width; x++)
+			{
+				const LinearTap& t = columns[x];
+				float* dst = out.At(Y, x / shuffle_factor);
+				for (int c = 0; c < 3; c++)
+					dst[shuffledChannel(x, y, c)] = blended[t.i0 * lr.c + c] * (1.0f - t.f) + blended[t.i1 * lr.c + c] * t.f;
+				dst[shuffledChannel(x, y, 3)] = 1.0f;
+			}
+		}
+	}
+}
+
+void ecpu::InitializeNetworkInput(const DLTUSFrame& frame, const Tensor& color, const Tensor& jau, const Tensor& history,
+	int upsample_factor, Tensor& input, int n, int y0, int y1)
+{
+	const int width = history.Shape().w;
+	const int height = history.Shape().h;
+	const int channels = input.Shape().c;
+	const PlaneView in_plane = input.Plane(n);
+	const PlaneView jau_plane = jau.Plane(n);
+	const ImageView<float> history_view = ViewOf(history);
+	const ImageView<float> motion_view = ViewOf(frame.motion);
+
+	for (int Y = y0; Y < y1; Y++)
+	{
+		for (int X = 0; X < width / shuffle_factor; X++)
+		{
+			float* pixel = in_plane.At(Y, X);
+			const float* jau_pixel = jau_plane.At(Y, X);
+
+			// Zero upsampling leaves everything but the pixels the jittered samples fell into at zero
+			for (int c = 0; c < channels / 2; c += 8)
+				float8::Zero().Store(pixel + c);
+
+			for (int k = 0; k < shuffle_factor * shuffle_factor; k++)
+			{
+				const int x = X * shuffle_factor + k % shuffle_factor;
+				const int y = Y * shuffle_factor + k / shuffle_factor;
+				const int lr_x = x / upsample_factor;
+				const int lr_y = y / upsample_factor;
+
+				const bool sampled =
+					(int)((lr_x + frame.jitter_x) * upsample_factor) == x &&
+					(int)((lr_y + frame.jitter_y) * upsample_factor) == y;
+				if (sampled)
+				{
+					for (int c = 0; c < 3; c++)
+						pixel[shuffledChannel(x, y, c)] = color.At(0, lr_y, lr_x, c);
+					pixel[shuffledChannel(x, y, 3)] = linearDepth(frame.depth.At(0, lr_y, lr_x, 0));
+				}
+
+				// Reproject the history, falling back to the upsampled frame outside the previous frame
+				const float u = (0.5f + x) / width;
+				const float v = (0.5f + y) / height;
+				float motion[2];
+				Sample<ResampleFilter::Bilinear>(motion_view, u, v, motion);
+				const float prev_u = u + motion[0];
+				const float prev_v = v + motion[1];
+
+				float reprojected[4];
+				if (prev_u > 0.0f && prev_u <= 1.0f && prev_v > 0.0f && prev_v <= 1.0f)
+				{
+					// catmullRom of the shader, the full cubic convolution from nine bilinear taps
+					Sample<ResampleFilter::CatmullRom9>(history_view, prev_u, prev_v, reprojected, CubicKernel::Sharp);
+				}
+				else
+				{
+					for (int c = 0; c < 4; c++)
+						reprojected[c] = jau_pixel[shuffledChannel(x, y, c)];
+				}
+				for (int c = 0; c < 4; c++)
+					pixel[shuffledChannel(x, y, c + 4)] = reprojected[c];
+			}
+		}
+	}
+}
+
+void ecpu::FinalizeNetworkOutput(const Tensor& input, const Tensor& output, const Tensor& jau, int n,
+	Tensor& history, int y0, int y1)
+{
+	const int width = history.Shape().w;
+	const PlaneView in_plane = input.Plane(n);
+	const PlaneView out_plane = output.Plane(n);
+	const PlaneView jau_plane = jau.Plane(n);
+	const PlaneView history_plane = history.Plane();
+	const float8 zero = float8::Zero();
+	const float8 one = float8::Set(1.0f);
+
+	// In the pixel-unshuffled layout every channel of a 4x4 block is 16 consecutive floats, so
+	// eight high resolution pixels, two rows of four, are blended per float8
+	for (int Y = y0; Y < y1; Y++)
+	{
+		for (int X = 0; X < width / shuffle_factor; X++)
+		{
+			const float* in_pixel = in_plane.At(Y, X);
+			const float* out_pixel = out_plane.At(Y, X);
+			const float* jau_pixel = jau_plane.At(Y, X);
+
+			for (int half = 0; half < 2; half++)
+			{
+				const int offset = half * 8;
+				const float8 alpha = float8::Min(float8::Max(float8::Load(out_pixel + offset), zero), one);
+				const float8 depth_res = float8::Min(float8::Max(float8::Load(out_pixel + 16 + offset), zero), one);
+
+				float blended[4][8];
+				for (int c = 0; c < 4; c++)
+				{
+					float8 history_value = float8::Load(in_pixel + (c + 4) * 16 + offset);
+					float8 b = float8::MulAdd(float8::Load(jau_pixel + c * 16 + offset), alpha, history_value * (one - alpha));
+					if (c == 3)
+						b = b * depth_res;
+					float8::Min(float8::Max(b, zero), one).Store(blended[c]);
+				}
+
+				for (int lane = 0; lane < 8; lane++)
+				{
+					const int y = Y * shuffle_factor + half * 2 + lane / 4;
+					const int x = X * shuffle_factor + lane % 4;
+					float* dst = history_plane.At(y, x);
+					for (int c = 0; c < 4; c++)
+						dst[c] = blended[c][lane];
+				}
+			}
+		}
+	}
+}
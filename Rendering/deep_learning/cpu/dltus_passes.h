@@ -0,0 +1,43 @@
+#pragma once
+#include "cpu/tensor.h"
+
+namespace ecpu
+{
+	// Low resolution inputs of one frame, the CPU counterpart of the textures DLTUS::Execute binds.
+	// Images are tensors holding a single image
+	struct DLTUSFrame
+	{
+		Tensor color;				// { 1, h, w, 3 } color, gamma encoded unless linear_color is set
+		Tensor depth;				// { 1, h, w, 1 } device depth
+		Tensor motion;				// { 1, h, w, 2 } uv offset from a pixel to its position in the previous frame
+		float jitter_x = 0.5f;		// Sample position inside a low resolution pixel
+		float jitter_y = 0.5f;
+		bool linear_color = false;	// Color still needs FormatInput, like the renderer target DLTUS gets
+	};
+
+	// CPU versions of the DLTUS shader passes around the network. They run in float where the
+	// shaders use half, so results match the GPU to half precision, not bit for bit.
+	// The passes handle the network rows [y0, y1) of the { H / 4, W / 4 } grid so callers can
+	// split frames over threads, each row covering four rows of high resolution pixels.
+
+	// format_input_ps.hlsl: gamma encodes the image rows [y0, y1) of color and quantizes them
+	// like the UNORM8x4 render target. formatted must have the shape of color
+	void FormatInput(const Tensor& color, Tensor& formatted, int y0, int y1);
+
+	// Jitter aligned bilinear upsample of color with alpha 1, stored pixel-unshuffled in image n
+	// of a { N, H / 4, W / 4, 64 } tensor: channel c * 16 + (y % 4) * 4 + x % 4 of a network pixel
+	// holds channel c of high resolution pixel (x, y). Both shaders compute it, here it is done
+	// once and shared
+	void JitterAlignedUpsample(const Tensor& color, float jitter_x, float jitter_y, int upsample_factor,
+		Tensor& jau, int n, int y0, int y1);
+
+	// init_network_cs.hlsl: writes image n of the { N, H / 4, W / 4, 128 } network input from the
+	// formatted color, the frame and the { 1, H, W, 4 } history of the previous frame
+	void InitializeNetworkInput(const DLTUSFrame& frame, const Tensor& color, const Tensor& jau, const Tensor& history,
+		int upsample_factor, Tensor& input, int n, int y0, int y1);
+
+	// finalize_network_ps.hlsl: blends the reprojected history stored in image n of the network
+	// input with the jitter aligned upsample, weighted by the network output, into the history
+	void FinalizeNetworkOutput(const Tensor& input, const Tensor& output, const Tensor& jau, int n,
+		Tensor& history, int y0, int y1);
+}
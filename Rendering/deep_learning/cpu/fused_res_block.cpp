@@ -0,0 +1,101 @@
+#include "fused_res_block.h"
+#include <stdexcept>
+
+ecpu::FusedResidualBlock::FusedResidualBlock(const ConvWeights& conv1, const ConvWeights& conv2, size_t cache_budget)
+	: conv1(conv1), conv2(conv2), cache_budget(cache_budget)
+{
+	if (conv1.Stride() != 1 || conv2.Stride() != 1 ||
+		conv1.OutputSize(16) != 16 || conv2.OutputSize(16) != 16 ||
+		conv1.InputChannels() != conv2.OutputChannels() || conv1.OutputChannels() != conv2.InputChannels())
+		throw std::runtime_error("Fused residual block needs two shape preserving convolutions");
+}
+
+void ecpu::FusedResidualBlock::chooseTileSize(int width, int height)
+{
+	// The scratch tile holds conv1 for the tile plus its halo
+	const int halo = conv2.Padding();
+	const size_t pixel_bytes = (size_t)conv1.PaddedOutputChannels() * sizeof(float);
+
+	tile_width = std::min(width, 64);
+	size_t rows = cache_budget / (pixel_bytes * (tile_width + 2 * halo));
+	tile_height = (int)std::max<size_t>(4, rows > (size_t)(2 * halo) ? rows - 2 * halo : 0);
+	tile_height = std::min(tile_height, height);
+}
+
+void ecpu::FusedResidualBlock::Execute(const Tensor& in, Tensor& out, ThreadPool& pool)
+{
+	if (&in == &out)
+		throw std::runtime_error("Fused residual block can not run in place");
+	if (in.Shape().c != conv1.InputChannels())
+		throw std::runtime_error("Fused residual block input has the wrong channel count");
+
+	const TensorShape& shape = in.Shape();
+	out.Resize(shape);
+	chooseTileSize(shape.w, shape.h);
+
+	const int halo = conv2.Padding();
+	const size_t scratch_size = (size_t)(tile_height + 2 * halo) * (tile_width + 2 * halo) * conv1.PaddedOutputChannels();
+	scratch.resize(pool.ThreadCount());
+	for (auto& s : scratch)
+		if (s.size() < scratch_size)
+			s.resize(scratch_size);
+
+	int tiles_x = (shape.w + tile_width - 1) / tile_width;
+	int tiles_y = (shape.h + tile_height - 1) / tile_height;
+	int tiles = tiles_x * tiles_y;
+
+	pool.ParallelFor(shape.n * tiles, [&](int task, int thread_index)
+		{
+			int n = task / tiles;
+			int ty = (task % tiles) / tiles_x;
+			int tx = (task % tiles) % tiles_x;
+			int ty0 = ty * tile_height;
+			int tx0 = tx * tile_width;
+			executeTile(in.Plane(n), out.Plane(n),
+				ty0, std::min(shape.h, ty0 + tile_height),
+				tx0, std::min(shape.w, tx0 + tile_width),
+				scratch[thread_index].data());
+		});
+
+	// Traffic bookkeeping. Every tile reads its input window (tile plus two pixel halo for the
+	// two convolutions) and writes its output once
+	const int in_halo = conv1.Padding() + halo;
+	unsigned long long conv1_pixels = 0;
+	unsigned long long in_pixels = 0;
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			int ty0 = ty * tile_height, ty1 = std::min(shape.h, ty0 + tile_height);
+			int tx0 = tx * tile_width, tx1 = std::min(shape.w, tx0 + tile_width);
+			conv1_pixels += (unsigned long long)(std::min(shape.h, ty1 + halo) - std::max(0, ty0 - halo)) *
+				(std::min(shape.w, tx1 + halo) - std::max(0, tx0 - halo));
+			in_pixels += (unsigned long long)(std::min(shape.h, ty1 + in_halo) - std::max(0, ty0 - in_halo)) *
+				(std::min(shape.w, tx1 + in_halo) - std::max(0, tx0 - in_halo));
+		}
+	}
+	const unsigned long long pixel_bytes = (unsigned long long)shape.c * sizeof(float);
+	bytes_read = in_pixels * pixel_bytes * shape.n;
+	bytes_written = (unsigned long long)shape.h * shape.w * pixel_bytes * shape.n;
+	halo_overhead = (double)conv1_pixels / ((double)shape.h * shape.w);
+}
+
+void ecpu::FusedResidualBlock::executeTile(const PlaneView& in, const PlaneView& out, int ty0, int ty1, int tx0, int tx1, float* scratch)
+{
+	const int halo = conv2.Padding();
+
+	// conv1 is needed for the tile plus the halo conv2 reads, clipped to the frame.
+	// Pixels outside the frame are left out of the window so conv2 pads there like on the full frame
+	PlaneView temp;
+	temp.y0 = std::max(0, ty0 - halo);
+	temp.x0 = std::max(0, tx0 - halo);
+	temp.height = std::min(in.height, ty1 + halo) - temp.y0;
+	temp.width = std::min(in.width, tx1 + halo) - temp.x0;
+	temp.channels = conv1.OutputChannels();
+	temp.pixel_stride = conv1.PaddedOutputChannels();
+	temp.row_stride = (ptrdiff_t)temp.width * temp.pixel_stride;
+	temp.data = scratch;
+
+	Convolve(in, conv1, true, nullptr, temp, temp.y0, temp.y0 + temp.height, temp.x0, temp.x0 + temp.width);
+	Convolve(temp, conv2, false, &in, out, ty0, ty1, tx0, tx1);
+}
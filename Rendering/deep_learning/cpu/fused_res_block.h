@@ -0,0 +1,48 @@
+#pragma once
+#include "cpu_conv.h"
+
+namespace ecpu
+{
+	// Residual block out = in + conv2(relu(conv1(in))) executed one spatial tile at a time.
+	// Each tile computes conv1 over the tile plus a one pixel halo into per thread scratch
+	// memory sized to stay in L2, then runs conv2 and the residual add straight from that
+	// scratch. The intermediate tensor never exists as a full frame, which removes two frame
+	// sized writes and three frame sized reads per block compared to the layer by layer schedule.
+	class FusedResidualBlock
+	{
+	public:
+		// cache_budget is the number of bytes of intermediate data one tile may keep in cache
+		FusedResidualBlock(const ConvWeights& conv1, const ConvWeights& conv2, size_t cache_budget = 192 * 1024);
+
+		// in and out must be different tensors, out is resized to fit
+		void Execute(const Tensor& in, Tensor& out, ThreadPool& pool);
+
+		// Tile size used for the last executed frame
+		int TileWidth() const { return tile_width; };
+		int TileHeight() const { return tile_height; };
+
+		// Bytes of full frame tensors read and written by the last Execute, halo reads included
+		unsigned long long BytesRead() const { return bytes_read; };
+		unsigned long long BytesWritten() const { return bytes_written; };
+
+		// Ratio between the conv1 pixels computed and the pixels of the frame, 1.0 means no recomputation
+		double HaloOverhead() const { return halo_overhead; };
+
+	private:
+		void chooseTileSize(int width, int height);
+		void executeTile(const PlaneView& in, const PlaneView& out, int ty0, int ty1, int tx0, int tx1, float* scratch);
+
+	private:
+		const ConvWeights& conv1;
+		const ConvWeights& conv2;
+		size_t cache_budget;
+
+		int tile_width = 0;
+		int tile_height = 0;
+		std::vector<AlignedVector<float>> scratch;
+
+		unsigned long long bytes_read = 0;
+		unsigned long long bytes_written = 0;
+		double halo_overhead = 1.0;
+	};
+}
@@ -0,0 +1,162 @@
+#include "incremental_executor.h"
+#include "cpu/simd.h"
+#include "cpu/timer.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	// Side of the square blocks of input pixels changes are tracked in
+	const int block_size = 8;
+}
+
+ecpu::IncrementalExecutor::IncrementalExecutor(MasterNet& net, float threshold, int tile_size)
+	: net(net), tiled(net, std::numeric_limits<size_t>::max(), tile_size), threshold(threshold), tile_size(tile_size), halo(tiled.Halo())
+{
+	if (tile_size < 1)
+		throw std::runtime_error("Incremental execution needs a fixed tile size");
+}
+
+void ecpu::IncrementalExecutor::findChangedBlocks(const Tensor& input, ThreadPool& pool)
+{
+	const TensorShape& s = input.Shape();
+	const int blocks = blocks_x * blocks_y;
+
+	pool.ParallelFor(s.n * blocks, [&](int task)
+		{
+			const int n = task / blocks;
+			const int by = (task % blocks) / blocks_x;
+			const int bx = (task % blocks) % blocks_x;
+			const int y1 = std::min(s.h, (by + 1) * block_size);
+			const int x0 = bx * block_size;
+			const size_t count = (size_t)(std::min(s.w, x0 + block_size) - x0) * s.c;
+			const PlaneView current = input.Plane(n);
+			const PlaneView previous = reference.Plane(n);
+
+			// Rows of a block are contiguous, compared eight floats at a time with an early out
+			bool dirty = false;
+			for (int y = by * block_size; y < y1 && !dirty; y++)
+			{
+				const float* a = current.At(y, x0);
+				const float* b = previous.At(y, x0);
+				float8 diff = float8::Zero();
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8)
+					diff = float8::Max(diff, float8::Abs(float8::Load(a + i) - float8::Load(b + i)));
+				float max_diff = diff.MaxElement();
+				for (; i < count; i++)
+					max_diff = std::max(max_diff, std::abs(a[i] - b[i]));
+				dirty = max_diff > threshold;
+			}
+			changed[task] = dirty;
+		});
+}
+
+void ecpu::IncrementalExecutor::updateReference(const Tensor& input, ThreadPool& pool)
+{
+	const TensorShape& s = input.Shape();
+	const int blocks = blocks_x * blocks_y;
+	pool.ParallelFor(s.n * blocks, [&](int task)
+		{
+			if (!changed[task])
+				return;
+			const int n = task / blocks;
+			const int by = (task % blocks) / blocks_x;
+			const int x0 = ((task % blocks) % blocks_x) * block_size;
+			const size_t bytes = (size_t)(std::min(s.w, x0 + block_size) - x0) * s.c * sizeof(float);
+			for (int y = by * block_size; y < std::min(s.h, (by + 1) * block_size); y++)
+				std::memcpy(reference.Plane(n).At(y, x0), input.Plane(n).At(y, x0), bytes);
+		});
+}
+
+const ecpu::Tensor& ecpu::IncrementalExecutor::Execute(const Tensor& input, ThreadPool& pool)
+{
+	Timer timer;
+	const TensorShape& s = input.Shape();
+	const NetworkGraph& graph = net.GetGraph();
+	const TensorShape out_shape = graph.InferShapes(s)[graph.OutputTensor()];
+	if (out_shape.h != s.h || out_shape.w != s.w)
+		throw std::runtime_error("Incremental execution needs a network keeping the input resolution");
+
+	blocks_x = (s.w + block_size - 1) / block_size;
+	blocks_y = (s.h + block_size - 1) / block_size;
+	last_stats = Stats();
+
+	// Without a previous frame of this shape everything is new
+	const bool full = reference_shape != s;
+	if (full)
+	{
+		reference_shape = s;
+		reference.Resize(s);
+		output.Resize(out_shape);
+		changed.assign((size_t)s.n * blocks_x * blocks_y, 1);
+	}
+	else
+	{
+		changed.resize((size_t)s.n * blocks_x * blocks_y);
+		findChangedBlocks(input, pool);
+	}
+
+	// A tile is dirty when any block of the input region it reads changed
+	const int tiles_x = (s.w + tile_size - 1) / tile_size;
+	const int tiles_y = (s.h + tile_size - 1) / tile_size;
+	dirty_tiles.assign((size_t)s.n * tiles_x * tiles_y, 0);
+	size_t tiled_pixels = 0;
+	for (int n = 0; n < s.n; n++)
+	{
+		for (int ty = 0; ty < tiles_y; ty++)
+		{
+			for (int tx = 0; tx < tiles_x; tx++)
+			{
+				const int y0 = ty * tile_size;
+				const int x0 = tx * tile_size;
+				const int y1 = std::min(s.h, y0 + tile_size);
+				const int x1 = std::min(s.w, x0 + tile_size);
+				const int in_y0 = std::max(y0 - halo, 0);
+				const int in_x0 = std::max(x0 - halo, 0);
+				const int in_y1 = std::min(y1 + halo, s.h);
+				const int in_x1 = std::min(x1 + halo, s.w);
+
+				bool dirty = full;
+				for (int by = in_y0 / block_size; by <= (in_y1 - 1) / block_size && !dirty; by++)
+					for (int bx = in_x0 / block_size; bx <= (in_x1 - 1) / block_size && !dirty; bx++)
+						dirty = changed[((size_t)n * blocks_y + by) * blocks_x + bx] != 0;
+
+				last_stats.tiles++;
+				last_stats.total_pixels += (size_t)(y1 - y0) * (x1 - x0);
+				if (dirty)
+				{
+					dirty_tiles[((size_t)n * tiles_y + ty) * tiles_x + tx] = 1;
+					last_stats.computed_tiles++;
+					last_stats.computed_pixels += (size_t)(y1 - y0) * (x1 - x0);
+					tiled_pixels += (size_t)(in_y1 - in_y0) * (in_x1 - in_x0);
+				}
+			}
+		}
+	}
+
+	// Tiles recompute their halo, so once they would cover more than the frame a full run is cheaper
+	if (tiled_pixels >= (size_t)s.n * s.h * s.w)
+	{
+		net.Execute(input, output, pool);
+		last_stats.computed_tiles = last_stats.tiles;
+		last_stats.computed_pixels = last_stats.total_pixels;
+	}
+	else if (last_stats.computed_tiles > 0)
+	{
+		tiled.Execute(input, output, pool, [&](int n, int y0, int, int x0, int)
+			{
+				return dirty_tiles[((size_t)n * tiles_y + y0 / tile_size) * tiles_x + x0 / tile_size] != 0;
+			});
+	}
+
+	if (full)
+		std::memcpy(reference.Data(), input.Data(), s.ByteSize());
+	else
+		updateReference(input, pool);
+
+	last_stats.seconds = timer.Elapsed();
+	return output;
+}
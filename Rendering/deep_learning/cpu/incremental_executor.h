@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include "tiled_executor.h"
+
+namespace ecpu
+{
+	// Change driven MasterNet execution for mostly static video. The output is cached between
+	// calls and only tiles whose receptive field saw an input change are recomputed, through the
+	// TiledExecutor. The network input holds color, depth and the reprojected history, so
+	// thresholding it covers changes in all of them.
+	// Changes are tracked per block of input pixels as the largest difference from a reference
+	// input. A block changing by more than the threshold marks every tile reading it dirty and
+	// becomes the new reference there. Blocks below the threshold keep their reference, so slow
+	// drift is caught once it adds up. A threshold of 0 recomputes every changed tile and the
+	// output is bit identical to MasterNet::Execute. Tiles recompute the halo around them, so when
+	// that would cost more than the whole frame the frame is run in one go instead.
+	class IncrementalExecutor
+	{
+	public:
+		struct Stats
+		{
+			int tiles = 0;
+			int computed_tiles = 0;
+			size_t computed_pixels = 0;	// Output pixels of the computed tiles
+			size_t total_pixels = 0;
+			double seconds = 0.0;
+
+			double SkippedRatio() const { return total_pixels > 0 ? 1.0 - (double)computed_pixels / total_pixels : 0.0; };
+		};
+
+	public:
+		// The network must keep the input resolution, like MasterNet does
+		IncrementalExecutor(MasterNet& net, float threshold = 0.0f, int tile_size = 32);
+
+		// Returns the output for input, valid until the next call
+		const Tensor& Execute(const Tensor& input, ThreadPool& pool);
+
+		// The next Execute recomputes everything
+		void Reset() { reference_shape = TensorShape(); };
+
+		const Stats& GetLastStats() const { return last_stats; };
+		float Threshold() const { return threshold; };
+
+	private:
+		// Marks blocks changed by more than the threshold
+		void findChangedBlocks(const Tensor& input, ThreadPool& pool);
+		void updateReference(const Tensor& input, ThreadPool& pool);
+
+	private:
+		MasterNet& net;
+		TiledExecutor tiled;
+		float threshold;
+		int tile_size;
+		int halo;
+
+		TensorShape reference_shape;
+		Tensor reference;
+		Tensor output;
+		int blocks_x = 0;
+		int blocks_y = 0;
+		std::vector<char> changed;		// Per block of every image
+		std::vector<char> dirty_tiles;	// Per tile of every image
+		Stats last_stats;
+	};
+}
@@ -0,0 +1,221 @@
+#include "network_graph.h"
+#include "cpu_conv.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	std::string lineError(int line, const std::string& message)
+	{
+		return "Network graph line " + std::to_string(line) + ": " + message;
+	}
+
+	// Splits "key=value" into its parts, a bare "key" gets an empty value
+	void splitOption(const std::string& token, std::string& key, std::string& value)
+	{
+		size_t split = token.find('=');
+		key = token.substr(0, split);
+		value = split == std::string::npos ? "" : token.substr(split + 1);
+	}
+
+	int parseInt(const std::string& value, int line)
+	{
+		try
+		{
+			size_t used = 0;
+			int out = std::stoi(value, &used);
+			if (used == value.size() && out > 0)
+				return out;
+		}
+		catch (const std::exception&) {}
+		throw std::runtime_error(lineError(line, "expected a positive integer, got '" + value + "'"));
+	}
+}
+
+ecpu::NetworkGraph ecpu::NetworkGraph::Parse(std::istream& stream)
+{
+	NetworkGraph graph;
+	std::string text;
+	int line = 0;
+	while (std::getline(stream, text))
+	{
+		line++;
+		std::istringstream tokens(text);
+		std::string op;
+		if (!(tokens >> op) || op[0] == '#')
+			continue;
+
+		std::vector<std::string> names;
+		GraphLayer layer;
+		int channels = 0;
+		std::string token;
+		while (tokens >> token)
+		{
+			std::string key, value;
+			splitOption(token, key, value);
+			if (value.empty() && key != "relu" && key != "replicate")
+				names.push_back(key);
+			else if (key == "channels")
+				channels = parseInt(value, line);
+			else if (key == "weights")
+				layer.weights = value;
+			else if (key == "size")
+				layer.filter_size = parseInt(value, line);
+			else if (key == "stride")
+				layer.stride = parseInt(value, line);
+			else if (key == "unshuffle")
+				layer.unshuffle = parseInt(value, line);
+			else if (key == "relu")
+				layer.relu = true;
+			else if (key == "replicate")
+				layer.replicate = true;
+			else
+				throw std::runtime_error(lineError(line, "unknown option " + key));
+		}
+
+		if (op == "input")
+		{
+			if (names.size() != 1 || channels == 0 || graph.input >= 0)
+				throw std::runtime_error(lineError(line, "expected a single 'input <name> channels=<n>'"));
+			graph.input = graph.addTensor(names[0], channels, line);
+		}
+		else if (op == "output")
+		{
+			if (names.size() != 1)
+				throw std::runtime_error(lineError(line, "expected 'output <name>'"));
+			graph.output = graph.findTensor(names[0], line);
+		}
+		else if (op == "conv")
+		{
+			if (names.size() != 2 || channels == 0 || layer.weights.empty())
+				throw std::runtime_error(lineError(line, "expected 'conv <output> <input> weights=<name> channels=<n>'"));
+			layer.type = GraphLayer::Type::Conv;
+			layer.inputs = { graph.findTensor(names[1], line) };
+			layer.output = graph.addTensor(names[0], channels, line);
+			if (graph.tensors[layer.inputs[0]].channels % (layer.unshuffle * layer.unshuffle) != 0)
+				throw std::runtime_error(lineError(line, "input channels are not divisible by the unshuffle factor squared"));
+			graph.layers.push_back(layer);
+		}
+		else if (op == "add")
+		{
+			if (names.size() != 3)
+				throw std::runtime_error(lineError(line, "expected 'add <output> <a> <b>'"));
+			layer.type = GraphLayer::Type::Add;
+			layer.inputs = { graph.findTensor(names[1], line), graph.findTensor(names[2], line) };
+			if (graph.tensors[layer.inputs[0]].channels != graph.tensors[layer.inputs[1]].channels)
+				throw std::runtime_error(lineError(line, "add inputs have different channel counts"));
+			layer.output = graph.addTensor(names[0], graph.tensors[layer.inputs[0]].channels, line);
+			graph.layers.push_back(layer);
+		}
+		else
+		{
+			throw std::runtime_error(lineError(line, "unknown layer type " + op));
+		}
+	}
+
+	if (graph.input < 0 || graph.output < 0 || graph.layers.empty())
+		throw std::runtime_error("Network graph needs an input, an output and at least one layer");
+	return graph;
+}
+
+ecpu::NetworkGraph ecpu::NetworkGraph::Load(const std::string& file_path)
+{
+	std::ifstream file(file_path);
+	if (file.fail())
+		throw std::runtime_error("Failed to load file " + file_path);
+	return Parse(file);
+}
+
+std::string ecpu::NetworkGraph::SidecarPath(const std::string& weight_path)
+{
+	size_t dot = weight_path.find_last_of('.');
+	size_t slash = weight_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return weight_path + ".graph";
+	return weight_path.substr(0, dot) + ".graph";
+}
+
+std::vector<ecpu::TensorShape> ecpu::NetworkGraph::InferShapes(const TensorShape& input_shape) const
+{
+	if (input_shape.c != tensors[input].channels)
+		throw std::runtime_error("Network input has " + std::to_string(input_shape.c) +
+			" channels, the graph expects " + std::to_string(tensors[input].channels));
+
+	std::vector<TensorShape> shapes(tensors.size());
+	shapes[input] = input_shape;
+	for (const auto& layer : layers)
+	{
+		const TensorShape& in = shapes[layer.inputs[0]];
+		if (layer.type == GraphLayer::Type::Conv)
+			shapes[layer.output] = TensorShape(in.n,
+				ConvOutputSize(in.h, layer.filter_size, layer.stride),
+				ConvOutputSize(in.w, layer.filter_size, layer.stride),
+				tensors[layer.output].channels);
+		else if (in != shapes[layer.inputs[1]])
+			throw std::runtime_error("Add layer writing " + tensors[layer.output].name + " has inputs of different shapes");
+		else
+			shapes[layer.output] = in;
+	}
+	return shapes;
+}
+
+std::vector<ecpu::PlanStep> ecpu::NetworkGraph::PlanSteps() const
+{
+	std::vector<PlanStep> steps(layers.size());
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		steps[i].inputs = layers[i].inputs;
+		steps[i].output = layers[i].output;
+		steps[i].elementwise = layers[i].type == GraphLayer::Type::Add;
+	}
+	return steps;
+}
+
+std::vector<int> ecpu::NetworkGraph::ConsumerCounts() const
+{
+	std::vector<int> counts(tensors.size(), 0);
+	for (const auto& layer : layers)
+		for (int in : layer.inputs)
+			counts[in]++;
+	return counts;
+}
+
+std::vector<float> ecpu::NetworkGraph::ConvFilter(const GraphLayer& layer, const WeightMap& weight_map) const
+{
+	const std::vector<float>& weights = GetWeights(weight_map, layer.weights + ".weight");
+	const int output_channels = tensors[layer.output].channels;
+	const int input_channels = tensors[layer.inputs[0]].channels;
+	const int r = layer.unshuffle;
+	if (weights.size() != (size_t)output_channels * input_channels * layer.filter_size * layer.filter_size)
+		throw std::runtime_error("Parameter " + layer.weights + ".weight does not match the layer shape in the graph");
+
+	if (r == 1)
+		return weights;
+	return PixelUnshuffleFilter(weights, output_channels, input_channels / (r * r), layer.filter_size * r, r);
+}
+
+const std::vector<float>& ecpu::NetworkGraph::ConvBias(const GraphLayer& layer, const WeightMap& weight_map) const
+{
+	const std::vector<float>& bias = GetWeights(weight_map, layer.weights + ".bias");
+	if (bias.size() != (size_t)tensors[layer.output].channels)
+		throw std::runtime_error("Parameter " + layer.weights + ".bias does not match the layer shape in the graph");
+	return bias;
+}
+
+int ecpu::NetworkGraph::findTensor(const std::string& name, int line) const
+{
+	for (int i = 0; i < (int)tensors.size(); i++)
+		if (tensors[i].name == name)
+			return i;
+	throw std::runtime_error(lineError(line, "tensor " + name + " is used before it is written"));
+}
+
+int ecpu::NetworkGraph::addTensor(const std::string& name, int channels, int line)
+{
+	for (const auto& t : tensors)
+		if (t.name == name)
+			throw std::runtime_error(lineError(line, "tensor " + name + " is written twice"));
+	tensors.push_back({ name, channels });
+	return (int)tensors.size() - 1;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <istream>
+#include "cpu/tensor.h"
+#include "weight_file.h"
+#include "buffer_planner.h"
+
+namespace ecpu
+{
+	struct GraphTensor
+	{
+		std::string name;
+		int channels = 0;
+	};
+
+	struct GraphLayer
+	{
+		enum class Type
+		{
+			Conv,
+			Add
+		};
+
+		Type type = Type::Conv;
+		std::vector<int> inputs;	// Tensor indices
+		int output = -1;
+
+		// Convolution parameters
+		std::string weights;		// Parameter prefix in the weight file, "<weights>.weight" and "<weights>.bias"
+		int filter_size = 1;
+		int stride = 1;
+		int unshuffle = 1;			// Weights are stored for a filter_size * unshuffle filter over pixel-shuffled input
+		bool relu = false;
+		bool replicate = false;		// Pads with the nearest edge pixel like padding_mode='replicate', otherwise zeros
+	};
+
+	// Layer graph of a network, read from the .graph sidecar written next to the weights by
+	// utils.SaveNetworkGraph in Network/utils.py. One layer per line, in execution order:
+	//
+	//   input x channels=128
+	//   conv t0 x weights=down.0 channels=32 size=1 unshuffle=4
+	//   conv t1 t0 weights=cnn1.0 channels=32 size=3 relu replicate
+	//   add t2 t0 t1
+	//   output t2
+	//
+	// Lines starting with # are comments. Tensor names are defined by the layer writing them
+	class NetworkGraph
+	{
+	public:
+		static NetworkGraph Parse(std::istream& stream);
+		static NetworkGraph Load(const std::string& file_path);
+
+		// Graph file belonging to a weight file, "nn_weights_200.bin" -> "nn_weights_200.graph"
+		static std::string SidecarPath(const std::string& weight_path);
+
+		const std::vector<GraphTensor>& Tensors() const { return tensors; };
+		const std::vector<GraphLayer>& Layers() const { return layers; };
+		int InputTensor() const { return input; };
+		int OutputTensor() const { return output; };
+
+		// Shape of every tensor for the given input shape
+		std::vector<TensorShape> InferShapes(const TensorShape& input_shape) const;
+
+		// Layers as seen by the buffer planner, element wise layers may write over their inputs
+		std::vector<PlanStep> PlanSteps() const;
+
+		// Number of layers reading each tensor
+		std::vector<int> ConsumerCounts() const;
+
+		// Filter of a convolution in PyTorch layout, rearranged for pixel-shuffled input when
+		// the layer has an unshuffle factor. Throws if the parameter count does not match the layer
+		std::vector<float> ConvFilter(const GraphLayer& layer, const WeightMap& weight_map) const;
+		const std::vector<float>& ConvBias(const GraphLayer& layer, const WeightMap& weight_map) const;
+
+	private:
+		int findTensor(const std::string& name, int line) const;
+		int addTensor(const std::string& name, int channels, int line);
+
+	private:
+		std::vector<GraphTensor> tensors;
+		std::vector<GraphLayer> layers;
+		int input = -1;
+		int output = -1;
+	};
+}
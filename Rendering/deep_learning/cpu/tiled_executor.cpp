@@ -0,0 +1,248 @@
+#include "tiled_executor.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	// Smallest tile considered when fitting the memory cap, below this the halo dominates
+	const int min_tile_size = 8;
+	// Tiles are not made smaller than this just to give more threads work
+	const int min_parallel_tile_size = 32;
+
+	// Copies the window of dst out of src, both must store their pixels densely
+	void copyWindow(const ecpu::PlaneView& src, const ecpu::PlaneView& dst)
+	{
+		const size_t row_bytes = (size_t)dst.width * dst.channels * sizeof(float);
+		for (int y = dst.y0; y < dst.y0 + dst.height; y++)
+			std::memcpy(dst.At(y, dst.x0), src.At(y, dst.x0), row_bytes);
+	}
+}
+
+ecpu::TiledExecutor::TiledExecutor(const MasterNet& net, size_t memory_cap, int tile_size)
+	: net(net), memory_cap(memory_cap), requested_tile_size(tile_size)
+{
+}
+
+int ecpu::TiledExecutor::Halo() const
+{
+	Region pixel;
+	pixel.y1 = 1;
+	pixel.x1 = 1;
+	return -requiredRegions(pixel, false)[net.GetGraph().InputTensor()].y0;
+}
+
+std::vector<ecpu::TiledExecutor::Region> ecpu::TiledExecutor::requiredRegions(const Region& output_region, bool clip) const
+{
+	const NetworkGraph& graph = net.GetGraph();
+	const auto& layers = graph.Layers();
+	std::vector<Region> regions(graph.Tensors().size());
+	regions[graph.OutputTensor()] = output_region;
+
+	// Walk the graph backwards growing every input by the footprint of the layers reading it
+	for (int i = (int)layers.size() - 1; i >= 0; i--)
+	{
+		const GraphLayer& layer = layers[i];
+		const Region& out = regions[layer.output];
+		if (out.Empty())
+			continue;
+
+		Region in = out;
+		if (layer.type == GraphLayer::Type::Conv)
+		{
+			const int pad = ConvPadding(layer.filter_size, layer.stride);
+			in.y0 = out.y0 * layer.stride - pad;
+			in.x0 = out.x0 * layer.stride - pad;
+			in.y1 = (out.y1 - 1) * layer.stride - pad + layer.filter_size;
+			in.x1 = (out.x1 - 1) * layer.stride - pad + layer.filter_size;
+		}
+
+		for (int t : layer.inputs)
+		{
+			if (clip)
+			{
+				in.y0 = std::max(in.y0, 0);
+				in.x0 = std::max(in.x0, 0);
+				in.y1 = std::min(in.y1, shapes[t].h);
+				in.x1 = std::min(in.x1, shapes[t].w);
+			}
+
+			Region& r = regions[t];
+			if (r.Empty())
+			{
+				r = in;
+			}
+			else
+			{
+				r.y0 = std::min(r.y0, in.y0);
+				r.x0 = std::min(r.x0, in.x0);
+				r.y1 = std::max(r.y1, in.y1);
+				r.x1 = std::max(r.x1, in.x1);
+			}
+		}
+	}
+	return regions;
+}
+
+ecpu::BufferPlan ecpu::TiledExecutor::tilePlan(int size) const
+{
+	// Worst case tile, far enough from the frame border that no region gets clipped
+	Region tile;
+	tile.y1 = size;
+	tile.x1 = size;
+	auto regions = requiredRegions(tile, false);
+
+	const auto& tensors = net.GetGraph().Tensors();
+	std::vector<size_t> bytes(tensors.size());
+	for (size_t t = 0; t < tensors.size(); t++)
+		bytes[t] = regions[t].Pixels() * tensors[t].channels * sizeof(float);
+
+	// No element wise layer works in place here, the regions of its inputs are usually larger
+	// than its output so the two could not share a row layout
+	auto steps = net.GetGraph().PlanSteps();
+	for (auto& step : steps)
+		step.elementwise = false;
+	return PlanBuffers(ComputeLifetimes(steps, bytes));
+}
+
+void ecpu::TiledExecutor::configure(const TensorShape& shape, int thread_count)
+{
+	const NetworkGraph& graph = net.GetGraph();
+	input_shape = shape;
+	shapes = graph.InferShapes(shape);
+	const TensorShape& out = shapes[graph.OutputTensor()];
+	const int max_side = std::max(out.h, out.w);
+
+	if (requested_tile_size > 0)
+	{
+		tile_size = requested_tile_size;
+	}
+	else
+	{
+		if (tilePlan(min_tile_size).TotalBytes() * thread_count > memory_cap)
+			throw std::runtime_error("Memory cap is too small for " + std::to_string(thread_count) + " parallel tiles");
+
+		// Largest tile whose buffers fit the cap for every thread, buffer sizes grow with the tile
+		int lo = min_tile_size;
+		int hi = std::max(max_side, min_tile_size);
+		while (lo < hi)
+		{
+			int mid = (lo + hi + 1) / 2;
+			if (tilePlan(mid).TotalBytes() * thread_count <= memory_cap)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		tile_size = lo;
+
+		// Aim for two tiles per thread so uneven tiles at the border do not leave threads idle
+		if (thread_count > 1)
+		{
+			int parallel_size = (int)std::sqrt((double)out.h * out.w / (2.0 * thread_count));
+			tile_size = std::min(tile_size, std::max(parallel_size, min_parallel_tile_size));
+		}
+	}
+
+	plan = tilePlan(tile_size);
+	working_set_bytes = plan.TotalBytes() * thread_count;
+	if (working_set_bytes > memory_cap)
+		throw std::runtime_error("Tile size " + std::to_string(tile_size) + " does not fit the memory cap");
+
+	thread_buffers.resize(thread_count);
+	for (auto& buffers : thread_buffers)
+	{
+		buffers.resize(plan.buffer_sizes.size());
+		for (size_t b = 0; b < buffers.size(); b++)
+			buffers[b].resize(plan.buffer_sizes[b] / sizeof(float));
+	}
+
+	tile_count = ((out.h + tile_size - 1) / tile_size) * ((out.w + tile_size - 1) / tile_size) * out.n;
+}
+
+void ecpu::TiledExecutor::Execute(const TensorShape& shape, const TileFunction& fill_input, const TileFunction& write_output, ThreadPool& pool,
+	const TileSelector& select)
+{
+	if (shape != input_shape || (int)thread_buffers.size() != pool.ThreadCount())
+		configure(shape, pool.ThreadCount());
+
+	const TensorShape& out = shapes[net.GetGraph().OutputTensor()];
+	const int tiles_x = (out.w + tile_size - 1) / tile_size;
+	const int tiles_y = (out.h + tile_size - 1) / tile_size;
+	const int tiles = tiles_x * tiles_y;
+	auto tileRegion = [&](int task)
+	{
+		Region tile;
+		tile.y0 = ((task % tiles) / tiles_x) * tile_size;
+		tile.x0 = ((task % tiles) % tiles_x) * tile_size;
+		tile.y1 = std::min(out.h, tile.y0 + tile_size);
+		tile.x1 = std::min(out.w, tile.x0 + tile_size);
+		return tile;
+	};
+
+	std::vector<int> tasks;
+	tasks.reserve(tile_count);
+	for (int task = 0; task < tile_count; task++)
+	{
+		Region tile = tileRegion(task);
+		if (!select || select(task / tiles, tile.y0, tile.y1, tile.x0, tile.x1))
+			tasks.push_back(task);
+	}
+
+	pool.ParallelFor((int)tasks.size(), [&](int i, int thread_index)
+		{
+			executeTile(tasks[i] / tiles, tileRegion(tasks[i]), fill_input, write_output, thread_index);
+		});
+}
+
+void ecpu::TiledExecutor::Execute(const Tensor& input, Tensor& output, ThreadPool& pool, const TileSelector& select)
+{
+	const NetworkGraph& graph = net.GetGraph();
+	output.Resize(graph.InferShapes(input.Shape())[graph.OutputTensor()]);
+	Execute(input.Shape(),
+		[&](int n, const PlaneView& window) { copyWindow(input.Plane(n), window); },
+		[&](int n, const PlaneView& tile) { copyWindow(tile, output.Plane(n).Window(tile.y0, tile.x0, tile.height, tile.width)); },
+		pool, select);
+}
+
+void ecpu::TiledExecutor::executeTile(int n, const Region& tile, const TileFunction& fill_input, const TileFunction& write_output, int thread_index)
+{
+	const NetworkGraph& graph = net.GetGraph();
+	const auto& tensors = graph.Tensors();
+	auto regions = requiredRegions(tile, true);
+	auto& buffers = thread_buffers[thread_index];
+
+	// Every tensor is stored densely over its region at the start of its planned buffer
+	std::vector<PlaneView> views(tensors.size());
+	for (size_t t = 0; t < tensors.size(); t++)
+	{
+		const Region& r = regions[t];
+		if (r.Empty())
+			continue;
+		PlaneView& v = views[t];
+		v.data = buffers[plan.tensor_buffers[t]].data();
+		v.y0 = r.y0;
+		v.x0 = r.x0;
+		v.height = r.y1 - r.y0;
+		v.width = r.x1 - r.x0;
+		v.channels = tensors[t].channels;
+		v.pixel_stride = v.channels;
+		v.row_stride = (ptrdiff_t)v.width * v.channels;
+	}
+
+	fill_input(n, views[graph.InputTensor()]);
+
+	const auto& layers = graph.Layers();
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		const GraphLayer& layer = layers[i];
+		const Region& r = regions[layer.output];
+		if (r.Empty())
+			continue;
+		if (layer.type == GraphLayer::Type::Conv)
+			Convolve(views[layer.inputs[0]], net.GetLayerWeights((int)i), layer.relu, nullptr, views[layer.output], r.y0, r.y1, r.x0, r.x1);
+		else
+			Add(views[layer.inputs[0]], views[layer.inputs[1]], views[layer.output], r.y0, r.y1, r.x0, r.x1);
+	}
+
+	write_output(n, views[graph.OutputTensor()]);
+}
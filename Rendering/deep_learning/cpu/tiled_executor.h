@@ -0,0 +1,80 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "cpu_master_net.h"
+
+namespace ecpu
+{
+	// Runs a MasterNet graph one output tile at a time so memory stays bounded at any resolution.
+	// Each tile computes every tensor over the region its output depends on, which is the tile
+	// grown by the receptive field of the remaining layers and clipped to the frame. Regions are
+	// only cut short at the frame border, so tiles pad like the full frame run, and the
+	// accumulation order of the kernels does not depend on the window, so stitched tiles are bit
+	// identical to MasterNet::Execute. Tiles are spread over the thread pool, each thread owning one set of
+	// tile buffers laid out by the buffer planner.
+	class TiledExecutor
+	{
+	public:
+		// Fills or consumes a window of image n of the network input or output, in frame
+		// coordinates of that tensor
+		using TileFunction = std::function<void(int n, const PlaneView& window)>;
+		// Decides whether the tile of image n covering output rows [y0, y1) and columns [x0, x1) is
+		// computed. Called on the calling thread before any tile runs
+		using TileSelector = std::function<bool(int n, int y0, int y1, int x0, int x1)>;
+
+		// memory_cap bounds the tile buffers of all threads together. A tile_size of 0 picks the
+		// largest square tile that fits the cap while still giving every thread work
+		TiledExecutor(const MasterNet& net, size_t memory_cap, int tile_size = 0);
+
+		// Streaming execution, fill_input is called for the input window of every tile and
+		// write_output with the finished output tile. Both are called from worker threads. Without a
+		// selector every tile is computed
+		void Execute(const TensorShape& input_shape, const TileFunction& fill_input, const TileFunction& write_output, ThreadPool& pool,
+			const TileSelector& select = nullptr);
+
+		// Convenience version reading and writing full frame tensors, with a selector only the
+		// selected tiles of output are written
+		void Execute(const Tensor& input, Tensor& output, ThreadPool& pool, const TileSelector& select = nullptr);
+
+		// Configuration chosen by the last Execute
+		int TileSize() const { return tile_size; };
+		int TileCount() const { return tile_count; };
+		size_t WorkingSetBytes() const { return working_set_bytes; };
+
+		// Extra pixels on each side of an output tile needed from the input
+		int Halo() const;
+
+	private:
+		struct Region
+		{
+			int y0 = 0;
+			int y1 = 0;
+			int x0 = 0;
+			int x1 = 0;
+
+			bool Empty() const { return y1 <= y0 || x1 <= x0; };
+			size_t Pixels() const { return Empty() ? 0 : (size_t)(y1 - y0) * (x1 - x0); };
+		};
+
+		// Region of every tensor needed to compute the given output region. With clip set, regions
+		// are clipped to the tensor shapes
+		std::vector<Region> requiredRegions(const Region& output_region, bool clip) const;
+		// Buffers of one thread for a square tile of the given size
+		BufferPlan tilePlan(int size) const;
+		void configure(const TensorShape& input_shape, int thread_count);
+		void executeTile(int n, const Region& tile, const TileFunction& fill_input, const TileFunction& write_output, int thread_index);
+
+	private:
+		const MasterNet& net;
+		size_t memory_cap;
+		int requested_tile_size;
+
+		TensorShape input_shape;
+		std::vector<TensorShape> shapes;
+		int tile_size = 0;
+		int tile_count = 0;
+		size_t working_set_bytes = 0;
+		BufferPlan plan;
+		std::vector<std::vector<AlignedVector<float>>> thread_buffers;
+	};
+}
@@ -0,0 +1,42 @@
+#include "weight_file.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+ecpu::WeightMap ecpu::LoadWeightFile(const std::string& file_path)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	if (file.fail())
+		throw std::runtime_error("Failed to load file " + file_path);
+
+	uint32_t num_weights = 0;
+	file.read(reinterpret_cast<char*>(&num_weights), 4);
+
+	WeightMap output;
+	for (uint32_t i = 0; i < num_weights; i++)
+	{
+		uint32_t name_length = 0;
+		file.read(reinterpret_cast<char*>(&name_length), 4);
+		std::string name(name_length, '\0');
+		file.read(&name[0], name_length);
+
+		uint32_t float_count = 0;
+		file.read(reinterpret_cast<char*>(&float_count), 4);
+		std::vector<float> weights(float_count);
+		file.read(reinterpret_cast<char*>(weights.data()), (std::streamsize)float_count * sizeof(float));
+
+		if (file.fail())
+			throw std::runtime_error("Weight file " + file_path + " is truncated");
+
+		output[name] = std::move(weights);
+	}
+	return output;
+}
+
+const std::vector<float>& ecpu::GetWeights(const WeightMap& weight_map, const std::string& name)
+{
+	auto it = weight_map.find(name);
+	if (it == weight_map.end())
+		throw std::runtime_error("Missing network parameter " + name);
+	return it->second;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace ecpu
+{
+	// Named float parameters as written by utils.SaveModelWeights in Network/utils.py
+	using WeightMap = std::unordered_map<std::string, std::vector<float>>;
+
+	WeightMap LoadWeightFile(const std::string& file_path);
+
+	// Returns the named parameter, throws if it is missing from the file
+	const std::vector<float>& GetWeights(const WeightMap& weight_map, const std::string& name);
+}
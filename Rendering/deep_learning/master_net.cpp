@@ -1,38 +1,18 @@
 #define NOMINMAX
-#include <fstream>
+#include <algorithm>
 #include "master_net.h"
 #include "graphics/internal/egx_internal.h"
 #include "graphics/internal/d3dx12.h"
 #include "float16_compressor.h"
-
-#define OPTIM 2
+#include "cpu/weight_file.h"
 
 namespace
 {
-    std::vector<uint16_t> pixelShuffleWeights(std::vector<uint16_t> weights, UINT output_channels, UINT input_channels, UINT kernel_size, UINT r)
+    std::vector<uint16_t> toFloat16(const std::vector<float>& weights)
     {
         std::vector<uint16_t> out(weights.size());
-        for (UINT o = 0; o < output_channels; o++)
-        {
-            for (UINT i = 0; i < input_channels; i++)
-            {
-                for (UINT y = 0; y < kernel_size; y++)
-                {
-                    for (UINT x = 0; x < kernel_size; x++)
-                    {
-                        UINT out_i = i * r * r + (y % r) * r + (x % r);
-                        UINT out_x = x / r;
-                        UINT out_y = y / r;
-                        out[o * input_channels * kernel_size * kernel_size +
-                            out_i * kernel_size * kernel_size / (r * r) +
-                            out_y * kernel_size / r + out_x] =
-                            weights[o * input_channels * kernel_size * kernel_size +
-                            i * kernel_size * kernel_size +
-                            y * kernel_size + x];
-                    }
-                }
-            }
-        }
+        for (size_t i = 0; i < weights.size(); i++)
+            out[i] = Float16Compressor::compress(weights[i]);
         return out;
     }
 }
@@ -65,77 +45,44 @@ egx::MasterNet::MasterNet(Device& dev, CommandContext& context, const ema::point
         //weight_path = "../network/MasterNet2x2/nn_weights_st2_10.bin";
         weight_path = "../network/MasterNet2x2/nn_weights_bias4-200.bin";
     }
-    auto weight_map = loadWeights(weight_path);
+    auto weight_map = ecpu::LoadWeightFile(weight_path);
+    graph = ecpu::NetworkGraph::Load(ecpu::NetworkGraph::SidecarPath(weight_path));
 
-    // Create layers
-    //UINT output_channels = 128;
-
-    // Down
-#if OPTIM == 2
-    DMLDims input_buffer_size = { 1, 128, window_size.y / 4, window_size.x / 4 };
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), input_buffer_size, 32, 1, false));
-#else
-    DMLDims input_buffer_size = { 1, 8, window_size.y, window_size.x };
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), input_buffer_size, 32, 4, false, 4));
-#endif
+    // The input is the pixel-unshuffled frame written by init_network_cs.hlsl and the output is
+    // read as two pixel-shuffled channels by finalize_network_ps.hlsl
+    const auto& tensors = graph.Tensors();
+    if (tensors[graph.InputTensor()].channels != 128 || tensors[graph.OutputTensor()].channels != 32)
+        throw std::runtime_error("Network graph must map 128 input channels to 32 output channels");
+    auto shapes = graph.InferShapes(ecpu::TensorShape(1, window_size.y / 4, window_size.x / 4, 128));
 
-    // Res block 1
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), conv_layers[0].GetOutputDims(), 32, 3, true));
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), conv_layers[1].GetOutputDims(), 32, 3, false));
-    add_layers.push_back(AddLayer(dev, dml_device.Get(), conv_layers[2].GetOutputDims()));
-
-    // Res block 2
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), add_layers[0].GetOutputDims(), 32, 3, true));
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), conv_layers[3].GetOutputDims(), 32, 3, false));
-    add_layers.push_back(AddLayer(dev, dml_device.Get(), conv_layers[4].GetOutputDims()));
-
-    // Res block 3
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), add_layers[1].GetOutputDims(), 32, 3, true));
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), conv_layers[5].GetOutputDims(), 32, 3, false));
-    add_layers.push_back(AddLayer(dev, dml_device.Get(), conv_layers[6].GetOutputDims()));
-
-    // Res block 4
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), add_layers[2].GetOutputDims(), 32, 3, true));
-    conv_layers.push_back(ConvLayer(dev, dml_device.Get(), conv_layers[7].GetOutputDims(), 32, 3, false));
-    add_layers.push_back(AddLayer(dev, dml_device.Get(), conv_layers[8].GetOutputDims()));
-
-    // Up
-#if OPTIM == 0
-    shuffle_layers.push_back(PixelShuffle(dev, dml_device.Get(), add_layers[3].GetOutputDims(), 4));
-#endif
+    // Create layers
+    for (const auto& layer : graph.Layers())
+    {
+        const auto& in = shapes[layer.inputs[0]];
+        DMLDims input_dims = { 1, (UINT)in.c, (UINT)in.h, (UINT)in.w };
+        if (layer.type == ecpu::GraphLayer::Type::Conv)
+        {
+            // DirectML convolutions only pad with zeros, so replicate layers differ from the
+            // trained model (and the CPU path) on the border pixels
+            layer_indices.push_back((UINT)conv_layers.size());
+            conv_layers.push_back(ConvLayer(dev, dml_device.Get(), input_dims, tensors[layer.output].channels, layer.filter_size, layer.relu, layer.stride));
+        }
+        else
+        {
+            layer_indices.push_back((UINT)add_layers.size());
+            add_layers.push_back(AddLayer(dev, dml_device.Get(), input_dims));
+        }
+    }
 
-    // Upload weights as biases
-    // Down
-#if OPTIM == 2
-    conv_layers[0].UploadWeights(dev, context, pixelShuffleWeights(weight_map["down.0.weight"], 32, 8, 4, 4));
-#else
-    conv_layers[0].UploadWeights(dev, context, weight_map["down.0.weight"]);
-#endif
-    conv_layers[0].UploadBias(dev, context, weight_map["down.0.bias"]);
-
-    // Res block 1
-    conv_layers[1].UploadWeights(dev, context, weight_map["cnn1.0.weight"]);
-    conv_layers[1].UploadBias(dev, context, weight_map["cnn1.0.bias"]);
-    conv_layers[2].UploadWeights(dev, context, weight_map["cnn1.2.weight"]);
-    conv_layers[2].UploadBias(dev, context, weight_map["cnn1.2.bias"]);
-
-    // Res block 2
-    conv_layers[3].UploadWeights(dev, context, weight_map["cnn2.0.weight"]);
-    conv_layers[3].UploadBias(dev, context, weight_map["cnn2.0.bias"]);
-    conv_layers[4].UploadWeights(dev, context, weight_map["cnn2.2.weight"]);
-    conv_layers[4].UploadBias(dev, context, weight_map["cnn2.2.bias"]);
-
-    // Res block 3
-    conv_layers[5].UploadWeights(dev, context, weight_map["cnn3.0.weight"]);
-    conv_layers[5].UploadBias(dev, context, weight_map["cnn3.0.bias"]);
-    conv_layers[6].UploadWeights(dev, context, weight_map["cnn3.2.weight"]);
-    conv_layers[6].UploadBias(dev, context, weight_map["cnn3.2.bias"]);
-
-    // Res block 4
-    conv_layers[7].UploadWeights(dev, context, weight_map["cnn4.0.weight"]);
-    conv_layers[7].UploadBias(dev, context, weight_map["cnn4.0.bias"]);
-    conv_layers[8].UploadWeights(dev, context, weight_map["cnn4.2.weight"]);
-    conv_layers[8].UploadBias(dev, context, weight_map["cnn4.2.bias"]);
+    // Upload weights and biases
+    for (size_t i = 0; i < graph.Layers().size(); i++)
+    {
+        const auto& layer = graph.Layers()[i];
+        if (layer.type != ecpu::GraphLayer::Type::Conv)
+            continue;
+        conv_layers[layer_indices[i]].UploadWeights(dev, context, toFloat16(graph.ConvFilter(layer, weight_map)));
+        conv_layers[layer_indices[i]].UploadBias(dev, context, toFloat16(graph.ConvBias(layer, weight_map)));
+    }
 
     dev.QueueList(context);
     dev.WaitForGPU();
@@ -143,8 +90,6 @@ egx::MasterNet::MasterNet(Device& dev, CommandContext& context, const ema::point
     // Create operator initializer
     if (conv_layers.size() > 0)
         ConvLayer::CreateConvInitializer(dev, dml_device.Get(), conv_layers);
-    if (shuffle_layers.size() > 0)
-        PixelShuffle::CreatePixelShuffleInitializer(dev, dml_device.Get(), shuffle_layers);
     if (add_layers.size() > 0)
         AddLayer::CreateAddLayerInitializer(dev, dml_device.Get(), add_layers);
 
@@ -153,13 +98,6 @@ egx::MasterNet::MasterNet(Device& dev, CommandContext& context, const ema::point
     ConvLayer::descriptor_count = ConvLayer::GetDescriptorCount(conv_layers);
     UINT descriptor_count = ConvLayer::descriptor_count * conv_layers.size();
 
-    if (shuffle_layers.size() > 0)
-    {
-        PixelShuffle::descriptor_start = descriptor_count;
-        PixelShuffle::descriptor_count = PixelShuffle::GetDescriptorCount(shuffle_layers);
-        descriptor_count = descriptor_count + PixelShuffle::descriptor_count * shuffle_layers.size();
-    }
-    
     AddLayer::descriptor_start = descriptor_count;
     AddLayer::descriptor_count = AddLayer::GetDescriptorCount(add_layers);
     descriptor_count = descriptor_count + AddLayer::descriptor_count * add_layers.size();
@@ -178,77 +116,54 @@ egx::MasterNet::MasterNet(Device& dev, CommandContext& context, const ema::point
 
     if(conv_layers.size() > 0)
         ConvLayer::InitializeConvLayers(dml_device.Get(), command_recorder.Get(), context.command_list.Get(), *descriptor_heap, conv_layers);
-    if (shuffle_layers.size() > 0)
-        PixelShuffle::InitializePixelShuffleLayers(dml_device.Get(), command_recorder.Get(), context.command_list.Get(), *descriptor_heap, shuffle_layers);
     if (add_layers.size() > 0)
         AddLayer::InitializeAddLayers(dml_device.Get(), command_recorder.Get(), context.command_list.Get(), *descriptor_heap, add_layers);
 
 
     // Set binding table from init to execute
-    conv_layers[0].CreateBindingTable(dml_device.Get(), *descriptor_heap, 0);
-    conv_layers[1].CreateBindingTable(dml_device.Get(), *descriptor_heap, 1);
-    conv_layers[2].CreateBindingTable(dml_device.Get(), *descriptor_heap, 2);
-    conv_layers[3].CreateBindingTable(dml_device.Get(), *descriptor_heap, 3);
-    conv_layers[4].CreateBindingTable(dml_device.Get(), *descriptor_heap, 4);
-    conv_layers[5].CreateBindingTable(dml_device.Get(), *descriptor_heap, 5);
-    conv_layers[6].CreateBindingTable(dml_device.Get(), *descriptor_heap, 6);
-    conv_layers[7].CreateBindingTable(dml_device.Get(), *descriptor_heap, 7);
-    conv_layers[8].CreateBindingTable(dml_device.Get(), *descriptor_heap, 8);
-    if(shuffle_layers.size() > 0)
-        shuffle_layers[0].CreateBindingTable(dml_device.Get(), *descriptor_heap, 0);
-    add_layers[0].CreateBindingTable(dml_device.Get(), *descriptor_heap, 0);
-    add_layers[1].CreateBindingTable(dml_device.Get(), *descriptor_heap, 1);
-    add_layers[2].CreateBindingTable(dml_device.Get(), *descriptor_heap, 2);
-    add_layers[3].CreateBindingTable(dml_device.Get(), *descriptor_heap, 3);
-
-    // Create input and output buffer
-    UINT64 max_int1_size = add_layers[0].GetOutputBufferSize();
-    UINT64 max_int2_size = conv_layers[0].GetOutputBufferSize();
-    UINT64 max_int3_size = add_layers[0].GetOutputBufferSize();
-    input_buffer = std::make_unique<UnorderedAccessBuffer>(dev, conv_layers[0].GetInputBufferSize());
-    intermediate_buffer1 = std::make_unique<UnorderedAccessBuffer>(dev, max_int1_size);
-    intermediate_buffer2 = std::make_unique<UnorderedAccessBuffer>(dev, max_int2_size);
-    intermediate_buffer3 = std::make_unique<UnorderedAccessBuffer>(dev, max_int3_size);
-#if OPTIM == 0
-    output_buffer = std::make_unique<UnorderedAccessBuffer>(dev, shuffle_layers[0].GetOutputBufferSize());
-#else
-    output_buffer = std::make_unique<UnorderedAccessBuffer>(dev, add_layers[3].GetOutputBufferSize());
-#endif
+    for (UINT i = 0; i < conv_layers.size(); i++)
+        conv_layers[i].CreateBindingTable(dml_device.Get(), *descriptor_heap, i);
+    for (UINT i = 0; i < add_layers.size(); i++)
+        add_layers[i].CreateBindingTable(dml_device.Get(), *descriptor_heap, i);
+
+    // Size of every tensor as laid out by DirectML
+    std::vector<size_t> tensor_bytes(tensors.size(), 0);
+    for (size_t i = 0; i < graph.Layers().size(); i++)
+    {
+        const auto& layer = graph.Layers()[i];
+        bool conv = layer.type == ecpu::GraphLayer::Type::Conv;
+        UINT64 input_size = conv ? conv_layers[layer_indices[i]].GetInputBufferSize() : add_layers[layer_indices[i]].GetInputBufferSize();
+        UINT64 output_size = conv ? conv_layers[layer_indices[i]].GetOutputBufferSize() : add_layers[layer_indices[i]].GetOutputBufferSize();
+        for (int in : layer.inputs)
+            tensor_bytes[in] = std::max(tensor_bytes[in], (size_t)input_size);
+        tensor_bytes[layer.output] = std::max(tensor_bytes[layer.output], (size_t)output_size);
+    }
+
+    // Share intermediate buffers between tensors that are never live at the same time
+    auto lifetimes = ecpu::ComputeLifetimes(graph.PlanSteps(), tensor_bytes);
+    lifetimes[graph.InputTensor()].external = true;
+    lifetimes[graph.OutputTensor()].external = true;
+    buffer_plan = ecpu::PlanBuffers(lifetimes);
+
+    // Create input, output and intermediate buffers
+    input_buffer = std::make_unique<UnorderedAccessBuffer>(dev, tensor_bytes[graph.InputTensor()]);
+    output_buffer = std::make_unique<UnorderedAccessBuffer>(dev, tensor_bytes[graph.OutputTensor()]);
+    for (size_t size : buffer_plan.buffer_sizes)
+        intermediate_buffers.push_back(std::make_unique<UnorderedAccessBuffer>(dev, size));
 
     input_buffer->CreateUnorderedAccessView(dev, true);
     output_buffer->CreateUnorderedAccessView(dev, true);
     input_buffer->CreateShaderResourceView(dev);
     output_buffer->CreateShaderResourceView(dev);
 
-    // Down
-    //shuffle_layers[0].BindResources(input_buffer->buffer.Get(), intermediate_buffer1->buffer.Get());
-    conv_layers[0].BindResources(input_buffer->buffer.Get(), intermediate_buffer3->buffer.Get());
-
-    // Res block 1
-    conv_layers[1].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer1->buffer.Get());
-    conv_layers[2].BindResources(intermediate_buffer1->buffer.Get(), intermediate_buffer2->buffer.Get());
-    add_layers[0].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer2->buffer.Get(), intermediate_buffer3->buffer.Get());
-
-    // Res block 2
-    conv_layers[3].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer1->buffer.Get());
-    conv_layers[4].BindResources(intermediate_buffer1->buffer.Get(), intermediate_buffer2->buffer.Get());
-    add_layers[1].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer2->buffer.Get(), intermediate_buffer3->buffer.Get());
-
-    // Res block 3
-    conv_layers[5].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer1->buffer.Get());
-    conv_layers[6].BindResources(intermediate_buffer1->buffer.Get(), intermediate_buffer2->buffer.Get());
-    add_layers[2].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer2->buffer.Get(), intermediate_buffer3->buffer.Get());
-
-    // Res block 4
-    conv_layers[7].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer1->buffer.Get());
-    conv_layers[8].BindResources(intermediate_buffer1->buffer.Get(), intermediate_buffer2->buffer.Get());
-
-#if OPTIM == 0
-    add_layers[3].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer2->buffer.Get(), intermediate_buffer3->buffer.Get());
-    shuffle_layers[0].BindResources(intermediate_buffer3->buffer.Get(), output_buffer->buffer.Get());
-#else
-    add_layers[3].BindResources(intermediate_buffer3->buffer.Get(), intermediate_buffer2->buffer.Get(), output_buffer->buffer.Get());
-#endif
+    for (size_t i = 0; i < graph.Layers().size(); i++)
+    {
+        const auto& layer = graph.Layers()[i];
+        if (layer.type == ecpu::GraphLayer::Type::Conv)
+            conv_layers[layer_indices[i]].BindResources(tensorResource(layer.inputs[0]), tensorResource(layer.output));
+        else
+            add_layers[layer_indices[i]].BindResources(tensorResource(layer.inputs[0]), tensorResource(layer.inputs[1]), tensorResource(layer.output));
+    }
 
     dev.QueueList(context);
     dev.WaitForGPU();
@@ -264,50 +179,14 @@ void egx::MasterNet::Execute(egx::Device& dev,
     context.SetTransitionBuffer(GetOutputBuffer(), egx::GPUBufferState::UnorderedAccess);
 
     // Record and execute
-
-    // Down
-    //command_recorder->RecordDispatch(context.command_list.Get(), shuffle_layers[0].GetCompiledOperator(), shuffle_layers[0].GetBindingTable());
-    //context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[0].GetCompiledOperator(), conv_layers[0].GetBindingTable());
-    context.SetUABarrier();
-
-    // Res block 1
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[1].GetCompiledOperator(), conv_layers[1].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[2].GetCompiledOperator(), conv_layers[2].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), add_layers[0].GetCompiledOperator(), add_layers[0].GetBindingTable());
-    context.SetUABarrier();
-
-    // Res block 2
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[3].GetCompiledOperator(), conv_layers[3].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[4].GetCompiledOperator(), conv_layers[4].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), add_layers[1].GetCompiledOperator(), add_layers[1].GetBindingTable());
-    context.SetUABarrier();
-
-    // Res block 3
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[5].GetCompiledOperator(), conv_layers[5].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[6].GetCompiledOperator(), conv_layers[6].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), add_layers[2].GetCompiledOperator(), add_layers[2].GetBindingTable());
-    context.SetUABarrier();
-
-    // Res block 4
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[7].GetCompiledOperator(), conv_layers[7].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[8].GetCompiledOperator(), conv_layers[8].GetBindingTable());
-    context.SetUABarrier();
-    command_recorder->RecordDispatch(context.command_list.Get(), add_layers[3].GetCompiledOperator(), add_layers[3].GetBindingTable());
-    context.SetUABarrier();
-
-    // Up
-#if OPTIM == 0
-    command_recorder->RecordDispatch(context.command_list.Get(), shuffle_layers[0].GetCompiledOperator(), shuffle_layers[0].GetBindingTable());
-    context.SetUABarrier();
-#endif
+    for (size_t i = 0; i < graph.Layers().size(); i++)
+    {
+        if (graph.Layers()[i].type == ecpu::GraphLayer::Type::Conv)
+            command_recorder->RecordDispatch(context.command_list.Get(), conv_layers[layer_indices[i]].GetCompiledOperator(), conv_layers[layer_indices[i]].GetBindingTable());
+        else
+            command_recorder->RecordDispatch(context.command_list.Get(), add_layers[layer_indices[i]].GetCompiledOperator(), add_layers[layer_indices[i]].GetBindingTable());
+        context.SetUABarrier();
+    }
 
     //dev.QueueListAndWaitForFinish(context);
 
@@ -315,35 +194,11 @@ void egx::MasterNet::Execute(egx::Device& dev,
 }
 
 
-std::unordered_map<std::string, std::vector<uint16_t>> egx::MasterNet::loadWeights(const std::string& file_path)
+ID3D12Resource* egx::MasterNet::tensorResource(int tensor)
 {
-    std::ifstream file(file_path, std::ios::binary);
-    if (file.fail())
-        throw std::runtime_error("Failed to load file " + file_path);
-
-    UINT num_weights = 0;
-    file.read(reinterpret_cast<char*>(&num_weights), 4);
-
-    std::unordered_map<std::string, std::vector<uint16_t>> output;
-    for (UINT i = 0; i < num_weights; i++)
-    {
-        UINT name_length = 0;
-        char name[255] = {};
-        file.read(reinterpret_cast<char*>(&name_length), 4);
-        file.read(name, name_length);
-
-        UINT float_count = 0;
-        file.read(reinterpret_cast<char*>(&float_count), 4);
-        std::vector<float> weights(float_count);
-        std::vector<uint16_t> weights16(float_count);
-        file.read(reinterpret_cast<char*>(weights.data()), float_count * sizeof(float));
-
-        // Compress floats
-        for (int j = 0; j < (int)weights.size(); j++)
-            weights16[j] = Float16Compressor::compress(weights[j]);
-
-        output[std::string(name)] = weights16;
-    }
-    return output;
+    if (tensor == graph.InputTensor())
+        return input_buffer->buffer.Get();
+    if (tensor == graph.OutputTensor())
+        return output_buffer->buffer.Get();
+    return intermediate_buffers[buffer_plan.tensor_buffers[tensor]]->buffer.Get();
 }
-
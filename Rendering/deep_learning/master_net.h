@@ -1,6 +1,5 @@
 #pragma once
 #include <vector>
-#include <unordered_map>
 #include <memory>
 #include <stdint.h>
 #include "dml_common.h"
@@ -9,8 +8,8 @@
 #include "graphics/unordered_access_buffer.h"
 
 #include "conv_layer.h"
-#include "pixel_shuffle.h"
 #include "add_layer.h"
+#include "cpu/network_graph.h"
 
 namespace egx
 {
@@ -27,8 +26,8 @@ namespace egx
 			CommandContext& context);
 
 	private:
-		std::unordered_map<std::string, std::vector<uint16_t>> loadWeights(const std::string& file_path);
-			
+		ID3D12Resource* tensorResource(int tensor);
+
 	private:
 		ema::point2D window_size;
 		int upsample_factor;
@@ -39,12 +38,14 @@ namespace egx
 
 		std::unique_ptr<UnorderedAccessBuffer> input_buffer;
 		std::unique_ptr<UnorderedAccessBuffer> output_buffer;
-		std::unique_ptr<UnorderedAccessBuffer> intermediate_buffer1;
-		std::unique_ptr<UnorderedAccessBuffer> intermediate_buffer2;
-		std::unique_ptr<UnorderedAccessBuffer> intermediate_buffer3;
+		std::vector<std::unique_ptr<UnorderedAccessBuffer>> intermediate_buffers;
 
+		// Layers are created from the graph stored next to the weights.
+		// layer_indices maps every graph layer to its index in conv_layers or add_layers
+		ecpu::NetworkGraph graph;
+		ecpu::BufferPlan buffer_plan;
+		std::vector<UINT> layer_indices;
 		std::vector<ConvLayer> conv_layers;
-		std::vector<PixelShuffle> shuffle_layers;
 		std::vector<AddLayer> add_layers;
 
 		UINT64 tensor_buffer_size;
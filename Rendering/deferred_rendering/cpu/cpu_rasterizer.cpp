@@ -0,0 +1,589 @@
+#include "cpu_rasterizer.h"
+#include "cpu_texture.h"
+#include "cpu/timer.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	const int vertices_per_task = 4096;
+	// Triangles binned by one task. Tiles walk the chunks in order, which keeps the draw order
+	const int triangles_per_chunk = 4096;
+	const int subpixel_bits = 8;
+	const int subpixel_scale = 1 << subpixel_bits;
+	// Triangles reaching further out than this multiple of w are also clipped in x and y, which
+	// keeps the fixed point coordinates far from overflowing the 64 bit edge functions
+	const float guard_band = 4.0f;
+	const uint32_t no_triangle = 0xffffffff;
+	// Clear color of the diffuse G-buffer target, ema::color::SkyBlue
+	const float sky_blue[3] = { 0.117f, 0.565f, 1.0f };
+
+	// Polygon vertex during clipping. Attributes come from the interpolation functions of the
+	// whole triangle, so clipping only needs positions
+	struct ClipPoint
+	{
+		float p[4];
+	};
+
+	// Keeps the part of the polygon where dot(plane, p) >= 0, Sutherland-Hodgman style
+	int clipPolygon(const ClipPoint* in, int count, const float* plane, ClipPoint* out)
+	{
+		int out_count = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const ClipPoint& a = in[i];
+			const ClipPoint& b = in[(i + 1) % count];
+			const float da = a.p[0] * plane[0] + a.p[1] * plane[1] + a.p[2] * plane[2] + a.p[3] * plane[3];
+			const float db = b.p[0] * plane[0] + b.p[1] * plane[1] + b.p[2] * plane[2] + b.p[3] * plane[3];
+			if (da >= 0.0f)
+				out[out_count++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				const float t = da / (da - db);
+				ClipPoint& c = out[out_count++];
+				for (int k = 0; k < 4; k++)
+					c.p[k] = a.p[k] + (b.p[k] - a.p[k]) * t;
+			}
+		}
+		return out_count;
+	}
+
+	// Homogeneous interpolation functions of the triangle with clip space vertices v: the rows
+	// (x, y, w) of the vertices times the barycentrics give the pixel position times w, so the
+	// inverse matrix maps pixels to barycentrics over w, which works for vertices behind the
+	// camera too. Writes u[i] = a[i] * x + b[i] * y + c[i] for pixel coordinates and the device
+	// depth plane, returns false for triangles seen edge on
+	bool interpolationFunctions(const float* const v[3], int width, int height, float* a, float* b, float* c, float* depth)
+	{
+		double m[3][3];
+		for (int i = 0; i < 3; i++)
+		{
+			m[i][0] = v[i][0];
+			m[i][1] = v[i][1];
+			m[i][2] = v[i][3];
+		}
+		const double cofactor[3][3] =
+		{
+			{ m[1][1] * m[2][2] - m[1][2] * m[2][1], m[1][2] * m[2][0] - m[1][0] * m[2][2], m[1][0] * m[2][1] - m[1][1] * m[2][0] },
+			{ m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1] },
+			{ m[0][1] * m[1][2] - m[0][2] * m[1][1], m[0][2] * m[1][0] - m[0][0] * m[1][2], m[0][0] * m[1][1] - m[0][1] * m[1][0] },
+		};
+		const double det = m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] + m[0][2] * cofactor[0][2];
+		if (det == 0.0)
+			return false;
+		// Column i of the inverse is row i of the cofactors over the determinant. Pixel
+		// coordinates map to ndc as x * 2 / w - 1 and 1 - y * 2 / h
+		double depth_plane[3] = { 0.0, 0.0, 0.0 };
+		bool finite = true;
+		const double inv_det = 1.0 / det;
+		const double scale_x = 2.0 / width;
+		const double scale_y = -2.0 / height;
+		for (int i = 0; i < 3; i++)
+		{
+			const double ix = cofactor[i][0] * inv_det;
+			const double iy = cofactor[i][1] * inv_det;
+			const double iw = cofactor[i][2] * inv_det;
+			const double da = ix * scale_x;
+			const double db = iy * scale_y;
+			const double dc = iw - ix + iy;
+			a[i] = (float)da;
+			b[i] = (float)db;
+			c[i] = (float)dc;
+			depth_plane[0] += da * v[i][2];
+			depth_plane[1] += db * v[i][2];
+			depth_plane[2] += dc * v[i][2];
+			finite = finite && std::isfinite(a[i]) && std::isfinite(b[i]) && std::isfinite(c[i]);
+		}
+		for (int i = 0; i < 3; i++)
+			depth[i] = (float)depth_plane[i];
+		return finite;
+	}
+
+	// Bits 0 to 5 are the frustum planes, x > w, x < -w, y > w, y < -w, z < 0 and z > w. Bit 4
+	// also means the vertex is behind the near plane, and bit 6 that it is outside the guard band
+	const int outcode_near = 16;
+	const int outcode_guard_band = 64;
+
+	int outcode(const float* c)
+	{
+		int code = 0;
+		code |= c[0] > c[3] ? 1 : 0;
+		code |= c[0] < -c[3] ? 2 : 0;
+		code |= c[1] > c[3] ? 4 : 0;
+		code |= c[1] < -c[3] ? 8 : 0;
+		code |= c[2] < 0.0f ? outcode_near : 0;
+		code |= c[2] > c[3] ? 32 : 0;
+		code |= std::abs(c[0]) > guard_band * c[3] || std::abs(c[1]) > guard_band * c[3] ? outcode_guard_band : 0;
+		return code;
+	}
+
+	// Sub-pixel position of a clip space point in front of the camera
+	void snapToGrid(const float* p, int width, int height, int32_t* x, int32_t* y)
+	{
+		const float rw = 1.0f / p[3];
+		*x = (int32_t)std::floor((p[0] * rw * 0.5f + 0.5f) * width * subpixel_scale + 0.5f);
+		*y = (int32_t)std::floor((0.5f - p[1] * rw * 0.5f) * height * subpixel_scale + 0.5f);
+	}
+
+	inline int64_t floorDiv(int64_t v, int64_t d)
+	{
+		return v >= 0 ? v / d : -((-v + d - 1) / d);
+	}
+
+	inline bool isTopLeft(int32_t dx, int32_t dy)
+	{
+		// Clockwise triangles on a y down screen: left edges go up, top edges go right
+		return dy < 0 || (dy == 0 && dx > 0);
+	}
+}
+
+ecpu::RasterCamera::RasterCamera(int width, int height, float near_plane, float far_plane, float field_of_view)
+	: width(width), height(height), near_plane(near_plane), far_plane(far_plane), field_of_view(field_of_view)
+{
+	Update();
+	has_last_view = false;
+}
+
+void ecpu::RasterCamera::Update()
+{
+	// egx::ProjectiveCamera::updateProjectionMatrix
+	const float tan_half_fov = std::tan(0.5f * field_of_view);
+	const float dims_x = (float)width / height * tan_half_fov * near_plane;
+	const float dims_y = tan_half_fov * near_plane;
+	projection_matrix_no_jitter = Matrix4::ProjectionOffset(near_plane, far_plane, dims_x, dims_y, 0.0f, 0.0f);
+	projection_matrix = Matrix4::ProjectionOffset(near_plane, far_plane, dims_x, dims_y,
+		(jitter_x - 0.5f) / width * 2.0f, -(jitter_y - 0.5f) / height * 2.0f);
+
+	// egx::FPCamera::SetRotation and Update. The first frame has no previous view and uses its own
+	const Matrix4 rotation = Matrix4::RollPitchYaw(roll_pitch_yaw);
+	const Vector3 forward = rotation.TransformDirection(Vector3(0.0f, 0.0f, 1.0f));
+	const Vector3 up = rotation.TransformDirection(Vector3(0.0f, 1.0f, 0.0f));
+	const Matrix4 new_view = Matrix4::LookAt(position, position + forward, up);
+	last_view_matrix = has_last_view ? view_matrix : new_view;
+	view_matrix = new_view;
+	has_last_view = true;
+}
+
+ecpu::SoftwareRasterizer::SoftwareRasterizer(int width, int height)
+	: width(width), height(height),
+	tiles_x((width + tile_size - 1) / tile_size), tiles_y((height + tile_size - 1) / tile_size),
+	triangle_ids((size_t)width * height, no_triangle),
+	depth(1, height, width, 1), normals(1, height, width, 4), albedo(1, height, width, 3), motion_vectors(1, height, width, 2)
+{
+	if (width <= 0 || height <= 0)
+		throw std::runtime_error("The rasterizer needs a positive size");
+}
+
+void ecpu::SoftwareRasterizer::Render(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool)
+{
+	if (camera.Width() != width || camera.Height() != height)
+		throw std::runtime_error("The camera size must match the rasterizer size");
+	for (const auto& draw : draws)
+		if (draw.mesh == nullptr || draw.material == nullptr)
+			throw std::runtime_error("Draws need a mesh and a material");
+
+	stats = Stats();
+	Timer timer;
+	transformVertices(draws, camera, pool);
+	stats.vertex_seconds = timer.Elapsed();
+
+	timer.Reset();
+	setupTriangles(draws, pool);
+	stats.setup_seconds = timer.Elapsed();
+
+	timer.Reset();
+	rasterizeTiles(draws, pool);
+	stats.raster_seconds = timer.Elapsed();
+
+	timer.Reset();
+	resolveTiles(draws, camera, pool);
+	stats.resolve_seconds = timer.Elapsed();
+}
+
+void ecpu::SoftwareRasterizer::transformVertices(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool)
+{
+	// Vertex and triangle offsets, and the blocks of vertices handed to the tasks
+	vertex_offsets.resize(draws.size() + 1);
+	triangle_offsets.resize(draws.size() + 1);
+	vertex_offsets[0] = 0;
+	triangle_offsets[0] = 0;
+	std::vector<std::pair<int, int>> blocks;
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		const int vertex_count = (int)draws[d].mesh->vertices.size();
+		vertex_offsets[d + 1] = vertex_offsets[d] + vertex_count;
+		triangle_offsets[d + 1] = triangle_offsets[d] + (uint32_t)(draws[d].mesh->indices.size() / 3);
+		for (int v = 0; v < vertex_count; v += vertices_per_task)
+			blocks.emplace_back((int)d, v);
+	}
+	vertices.resize(vertex_offsets.back());
+	stats.triangles = triangle_offsets.back();
+
+	pool.ParallelFor((int)blocks.size(), [&](int task)
+		{
+			const RasterDraw& draw = draws[blocks[task].first];
+			// motion_vector_vs.hlsl and deferred_model_nm_vs.hlsl
+			const Matrix4 world_view = draw.world * camera.ViewMatrix();
+			const Matrix4 clip_matrix = world_view * camera.ProjectionMatrix();
+			const Matrix4 curr_matrix = world_view * camera.ProjectionMatrixNoJitter();
+			const Matrix4 last_matrix = draw.last_world * camera.LastViewMatrix() * camera.ProjectionMatrixNoJitter();
+
+			const auto& mesh_vertices = draw.mesh->vertices;
+			const int v0 = blocks[task].second;
+			const int v1 = std::min((int)mesh_vertices.size(), v0 + vertices_per_task);
+			Vertex* out = vertices.data() + vertex_offsets[blocks[task].first];
+			for (int v = v0; v < v1; v++)
+			{
+				const eio::ObjbVertex& in = mesh_vertices[v];
+				const Vector3 position(in.position[0], in.position[1], in.position[2]);
+				Vertex& o = out[v];
+				const Vector4 clip = clip_matrix.Transform(position);
+				const Vector4 curr = curr_matrix.Transform(position);
+				const Vector4 last = last_matrix.Transform(position);
+				const Vector3 normal = world_view.TransformDirection(Vector3(in.normal[0], in.normal[1], in.normal[2])).Normalized();
+				o.clip[0] = clip.x; o.clip[1] = clip.y; o.clip[2] = clip.z; o.clip[3] = clip.w;
+				o.curr[0] = curr.x; o.curr[1] = curr.y; o.curr[2] = curr.w;
+				o.last[0] = last.x; o.last[1] = last.y; o.last[2] = last.w;
+				o.normal[0] = normal.x; o.normal[1] = normal.y; o.normal[2] = normal.z;
+				o.uv[0] = in.uv[0]; o.uv[1] = in.uv[1];
+				o.distance = world_view.Transform(position).z;
+				// Vertices are shared by about six triangles, so the culling inputs are computed here
+				o.outcode = outcode(o.clip);
+				o.screen[0] = o.screen[1] = 0;
+				if ((o.outcode & (outcode_near | outcode_guard_band)) == 0)
+					snapToGrid(o.clip, width, height, &o.screen[0], &o.screen[1]);
+			}
+		});
+}
+
+void ecpu::SoftwareRasterizer::setupTriangles(const std::vector<RasterDraw>& draws, ThreadPool& pool)
+{
+	const uint32_t triangle_count = triangle_offsets.back();
+	const int chunk_count = (int)((triangle_count + triangles_per_chunk - 1) / triangles_per_chunk);
+	const int tile_count = tiles_x * tiles_y;
+	setups.resize(triangle_count);
+	if ((int)chunk_triangles.size() < chunk_count)
+	{
+		chunk_triangles.resize(chunk_count);
+		chunk_bins.resize(chunk_count);
+	}
+	std::vector<size_t> chunk_rasterized(chunk_count, 0);
+	std::vector<size_t> chunk_entries(chunk_count, 0);
+
+	pool.ParallelFor(chunk_count, [&](int chunk)
+		{
+			auto& triangles = chunk_triangles[chunk];
+			auto& bins = chunk_bins[chunk];
+			triangles.clear();
+			bins.resize(tile_count);
+			for (auto& bin : bins)
+				bin.clear();
+
+			const uint32_t t0 = (uint32_t)chunk * triangles_per_chunk;
+			const uint32_t t1 = std::min(triangle_count, t0 + triangles_per_chunk);
+			uint32_t draw = (uint32_t)(std::upper_bound(triangle_offsets.begin(), triangle_offsets.end(), t0) - triangle_offsets.begin()) - 1;
+			for (uint32_t t = t0; t < t1; t++)
+			{
+				while (t >= triangle_offsets[draw + 1])
+					draw++;
+				const auto& indices = draws[draw].mesh->indices;
+				const uint32_t local = t - triangle_offsets[draw];
+				TriangleSetup& setup = setups[t];
+				const Vertex* v[3];
+				for (int i = 0; i < 3; i++)
+				{
+					setup.vertices[i] = vertex_offsets[draw] + indices[local * 3 + i];
+					v[i] = &vertices[setup.vertices[i]];
+				}
+				setup.draw = draw;
+
+				// Trivial rejection against the view frustum
+				const int outside_all = v[0]->outcode & v[1]->outcode & v[2]->outcode & 0x3f;
+				const int outside_any = v[0]->outcode | v[1]->outcode | v[2]->outcode;
+				if (outside_all != 0)
+					continue;
+
+				int32_t sx[9];
+				int32_t sy[9];
+				int count = 3;
+				if ((outside_any & (outcode_near | outcode_guard_band)) == 0)
+				{
+					for (int i = 0; i < 3; i++)
+					{
+						sx[i] = v[i]->screen[0];
+						sy[i] = v[i]->screen[1];
+					}
+				}
+				else
+				{
+					// Clip to the near plane and, only where needed, the guard band
+					ClipPoint polygon[2][9];
+					for (int i = 0; i < 3; i++)
+						for (int k = 0; k < 4; k++)
+							polygon[0][i].p[k] = v[i]->clip[k];
+					int current = 0;
+					if (outside_any & outcode_near)
+					{
+						const float near_plane[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+						count = clipPolygon(polygon[current], count, near_plane, polygon[1 - current]);
+						current = 1 - current;
+					}
+					if (outside_any & outcode_guard_band)
+					{
+						const float planes[4][4] =
+						{
+							{ -1.0f, 0.0f, 0.0f, guard_band }, { 1.0f, 0.0f, 0.0f, guard_band },
+							{ 0.0f, -1.0f, 0.0f, guard_band }, { 0.0f, 1.0f, 0.0f, guard_band },
+						};
+						for (int p = 0; p < 4 && count >= 3; p++)
+						{
+							count = clipPolygon(polygon[current], count, planes[p], polygon[1 - current]);
+							current = 1 - current;
+						}
+					}
+					if (count < 3)
+						continue;
+					// Snap to the sub-pixel grid, the polygon is fanned into triangles below
+					for (int i = 0; i < count; i++)
+						snapToGrid(polygon[current][i].p, width, height, &sx[i], &sy[i]);
+				}
+
+				const bool masked = draws[draw].material->mask_texture.data != nullptr;
+				bool has_setup = false;
+				for (int i = 1; i + 1 < count; i++)
+				{
+					const int32_t x[3] = { sx[0], sx[i], sx[i + 1] };
+					const int32_t y[3] = { sy[0], sy[i], sy[i + 1] };
+					// Back faces and degenerate triangles. Front faces are clockwise, like the
+					// default rasterizer state
+					const int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+					if (area <= 0)
+						continue;
+
+					RasterTriangle tri;
+					for (int e = 0; e < 3; e++)
+					{
+						const int a = e;
+						const int b = (e + 1) % 3;
+						tri.edge_a[e] = y[a] - y[b];
+						tri.edge_b[e] = x[b] - x[a];
+						tri.edge_c[e] = -(int64_t)tri.edge_a[e] * x[a] - (int64_t)tri.edge_b[e] * y[a];
+						if (!isTopLeft(x[b] - x[a], y[b] - y[a]))
+							tri.edge_c[e] -= 1;
+					}
+					// Pixels whose centers x * 256 + 128 fall inside the bounds
+					const int32_t min_x = std::min(x[0], std::min(x[1], x[2]));
+					const int32_t max_x = std::max(x[0], std::max(x[1], x[2]));
+					const int32_t min_y = std::min(y[0], std::min(y[1], y[2]));
+					const int32_t max_y = std::max(y[0], std::max(y[1], y[2]));
+					const int half = subpixel_scale / 2;
+					tri.x0 = (int)std::max<int64_t>(0, floorDiv(min_x - half + subpixel_scale - 1, subpixel_scale));
+					tri.y0 = (int)std::max<int64_t>(0, floorDiv(min_y - half + subpixel_scale - 1, subpixel_scale));
+					tri.x1 = (int)std::min<int64_t>(width - 1, floorDiv(max_x - half, subpixel_scale));
+					tri.y1 = (int)std::min<int64_t>(height - 1, floorDiv(max_y - half, subpixel_scale));
+					if (tri.x0 > tri.x1 || tri.y0 > tri.y1)
+						continue;
+					// Interpolation is set up once per triangle, and only for triangles with a
+					// piece covering a pixel center, most culled triangles never get here
+					if (!has_setup)
+					{
+						const float* clip[3] = { v[0]->clip, v[1]->clip, v[2]->clip };
+						if (!interpolationFunctions(clip, width, height, setup.a, setup.b, setup.c, setup.depth))
+							break;
+						has_setup = true;
+					}
+					tri.triangle = t;
+					tri.masked = masked;
+
+					const uint32_t index = (uint32_t)triangles.size();
+					triangles.push_back(tri);
+					chunk_rasterized[chunk]++;
+
+					// Bin to every tile of the bounds that is not fully outside one of the edges
+					const int tx0 = tri.x0 / tile_size;
+					const int ty0 = tri.y0 / tile_size;
+					const int tx1 = tri.x1 / tile_size;
+					const int ty1 = tri.y1 / tile_size;
+					const bool single_tile = tx0 == tx1 && ty0 == ty1;
+					for (int ty = ty0; ty <= ty1; ty++)
+					{
+						for (int tx = tx0; tx <= tx1; tx++)
+						{
+							if (!single_tile)
+							{
+								const int64_t cx0 = (int64_t)std::max(tri.x0, tx * tile_size) * subpixel_scale + half;
+								const int64_t cx1 = (int64_t)std::min(tri.x1, tx * tile_size + tile_size - 1) * subpixel_scale + half;
+								const int64_t cy0 = (int64_t)std::max(tri.y0, ty * tile_size) * subpixel_scale + half;
+								const int64_t cy1 = (int64_t)std::min(tri.y1, ty * tile_size + tile_size - 1) * subpixel_scale + half;
+								bool outside = false;
+								for (int e = 0; e < 3 && !outside; e++)
+								{
+									const int64_t best = tri.edge_a[e] * (tri.edge_a[e] > 0 ? cx1 : cx0) +
+										tri.edge_b[e] * (tri.edge_b[e] > 0 ? cy1 : cy0) + tri.edge_c[e];
+									outside = best < 0;
+								}
+								if (outside)
+									continue;
+							}
+							bins[ty * tiles_x + tx].push_back(index);
+							chunk_entries[chunk]++;
+						}
+					}
+				}
+			}
+		});
+
+	for (int chunk = 0; chunk < chunk_count; chunk++)
+	{
+		stats.rasterized_triangles += chunk_rasterized[chunk];
+		stats.bin_entries += chunk_entries[chunk];
+	}
+}
+
+void ecpu::SoftwareRasterizer::rasterizeTiles(const std::vector<RasterDraw>& draws, ThreadPool& pool)
+{
+	const int chunk_count = (int)((triangle_offsets.back() + triangles_per_chunk - 1) / triangles_per_chunk);
+	const float* linear = GetTexelTables().linear;
+	pool.ParallelFor(tiles_x * tiles_y, [&](int tile)
+		{
+			const int tile_x0 = (tile % tiles_x) * tile_size;
+			const int tile_y0 = (tile / tiles_x) * tile_size;
+			const int tile_x1 = std::min(width, tile_x0 + tile_size) - 1;
+			const int tile_y1 = std::min(height, tile_y0 + tile_size) - 1;
+			for (int y = tile_y0; y <= tile_y1; y++)
+			{
+				std::fill_n(depth.Data() + (size_t)y * width + tile_x0, tile_x1 - tile_x0 + 1, 1.0f);
+				std::fill_n(triangle_ids.data() + (size_t)y * width + tile_x0, tile_x1 - tile_x0 + 1, no_triangle);
+			}
+
+			for (int chunk = 0; chunk < chunk_count; chunk++)
+			{
+				const auto& triangles = chunk_triangles[chunk];
+				for (uint32_t index : chunk_bins[chunk][tile])
+				{
+					const RasterTriangle& tri = triangles[index];
+					const TriangleSetup& setup = setups[tri.triangle];
+					const int x0 = std::max(tri.x0, tile_x0);
+					const int x1 = std::min(tri.x1, tile_x1);
+					const int y0 = std::max(tri.y0, tile_y0);
+					const int y1 = std::min(tri.y1, tile_y1);
+					const int64_t step[3] = { (int64_t)tri.edge_a[0] * subpixel_scale, (int64_t)tri.edge_a[1] * subpixel_scale, (int64_t)tri.edge_a[2] * subpixel_scale };
+					const int64_t cx = (int64_t)x0 * subpixel_scale + subpixel_scale / 2;
+					for (int y = y0; y <= y1; y++)
+					{
+						const int64_t cy = (int64_t)y * subpixel_scale + subpixel_scale / 2;
+						int64_t e0 = tri.edge_a[0] * cx + tri.edge_b[0] * cy + tri.edge_c[0];
+						int64_t e1 = tri.edge_a[1] * cx + tri.edge_b[1] * cy + tri.edge_c[1];
+						int64_t e2 = tri.edge_a[2] * cx + tri.edge_b[2] * cy + tri.edge_c[2];
+						float* depth_row = depth.Data() + (size_t)y * width;
+						uint32_t* id_row = triangle_ids.data() + (size_t)y * width;
+						const float py = (float)y + 0.5f;
+						for (int x = x0; x <= x1; x++, e0 += step[0], e1 += step[1], e2 += step[2])
+						{
+							if ((e0 | e1 | e2) < 0)
+								continue;
+							const float px = (float)x + 0.5f;
+							const float z = std::max(0.0f, setup.depth[0] * px + setup.depth[1] * py + setup.depth[2]);
+							if (z > 1.0f || !(z < depth_row[x]))
+								continue;
+							if (tri.masked)
+							{
+								// clip(mask - 0.5) of deferred_model_nm_ps.hlsl
+								float u[3];
+								for (int i = 0; i < 3; i++)
+									u[i] = setup.a[i] * px + setup.b[i] * py + setup.c[i];
+								const float rsum = 1.0f / (u[0] + u[1] + u[2]);
+								float uv[2];
+								for (int k = 0; k < 2; k++)
+									uv[k] = (u[0] * vertices[setup.vertices[0]].uv[k] + u[1] * vertices[setup.vertices[1]].uv[k] +
+										u[2] * vertices[setup.vertices[2]].uv[k]) * rsum;
+								float mask;
+								SampleWrap(draws[setup.draw].material->mask_texture, uv[0], uv[1], linear, 1, &mask);
+								if (mask < 0.5f)
+									continue;
+							}
+							depth_row[x] = z;
+							id_row[x] = tri.triangle;
+						}
+					}
+				}
+			}
+		});
+}
+
+void ecpu::SoftwareRasterizer::resolveTiles(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool)
+{
+	const float* srgb = GetTexelTables().srgb;
+	const float far_plane = camera.FarPlane();
+	pool.ParallelFor(tiles_x * tiles_y, [&](int tile)
+		{
+			const int tile_x0 = (tile % tiles_x) * tile_size;
+			const int tile_y0 = (tile / tiles_x) * tile_size;
+			const int tile_x1 = std::min(width, tile_x0 + tile_size);
+			const int tile_y1 = std::min(height, tile_y0 + tile_size);
+			for (int y = tile_y0; y < tile_y1; y++)
+			{
+				for (int x = tile_x0; x < tile_x1; x++)
+				{
+					const size_t pixel = (size_t)y * width + x;
+					float* n = normals.Data() + pixel * 4;
+					float* a = albedo.Data() + pixel * 3;
+					float* mv = motion_vectors.Data() + pixel * 2;
+					const uint32_t id = triangle_ids[pixel];
+					if (id == no_triangle)
+					{
+						// Render target clear values
+						n[0] = n[1] = n[2] = 0.0f;
+						n[3] = far_plane;
+						a[0] = sky_blue[0]; a[1] = sky_blue[1]; a[2] = sky_blue[2];
+						mv[0] = mv[1] = 0.0f;
+						continue;
+					}
+
+					const TriangleSetup& setup = setups[id];
+					const float px = (float)x + 0.5f;
+					const float py = (float)y + 0.5f;
+					float b[3];
+					for (int i = 0; i < 3; i++)
+						b[i] = setup.a[i] * px + setup.b[i] * py + setup.c[i];
+					const float rsum = 1.0f / (b[0] + b[1] + b[2]);
+					for (int i = 0; i < 3; i++)
+						b[i] *= rsum;
+					const Vertex& v0 = vertices[setup.vertices[0]];
+					const Vertex& v1 = vertices[setup.vertices[1]];
+					const Vertex& v2 = vertices[setup.vertices[2]];
+
+					// Interpolated, not renormalized, like the tbn row the pixel shader writes
+					for (int k = 0; k < 3; k++)
+						n[k] = b[0] * v0.normal[k] + b[1] * v1.normal[k] + b[2] * v2.normal[k];
+					n[3] = b[0] * v0.distance + b[1] * v1.distance + b[2] * v2.distance;
+
+					const RasterMaterial& material = *draws[setup.draw].material;
+					if (material.diffuse_texture.data != nullptr)
+					{
+						const float u = b[0] * v0.uv[0] + b[1] * v1.uv[0] + b[2] * v2.uv[0];
+						const float v = b[0] * v0.uv[1] + b[1] * v1.uv[1] + b[2] * v2.uv[1];
+						SampleWrap(material.diffuse_texture, u, v, srgb, 3, a);
+					}
+					else
+					{
+						a[0] = material.diffuse_color[0];
+						a[1] = material.diffuse_color[1];
+						a[2] = material.diffuse_color[2];
+					}
+
+					// motion_vector_ps.hlsl
+					float curr[3];
+					float last[3];
+					for (int k = 0; k < 3; k++)
+					{
+						curr[k] = b[0] * v0.curr[k] + b[1] * v1.curr[k] + b[2] * v2.curr[k];
+						last[k] = b[0] * v0.last[k] + b[1] * v1.last[k] + b[2] * v2.last[k];
+					}
+					mv[0] = (last[0] / last[2] - curr[0] / curr[2]) * 0.5f;
+					mv[1] = (last[1] / last[2] - curr[1] / curr[2]) * -0.5f;
+				}
+			}
+		});
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "cpu/tensor.h"
+#include "cpu/thread_pool.h"
+#include "cpu/matrix4.h"
+#include "cpu/resample.h"
+#include "cpu/occlusion_culler.h"
+#include "io/objb.h"
+
+namespace ecpu
+{
+	// Material inputs of deferred_model_nm_ps.hlsl and closest_hit.hlsl. Textures are views of 8
+	// bit images the caller keeps alive, a view without data means the material has no such
+	// texture. The normal and specular maps and the reflectance are only read by the ray tracer
+	struct RasterMaterial
+	{
+		float diffuse_color[3] = { 0.0f, 0.0f, 0.0f };
+		float reflectance = 0.0f;
+		ImageView<uint8_t> diffuse_texture;	// sRGB encoded, like the FORCE_SRGB diffuse textures
+		ImageView<uint8_t> normal_map;		// Tangent space xy in the first two channels
+		ImageView<uint8_t> specular_map;	// First channel
+		ImageView<uint8_t> mask_texture;	// First channel, texels below one half are clipped
+	};
+
+	// One mesh drawn with the world matrices of the current and the previous frame, what
+	// egx::Model uploads in its model buffer. The model space bounds and occluder triangles
+	// of the mesh are optional, draws without bounds are never culled
+	struct RasterDraw
+	{
+		const eio::ObjbMesh* mesh = nullptr;
+		const RasterMaterial* material = nullptr;
+		Matrix4 world = Matrix4::Identity();
+		Matrix4 last_world = Matrix4::Identity();
+		const Aabb* bounds = nullptr;
+		const OccluderMesh* occluder = nullptr;
+	};
+
+	// CPU version of egx::FPCamera. Update moves the current view to the last view, the camera
+	// buffer copy UpdateBuffer does for the motion vector pass
+	class RasterCamera
+	{
+	public:
+		RasterCamera(int width, int height, float near_plane, float far_plane, float field_of_view);
+
+		void SetPosition(const Vector3& new_position) { position = new_position; };
+		void SetRotation(const Vector3& new_roll_pitch_yaw) { roll_pitch_yaw = new_roll_pitch_yaw; };
+		// Sample position inside a pixel in [0, 1), 0.5 is the pixel center
+		void SetJitter(float x, float y) { jitter_x = x; jitter_y = y; };
+		void Update();
+
+		inline int Width() const { return width; };
+		inline int Height() const { return height; };
+		inline float FarPlane() const { return far_plane; };
+		inline const Matrix4& ViewMatrix() const { return view_matrix; };
+		inline const Matrix4& LastViewMatrix() const { return last_view_matrix; };
+		inline const Matrix4& ProjectionMatrix() const { return projection_matrix; };
+		inline const Matrix4& ProjectionMatrixNoJitter() const { return projection_matrix_no_jitter; };
+
+	private:
+		int width;
+		int height;
+		float near_plane;
+		float far_plane;
+		float field_of_view;
+
+		Vector3 position;
+		Vector3 roll_pitch_yaw;
+		float jitter_x = 0.5f;
+		float jitter_y = 0.5f;
+		bool has_last_view = false;
+
+		Matrix4 view_matrix = Matrix4::Identity();
+		Matrix4 last_view_matrix = Matrix4::Identity();
+		Matrix4 projection_matrix = Matrix4::Identity();
+		Matrix4 projection_matrix_no_jitter = Matrix4::Identity();
+	};
+
+	// Tile binned software rasterizer producing the G-buffer and motion vectors of the deferred
+	// renderer for the dataset tools, without a GPU.
+	// Vertices are transformed in parallel blocks. Triangles are clipped against the near plane
+	// and a guard band, back face culled and binned to 64x64 pixel tiles in fixed size chunks.
+	// Each tile is then rasterized by one thread in fixed point with the top-left fill rule,
+	// walking the chunks in order, into a depth and triangle id visibility buffer, so the result
+	// does not depend on the thread count. A resolve pass interpolates the attributes of the
+	// visible triangle of each pixel with perspective correct barycentrics.
+	// Outputs follow the conventions of the GPU passes: depth is the D3D depth buffer value, the
+	// normals hold the view space normal and distance of the G-buffer, albedo the diffuse color
+	// in linear space and the motion vectors the uv offset of motion_vector_ps.hlsl.
+	class SoftwareRasterizer
+	{
+	public:
+		struct Stats
+		{
+			size_t triangles = 0;			// Triangles submitted
+			size_t rasterized_triangles = 0;	// Triangles left after culling, clipped triangles counted per piece
+			size_t bin_entries = 0;			// Triangle and tile pairs
+			double vertex_seconds = 0.0;
+			double setup_seconds = 0.0;		// Clipping, culling and binning
+			double raster_seconds = 0.0;		// Coverage and depth test
+			double resolve_seconds = 0.0;	// Attribute interpolation and texturing
+
+			double TotalSeconds() const { return vertex_seconds + setup_seconds + raster_seconds + resolve_seconds; };
+		};
+
+		static const int tile_size = 64;
+
+	public:
+		SoftwareRasterizer(int width, int height);
+
+		void Render(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool);
+
+		const Tensor& GetDepth() const { return depth; };				// { 1, h, w, 1 }, 1 where nothing was drawn
+		const Tensor& GetNormals() const { return normals; };			// { 1, h, w, 4 }, normal and view space distance
+		const Tensor& GetAlbedo() const { return albedo; };				// { 1, h, w, 3 }
+		const Tensor& GetMotionVectors() const { return motion_vectors; };	// { 1, h, w, 2 }
+		const Stats& GetLastStats() const { return stats; };
+
+	private:
+		// Transformed vertex shared by the passes
+		struct Vertex
+		{
+			float clip[4];		// Jittered clip space position
+			float curr[3];		// xyw of the clip space position without jitter
+			float last[3];		// xyw of the previous frame position without jitter
+			float normal[3];	// View space normal
+			float uv[2];
+			float distance;		// View space depth
+			int32_t screen[2];	// Sub-pixel position, set when the vertex needs no clipping
+			int32_t outcode;	// Frustum planes the vertex is outside and the clipping it needs
+		};
+
+		// Interpolation functions of a triangle. At pixel center (x, y) the perspective correct
+		// barycentrics are proportional to u[i] = a[i] * x + b[i] * y + c[i], and device depth is
+		// a plane in screen space
+		struct TriangleSetup
+		{
+			float a[3];
+			float b[3];
+			float c[3];
+			float depth[3];
+			uint32_t vertices[3];
+			uint32_t draw;
+		};
+
+		// Screen space triangle, or piece of a clipped triangle, in 8 bit sub-pixel fixed point
+		struct RasterTriangle
+		{
+			int32_t edge_a[3];
+			int32_t edge_b[3];
+			int64_t edge_c[3];	// Includes the fill rule bias
+			int x0, y0, x1, y1;	// Inclusive pixel bounds
+			uint32_t triangle;	// Index of the TriangleSetup
+			bool masked;
+		};
+
+		void transformVertices(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool);
+		void setupTriangles(const std::vector<RasterDraw>& draws, ThreadPool& pool);
+		void rasterizeTiles(const std::vector<RasterDraw>& draws, ThreadPool& pool);
+		void resolveTiles(const std::vector<RasterDraw>& draws, const RasterCamera& camera, ThreadPool& pool);
+
+	private:
+		int width;
+		int height;
+		int tiles_x;
+		int tiles_y;
+		Stats stats;
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> vertex_offsets;	// First vertex of each draw
+		std::vector<uint32_t> triangle_offsets;	// First triangle of each draw
+		std::vector<TriangleSetup> setups;
+
+		// Triangles and per tile bins of every chunk of triangles
+		std::vector<std::vector<RasterTriangle>> chunk_triangles;
+		std::vector<std::vector<std::vector<uint32_t>>> chunk_bins;
+
+		std::vector<uint32_t> triangle_ids;	// Visibility buffer, the setup index per pixel
+		Tensor depth;
+		Tensor normals;
+		Tensor albedo;
+		Tensor motion_vectors;
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include "cpu/resample.h"
+
+namespace ecpu
+{
+	// Decoding tables for 8 bit texels, the sRGB one is what sampling a FORCE_SRGB texture does
+	struct TexelTables
+	{
+		float linear[256];
+		float srgb[256];
+
+		TexelTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				const float v = (float)i / 255.0f;
+				linear[i] = v;
+				srgb[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+			}
+		}
+	};
+
+	inline const TexelTables& GetTexelTables()
+	{
+		static const TexelTables tables;
+		return tables;
+	}
+
+	// Bilinear sample of the top mip level with the linear_wrap sampler of the model shaders.
+	// decode is one of the texel tables, writes the first count channels
+	inline void SampleWrap(const ImageView<uint8_t>& texture, float u, float v, const float* decode, int count, float* out)
+	{
+		const float x = (u - std::floor(u)) * texture.width - 0.5f;
+		const float y = (v - std::floor(v)) * texture.height - 0.5f;
+		const float fx = std::floor(x);
+		const float fy = std::floor(y);
+		const float wx = x - fx;
+		const float wy = y - fy;
+		const int x0 = ((int)fx + texture.width) % texture.width;
+		const int y0 = ((int)fy + texture.height) % texture.height;
+		const int x1 = (x0 + 1) % texture.width;
+		const int y1 = (y0 + 1) % texture.height;
+		const uint8_t* t00 = texture.Texel(x0, y0);
+		const uint8_t* t10 = texture.Texel(x1, y0);
+		const uint8_t* t01 = texture.Texel(x0, y1);
+		const uint8_t* t11 = texture.Texel(x1, y1);
+		for (int c = 0; c < count; c++)
+		{
+			const int tc = c < texture.channels ? c : texture.channels - 1;
+			const float top = decode[t00[tc]] + (decode[t10[tc]] - decode[t00[tc]]) * wx;
+			const float bottom = decode[t01[tc]] + (decode[t11[tc]] - decode[t01[tc]]) * wx;
+			out[c] = top + (bottom - top) * wy;
+		}
+	}
+}
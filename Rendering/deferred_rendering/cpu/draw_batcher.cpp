@@ -0,0 +1,104 @@
+#include "draw_batcher.h"
+#include <algorithm>
+#include "cpu/timer.h"
+
+namespace
+{
+	// State changes between consecutive draws with the given keys
+	void countChanges(uint64_t last, uint64_t key, size_t& pipeline_changes, size_t& material_changes, size_t& mesh_changes)
+	{
+		using ecpu::DrawKey;
+		if (DrawKey::Pass(key) != DrawKey::Pass(last) || DrawKey::Pipeline(key) != DrawKey::Pipeline(last))
+			pipeline_changes++;
+		if (DrawKey::Material(key) != DrawKey::Material(last))
+			material_changes++;
+		if (DrawKey::Mesh(key) != DrawKey::Mesh(last))
+			mesh_changes++;
+	}
+}
+
+uint64_t ecpu::DrawKey::Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+	// Rounded in double, a float holds 2^24 - 1 but not 2^24 - 0.5
+	const double max_depth = (double)((1u << depth_bits) - 1);
+	const double scaled = depth > 0.0f ? std::min(depth, 1.0f) * max_depth : 0.0;
+	uint64_t key = pass;
+	key = (key << pipeline_bits) | pipeline;
+	key = (key << material_bits) | material;
+	key = (key << mesh_bits) | mesh;
+	key = (key << depth_bits) | (uint64_t)(scaled + 0.5);
+	return key;
+}
+
+void ecpu::RadixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch)
+{
+	if (items.size() < 2)
+		return;
+	scratch.resize(items.size());
+
+	// Counts of every digit in one pass over the keys
+	size_t offsets[8][256] = {};
+	uint64_t differing = 0;
+	const uint64_t first_key = items[0].key;
+	for (const auto& item : items)
+	{
+		differing |= item.key ^ first_key;
+		for (int digit = 0; digit < 8; digit++)
+			offsets[digit][(item.key >> (digit * 8)) & 0xff]++;
+	}
+
+	for (int digit = 0; digit < 8; digit++)
+	{
+		const int shift = digit * 8;
+		if (((differing >> shift) & 0xff) == 0)
+			continue;
+		size_t sum = 0;
+		for (auto& offset : offsets[digit])
+		{
+			const size_t count = offset;
+			offset = sum;
+			sum += count;
+		}
+		size_t* digit_offsets = offsets[digit];
+		for (const auto& item : items)
+			scratch[digit_offsets[(item.key >> shift) & 0xff]++] = item;
+		items.swap(scratch);
+	}
+}
+
+void ecpu::DrawBatcher::Build()
+{
+	stats = Stats();
+	stats.draws = items.size();
+	for (size_t i = 1; i < items.size(); i++)
+		countChanges(items[i - 1].key, items[i].key, stats.unsorted_pipeline_changes, stats.unsorted_material_changes, stats.unsorted_mesh_changes);
+
+	Timer timer;
+	RadixSort(items, scratch);
+	stats.sort_seconds = timer.Elapsed();
+
+	timer.Reset();
+	batches.clear();
+	instances.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const uint64_t key = items[i].key;
+		if (batches.empty() || DrawKey::State(batches.back().key) != DrawKey::State(key))
+		{
+			if (!batches.empty())
+				countChanges(batches.back().key, key, stats.pipeline_changes, stats.material_changes, stats.mesh_changes);
+			batches.push_back({ key, (uint32_t)i, 0 });
+		}
+		batches.back().count++;
+		instances[i] = items[i].instance;
+	}
+	stats.batches = batches.size();
+	stats.merge_seconds = timer.Elapsed();
+}
+
+size_t ecpu::DrawBatcher::FirstBatch(uint32_t pass) const
+{
+	const auto first = std::lower_bound(batches.begin(), batches.end(), pass,
+		[](const DrawBatch& batch, uint32_t p) { return DrawKey::Pass(batch.key) < p; });
+	return (size_t)(first - batches.begin());
+}
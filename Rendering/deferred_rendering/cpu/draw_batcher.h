@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ecpu
+{
+	// 64 bit draw sort key, from the most significant field: pass, pipeline, material, mesh and
+	// quantized depth. Sorting the keys groups the draws of a pass by pipeline state, then by
+	// material and mesh, and orders the instances of a mesh front to back
+	struct DrawKey
+	{
+		static const int depth_bits = 24;
+		static const int mesh_bits = 16;
+		static const int material_bits = 16;
+		static const int pipeline_bits = 4;
+		static const int pass_bits = 4;
+
+		// Depth in [0, 1] is clamped, the other fields must fit their bits
+		static uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+		static uint32_t Pass(uint64_t key) { return (uint32_t)(key >> (64 - pass_bits)); };
+		static uint32_t Pipeline(uint64_t key) { return (uint32_t)(key >> (depth_bits + mesh_bits + material_bits)) & ((1u << pipeline_bits) - 1); };
+		static uint32_t Material(uint64_t key) { return (uint32_t)(key >> (depth_bits + mesh_bits)) & ((1u << material_bits) - 1); };
+		static uint32_t Mesh(uint64_t key) { return (uint32_t)(key >> depth_bits) & ((1u << mesh_bits) - 1); };
+		// Equal for draws that can share one instanced draw
+		static uint64_t State(uint64_t key) { return key >> depth_bits; };
+	};
+
+	// One instance of a mesh to draw, the instance indexes the caller's transforms
+	struct DrawItem
+	{
+		uint64_t key;
+		uint32_t instance;
+	};
+
+	// Stable sort by key, least significant eight bit digit first, with the counts of all digits
+	// taken in one pass. Digits every key shares are skipped, so unused fields cost no passes
+	void RadixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch);
+
+	// Consecutive instances of the same pass, pipeline, material and mesh, drawn as one instanced draw
+	struct DrawBatch
+	{
+		uint64_t key;			// Key of the first instance
+		uint32_t first;			// First instance in Instances()
+		uint32_t count;
+	};
+
+	// Builds instanced draws from draws added in any order. The stats count the state changes
+	// between consecutive draws in the order the draws were added, one draw per instance, and
+	// after sorting and merging
+	class DrawBatcher
+	{
+	public:
+		struct Stats
+		{
+			size_t draws = 0;
+			size_t batches = 0;
+			size_t pipeline_changes = 0;
+			size_t material_changes = 0;
+			size_t mesh_changes = 0;
+			size_t unsorted_pipeline_changes = 0;
+			size_t unsorted_material_changes = 0;
+			size_t unsorted_mesh_changes = 0;
+			double sort_seconds = 0.0;
+			double merge_seconds = 0.0;
+		};
+
+	public:
+		void Clear() { items.clear(); };
+		void Add(uint64_t key, uint32_t instance) { items.push_back({ key, instance }); };
+		// Sorts the draws added since Clear and merges them into batches
+		void Build();
+
+		const std::vector<DrawBatch>& Batches() const { return batches; };
+		// Instances of the batches in batch order
+		const std::vector<uint32_t>& Instances() const { return instances; };
+		// First batch of the pass or a later one, Batches().size() if there is none
+		size_t FirstBatch(uint32_t pass) const;
+		const Stats& GetLastStats() const { return stats; };
+
+	private:
+		std::vector<DrawItem> items;
+		std::vector<DrawItem> scratch;
+		std::vector<DrawBatch> batches;
+		std::vector<uint32_t> instances;
+		Stats stats;
+	};
+}
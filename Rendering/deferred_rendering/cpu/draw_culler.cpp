@@ -0,0 +1,74 @@
+#include "draw_culler.h"
+#include "cpu/timer.h"
+
+void ecpu::DrawCuller::Clear()
+{
+	bounds.Clear();
+	fields.clear();
+	dynamic.clear();
+	occluders.clear();
+}
+
+void ecpu::DrawCuller::Add(const Aabb& box, const Matrix4& world, uint32_t pipeline, uint32_t material, uint32_t mesh, bool is_dynamic,
+	const OccluderMesh* occluder)
+{
+	bounds.PushTransformed(box, world);
+	fields.push_back({ pipeline, material, mesh });
+	dynamic.push_back(is_dynamic ? 1 : 0);
+	occluders.push_back({ occluder && !occluder->indices.empty() ? occluder : nullptr, world });
+}
+
+void ecpu::DrawCuller::Build(const Matrix4& view_projection, float margin, const Matrix4& shadow_view_projection,
+	MaskedOcclusionCuller* occlusion)
+{
+	Timer timer;
+	stats = Stats();
+	stats.meshes = bounds.Size();
+	visible.clear();
+	bounds.Cull(Frustum::FromMatrix(view_projection, margin), visible);
+	shadow_visible.clear();
+	bounds.Cull(Frustum::FromMatrix(shadow_view_projection), shadow_visible);
+	stats.shadow_meshes = shadow_visible.size();
+	stats.cull_seconds = timer.Elapsed();
+	if (occlusion)
+	{
+		timer.Reset();
+		cullOccluded(view_projection, *occlusion);
+		stats.occlusion_seconds = timer.Elapsed();
+	}
+	stats.camera_meshes = visible.size();
+
+	timer.Reset();
+	batcher.Clear();
+	for (uint32_t i : visible)
+	{
+		// Device depth of the box center orders the instances of a mesh front to back
+		const Vector4 center = view_projection.Transform(bounds.Get(i).Center());
+		const float depth = center.w > 0.0f ? center.z / center.w : 0.0f;
+		const KeyFields& key = fields[i];
+		batcher.Add(DrawKey::Make(camera_pass, key.pipeline, key.material, key.mesh, depth), i);
+		if (dynamic[i])
+			batcher.Add(DrawKey::Make(dynamic_pass, key.pipeline, key.material, key.mesh, depth), i);
+	}
+	batcher.Build();
+	first_dynamic = batcher.FirstBatch(dynamic_pass);
+	stats.batching = batcher.GetLastStats();
+	stats.batch_seconds = timer.Elapsed();
+}
+
+void ecpu::DrawCuller::cullOccluded(const Matrix4& view_projection, MaskedOcclusionCuller& occlusion)
+{
+	// Occluders off screen hide nothing, so only those in view are rendered
+	occlusion.Clear();
+	for (uint32_t i : visible)
+		if (occluders[i].mesh)
+			occlusion.RenderOccluder(*occluders[i].mesh, occluders[i].world * view_projection);
+
+	// The bounds are in world space already
+	size_t kept = 0;
+	for (uint32_t i : visible)
+		if (!occlusion.IsOccluded(bounds.Get(i), view_projection))
+			visible[kept++] = i;
+	stats.occluded_meshes = visible.size() - kept;
+	visible.resize(kept);
+}
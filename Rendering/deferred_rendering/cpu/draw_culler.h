@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "cpu/frustum.h"
+#include "cpu/occlusion_culler.h"
+#include "draw_batcher.h"
+
+namespace ecpu
+{
+	// The part of DrawList that does not touch the GPU, so the frame preparation can be measured
+	// without a device. The mesh bounds are moved to world space into one SoA array and culled
+	// against the camera and shadow camera frustums eight at a time. With an occlusion culler the
+	// occluders of the meshes in view are rendered into it and the meshes it hides leave the
+	// camera draws, the shadow draws keep them. The camera draws are sorted by their draw keys
+	// and merged into instanced draws, every visible draw in the camera pass and the dynamic
+	// ones again in the dynamic pass, for the motion vectors
+	class DrawCuller
+	{
+	public:
+		static const uint32_t camera_pass = 0;
+		static const uint32_t dynamic_pass = 1;
+
+		struct Stats
+		{
+			size_t meshes = 0;
+			size_t camera_meshes = 0;
+			size_t shadow_meshes = 0;
+			size_t occluded_meshes = 0;	// In view but hidden, left out of camera_meshes
+			double cull_seconds = 0.0;
+			double occlusion_seconds = 0.0;
+			double batch_seconds = 0.0;
+			DrawBatcher::Stats batching;
+		};
+
+	public:
+		void Clear();
+		// A mesh with model space bounds, the key fields as in DrawKey::Make. The occluder, in
+		// model space too, must outlive Build
+		void Add(const Aabb& bounds, const Matrix4& world, uint32_t pipeline, uint32_t material, uint32_t mesh, bool dynamic,
+			const OccluderMesh* occluder = nullptr);
+		size_t Size() const { return bounds.Size(); };
+
+		// margin widens the camera frustum like Frustum::FromMatrix. The occlusion culler, if
+		// any, is cleared and culls the camera draws
+		void Build(const Matrix4& view_projection, float margin, const Matrix4& shadow_view_projection,
+			MaskedOcclusionCuller* occlusion = nullptr);
+
+		// Batches of the camera pass, then of the dynamic pass from FirstDynamicBatch. The
+		// instances are the indices of the added meshes
+		const std::vector<DrawBatch>& Batches() const { return batcher.Batches(); };
+		const std::vector<uint32_t>& Instances() const { return batcher.Instances(); };
+		size_t FirstDynamicBatch() const { return first_dynamic; };
+		// Meshes inside the shadow camera frustum, in order
+		const std::vector<uint32_t>& ShadowVisible() const { return shadow_visible; };
+		const Stats& GetLastStats() const { return stats; };
+
+	private:
+		struct KeyFields
+		{
+			uint32_t pipeline;
+			uint32_t material;
+			uint32_t mesh;
+		};
+
+		struct Occluder
+		{
+			const OccluderMesh* mesh;
+			Matrix4 world;
+		};
+
+		void cullOccluded(const Matrix4& view_projection, MaskedOcclusionCuller& occlusion);
+
+		BoundsSoA bounds;
+		std::vector<KeyFields> fields;
+		std::vector<uint8_t> dynamic;
+		std::vector<Occluder> occluders;	// One per mesh, null mesh if it has none
+		std::vector<uint32_t> visible;
+		std::vector<uint32_t> shadow_visible;
+		DrawBatcher batcher;
+		size_t first_dynamic = 0;
+		Stats stats;
+	};
+}
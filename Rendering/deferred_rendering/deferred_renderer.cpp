@@ -1,5 +1,6 @@
 #include "deferred_renderer.h"
 #include "graphics/cpu_buffer.h"
+#include <cstring>
 
 DeferredRenderer::DeferredRenderer(egx::Device& dev, egx::CommandContext& context, const ema::point2D& size, float far_plane, float mipmap_bias)
 	: g_buffer(dev, size, far_plane),
@@ -42,9 +43,44 @@ void DeferredRenderer::PrepareFrame(egx::Device& dev, egx::CommandContext& conte
 	context.ClearDepthStencil(g_buffer.DepthBuffer());
 }
 
-void DeferredRenderer::RenderDepthOnly(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model)
+void DeferredRenderer::UploadInstances(egx::Device& dev, egx::CommandContext& context, const std::vector<egx::Model*>& instances)
+{
+	instance_data.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+		instance_data[i] = instances[i]->GetBufferData();
+	if (instance_data.empty() || (instance_data.size() == uploaded_data.size() &&
+		std::memcmp(instance_data.data(), uploaded_data.data(), instance_data.size() * sizeof(egx::Model::BufferType)) == 0))
+		return;
+
+	// The buffer grows by doubling, the old one may still be read by the GPU
+	if (!instance_buffer || instance_buffer->GetElementCount() < (int)instance_data.size())
+	{
+		int capacity = instance_buffer ? instance_buffer->GetElementCount() : 256;
+		while (capacity < (int)instance_data.size())
+			capacity *= 2;
+		dev.WaitForGPU();
+		instance_buffer = std::make_unique<egx::StructuredBuffer>(dev, (int)sizeof(egx::Model::BufferType), capacity);
+	}
+
+	uploaded_data = instance_data;
+	egx::CPUBuffer cpu_buffer(instance_data.data(), (int)(instance_data.size() * sizeof(egx::Model::BufferType)));
+	context.SetTransitionBuffer(*instance_buffer, egx::GPUBufferState::CopyDest);
+	dev.ScheduleUpload(context, cpu_buffer, *instance_buffer);
+	context.SetTransitionBuffer(*instance_buffer, egx::GPUBufferState::NonPixelResource);
+}
+
+void DeferredRenderer::RenderShadows(egx::Device& dev, egx::CommandContext& context, const std::vector<ModelDraws>& draws)
+{
+	for (const auto& model_draws : draws)
+		light_manager.RenderToShadowMap(dev, context, model_draws);
+	light_manager.FinishShadowMap(context);
+}
+
+void DeferredRenderer::RenderDepthOnly(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws)
 {
 	context.SetDepthStencilBuffer(g_buffer.DepthBuffer());
+	if (draws.empty())
+		return;
 
 	// Set root signature and pipeline state
 	context.SetRootSignature(depth_only_rs);
@@ -52,39 +88,43 @@ void DeferredRenderer::RenderDepthOnly(egx::Device& dev, egx::CommandContext& co
 
 	// Set root values
 	context.SetRootConstantBuffer(0, camera.GetBuffer());
-	context.SetRootConstantBuffer(1, model.GetModelBuffer());
+	context.SetRootShaderResource(1, *instance_buffer);
 
 	// Set scissor and viewport
 	context.SetViewport(size);
 	context.SetScissor(size);
 	context.SetPrimitiveTopology(egx::Topology::TriangleList);
 
-	for (auto pmesh : model.GetMeshes())
+	// The draws are sorted by material and mesh, so only the changes are set
+	const egx::Material* last_material = nullptr;
+	for (const auto& draw : draws)
 	{
-		if (pmesh->GetIndexBuffer().GetElementCount() > 0)
-		{
-			// Set vertex buffer
-			context.SetVertexBuffer(pmesh->GetVertexBuffer());
-			context.SetIndexBuffer(pmesh->GetIndexBuffer());
+		const egx::Mesh* pmesh = draw.mesh;
+		context.SetVertexBuffer(pmesh->GetVertexBuffer());
+		context.SetIndexBuffer(pmesh->GetIndexBuffer());
 
-			// Set material
-			const auto& material = pmesh->GetMaterial();
+		// Set material
+		const auto& material = pmesh->GetMaterial();
+		if (&material != last_material)
+		{
 			context.SetRootConstantBuffer(2, material.GetBuffer());
-
 			if (material.HasMaskTexture())
 				context.SetRootDescriptorTable(3, material.GetMaskTexture());
-
-			// Draw
-			context.DrawIndexed(pmesh->GetIndexBuffer().GetElementCount());
+			last_material = &material;
 		}
+
+		// Draw
+		uint32_t first_instance = draw.first_instance;
+		context.SetRootConstant(4, 1, &first_instance);
+		context.DrawIndexedInstanced(pmesh->GetIndexBuffer().GetElementCount(), draw.instance_count);
 	}
 }
 
-void DeferredRenderer::RenderModel(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model)
+void DeferredRenderer::RenderModel(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws)
 {
-	light_manager.RenderToShadowMap(dev, context, model);
-
 	context.SetRenderTargets(g_buffer.DiffuseBuffer(), g_buffer.NormalBuffer(), g_buffer.DepthBuffer());
+	if (draws.empty())
+		return;
 
 	// Set root signature and pipeline state
 	context.SetRootSignature(model_rs);
@@ -92,25 +132,26 @@ void DeferredRenderer::RenderModel(egx::Device& dev, egx::CommandContext& contex
 
 	// Set root values
 	context.SetRootConstantBuffer(0, camera.GetBuffer());
-	context.SetRootConstantBuffer(1, model.GetModelBuffer());
+	context.SetRootShaderResource(1, *instance_buffer);
 
 	// Set scissor and viewport
 	context.SetViewport(size);
 	context.SetScissor(size);
 	context.SetPrimitiveTopology(egx::Topology::TriangleList);
 
-	for (auto pmesh : model.GetMeshes())
+	// The draws are sorted by material and mesh, so only the changes are set
+	const egx::Material* last_material = nullptr;
+	for (const auto& draw : draws)
 	{
-		if (pmesh->GetIndexBuffer().GetElementCount() > 0)
-		{
-			// Set vertex buffer
-			context.SetVertexBuffer(pmesh->GetVertexBuffer());
-			context.SetIndexBuffer(pmesh->GetIndexBuffer());
+		const egx::Mesh* pmesh = draw.mesh;
+		context.SetVertexBuffer(pmesh->GetVertexBuffer());
+		context.SetIndexBuffer(pmesh->GetIndexBuffer());
 
-			// Set material
-			const auto& material = pmesh->GetMaterial();
+		// Set material
+		const auto& material = pmesh->GetMaterial();
+		if (&material != last_material)
+		{
 			context.SetRootConstantBuffer(2, material.GetBuffer());
-
 			if (material.HasDiffuseTexture())
 				context.SetRootDescriptorTable(3, material.GetDiffuseTexture());
 			if (material.HasNormalMap())
@@ -119,10 +160,13 @@ void DeferredRenderer::RenderModel(egx::Device& dev, egx::CommandContext& contex
 				context.SetRootDescriptorTable(5, material.GetSpecularMap());
 			if (material.HasMaskTexture())
 				context.SetRootDescriptorTable(6, material.GetMaskTexture());
-
-			// Draw
-			context.DrawIndexed(pmesh->GetIndexBuffer().GetElementCount());
+			last_material = &material;
 		}
+
+		// Draw
+		uint32_t first_instance = draw.first_instance;
+		context.SetRootConstant(7, 1, &first_instance);
+		context.DrawIndexedInstanced(pmesh->GetIndexBuffer().GetElementCount(), draw.instance_count);
 	}
 
 }
@@ -157,9 +201,11 @@ void DeferredRenderer::RenderLight(egx::Device& dev, egx::CommandContext& contex
 	context.Draw(4);
 }
 
-void DeferredRenderer::RenderMotionVectors(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model)
+void DeferredRenderer::RenderMotionVectors(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws)
 {
 	context.SetRenderTarget(motion_vectors, g_buffer.DepthBuffer());
+	if (draws.empty())
+		return;
 
 	// Set root signature and pipeline state
 	context.SetRootSignature(motion_vector_rs);
@@ -168,24 +214,24 @@ void DeferredRenderer::RenderMotionVectors(egx::Device& dev, egx::CommandContext
 	// Set root values
 	context.SetRootConstantBuffer(0, camera.GetBuffer());
 	context.SetRootConstantBuffer(1, camera.GetLastBuffer());
-	context.SetRootConstantBuffer(2, model.GetModelBuffer());
+	context.SetRootShaderResource(2, *instance_buffer);
 
 	// Set scissor and viewport
 	context.SetViewport(size);
 	context.SetScissor(size);
 	context.SetPrimitiveTopology(egx::Topology::TriangleList);
 
-	for (auto pmesh : model.GetMeshes())
+	for (const auto& draw : draws)
 	{
-		if (pmesh->GetIndexBuffer().GetElementCount() > 0)
-		{
-			// Set vertex buffer
-			context.SetVertexBuffer(pmesh->GetVertexBuffer());
-			context.SetIndexBuffer(pmesh->GetIndexBuffer());
-
-			// Draw
-			context.DrawIndexed(pmesh->GetIndexBuffer().GetElementCount());
-		}
+		// Set vertex buffer
+		const egx::Mesh* pmesh = draw.mesh;
+		context.SetVertexBuffer(pmesh->GetVertexBuffer());
+		context.SetIndexBuffer(pmesh->GetIndexBuffer());
+
+		// Draw
+		uint32_t first_instance = draw.first_instance;
+		context.SetRootConstant(3, 1, &first_instance);
+		context.DrawIndexedInstanced(pmesh->GetIndexBuffer().GetElementCount(), draw.instance_count);
 	}
 }
 
@@ -212,9 +258,10 @@ void DeferredRenderer::initializeDepthOnlyRenderer(egx::Device& dev)
 {
 	// Create root signature
 	depth_only_rs.InitConstantBuffer(0); // Camera
-	depth_only_rs.InitConstantBuffer(1); // Model
+	depth_only_rs.InitShaderResource(1); // Instance models
 	depth_only_rs.InitConstantBuffer(2); // Material
 	depth_only_rs.InitDescriptorTable(0, egx::ShaderVisibility::Pixel); // Material mask texture
+	depth_only_rs.InitConstants(1, 1); // First instance
 	depth_only_rs.AddSampler(egx::Sampler::LinearWrap(), 0);
 	depth_only_rs.Finalize(dev);
 
@@ -254,12 +301,13 @@ void DeferredRenderer::initializeModelRenderer(egx::Device& dev, float mipmap_bi
 	ssaa_sampler.SetMipMapBias(-0.0f + mipmap_bias); // 0.5 * log2(num_samples) (num_samples = 32)
 
 	model_rs.InitConstantBuffer(0); // Camera buffer
-	model_rs.InitConstantBuffer(1); // Model buffer
+	model_rs.InitShaderResource(4); // Instance models
 	model_rs.InitConstantBuffer(2); // Material buffer
 	model_rs.InitDescriptorTable(0, egx::ShaderVisibility::Pixel); // Diffuse
 	model_rs.InitDescriptorTable(1, egx::ShaderVisibility::Pixel); // Normals
 	model_rs.InitDescriptorTable(2, egx::ShaderVisibility::Pixel); // Specular
 	model_rs.InitDescriptorTable(3, egx::ShaderVisibility::Pixel); // Mask
+	model_rs.InitConstants(1, 1); // First instance
 	model_rs.AddSampler(normal_sampler, 0);
 	model_rs.AddSampler(taa_sampler, 1);
 	model_rs.AddSampler(ssaa_sampler, 2);
@@ -327,7 +375,8 @@ void DeferredRenderer::initializeMotionVectorRenderer(egx::Device& dev)
 	// Create root signature
 	motion_vector_rs.InitConstantBuffer(0); // Camera buffer
 	motion_vector_rs.InitConstantBuffer(1); // Last Camera buffer
-	motion_vector_rs.InitConstantBuffer(2); // Model buffer
+	motion_vector_rs.InitShaderResource(0); // Instance models
+	motion_vector_rs.InitConstants(1, 2); // First instance
 	motion_vector_rs.AddSampler(egx::Sampler::LinearClamp(), 0);
 	motion_vector_rs.Finalize(dev);
 
@@ -3,6 +3,7 @@
 #include "g_buffer.h"
 #include "graphics/camera.h"
 #include "light_manager.h"
+#include "draw_list.h"
 #include "graphics/model.h"
 #include "tone_mapper.h"
 
@@ -14,12 +15,18 @@ public:
 	void UpdateLight(egx::Camera& camera);
 
 	void PrepareFrame(egx::Device& dev, egx::CommandContext& context);
-	void RenderDepthOnly(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model);
-	void RenderModel(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model);
+	// Uploads the model matrices of DrawList::Instances for the instanced draws of the frame
+	void UploadInstances(egx::Device& dev, egx::CommandContext& context, const std::vector<egx::Model*>& instances);
+	// The draws of a DrawList, static models before dynamic ones
+	void RenderShadows(egx::Device& dev, egx::CommandContext& context, const std::vector<ModelDraws>& draws);
+	void RenderDepthOnly(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws);
+	void RenderModel(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws);
 	void RenderLight(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::RenderTarget& target);
-	void RenderMotionVectors(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, egx::Model& model);
+	void RenderMotionVectors(egx::Device& dev, egx::CommandContext& context, egx::Camera& camera, const std::vector<InstancedDraw>& draws);
 	void PrepareFrameEnd() { light_manager.PrepareFrameEnd(); };
 
+	const egx::Camera& GetShadowCamera() const { return light_manager.GetCamera(); };
+
 	void ApplyToneMapping(egx::Device& dev, egx::CommandContext& context, egx::Texture2D& texture, egx::RenderTarget& target) { tone_mapper.Apply(dev, context, texture, target); };
 
 	GBuffer& GetGBuffer() { return g_buffer; };
@@ -52,6 +59,11 @@ private:
 
 	ToneMapper tone_mapper;
 
+	// Model matrices of the instanced draws, uploaded again only when they change
+	std::unique_ptr<egx::StructuredBuffer> instance_buffer;
+	std::vector<egx::Model::BufferType> instance_data;
+	std::vector<egx::Model::BufferType> uploaded_data;
+
 	// Shader macros
 	egx::ShaderMacroList macro_list;
 	bool recompile_shaders;
@@ -0,0 +1,110 @@
+#include "draw_list.h"
+#include <stdexcept>
+
+namespace
+{
+	// Widening of the camera frustum, in ndc, covering the sub pixel jitter of TAA and SSAA
+	const float jitter_margin = 0.01f;
+	// Depth buffer of the occlusion culling, whole 8x8 tiles at about the 16:9 of the window
+	const int occlusion_width = 256;
+	const int occlusion_height = 144;
+
+	ecpu::Matrix4 toMatrix4(const ema::mat4& matrix)
+	{
+		ecpu::Matrix4 out;
+		for (int i = 0; i < 4; i++)
+		{
+			const ema::vec4 row = matrix[i];
+			out.m[i][0] = row.x;
+			out.m[i][1] = row.y;
+			out.m[i][2] = row.z;
+			out.m[i][3] = row.w;
+		}
+		return out;
+	}
+}
+
+DrawList::DrawList()
+	: occlusion(occlusion_width, occlusion_height)
+{
+}
+
+void DrawList::Build(const std::vector<std::shared_ptr<egx::Model>>& models, const egx::Camera& camera, const egx::Camera& shadow_camera)
+{
+	culler.Clear();
+	draw_models.clear();
+	draw_meshes.clear();
+	for (const auto& pmodel : models)
+	{
+		const ecpu::Matrix4& world = pmodel->WorldMatrix();
+		for (const auto& pmesh : pmodel->GetMeshes())
+		{
+			if (pmesh->GetIndexBuffer().GetElementCount() == 0)
+				continue;
+			const MeshKey& key = meshKey(pmesh.get());
+			culler.Add(pmesh->GetBounds(), world, key.pipeline, key.material, key.mesh, !pmodel->IsStatic(), &pmesh->GetOccluder());
+			draw_models.push_back(pmodel.get());
+			draw_meshes.push_back(pmesh.get());
+		}
+	}
+	culler.Build(toMatrix4(camera.ViewMatrix() * camera.ProjectionMatrixNoJitter()), jitter_margin,
+		toMatrix4(shadow_camera.ViewMatrix() * shadow_camera.ProjectionMatrixNoJitter()), &occlusion);
+
+	const auto& culled = culler.Instances();
+	instances.resize(culled.size());
+	for (size_t i = 0; i < culled.size(); i++)
+		instances[i] = draw_models[culled[i]];
+
+	const auto& batches = culler.Batches();
+	camera_draws.clear();
+	dynamic_draws.clear();
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		InstancedDraw draw;
+		draw.mesh = draw_meshes[culled[batches[b].first]];
+		draw.first_instance = batches[b].first;
+		draw.instance_count = batches[b].count;
+		(b < culler.FirstDynamicBatch() ? camera_draws : dynamic_draws).push_back(draw);
+	}
+	gather(shadow_draws);
+}
+
+void DrawList::gather(std::vector<ModelDraws>& out) const
+{
+	// Reuses the mesh lists of earlier frames
+	size_t used = 0;
+	for (uint32_t i : culler.ShadowVisible())
+	{
+		if (used == 0 || out[used - 1].model != draw_models[i])
+		{
+			if (used == out.size())
+				out.emplace_back();
+			out[used].model = draw_models[i];
+			out[used].meshes.clear();
+			used++;
+		}
+		out[used - 1].meshes.push_back(draw_meshes[i]);
+	}
+	out.resize(used);
+}
+
+const DrawList::MeshKey& DrawList::meshKey(const egx::Mesh* mesh)
+{
+	auto found = mesh_keys.find(mesh);
+	if (found != mesh_keys.end())
+		return found->second;
+
+	const egx::Material* material = &mesh->GetMaterial();
+	auto material_id = material_ids.find(material);
+	if (material_id == material_ids.end())
+		material_id = material_ids.emplace(material, (uint32_t)material_ids.size()).first;
+	if (material_id->second >= (1u << ecpu::DrawKey::material_bits) || mesh_keys.size() >= (1u << ecpu::DrawKey::mesh_bits))
+		throw std::runtime_error("Too many meshes or materials for the draw keys");
+
+	// Alpha tested meshes after the opaque ones
+	MeshKey key;
+	key.pipeline = material->HasMaskTexture() ? 1 : 0;
+	key.material = material_id->second;
+	key.mesh = (uint32_t)mesh_keys.size();
+	return mesh_keys.emplace(mesh, key).first->second;
+}
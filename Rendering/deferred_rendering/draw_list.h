@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "graphics/camera.h"
+#include "graphics/model.h"
+#include "graphics/mesh.h"
+#include "deferred_rendering/cpu/draw_culler.h"
+
+// The meshes of one model that passed culling
+struct ModelDraws
+{
+	egx::Model* model = nullptr;
+	std::vector<egx::Mesh*> meshes;
+};
+
+// Instances of a mesh drawn with one instanced draw, a range of DrawList::Instances
+struct InstancedDraw
+{
+	egx::Mesh* mesh = nullptr;
+	uint32_t first_instance = 0;
+	uint32_t instance_count = 0;
+};
+
+// Frustum culled draws of the models, built once a frame for the camera and the shadow map
+// camera and used by every pass of the frame, the SSAA samples included. The culling and
+// batching is ecpu::DrawCuller's, which also drops the camera draws hidden behind the
+// occluders the meshes were loaded with. The shadow draws are per model, which keep their order, so
+// static models still come first. The camera draws are instanced draws, front to back within a
+// mesh, for all visible models and for the dynamic ones alone
+class DrawList
+{
+public:
+	DrawList();
+
+	void Build(const std::vector<std::shared_ptr<egx::Model>>& models, const egx::Camera& camera, const egx::Camera& shadow_camera);
+
+	const std::vector<InstancedDraw>& CameraDraws() const { return camera_draws; };
+	const std::vector<InstancedDraw>& DynamicDraws() const { return dynamic_draws; };
+	const std::vector<ModelDraws>& ShadowDraws() const { return shadow_draws; };
+	// Model of every instance of the instanced draws
+	const std::vector<egx::Model*>& Instances() const { return instances; };
+	const ecpu::DrawCuller::Stats& GetLastStats() const { return culler.GetLastStats(); };
+	const ecpu::MaskedOcclusionCuller::Stats& GetOcclusionStats() const { return occlusion.GetStats(); };
+
+private:
+	// Sort key fields of a mesh, numbered the first time it is drawn
+	struct MeshKey
+	{
+		uint32_t pipeline;
+		uint32_t material;
+		uint32_t mesh;
+	};
+
+	void gather(std::vector<ModelDraws>& out) const;
+	const MeshKey& meshKey(const egx::Mesh* mesh);
+
+private:
+	ecpu::DrawCuller culler;
+	ecpu::MaskedOcclusionCuller occlusion;
+	std::vector<egx::Model*> draw_models;	// One per culled mesh
+	std::vector<egx::Mesh*> draw_meshes;
+	std::vector<ModelDraws> shadow_draws;
+
+	std::unordered_map<const egx::Mesh*, MeshKey> mesh_keys;
+	std::unordered_map<const egx::Material*, uint32_t> material_ids;
+	std::vector<InstancedDraw> camera_draws;
+	std::vector<InstancedDraw> dynamic_draws;
+	std::vector<egx::Model*> instances;
+};
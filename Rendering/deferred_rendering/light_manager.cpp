@@ -54,7 +54,7 @@ LightManager::LightManager(egx::Device& dev, egx::CommandContext& context)
 	// Create Shaders
 	egx::Shader VS;
 	egx::Shader PS;
-	VS.CompileVertexShader("../Rendering/shaders/deferred/depth_only_vs.hlsl");
+	VS.CompileVertexShader("../Rendering/shaders/deferred/shadow_vs.hlsl");
 	PS.CompilePixelShader("../Rendering/shaders/deferred/depth_only_ps.hlsl");
 
 	// Get input layout
@@ -109,16 +109,13 @@ void LightManager::PrepareFrame(egx::Device& dev, egx::CommandContext& context)
 	}
 	else
 	{
-		current_buffer_is_static = false;
-		context.SetTransitionBuffer(static_depth_buffer, egx::GPUBufferState::CopySource);
-		context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::CopyDest);
-		context.CopyBuffer(static_depth_buffer, depth_buffer);
-		context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::DepthWrite);
+		copyStaticShadowMap(context);
 	}
 }
 
-void LightManager::RenderToShadowMap(egx::Device& dev, egx::CommandContext& context, egx::Model& model)
+void LightManager::RenderToShadowMap(egx::Device& dev, egx::CommandContext& context, const ModelDraws& draws)
 {
+	egx::Model& model = *draws.model;
 	if (current_buffer_is_static)
 	{
 		if (model.IsStatic())
@@ -127,11 +124,7 @@ void LightManager::RenderToShadowMap(egx::Device& dev, egx::CommandContext& cont
 		}
 		else
 		{
-			current_buffer_is_static = false;
-			context.SetTransitionBuffer(static_depth_buffer, egx::GPUBufferState::CopySource);
-			context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::CopyDest);
-			context.CopyBuffer(static_depth_buffer, depth_buffer);
-			context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::DepthWrite);
+			copyStaticShadowMap(context);
 			context.SetDepthStencilBuffer(depth_buffer);
 		}
 	}
@@ -156,30 +149,42 @@ void LightManager::RenderToShadowMap(egx::Device& dev, egx::CommandContext& cont
 	context.SetScissor(shadow_map_size);
 	context.SetPrimitiveTopology(egx::Topology::TriangleList);
 
-	for (auto pmesh : model.GetMeshes())
+	for (auto pmesh : draws.meshes)
 	{
-		if (pmesh->GetIndexBuffer().GetElementCount() > 0)
-		{
-			// Set vertex buffer
-			context.SetVertexBuffer(pmesh->GetVertexBuffer());
-			context.SetIndexBuffer(pmesh->GetIndexBuffer());
+		// Set vertex buffer
+		context.SetVertexBuffer(pmesh->GetVertexBuffer());
+		context.SetIndexBuffer(pmesh->GetIndexBuffer());
 
-			// Set material
-			const auto& material = pmesh->GetMaterial();
-			context.SetRootConstantBuffer(2, material.GetBuffer());
-			context.SetDescriptorHeap(*dev.buffer_heap);
+		// Set material
+		const auto& material = pmesh->GetMaterial();
+		context.SetRootConstantBuffer(2, material.GetBuffer());
+		context.SetDescriptorHeap(*dev.buffer_heap);
 
-			if (material.HasMaskTexture())
-				context.SetRootDescriptorTable(3, material.GetMaskTexture());
+		if (material.HasMaskTexture())
+			context.SetRootDescriptorTable(3, material.GetMaskTexture());
 
-			// Draw
-			context.DrawIndexed(pmesh->GetIndexBuffer().GetElementCount());
-		}
+		// Draw
+		context.DrawIndexed(pmesh->GetIndexBuffer().GetElementCount());
 	}
 
 }
 
+void LightManager::FinishShadowMap(egx::CommandContext& context)
+{
+	if (current_buffer_is_static)
+		copyStaticShadowMap(context);
+}
+
 void LightManager::PrepareFrameEnd()
 {
 	update_static_this_frame = false;
+}
+
+void LightManager::copyStaticShadowMap(egx::CommandContext& context)
+{
+	current_buffer_is_static = false;
+	context.SetTransitionBuffer(static_depth_buffer, egx::GPUBufferState::CopySource);
+	context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::CopyDest);
+	context.CopyBuffer(static_depth_buffer, depth_buffer);
+	context.SetTransitionBuffer(depth_buffer, egx::GPUBufferState::DepthWrite);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "g_buffer.h"
 #include "graphics/camera.h"
 #include "graphics/model.h"
+#include "draw_list.h"
 
 class LightManager
 {
@@ -12,10 +13,14 @@ public:
 	void Update(const egx::Camera& player_camera);
 
 	void PrepareFrame(egx::Device& dev, egx::CommandContext& context);
-	void RenderToShadowMap(egx::Device& dev, egx::CommandContext& context, egx::Model& model);
+	void RenderToShadowMap(egx::Device& dev, egx::CommandContext& context, const ModelDraws& draws);
+	// Called after the last model of the frame, the shadow map must hold the static models even
+	// when no dynamic model casts a shadow
+	void FinishShadowMap(egx::CommandContext& context);
 	void PrepareFrameEnd();
 	egx::DepthBuffer& GetShadowMap() { return depth_buffer; };
 	egx::ConstantBuffer& GetLightBuffer() { return const_buffer; };
+	const egx::Camera& GetCamera() const { return camera; };
 
 private:
 	egx::OrthographicCamera camera;
@@ -34,4 +39,7 @@ private:
 
 	float r;
 
+private:
+	void copyStaticShadowMap(egx::CommandContext& context);
+
 };
\ No newline at end of file
@@ -0,0 +1,502 @@
+#include "cpu_ray_tracer.h"
+#include "deferred_rendering/cpu/cpu_texture.h"
+#include "cpu/timer.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <numeric>
+
+namespace
+{
+	// RayDesc.TMax of the shaders
+	const float ray_t_max = 100000.0f;
+	// RayDesc.TMin of the shadow and reflection rays, which start on the surface
+	const float secondary_t_min = 0.01f;
+	// Payload depth of the primary rays, reflections are traced below the maximum
+	const int primary_depth = 1;
+	const int max_depth = 2;
+	const float sky_color[3] = { 0.117f, 0.565f, 1.0f };
+	const float pi = 3.14159265f;
+
+	// l of closest_hit.hlsl and miss.hlsl, the direction towards the sun
+	ecpu::Vector3 lightDirection()
+	{
+		return ecpu::Vector3(0.15f, -1.0f, 0.15f).Normalized() * -1.0f;
+	}
+
+	// cash of ray_gen.hlsl. The shader takes the signed remainder of the hash, the index is kept
+	// unsigned here so every pixel gets a valid jitter point
+	uint32_t cash(uint32_t x, uint32_t y)
+	{
+		int32_t h = (int32_t)(x * 374761393u + y * 668265263u);
+		h = (int32_t)((uint32_t)(h ^ (h >> 13)) * 1274126177u);
+		return (uint32_t)(h ^ (h >> 16));
+	}
+
+	// The GGX distribution specular_spec returns, the rest of that function is unreachable
+	float specularSpec(const ecpu::Vector3& n, const ecpu::Vector3& h, float r)
+	{
+		const float alpha = r * r;
+		const float alpha2 = alpha * alpha;
+		const float nh = n.Dot(h);
+		const float t = nh * nh * (alpha2 - 1.0f) + 1.0f;
+		return alpha2 / (pi * t * t);
+	}
+
+	inline float saturate(float v)
+	{
+		return std::min(1.0f, std::max(0.0f, v));
+	}
+
+	// MissShader. pow of a negative base is NaN in HLSL, which saturate turns into 0
+	void miss(const ecpu::Vector3& direction, float* out)
+	{
+		const float sun = direction.Dot(lightDirection());
+		const float sun_factor = sun > 0.0f ? saturate(std::pow(sun, 1000.0f)) : 0.0f;
+		for (int c = 0; c < 3; c++)
+			out[c] = sky_color[c] + (1.0f - sky_color[c]) * sun_factor;
+	}
+}
+
+ecpu::CPURayTracer::CPURayTracer(int width, int height)
+	: width(width), height(height), color(1, height, width, 3), sample_counts(1, height, width, 1)
+{
+	if (width <= 0 || height <= 0)
+		throw std::runtime_error("The ray tracer needs a positive size");
+}
+
+void ecpu::CPURayTracer::Build(const std::vector<RasterDraw>& new_draws, ThreadPool& pool)
+{
+	for (const auto& draw : new_draws)
+		if (draw.mesh == nullptr || draw.material == nullptr)
+			throw std::runtime_error("Draws need a mesh and a material");
+
+	Timer timer;
+	// Moving instances keep the top level tree, only a different set of meshes rebuilds it
+	const bool same_meshes = !top_level.Nodes().empty() && new_draws.size() == draws.size() &&
+		std::equal(new_draws.begin(), new_draws.end(), draws.begin(), [](const RasterDraw& a, const RasterDraw& b) { return a.mesh == b.mesh; });
+	draws = new_draws;
+	instances.resize(draws.size());
+	instance_bounds.resize(draws.size());
+	stats.triangles = 0;
+	stats.bottom_level_builds = 0;
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		auto found = bottom_levels.find(draws[d].mesh);
+		if (found == bottom_levels.end())
+		{
+			found = bottom_levels.emplace(draws[d].mesh, BottomLevel()).first;
+			buildBottomLevel(*draws[d].mesh, pool, found->second);
+			stats.bottom_level_builds++;
+		}
+		const BottomLevel& bottom_level = found->second;
+		instances[d] = { &bottom_level, draws[d].world.Inverse() };
+		stats.triangles += bottom_level.bvh.GetBuildStats().primitives;
+
+		// The world box of the model box's corners, a point for meshes without triangles
+		const Aabb& model_bounds = bottom_level.bvh.Bounds();
+		Aabb& bounds = instance_bounds[d];
+		bounds = Aabb();
+		for (int corner = 0; corner < (model_bounds.Empty() ? 1 : 8); corner++)
+		{
+			const Vector3 p = model_bounds.Empty() ? Vector3() : Vector3(
+				(corner & 1) ? model_bounds.max.x : model_bounds.min.x,
+				(corner & 2) ? model_bounds.max.y : model_bounds.min.y,
+				(corner & 4) ? model_bounds.max.z : model_bounds.min.z);
+			const Vector4 w = draws[d].world.Transform(p);
+			bounds.Grow(Vector3(w.x, w.y, w.z));
+		}
+	}
+
+	if (same_meshes)
+		top_level.Refit(instance_bounds);
+	else
+		top_level.Build(instance_bounds);
+	stats.instances = instances.size();
+	stats.top_level_refit = same_meshes;
+	stats.build_seconds = timer.Elapsed();
+}
+
+void ecpu::CPURayTracer::buildBottomLevel(const eio::ObjbMesh& mesh, ThreadPool& pool, BottomLevel& out)
+{
+	std::vector<Vector3> positions(mesh.vertices.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		positions[i] = Vector3(mesh.vertices[i].position[0], mesh.vertices[i].position[1], mesh.vertices[i].position[2]);
+	// Whole triangles only, like the index buffer the GPU version builds its BLAS from
+	std::vector<uint32_t> indices(mesh.indices.begin(), mesh.indices.begin() + mesh.indices.size() / 3 * 3);
+	BvhBuildSettings settings;
+	settings.spatial_splits = true;
+	out.bvh.BuildTriangles(positions, indices, settings, pool);
+
+	out.triangles.resize(out.bvh.Primitives().size());
+	for (size_t i = 0; i < out.triangles.size(); i++)
+	{
+		const uint32_t first = out.bvh.Primitives()[i] * 3;
+		const Vector3& p0 = positions[indices[first]];
+		const Vector3 e1 = positions[indices[first + 1]] - p0;
+		const Vector3 e2 = positions[indices[first + 2]] - p0;
+		Triangle& triangle = out.triangles[i];
+		triangle = { { p0.x, p0.y, p0.z }, { e1.x, e1.y, e1.z }, { e2.x, e2.y, e2.z }, first };
+	}
+}
+
+void ecpu::CPURayTracer::Render(const RasterCamera& camera, const std::vector<JitterPoint>& jitter, int sample_count, ThreadPool& pool)
+{
+	if (sample_count < 1)
+		throw std::runtime_error("The ray tracer needs at least one sample");
+	const PrimaryRays rays = primaryRays(camera, jitter);
+
+	Timer timer;
+	std::vector<RayCounts> row_counts(height);
+	pool.ParallelFor(height, [&](int y)
+		{
+			RayCounts& counts = row_counts[y];
+			float* out = color.Data() + (size_t)y * width * 3;
+			for (int x = 0; x < width; x++)
+			{
+				float sum[3] = { 0.0f, 0.0f, 0.0f };
+				for (int s = 0; s < sample_count; s++)
+				{
+					float sample[3];
+					samplePixel(rays, jitter, x, y, s, counts, sample);
+					for (int c = 0; c < 3; c++)
+						sum[c] += sample[c];
+				}
+				for (int c = 0; c < 3; c++)
+					out[x * 3 + c] = sum[c] / sample_count;
+			}
+		});
+	std::fill(sample_counts.Data(), sample_counts.Data() + sample_counts.ElementCount(), (float)sample_count);
+
+	stats.primary_rays = (size_t)width * height * sample_count;
+	stats.budget_samples = stats.primary_rays;
+	stats.converged_pixels = 0;
+	stats.max_pixel_samples = sample_count;
+	stats.shadow_rays = 0;
+	stats.reflection_rays = 0;
+	for (const auto& counts : row_counts)
+	{
+		stats.shadow_rays += counts.shadow;
+		stats.reflection_rays += counts.reflection;
+	}
+	stats.trace_seconds = timer.Elapsed();
+}
+
+void ecpu::CPURayTracer::RenderAdaptive(const RasterCamera& camera, const std::vector<JitterPoint>& jitter, const AdaptiveSamplingSettings& settings, ThreadPool& pool)
+{
+	if (settings.min_samples < 2 || settings.batch_samples < 1 || settings.average_samples < settings.min_samples ||
+		settings.max_samples < settings.min_samples || !(settings.threshold >= 0.0f))
+		throw std::runtime_error("Adaptive sampling needs two samples per pixel to estimate the variance, and a budget and maximum of at least that");
+	const PrimaryRays rays = primaryRays(camera, jitter);
+
+	Timer timer;
+	const int pixel_count = width * height;
+	estimates.assign(pixel_count, PixelEstimate());
+	std::vector<RayCounts> thread_counts(pool.ThreadCount());
+	// The pixels take up to count more samples each, in chunks of neighbouring pixels
+	const int chunk = 64;
+	auto sampleRound = [&](const std::vector<int>& pixels, int count)
+	{
+		pool.ParallelFor(((int)pixels.size() + chunk - 1) / chunk, [&](int c, int thread)
+			{
+				const int end = std::min((int)pixels.size(), (c + 1) * chunk);
+				for (int i = c * chunk; i < end; i++)
+				{
+					const int p = pixels[i];
+					PixelEstimate& e = estimates[p];
+					const int last = std::min(settings.max_samples, e.samples + count);
+					for (; e.samples < last; e.samples++)
+					{
+						float sample[3];
+						samplePixel(rays, jitter, p % width, p / width, e.samples, thread_counts[thread], sample);
+						for (int k = 0; k < 3; k++)
+						{
+							const float delta = sample[k] - (e.samples > 0 ? e.sum[k] / e.samples : 0.0f);
+							e.sum[k] += sample[k];
+							e.m2[k] += delta * (sample[k] - e.sum[k] / (e.samples + 1));
+						}
+					}
+				}
+			});
+	};
+
+	std::vector<int> active(pixel_count);
+	std::iota(active.begin(), active.end(), 0);
+	sampleRound(active, settings.min_samples);
+	const size_t budget = (size_t)pixel_count * settings.average_samples;
+	size_t used = (size_t)pixel_count * settings.min_samples;
+	auto halfWidth = [&](int x, int y)
+	{
+		const PixelEstimate& e = estimates[(size_t)y * width + x];
+		float half_width = 0.0f;
+		for (int k = 0; k < 3; k++)
+			half_width = std::max(half_width, settings.z * std::sqrt(std::max(0.0f, e.m2[k]) / ((e.samples - 1) * (float)e.samples)));
+		return half_width;
+	};
+	stats.converged_pixels = 0;
+	std::vector<std::pair<float, int>> noisy;
+	while (!active.empty())
+	{
+		// Pixels whose interval is below the threshold are done, the others sample on while
+		// the budget lasts, noisiest first. A pixel next to a noisy one is noisy too: an edge
+		// covering a small part of a pixel can miss all of its first samples
+		noisy.clear();
+		for (int p : active)
+		{
+			if (estimates[p].samples >= settings.max_samples)
+				continue;
+			const int x = p % width;
+			const int y = p / width;
+			float half_width = 0.0f;
+			for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ny++)
+				for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); nx++)
+					half_width = std::max(half_width, halfWidth(nx, ny));
+			if (half_width < settings.threshold)
+				stats.converged_pixels++;
+			else
+				noisy.push_back({ half_width, p });
+		}
+		const size_t affordable = (budget - used) / settings.batch_samples;
+		if (noisy.size() > affordable)
+		{
+			std::sort(noisy.begin(), noisy.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b)
+				{
+					return a.first > b.first || (a.first == b.first && a.second < b.second);
+				});
+			noisy.resize(affordable);
+		}
+		active.clear();
+		for (const auto& n : noisy)
+		{
+			active.push_back(n.second);
+			used += std::min(settings.batch_samples, settings.max_samples - estimates[n.second].samples);
+		}
+		std::sort(active.begin(), active.end());
+		sampleRound(active, settings.batch_samples);
+	}
+
+	stats.primary_rays = 0;
+	stats.max_pixel_samples = 0;
+	for (int p = 0; p < pixel_count; p++)
+	{
+		const PixelEstimate& e = estimates[p];
+		for (int k = 0; k < 3; k++)
+			color.Data()[(size_t)p * 3 + k] = e.sum[k] / e.samples;
+		sample_counts.Data()[p] = (float)e.samples;
+		stats.primary_rays += e.samples;
+		stats.max_pixel_samples = std::max(stats.max_pixel_samples, e.samples);
+	}
+	stats.budget_samples = budget;
+	stats.shadow_rays = 0;
+	stats.reflection_rays = 0;
+	for (const auto& counts : thread_counts)
+	{
+		stats.shadow_rays += counts.shadow;
+		stats.reflection_rays += counts.reflection;
+	}
+	stats.trace_seconds = timer.Elapsed();
+}
+
+ecpu::CPURayTracer::PrimaryRays ecpu::CPURayTracer::primaryRays(const RasterCamera& camera, const std::vector<JitterPoint>& jitter) const
+{
+	if (camera.Width() != width || camera.Height() != height)
+		throw std::runtime_error("The camera size must match the ray tracer size");
+	if (jitter.empty())
+		throw std::runtime_error("The ray tracer needs jitter points");
+	PrimaryRays rays;
+	rays.inv_projection = camera.ProjectionMatrixNoJitter().Inverse();
+	rays.inv_view = camera.ViewMatrix().Inverse();
+	const Vector4 eye = rays.inv_view.Transform(Vector3(0.0f, 0.0f, 0.0f));
+	rays.origin = Vector3(eye.x, eye.y, eye.z);
+	return rays;
+}
+
+void ecpu::CPURayTracer::samplePixel(const PrimaryRays& rays, const std::vector<JitterPoint>& jitter, int x, int y, int s, RayCounts& counts, float* out) const
+{
+	// RayGenerationShader: rays through the jittered pixel positions on the near plane
+	const JitterPoint& j = jitter[(cash((uint32_t)x, (uint32_t)y) + (uint32_t)s) % (uint32_t)jitter.size()];
+	const float dx = ((float)x + j.x) / width * 2.0f - 1.0f;
+	const float dy = ((float)y + j.y) / height * 2.0f - 1.0f;
+	const Vector4 view_pos = rays.inv_projection.Transform(Vector3(dx, -dy, 0.0f));
+	const Vector3 direction = rays.inv_view.TransformDirection(Vector3(view_pos.x, view_pos.y, view_pos.z)).Normalized();
+	trace(rays.origin, direction, 0.0f, primary_depth, counts, out);
+}
+
+bool ecpu::CPURayTracer::intersect(Ray& ray, bool any_hit, Hit& hit) const
+{
+	bool found = false;
+	top_level.Traverse(ray, [&](uint32_t first, uint32_t count, Ray& world_ray)
+		{
+			for (uint32_t k = first; k < first + count; k++)
+			{
+				// The model space ray keeps the world space length, so t is the same in both
+				const uint32_t index = top_level.Primitives()[k];
+				const Instance& instance = instances[index];
+				const RasterDraw& draw = draws[index];
+				const Vector4 model_origin = instance.world_to_model.Transform(world_ray.origin);
+				Ray ray;
+				ray.origin = Vector3(model_origin.x, model_origin.y, model_origin.z);
+				ray.direction = instance.world_to_model.TransformDirection(world_ray.direction);
+				ray.t_min = world_ray.t_min;
+				ray.t_max = world_ray.t_max;
+				const float d[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+				const float o[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+				bool stop = false;
+				instance.bottom_level->bvh.Traverse(ray, [&](uint32_t first_triangle, uint32_t triangle_count, Ray& r)
+					{
+						for (uint32_t i = first_triangle; i < first_triangle + triangle_count; i++)
+						{
+							// Moller-Trumbore without culling, DXR hits both faces
+							const Triangle& tri = instance.bottom_level->triangles[i];
+							const float p[3] = { d[1] * tri.e2[2] - d[2] * tri.e2[1], d[2] * tri.e2[0] - d[0] * tri.e2[2], d[0] * tri.e2[1] - d[1] * tri.e2[0] };
+							const float det = tri.e1[0] * p[0] + tri.e1[1] * p[1] + tri.e1[2] * p[2];
+							if (det == 0.0f)
+								continue;
+							const float inv_det = 1.0f / det;
+							const float s[3] = { o[0] - tri.v0[0], o[1] - tri.v0[1], o[2] - tri.v0[2] };
+							const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+							if (u < 0.0f || u > 1.0f)
+								continue;
+							const float q[3] = { s[1] * tri.e1[2] - s[2] * tri.e1[1], s[2] * tri.e1[0] - s[0] * tri.e1[2], s[0] * tri.e1[1] - s[1] * tri.e1[0] };
+							const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+							if (v < 0.0f || u + v > 1.0f)
+								continue;
+							const float t = (tri.e2[0] * q[0] + tri.e2[1] * q[1] + tri.e2[2] * q[2]) * inv_det;
+							if (t < r.t_min || t > r.t_max)
+								continue;
+							if (draw.material->mask_texture.data != nullptr && !passesMask(draw, tri, u, v, any_hit))
+								continue;
+
+							hit = { t, u, v, index, i };
+							r.t_max = t;
+							found = true;
+							if (any_hit)
+							{
+								stop = true;
+								return true;
+							}
+						}
+						return false;
+					});
+				world_ray.t_max = ray.t_max;
+				if (stop)
+					return true;
+			}
+			return false;
+		});
+	return found;
+}
+
+bool ecpu::CPURayTracer::passesMask(const RasterDraw& draw, const Triangle& triangle, float u, float v, bool shadow) const
+{
+	// AnyHitShader ignores hits below one half, ShadowAnyHit accepts hits above it
+	const auto& mesh = *draw.mesh;
+	const float* uv0 = mesh.vertices[mesh.indices[triangle.index]].uv;
+	const float* uv1 = mesh.vertices[mesh.indices[triangle.index + 1]].uv;
+	const float* uv2 = mesh.vertices[mesh.indices[triangle.index + 2]].uv;
+	const float w = 1.0f - u - v;
+	float mask = 0.0f;
+	SampleWrap(draw.material->mask_texture, uv0[0] * w + uv1[0] * u + uv2[0] * v, uv0[1] * w + uv1[1] * u + uv2[1] * v,
+		GetTexelTables().linear, 1, &mask);
+	return shadow ? mask > 0.5f : mask >= 0.5f;
+}
+
+void ecpu::CPURayTracer::trace(const Vector3& origin, const Vector3& direction, float t_min, int depth, RayCounts& counts, float* out) const
+{
+	Ray ray;
+	ray.origin = origin;
+	ray.direction = direction;
+	ray.t_min = t_min;
+	ray.t_max = ray_t_max;
+	Hit hit;
+	if (intersect(ray, false, hit))
+		shade(ray, hit, depth, counts, out);
+	else
+		miss(direction, out);
+}
+
+void ecpu::CPURayTracer::shade(const Ray& ray, const Hit& hit, int depth, RayCounts& counts, float* out) const
+{
+	// ClosestHitShader
+	const Triangle& triangle = instances[hit.instance].bottom_level->triangles[hit.triangle];
+	const RasterDraw& draw = draws[hit.instance];
+	const RasterMaterial& material = *draw.material;
+	const auto& mesh = *draw.mesh;
+	const float barycentrics[3] = { 1.0f - hit.u - hit.v, hit.u, hit.v };
+	float ms_normal[3] = { 0.0f, 0.0f, 0.0f };
+	float ms_tangent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float uv[2] = { 0.0f, 0.0f };
+	for (int i = 0; i < 3; i++)
+	{
+		const eio::ObjbVertex& vertex = mesh.vertices[mesh.indices[triangle.index + i]];
+		for (int c = 0; c < 3; c++)
+			ms_normal[c] += vertex.normal[c] * barycentrics[i];
+		for (int c = 0; c < 4; c++)
+			ms_tangent[c] += vertex.tangent[c] * barycentrics[i];
+		for (int c = 0; c < 2; c++)
+			uv[c] += vertex.uv[c] * barycentrics[i];
+	}
+
+	const Vector3 ws_position = ray.origin + ray.direction * hit.t;
+	const Vector3 ws_normal = draw.world.TransformDirection(Vector3(ms_normal[0], ms_normal[1], ms_normal[2])).Normalized();
+	const Vector3 ws_tangent = draw.world.TransformDirection(Vector3(ms_tangent[0], ms_tangent[1], ms_tangent[2])).Normalized();
+	const Vector3 ws_bitangent = ws_tangent.Cross(ws_normal) * ms_tangent[3];
+	const Vector3 v = ray.direction.Normalized() * -1.0f;
+
+	const TexelTables& tables = GetTexelTables();
+	Vector3 n = ws_normal;
+	if (material.normal_map.data != nullptr)
+	{
+		// The .xyx swizzle of the shader, z comes from the first channel
+		float texel[2];
+		SampleWrap(material.normal_map, uv[0], uv[1], tables.linear, 2, texel);
+		const Vector3 normal_sample(texel[0] * 2.0f - 1.0f, -(texel[1] * 2.0f - 1.0f), texel[0]);
+		n = (ws_tangent * normal_sample.x + ws_bitangent * normal_sample.y + ws_normal * normal_sample.z).Normalized();
+		// Vertices with degenerate uvs are baked with NaN tangents. The shader writes NaN there,
+		// which the UNORM target turns black, the reference keeps the interpolated normal
+		if (!std::isfinite(n.x) || !std::isfinite(n.y) || !std::isfinite(n.z))
+			n = ws_normal;
+	}
+
+	// The shader ignores the material's diffuse color, untextured materials are black
+	float albedo[3] = { 0.0f, 0.0f, 0.0f };
+	if (material.diffuse_texture.data != nullptr)
+		SampleWrap(material.diffuse_texture, uv[0], uv[1], tables.srgb, 3, albedo);
+	float specular_intensity = 0.0f;
+	if (material.specular_map.data != nullptr)
+		SampleWrap(material.specular_map, uv[0], uv[1], tables.linear, 1, &specular_intensity);
+
+	for (int c = 0; c < 3; c++)
+		out[c] = 0.2f * albedo[c];
+	const Vector3 l = lightDirection();
+
+	Ray shadow_ray;
+	shadow_ray.origin = ws_position;
+	shadow_ray.direction = l;
+	shadow_ray.t_min = secondary_t_min;
+	shadow_ray.t_max = ray_t_max;
+	Hit shadow_hit;
+	counts.shadow++;
+	if (!intersect(shadow_ray, true, shadow_hit))
+	{
+		// Empirical model
+		const float roughness = 0.8f - 0.7f * specular_intensity;
+		const float shinyness = 0.2f * specular_intensity;
+		const Vector3 h = (l + v).Normalized();
+		const float nl = saturate(n.Dot(l));
+		const float specular = specularSpec(n, h, roughness);
+		for (int c = 0; c < 3; c++)
+			out[c] += nl * (albedo[c] + (specular - albedo[c]) * shinyness);
+	}
+
+	if (depth < max_depth && material.reflectance > 0.0f)
+	{
+		const Vector3 reflected = (v - n * (2.0f * v.Dot(n))) * -1.0f;
+		float reflected_color[3];
+		counts.reflection++;
+		trace(ws_position, reflected, secondary_t_min, depth + 1, counts, reflected_color);
+		const float weight = material.reflectance * specular_intensity;
+		for (int c = 0; c < 3; c++)
+			out[c] += (reflected_color[c] - out[c]) * weight;
+	}
+}
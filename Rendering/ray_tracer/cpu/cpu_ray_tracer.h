@@ -0,0 +1,154 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "cpu/tensor.h"
+#include "cpu/thread_pool.h"
+#include "cpu/bvh.h"
+#include "aa/taa/jitter_points.h"
+#include "deferred_rendering/cpu/cpu_rasterizer.h"
+
+namespace ecpu
+{
+	// Sampling of RenderAdaptive. Every pixel takes min_samples, then pixels keep taking batches
+	// while the confidence interval of their mean, z standard errors wide on either side, is at
+	// least threshold in some channel. The budget of average_samples per pixel goes to the
+	// noisiest pixels first, none taking more than max_samples
+	struct AdaptiveSamplingSettings
+	{
+		int min_samples = 8;
+		int batch_samples = 8;
+		int average_samples = 64;
+		int max_samples = 256;
+		float threshold = 1.0f / 255.0f;
+		float z = 1.96f;	// 95 % confidence
+	};
+
+	// CPU version of RayTracer for rendering reference images without DXR hardware. Like the
+	// BLAS and TLAS of the GPU version, every mesh gets a bottom level Bvh8 over its triangles
+	// in model space, built the first time the mesh is drawn with spatial splits on the pool, and
+	// Build only puts the draws' instance bounds in a top level Bvh8. When the draws use the same meshes as the last Build
+	// the top level is refit instead of rebuilt, so a frame costs as much as its instance count.
+	// Render traces the shaders of shaders/ray_tracing for every pixel: the jittered primary ray
+	// of ray_gen.hlsl, the shading, shadow ray and one bounce of reflection of closest_hit.hlsl,
+	// the masked any hit shaders and the sky and sun of miss.hlsl. Rows are traced in parallel
+	// and each pixel averages its samples, so the result does not depend on the thread count.
+	// The output is the linear color the shaders write, before tone mapping
+	class CPURayTracer
+	{
+	public:
+		struct Stats
+		{
+			size_t triangles = 0;			// Of all instances
+			size_t instances = 0;
+			size_t bottom_level_builds = 0;	// Meshes drawn for the first time
+			bool top_level_refit = false;
+			size_t primary_rays = 0;
+			size_t shadow_rays = 0;
+			size_t reflection_rays = 0;
+			size_t budget_samples = 0;		// What a fixed render takes, above primary_rays when adaptive sampling saves samples
+			size_t converged_pixels = 0;	// Adaptive pixels stopped by the threshold
+			int max_pixel_samples = 0;
+			double build_seconds = 0.0;
+			double trace_seconds = 0.0;
+
+			size_t Rays() const { return primary_rays + shadow_rays + reflection_rays; };
+		};
+
+	public:
+		CPURayTracer(int width, int height);
+
+		// The draws' materials must stay alive until the next Build. Bottom levels are kept per
+		// mesh address, so the meshes must stay alive and unchanged while the tracer is used
+		void Build(const std::vector<RasterDraw>& draws, ThreadPool& pool);
+		// Averages sample_count passes with jitter_index 0 to sample_count - 1, each pixel
+		// taking the jitter points in the hashed order of ray_gen.hlsl
+		void Render(const RasterCamera& camera, const std::vector<JitterPoint>& jitter, int sample_count, ThreadPool& pool);
+		// Like Render, with a sample count per pixel from the variance of its samples. A pixel's
+		// samples only depend on the pixel, so the result does not depend on the thread count,
+		// and pixels that take sample_count samples match Render exactly
+		void RenderAdaptive(const RasterCamera& camera, const std::vector<JitterPoint>& jitter, const AdaptiveSamplingSettings& settings, ThreadPool& pool);
+
+		const Tensor& GetColor() const { return color; };	// { 1, h, w, 3 }
+		const Tensor& GetSampleCounts() const { return sample_counts; };	// { 1, h, w, 1 }
+		const Stats& GetLastStats() const { return stats; };
+		const Bvh8& GetTopLevel() const { return top_level; };
+
+	private:
+		// Model space triangle in the bottom level primitive order, with the edges of the
+		// intersection test. Triangles the build split spatially are stored once per leaf
+		struct Triangle
+		{
+			float v0[3];
+			float e1[3];
+			float e2[3];
+			uint32_t index;	// First index of the triangle in the mesh's index buffer
+		};
+
+		struct BottomLevel
+		{
+			Bvh8 bvh;
+			std::vector<Triangle> triangles;
+		};
+
+		struct Instance
+		{
+			const BottomLevel* bottom_level;
+			Matrix4 world_to_model;
+		};
+
+		struct Hit
+		{
+			float t;
+			float u;	// Barycentric weights of the second and third vertex, like
+			float v;	// BuiltInTriangleIntersectionAttributes
+			uint32_t instance;
+			uint32_t triangle;
+		};
+
+		struct RayCounts
+		{
+			size_t shadow = 0;
+			size_t reflection = 0;
+		};
+
+		// The camera of ray_gen.hlsl
+		struct PrimaryRays
+		{
+			Matrix4 inv_projection;
+			Matrix4 inv_view;
+			Vector3 origin;
+		};
+
+		// Running sums of a pixel's samples, with the squared deviations of Welford's method
+		struct PixelEstimate
+		{
+			float sum[3];
+			float m2[3];
+			int samples;
+		};
+
+		static void buildBottomLevel(const eio::ObjbMesh& mesh, ThreadPool& pool, BottomLevel& out);
+		bool intersect(Ray& ray, bool any_hit, Hit& hit) const;
+		bool passesMask(const RasterDraw& draw, const Triangle& triangle, float u, float v, bool shadow) const;
+		void shade(const Ray& ray, const Hit& hit, int depth, RayCounts& counts, float* out) const;
+		PrimaryRays primaryRays(const RasterCamera& camera, const std::vector<JitterPoint>& jitter) const;
+		// Sample s of pixel x, y, taking the jitter points in the hashed order
+		void samplePixel(const PrimaryRays& rays, const std::vector<JitterPoint>& jitter, int x, int y, int s, RayCounts& counts, float* out) const;
+		void trace(const Vector3& origin, const Vector3& direction, float t_min, int depth, RayCounts& counts, float* out) const;
+
+	private:
+		int width;
+		int height;
+		Stats stats;
+
+		std::vector<RasterDraw> draws;
+		std::map<const eio::ObjbMesh*, BottomLevel> bottom_levels;
+		std::vector<Instance> instances;	// One per draw
+		std::vector<Aabb> instance_bounds;
+		Bvh8 top_level;
+		Tensor color;
+		Tensor sample_counts;
+		std::vector<PixelEstimate> estimates;
+	};
+}
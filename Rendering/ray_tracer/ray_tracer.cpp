@@ -70,16 +70,16 @@ RayTracer::RayTracer(egx::Device& dev, egx::CommandContext& context, const ema::
 	
 }
 
-void RayTracer::BuildTLAS(egx::Device& dev, egx::CommandContext& context, std::vector<std::shared_ptr<egx::Model>>& models)
+void RayTracer::BuildTLAS(egx::Device& dev, egx::CommandContext& context, const std::vector<std::shared_ptr<egx::Model>>& models)
 {
 	tlas.Build(dev, context, models);
 }
-void RayTracer::ReBuildTLAS(egx::CommandContext& context, std::vector<std::shared_ptr<egx::Model>>& models)
+void RayTracer::ReBuildTLAS(egx::CommandContext& context, const std::vector<std::shared_ptr<egx::Model>>& models)
 {
 	tlas.ReBuild(context, models);
 }
 
-void RayTracer::UpdateShaderTable(egx::Device& dev, egx::ConstantBuffer& camera_buffer, egx::ConstantBuffer& jitter_buffer, std::vector<std::shared_ptr<egx::Mesh>>& meshes)
+void RayTracer::UpdateShaderTable(egx::Device& dev, egx::ConstantBuffer& camera_buffer, egx::ConstantBuffer& jitter_buffer, const std::vector<std::shared_ptr<egx::Mesh>>& meshes)
 {
 	auto& program1 = shader_table.AddRayGenerationProgram(L"RayGenerationShader");
 	program1.AddUnorderedAccessTable(output_buffer);
@@ -0,0 +1,190 @@
+#include "cpu_scene.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <cstdint>
+
+namespace
+{
+	ecpu::ImageView<uint8_t> loadTexture(const std::string& path, std::map<std::string, eio::PngImage>& textures)
+	{
+		auto it = textures.find(path);
+		if (it == textures.end())
+			it = textures.emplace(path, eio::LoadPng(path)).first;
+		const eio::PngImage& image = it->second;
+		return ecpu::ImageView<uint8_t>(image.pixels.data(), image.width, image.height, image.channels);
+	}
+
+	// Share of the model's surface area a mesh needs to be an occluder
+	const float min_occluder_area = 0.02f;
+
+	ecpu::OccluderSource occluderSource(const eio::ObjbMesh& mesh)
+	{
+		ecpu::OccluderSource source;
+		source.positions.reserve(mesh.vertices.size());
+		for (const auto& vertex : mesh.vertices)
+			source.positions.push_back(ecpu::Vector3(vertex.position[0], vertex.position[1], vertex.position[2]));
+		source.indices = mesh.indices;
+		return source;
+	}
+}
+
+std::vector<int> ecpu::SelectOccluderMeshes(const std::vector<eio::ObjbMesh>& meshes, const std::vector<eio::ObjbMaterial>& materials)
+{
+	if (materials.size() < meshes.size())
+		throw std::runtime_error("Occluder selection needs a material per mesh");
+	std::vector<float> areas(meshes.size());
+	float total_area = 0.0f;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		areas[i] = ecpu::SurfaceArea(occluderSource(meshes[i]));
+		total_area += areas[i];
+	}
+	std::vector<int> selected;
+	for (size_t i = 0; i < meshes.size(); i++)
+		if (materials[i].mask_map.empty() && areas[i] > 0.0f && areas[i] >= min_occluder_area * total_area)
+			selected.push_back((int)i);
+	return selected;
+}
+
+void ecpu::BakeOccluders(const std::string& obj_name)
+{
+	eio::SaveOccluders(obj_name, SelectOccluderMeshes(eio::LoadObjb(obj_name), eio::LoadMtl(obj_name)));
+}
+
+int ecpu::LoadCameraVideoCount(const std::string& folder)
+{
+	const std::string file_name = folder + "cam_pos_video_count.txt";
+	std::ifstream file(file_name);
+	if (file.fail())
+		throw std::runtime_error("Failed to load file " + file_name);
+	int count = 0;
+	file >> count;
+	return count;
+}
+
+std::vector<ecpu::CameraFrame> ecpu::LoadCameraPath(const std::string& folder, int video)
+{
+	const std::string file_name = folder + "cam_pos_video" + std::to_string(video) + ".txt";
+	std::ifstream file(file_name);
+	if (file.fail())
+		throw std::runtime_error("Failed to load file " + file_name);
+	int frame_count = 0;
+	file >> frame_count;
+	std::vector<CameraFrame> frames(std::max(0, frame_count));
+	for (auto& frame : frames)
+	{
+		file >> frame.time >> frame.position.x >> frame.position.y >> frame.position.z >>
+			frame.rotation.x >> frame.rotation.y >> frame.rotation.z;
+	}
+	return frames;
+}
+
+ecpu::CPUModel::CPUModel(const std::string& obj_name, std::map<std::string, eio::PngImage>& textures)
+	: meshes(eio::LoadObjb(obj_name))
+{
+	const auto mtl = eio::LoadMtl(obj_name);
+	if (mtl.size() < meshes.size())
+		throw std::runtime_error(obj_name + " has more meshes than materials");
+	materials.resize(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		std::copy(mtl[i].diffuse_color, mtl[i].diffuse_color + 3, materials[i].diffuse_color);
+		materials[i].reflectance = mtl[i].reflectance;
+		if (!mtl[i].diffuse_map.empty())
+			materials[i].diffuse_texture = loadTexture(mtl[i].diffuse_map, textures);
+		if (!mtl[i].normal_map.empty())
+			materials[i].normal_map = loadTexture(mtl[i].normal_map, textures);
+		if (!mtl[i].specular_map.empty())
+			materials[i].specular_map = loadTexture(mtl[i].specular_map, textures);
+		if (!mtl[i].mask_map.empty())
+			materials[i].mask_texture = loadTexture(mtl[i].mask_map, textures);
+	}
+
+	mesh_bounds.resize(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+		for (const auto& vertex : meshes[i].vertices)
+			mesh_bounds[i].Grow(Vector3(vertex.position[0], vertex.position[1], vertex.position[2]));
+	occluders.resize(meshes.size());
+	std::vector<int> occluder_meshes;
+	if (eio::LoadOccluders(obj_name, occluder_meshes))
+	{
+		std::vector<OccluderSource> sources;
+		for (const auto& mesh : meshes)
+			sources.push_back(occluderSource(mesh));
+		occluders = MakeOccluders(sources, occluder_meshes);
+	}
+}
+
+ecpu::CPUSponzaScene::CPUSponzaScene()
+	: sponza("../Rendering/models/sponza", textures), knight("../Rendering/models/knight", textures)
+{
+	instances.resize(4);
+	instances[0].model = &sponza;
+	instances[0].scale = 0.01f;
+	const Vector3 knight_positions[3] = { { -0.8f, 0.0f, 0.5f }, { -4.4f, 0.0f, 0.5f }, { 3.0f, 0.0f, 0.5f } };
+	const float knight_rotations[3] = { 0.0f, 3.141692f, 3.141692f };
+	for (int i = 0; i < 3; i++)
+	{
+		instances[i + 1].model = &knight;
+		instances[i + 1].scale = 1.2f;
+		instances[i + 1].position = knight_positions[i];
+		instances[i + 1].rotation = Vector3(0.0f, 0.0f, knight_rotations[i]);
+	}
+}
+
+void ecpu::CPUSponzaScene::Update(float time)
+{
+	instances[1].rotation = Vector3(0.0f, 0.0f, time);
+	instances[2].position = Vector3(-4.4f, 0.0f, 0.5f + 0.5f * std::sin(10.0f * time));
+}
+
+std::vector<ecpu::RasterDraw> ecpu::CPUSponzaScene::NextDraws()
+{
+	std::vector<RasterDraw> draws;
+	for (auto& instance : instances)
+	{
+		const Matrix4 world = Matrix4::World(instance.position, instance.rotation, Vector3(instance.scale, instance.scale, instance.scale));
+		const auto& meshes = instance.model->Meshes();
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			if (meshes[i].indices.empty())
+				continue;
+			RasterDraw draw;
+			draw.mesh = &meshes[i];
+			draw.material = &instance.model->Materials()[i];
+			draw.world = world;
+			draw.last_world = instance.has_last_world ? instance.last_world : world;
+			draw.bounds = &instance.model->MeshBounds()[i];
+			if (!instance.model->Occluders()[i].indices.empty())
+				draw.occluder = &instance.model->Occluders()[i];
+			draws.push_back(draw);
+		}
+		instance.last_world = world;
+		instance.has_last_world = true;
+	}
+	return draws;
+}
+
+void ecpu::CPUSponzaScene::ResetMotion()
+{
+	for (auto& instance : instances)
+		instance.has_last_world = false;
+}
+
+std::vector<ecpu::RasterDraw> ecpu::CullOccludedDraws(const std::vector<RasterDraw>& draws, const RasterCamera& camera, MaskedOcclusionCuller& culler)
+{
+	const Matrix4 view_projection = camera.ViewMatrix() * camera.ProjectionMatrixNoJitter();
+	culler.Clear();
+	for (const auto& draw : draws)
+		if (draw.occluder)
+			culler.RenderOccluder(*draw.occluder, draw.world * view_projection);
+
+	std::vector<RasterDraw> visible;
+	visible.reserve(draws.size());
+	for (const auto& draw : draws)
+		if (!draw.bounds || !culler.IsOccluded(*draw.bounds, draw.world * view_projection))
+			visible.push_back(draw);
+	return visible;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "io/png.h"
+#include "io/objb.h"
+#include "deferred_rendering/cpu/cpu_rasterizer.h"
+
+namespace ecpu
+{
+	// One frame of the cam_pos_video files enn::DatasetVideo writes, time in microseconds
+	struct CameraFrame
+	{
+		long long time = 0;
+		Vector3 position;
+		Vector3 rotation;
+	};
+
+	// Reading of the recorded camera paths in a folder such as ../DatasetGenerator/camera_positions/
+	int LoadCameraVideoCount(const std::string& folder);
+	std::vector<CameraFrame> LoadCameraPath(const std::string& folder, int video);
+
+	// Occluders are the large opaque meshes, the walls, pillars and floors of Sponza: meshes
+	// without a mask texture holding at least 2 % of the model's surface area
+	std::vector<int> SelectOccluderMeshes(const std::vector<eio::ObjbMesh>& meshes, const std::vector<eio::ObjbMaterial>& materials);
+	// Tags the occluders of a baked model in its .occluders file
+	void BakeOccluders(const std::string& obj_name);
+
+	// Meshes of an .objb model with the materials of its .mtl file, mesh i using material i like
+	// LoadMeshFromOBJB. Textures are decoded once and shared between models. Meshes tagged in
+	// the model's .occluders file get the triangles large enough to be worth rasterizing as
+	// occluders, the other meshes and models that were not tagged get none
+	class CPUModel
+	{
+	public:
+		CPUModel(const std::string& obj_name, std::map<std::string, eio::PngImage>& textures);
+
+		const std::vector<eio::ObjbMesh>& Meshes() const { return meshes; };
+		const std::vector<RasterMaterial>& Materials() const { return materials; };
+		const std::vector<Aabb>& MeshBounds() const { return mesh_bounds; };
+		const std::vector<OccluderMesh>& Occluders() const { return occluders; };	// One per mesh
+
+	private:
+		std::vector<eio::ObjbMesh> meshes;
+		std::vector<RasterMaterial> materials;
+		std::vector<Aabb> mesh_bounds;
+		std::vector<OccluderMesh> occluders;
+	};
+
+	// Renders the occluders of the draws into the culler, seen from the camera, and returns
+	// the draws the culler does not hide, in order. The culler's stats count the frame
+	std::vector<RasterDraw> CullOccludedDraws(const std::vector<RasterDraw>& draws, const RasterCamera& camera, MaskedOcclusionCuller& culler);
+
+	// SponzaScene without the GPU resources, for the CPU renderers. The world matrices of the
+	// previous frame are remembered for the motion vectors
+	class CPUSponzaScene
+	{
+	public:
+		CPUSponzaScene();
+		// Materials point into the texture cache
+		CPUSponzaScene(const CPUSponzaScene&) = delete;
+		CPUSponzaScene& operator=(const CPUSponzaScene&) = delete;
+
+		// SponzaScene::Update
+		void Update(float time);
+		// Draws of the current frame, after which the current world matrices become the last ones.
+		// The draws carry the bounds and occluders of their meshes
+		std::vector<RasterDraw> NextDraws();
+		// The first frame of a video has no previous frame and gets the motion of a static scene
+		void ResetMotion();
+
+	private:
+		struct Instance
+		{
+			const CPUModel* model = nullptr;
+			Vector3 position;
+			Vector3 rotation;
+			float scale = 1.0f;
+			Matrix4 last_world = Matrix4::Identity();
+			bool has_last_world = false;
+		};
+
+		std::map<std::string, eio::PngImage> textures;
+		CPUModel sponza;
+		CPUModel knight;
+		std::vector<Instance> instances;
+	};
+}
@@ -0,0 +1,151 @@
+#include "stress_scene.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "io/objb.h"
+#include "cpu/timer.h"
+
+namespace
+{
+	const float two_pi = 6.2831853f;
+	// DrawList's widening of the camera frustum for the jitter of TAA and SSAA
+	const float jitter_margin = 0.01f;
+}
+
+std::vector<ecpu::StressInstance> ecpu::GenerateStressScene(const StressSceneDesc& desc, const std::vector<float>& prop_sizes)
+{
+	if (desc.instances < 0 || desc.materials < 1 || !(desc.dynamic_fraction >= 0.0f && desc.dynamic_fraction <= 1.0f) || !(desc.spacing > 0.0f))
+		throw std::runtime_error("Invalid stress scene description");
+	if (desc.instances > 0 && prop_sizes.empty())
+		throw std::runtime_error("Stress scene without props");
+
+	uint32_t state = desc.seed;
+	auto random = [&]() { state = state * 1664525u + 1013904223u; return (float)(state >> 8) / (float)(1 << 24); };
+	const int side = (int)std::ceil(std::sqrt((double)desc.instances));
+	const float center = 0.5f * (float)(side - 1);
+	const int prop_count = (int)prop_sizes.size();
+	std::vector<StressInstance> instances(desc.instances);
+	for (int i = 0; i < desc.instances; i++)
+	{
+		StressInstance& instance = instances[i];
+		instance.prop = std::min((int)(random() * prop_count), prop_count - 1);
+		instance.material = std::min((int)(random() * desc.materials), desc.materials - 1);
+		instance.dynamic = std::floor((i + 1) * (double)desc.dynamic_fraction) > std::floor(i * (double)desc.dynamic_fraction);
+
+		const float jitter_x = random() - 0.5f;
+		const float jitter_z = random() - 0.5f;
+		instance.position.x = ((float)(i % side) - center + 0.2f * jitter_x) * desc.spacing;
+		instance.position.z = ((float)(i / side) - center + 0.2f * jitter_z) * desc.spacing;
+		instance.rotation.z = random() * two_pi;
+		const float size = prop_sizes[instance.prop];
+		instance.scale = (0.6f + 0.2f * random()) * desc.spacing / (size > 0.0f ? size : 1.0f);
+		instance.phase = random() * two_pi;
+	}
+	return instances;
+}
+
+void ecpu::AnimateStressInstance(const StressInstance& instance, float time, Vector3& position, Vector3& rotation)
+{
+	position = instance.position;
+	rotation = instance.rotation;
+	if (!instance.dynamic)
+		return;
+	// Like the knights of SponzaScene
+	rotation.z += time;
+	position.z += 0.5f * std::sin(10.0f * time + instance.phase);
+}
+
+ecpu::StressProp ecpu::LoadStressProp(const std::string& obj_name)
+{
+	const auto meshes = eio::LoadObjb(obj_name);
+	const auto materials = eio::LoadMtl(obj_name);
+	if (materials.size() < meshes.size())
+		throw std::runtime_error(obj_name + " has more meshes than materials");
+	StressProp prop;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].indices.empty())
+			continue;
+		Aabb box;
+		for (const auto& vertex : meshes[i].vertices)
+			box.Grow(Vector3(vertex.position[0], vertex.position[1], vertex.position[2]));
+		prop.mesh_bounds.push_back(box);
+		prop.masked.push_back(materials[i].mask_map.empty() ? 0 : 1);
+		prop.bounds.Grow(box);
+	}
+	return prop;
+}
+
+ecpu::CPUStressScene::CPUStressScene(const StressSceneDesc& desc, const std::vector<StressProp>& props)
+	: props(props), material_variants((uint32_t)std::max(desc.materials, 1))
+{
+	std::vector<float> sizes;
+	uint32_t meshes = 0;
+	uint32_t materials = 0;
+	for (const auto& prop : props)
+	{
+		if (prop.masked.size() != prop.mesh_bounds.size())
+			throw std::runtime_error("Stress prop needs a mask flag per mesh");
+		first_mesh.push_back(meshes);
+		first_material.push_back(materials);
+		meshes += (uint32_t)prop.mesh_bounds.size();
+		materials += (uint32_t)prop.mesh_bounds.size() * material_variants;
+		const Vector3 extent = prop.bounds.Empty() ? Vector3(0.0f, 0.0f, 0.0f) : prop.bounds.max - prop.bounds.min;
+		sizes.push_back(std::max(extent.x, std::max(extent.y, extent.z)));
+	}
+	if (meshes > (1u << DrawKey::mesh_bits) || materials > (1u << DrawKey::material_bits))
+		throw std::runtime_error("Too many meshes or materials for the draw keys");
+
+	instances = GenerateStressScene(desc, sizes);
+	for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+	{
+		const StressInstance& instance = instances[i];
+		const uint32_t node = transforms.Add();
+		transforms.SetPosition(node, instance.position);
+		transforms.SetRotation(node, instance.rotation);
+		transforms.SetScale(node, Vector3(instance.scale, instance.scale, instance.scale));
+		if (instance.dynamic)
+			dynamic_instances.push_back(i);
+	}
+	transforms.Update();
+}
+
+void ecpu::CPUStressScene::Update(float time)
+{
+	Timer timer;
+	Vector3 position, rotation;
+	for (uint32_t i : dynamic_instances)
+	{
+		AnimateStressInstance(instances[i], time, position, rotation);
+		transforms.SetPosition(i, position);
+		transforms.SetRotation(i, rotation);
+	}
+	transforms.Update();
+	stats.transform_seconds = timer.Elapsed();
+}
+
+void ecpu::CPUStressScene::PrepareFrame(const Matrix4& view_projection, const Matrix4& shadow_view_projection)
+{
+	Timer timer;
+	culler.Clear();
+	for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+	{
+		const StressInstance& instance = instances[i];
+		const StressProp& prop = props[instance.prop];
+		const Matrix4& world = transforms.World(i);
+		for (uint32_t mesh = 0; mesh < (uint32_t)prop.mesh_bounds.size(); mesh++)
+		{
+			const uint32_t material = first_material[instance.prop] + mesh * material_variants + (uint32_t)instance.material;
+			culler.Add(prop.mesh_bounds[mesh], world, prop.masked[mesh], material, first_mesh[instance.prop] + mesh, instance.dynamic);
+		}
+	}
+	stats.gather_seconds = timer.Elapsed();
+
+	culler.Build(view_projection, jitter_margin, shadow_view_projection);
+	stats.cull_seconds = culler.GetLastStats().cull_seconds;
+	stats.batch_seconds = culler.GetLastStats().batch_seconds;
+
+	// Every instance has a model buffer
+	stats.uploads = transforms.Changed().size();
+	transforms.ClearChanged();
+}
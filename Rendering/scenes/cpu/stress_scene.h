@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "cpu/transform_hierarchy.h"
+#include "cpu/bvh.h"
+#include "deferred_rendering/cpu/draw_culler.h"
+
+namespace ecpu
+{
+	// Parameters of a procedural scene of many prop instances, for measuring how the frame loop
+	// scales with the instance count
+	struct StressSceneDesc
+	{
+		int instances = 1000;
+		int materials = 16;				// Material variants of every prop material
+		float dynamic_fraction = 0.1f;	// Share of the instances that move every frame
+		float spacing = 3.0f;			// Between the cells of the instance grid
+		uint32_t seed = 1;
+	};
+
+	// One prop placed by GenerateStressScene
+	struct StressInstance
+	{
+		int prop = 0;
+		int material = 0;	// Variant in [0, materials)
+		bool dynamic = false;
+		Vector3 position;
+		Vector3 rotation;
+		float scale = 1.0f;
+		float phase = 0.0f;	// Of the animation
+	};
+
+	// Instances on a square grid in the xz plane centered on the origin, one per cell with some
+	// jitter, each a random prop, material variant and yaw. A prop is scaled so its largest
+	// extent, prop_sizes[prop], fills most of a cell. The dynamic instances are spread evenly
+	// over the grid, there are exactly dynamic_fraction * instances of them, rounded down
+	std::vector<StressInstance> GenerateStressScene(const StressSceneDesc& desc, const std::vector<float>& prop_sizes);
+	// Position and rotation of an instance at the given time, dynamic instances spin and slide
+	void AnimateStressInstance(const StressInstance& instance, float time, Vector3& position, Vector3& rotation);
+
+	// The culling data of a baked model: the bounds of its meshes and whether their materials
+	// are alpha tested, mesh i using material i like LoadMeshFromOBJB. Empty meshes are dropped
+	struct StressProp
+	{
+		std::vector<Aabb> mesh_bounds;
+		std::vector<uint8_t> masked;
+		Aabb bounds;
+	};
+	StressProp LoadStressProp(const std::string& obj_name);
+
+	// StressScene without the GPU resources, for measuring the CPU side of a frame headless:
+	// the transform update, the culling and batching of DrawList and the model buffer uploads of
+	// Scene::UploadTransforms, counted but not done. Every variant of a prop material is its own
+	// draw key material, so the material count reaches the batching
+	class CPUStressScene
+	{
+	public:
+		// Frame preparation of the last Update and PrepareFrame
+		struct Stats
+		{
+			size_t uploads = 0;
+			double transform_seconds = 0.0;
+			double gather_seconds = 0.0;
+			double cull_seconds = 0.0;
+			double batch_seconds = 0.0;
+
+			double TotalSeconds() const { return transform_seconds + gather_seconds + cull_seconds + batch_seconds; };
+		};
+
+	public:
+		CPUStressScene(const StressSceneDesc& desc, const std::vector<StressProp>& props);
+
+		// Scene::Update
+		void Update(float time);
+		// DrawList::Build for a camera and the shadow map camera
+		void PrepareFrame(const Matrix4& view_projection, const Matrix4& shadow_view_projection);
+
+		const std::vector<StressInstance>& Instances() const { return instances; };
+		const TransformHierarchy& GetTransforms() const { return transforms; };
+		const DrawCuller& GetDrawCuller() const { return culler; };
+		const Stats& GetLastStats() const { return stats; };
+
+	private:
+		std::vector<StressProp> props;
+		uint32_t material_variants;
+		std::vector<uint32_t> first_mesh;		// Draw key mesh of the first mesh of each prop
+		std::vector<uint32_t> first_material;	// Draw key material of the first variant of each prop
+		std::vector<StressInstance> instances;
+		std::vector<uint32_t> dynamic_instances;
+		TransformHierarchy transforms;
+		DrawCuller culler;
+		Stats stats;
+	};
+}
@@ -1,19 +1,34 @@
 #include "scene.h"
 #include "io/mesh_io.h"
+#include <algorithm>
 
+size_t Scene::UploadTransforms(egx::Device& dev, egx::CommandContext& context)
+{
+	size_t uploads = 0;
+	for (uint32_t node : transforms.Changed())
+	{
+		if (node < node_models.size() && node_models[node])
+		{
+			node_models[node]->UpdateBuffer(dev, context);
+			uploads++;
+		}
+	}
+	transforms.ClearChanged();
+	return uploads;
+}
 
 SponzaScene::SponzaScene(egx::Device& dev, egx::CommandContext& context, egx::MaterialManager& mat_manager)
 {
 	// Load assets
 	sponza_mesh = eio::LoadMeshFromOBJB(dev, context, "../Rendering/models/sponza", mat_manager);
-	sponza_model = std::make_shared<egx::Model>(dev, sponza_mesh);
+	sponza_model = std::make_shared<egx::Model>(dev, transforms, sponza_mesh);
 	sponza_model->SetScale(0.01f);
 	sponza_model->SetStatic(true);
 
 	knight_mesh = eio::LoadMeshFromOBJB(dev, context, "../Rendering/models/knight", mat_manager);
-	knight_model1 = std::make_shared<egx::Model>(dev, knight_mesh);
-	knight_model2 = std::make_shared<egx::Model>(dev, knight_mesh);
-	knight_model3 = std::make_shared<egx::Model>(dev, knight_mesh);
+	knight_model1 = std::make_shared<egx::Model>(dev, transforms, knight_mesh);
+	knight_model2 = std::make_shared<egx::Model>(dev, transforms, knight_mesh);
+	knight_model3 = std::make_shared<egx::Model>(dev, transforms, knight_mesh);
 	knight_model1->SetScale(1.2f);
 	knight_model2->SetScale(1.2f);
 	knight_model3->SetScale(1.2f);
@@ -27,15 +42,65 @@ SponzaScene::SponzaScene(egx::Device& dev, egx::CommandContext& context, egx::Ma
 
 	meshes.insert(meshes.end(), sponza_mesh.begin(), sponza_mesh.end());
 	meshes.insert(meshes.end(), knight_mesh.begin(), knight_mesh.end());
-	static_models.push_back(sponza_model);
-	dynamic_models.push_back(knight_model1);
-	dynamic_models.push_back(knight_model2);
-	dynamic_models.push_back(knight_model3);
+	addModel(sponza_model);
+	addModel(knight_model1);
+	addModel(knight_model2);
+	addModel(knight_model3);
+	transforms.Update();
 }
 
-void SponzaScene::Update(float time)
+void SponzaScene::animate(float time)
 {
 	float rot = time;
 	knight_model1->SetRotation(ema::vec3(0.0f, 0.0f, rot));
 	knight_model2->SetPosition(ema::vec3(-4.4f, 0.0f, 0.5f + 0.5f * sinf(10.0f * time)));
+}
+
+StressScene::StressScene(egx::Device& dev, egx::CommandContext& context, egx::MaterialManager& mat_manager, const ecpu::StressSceneDesc& desc,
+	const std::vector<std::string>& prop_names)
+{
+	std::vector<std::vector<std::shared_ptr<egx::Mesh>>> props;
+	std::vector<float> sizes;
+	for (const auto& name : prop_names)
+	{
+		props.push_back(eio::LoadMeshFromOBJB(dev, context, name, mat_manager));
+		ecpu::Aabb bounds;
+		for (const auto& pmesh : props.back())
+			bounds.Grow(pmesh->GetBounds());
+		const ecpu::Vector3 extent = bounds.Empty() ? ecpu::Vector3(0.0f, 0.0f, 0.0f) : bounds.max - bounds.min;
+		sizes.push_back(std::max(extent.x, std::max(extent.y, extent.z)));
+		meshes.insert(meshes.end(), props.back().begin(), props.back().end());
+	}
+	instances = ecpu::GenerateStressScene(desc, sizes);
+
+	// Static models first, so adding them never moves the dynamic ones
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+		{
+			const ecpu::StressInstance& instance = instances[i];
+			if (instance.dynamic != (pass == 1))
+				continue;
+			auto model = std::make_shared<egx::Model>(dev, transforms, props[instance.prop]);
+			model->SetPosition(ema::vec3(instance.position.x, instance.position.y, instance.position.z));
+			model->SetRotation(ema::vec3(instance.rotation.x, instance.rotation.y, instance.rotation.z));
+			model->SetScale(instance.scale);
+			model->SetStatic(!instance.dynamic);
+			addModel(model);
+			if (instance.dynamic)
+				dynamic_instances.push_back(i);
+		}
+	}
+	transforms.Update();
+}
+
+void StressScene::animate(float time)
+{
+	ecpu::Vector3 position, rotation;
+	for (size_t i = 0; i < dynamic_instances.size(); i++)
+	{
+		ecpu::AnimateStressInstance(instances[dynamic_instances[i]], time, position, rotation);
+		dynamic_models[i]->SetPosition(ema::vec3(position.x, position.y, position.z));
+		dynamic_models[i]->SetRotation(ema::vec3(rotation.x, rotation.y, rotation.z));
+	}
 }
\ No newline at end of file
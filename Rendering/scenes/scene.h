@@ -2,6 +2,7 @@
 #include <vector>
 #include "graphics/model.h"
 #include "graphics/materials.h"
+#include "scenes/cpu/stress_scene.h"
 
 class Scene
 {
@@ -9,19 +10,53 @@ protected:
 	std::vector<std::shared_ptr<egx::Mesh>> meshes;
 	std::vector<std::shared_ptr<egx::Model>> static_models;
 	std::vector<std::shared_ptr<egx::Model>> dynamic_models;
+	std::vector<std::shared_ptr<egx::Model>> models; // Static models first, like the shadow map needs
+	// Transforms of the models, which keep a pointer to it, so scenes are never copied
+	ecpu::TransformHierarchy transforms;
+	std::vector<egx::Model*> node_models; // Model of each transform node, if any
+
+	// Adds the model to the static or the dynamic models and to the list of all models
+	void addModel(const std::shared_ptr<egx::Model>& model)
+	{
+		const uint32_t node = model->GetTransformNode();
+		if (node >= node_models.size())
+			node_models.resize(node + 1, nullptr);
+		node_models[node] = model.get();
+		if (model->IsStatic())
+		{
+			models.insert(models.begin() + static_models.size(), model);
+			static_models.push_back(model);
+		}
+		else
+		{
+			models.push_back(model);
+			dynamic_models.push_back(model);
+		}
+	};
+
+	// Moves the models of the scene at the given time
+	virtual void animate(float time) = 0;
 
 public:
 	Scene() {};
-	std::vector<std::shared_ptr<egx::Mesh>> GetMeshes() { return meshes; };
-	std::vector<std::shared_ptr<egx::Model>> GetStaticModels() { return static_models; };
-	std::vector<std::shared_ptr<egx::Model>> GetDynamicModels() { return dynamic_models; };
-	std::vector<std::shared_ptr<egx::Model>> GetModels() 
-	{ 
-		std::vector<std::shared_ptr<egx::Model>> out(static_models.begin(), static_models.end());
-		out.insert(out.end(), dynamic_models.begin(), dynamic_models.end());
-		return out;
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+	virtual ~Scene() {};
+	const std::vector<std::shared_ptr<egx::Mesh>>& GetMeshes() const { return meshes; };
+	const std::vector<std::shared_ptr<egx::Model>>& GetStaticModels() const { return static_models; };
+	const std::vector<std::shared_ptr<egx::Model>>& GetDynamicModels() const { return dynamic_models; };
+	const std::vector<std::shared_ptr<egx::Model>>& GetModels() const { return models; };
+	const ecpu::TransformHierarchy& GetTransforms() const { return transforms; };
+
+	// Animates the scene and recomputes the world matrices of the models that moved
+	void Update(float time)
+	{
+		animate(time);
+		transforms.Update();
 	};
-	virtual void Update(float time) = 0;
+	// Uploads the model buffers of the models whose world or last world matrix changed since
+	// the last upload and returns how many there were
+	size_t UploadTransforms(egx::Device& dev, egx::CommandContext& context);
 };
 
 class SponzaScene : public Scene
@@ -36,5 +71,24 @@ private:
 
 public:
 	SponzaScene(egx::Device& dev, egx::CommandContext& context, egx::MaterialManager& mat_manager);
-	void Update(float time);
+
+protected:
+	void animate(float time);
+};
+
+// Instances of baked models placed by ecpu::GenerateStressScene, for seeing how the frame loop
+// scales. The meshes keep the materials of their .mtl files, the material variants of the
+// description only reach the draw keys of ecpu::CPUStressScene
+class StressScene : public Scene
+{
+private:
+	std::vector<ecpu::StressInstance> instances;
+	std::vector<uint32_t> dynamic_instances; // In the order of the dynamic models
+
+public:
+	StressScene(egx::Device& dev, egx::CommandContext& context, egx::MaterialManager& mat_manager, const ecpu::StressSceneDesc& desc,
+		const std::vector<std::string>& prop_names = { "../Rendering/models/knight", "../Rendering/models/good-well" });
+
+protected:
+	void animate(float time);
 };
\ No newline at end of file
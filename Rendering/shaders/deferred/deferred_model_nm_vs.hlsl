@@ -5,9 +5,11 @@ cbuffer CameraBuffer : register(b0)
 {
 	CameraBufferType camera;
 }
-cbuffer ModelBuffer : register(b1)
+// The models of all instanced draws, an instanced draw starts at first_instance
+StructuredBuffer<ModelBufferType> instances : register(t4);
+cbuffer InstanceBuffer : register(b1)
 {
-	ModelBufferType model;
+	uint first_instance;
 }
 
 struct VSInput
@@ -26,8 +28,9 @@ struct VSOutput
 	float3x3 tbn : NORMAL;
 };
 
-VSOutput VS(VSInput input)
+VSOutput VS(VSInput input, uint instance_id : SV_InstanceID)
 {
+	ModelBufferType model = instances[first_instance + instance_id];
 	VSOutput output;
 	output.position = mul(float4(input.position, 1.0), model.world_matrix);
 	output.position = mul(output.position, camera.view_matrix);
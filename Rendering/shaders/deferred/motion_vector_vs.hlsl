@@ -9,9 +9,11 @@ cbuffer LastFrameCameraBuffer : register(b1)
 {
 	CameraBufferType last_cam;
 }
-cbuffer ModelBuffer : register(b2)
+// The models of all instanced draws, an instanced draw starts at first_instance
+StructuredBuffer<ModelBufferType> instances : register(t0);
+cbuffer InstanceBuffer : register(b2)
 {
-	ModelBufferType model;
+	uint first_instance;
 }
 
 struct VSInput
@@ -29,8 +31,9 @@ struct VSOutput
 	float3 last_pos: TEXCOORD1;
 };
 
-VSOutput VS(VSInput input)
+VSOutput VS(VSInput input, uint instance_id : SV_InstanceID)
 {
+	ModelBufferType model = instances[first_instance + instance_id];
 	VSOutput output;
 	float4 curr_pos = mul(float4(input.position, 1.0), model.world_matrix);
 	float4 last_pos = mul(float4(input.position, 1.0), model.last_world_matrix);
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "cpu/thread_pool.h"
+#include "cpu/timer.h"
+#include "io/png.h"
+#include "aa/taa/jitter_points.h"
+#include "deep_learning/cpu/dataset_reader.h"
+#include "ray_tracer/cpu/cpu_ray_tracer.h"
+#include "scenes/cpu/cpu_scene.h"
+
+// Renders the reference targets of the dataset with the CPU ray tracer instead of the SSAA
+// passes of DatasetGenerator: every frame of the recorded camera paths through the Sponza scene,
+// averaged over the Halton jitter of SSAA and written sRGB encoded, like the UNORM8x4SRGB
+// target, to the spp folders of the dataset layout. With an adaptive threshold, in 1/255 of the
+// output, pixels stop sampling once converged and the saved samples go to the noisiest pixels,
+// keeping samples per pixel as the average.
+// Usage: TargetTracer <output root> [samples per pixel] [video count] [adaptive threshold]
+namespace
+{
+	const char* usage = "Usage: TargetTracer <output root> [samples per pixel] [video count] [adaptive threshold]";
+
+	// The settings of DatasetGenerator
+	const int output_width = 1920;
+	const int output_height = 1080;
+	const float near_plane = 0.1f;
+	const float far_plane = 100.0f;
+	const float field_of_view = 3.141592f / 3.0f;
+	const int default_samples_per_pixel = 64;
+	// Adaptive pixels take from an eighth to four times the average
+	const int adaptive_min_divisor = 8;
+	const int adaptive_max_factor = 4;
+
+	const std::string camera_folder = "../DatasetGenerator/camera_positions/";
+
+	void makeDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	// What writing to the sRGB render target does
+	eio::PngImage srgbImage(const ecpu::Tensor& color)
+	{
+		ecpu::Tensor encoded(color.Shape());
+		for (size_t i = 0; i < color.ElementCount(); i++)
+		{
+			const float v = std::min(1.0f, std::max(0.0f, color.Data()[i]));
+			encoded.Data()[i] = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+		}
+		return ecpu::TensorToImage(encoded);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << usage << std::endl;
+		return 1;
+	}
+	const std::string root = argv[1];
+	const int samples_per_pixel = argc > 2 ? std::max(1, std::atoi(argv[2])) : default_samples_per_pixel;
+	const int recorded_videos = ecpu::LoadCameraVideoCount(camera_folder);
+	const int video_count = argc > 3 ? std::min(recorded_videos, std::max(0, std::atoi(argv[3]))) : recorded_videos;
+	const float adaptive_threshold = argc > 4 ? (float)std::atof(argv[4]) / 255.0f : 0.0f;
+	if (adaptive_threshold > 0.0f && samples_per_pixel < 2)
+	{
+		std::cout << "Adaptive sampling needs at least two samples per pixel" << std::endl;
+		return 1;
+	}
+	ecpu::AdaptiveSamplingSettings adaptive;
+	adaptive.average_samples = samples_per_pixel;
+	adaptive.min_samples = std::max(2, samples_per_pixel / adaptive_min_divisor);
+	adaptive.batch_samples = adaptive.min_samples;
+	adaptive.max_samples = samples_per_pixel * adaptive_max_factor;
+	adaptive.threshold = adaptive_threshold;
+
+	std::cout << "Loading the scene" << std::endl;
+	ecpu::CPUSponzaScene scene;
+	ecpu::ThreadPool pool;
+	ecpu::CPURayTracer tracer(output_width, output_height);
+	const auto jitter = HaltonJitterPoints(2, 3, adaptive_threshold > 0.0f ? adaptive.max_samples : samples_per_pixel);
+
+	const std::string directory = root + "/spp" + std::to_string(samples_per_pixel);
+	makeDirectory(root);
+	makeDirectory(directory);
+	for (int v = 0; v < video_count; v++)
+		makeDirectory(directory + "/video" + std::to_string(v));
+
+	std::cout << "Tracing " << video_count << " videos at " << output_width << "x" << output_height << " with " << samples_per_pixel
+		<< " samples per pixel" << (adaptive_threshold > 0.0f ? " on average" : "") << " on " << pool.ThreadCount() << " threads" << std::endl;
+	ecpu::CPURayTracer::Stats total;
+	int frames = 0;
+	ecpu::Timer timer;
+	for (int v = 0; v < video_count; v++)
+	{
+		const auto path = ecpu::LoadCameraPath(camera_folder, v);
+		ecpu::RasterCamera camera(output_width, output_height, near_plane, far_plane, field_of_view);
+		for (int f = 0; f < (int)path.size(); f++)
+		{
+			camera.SetPosition(path[f].position);
+			camera.SetRotation(path[f].rotation);
+			camera.Update();
+			scene.Update((float)((double)path[f].time / 1000000.0));
+			tracer.Build(scene.NextDraws(), pool);
+			if (adaptive_threshold > 0.0f)
+				tracer.RenderAdaptive(camera, jitter, adaptive, pool);
+			else
+				tracer.Render(camera, jitter, samples_per_pixel, pool);
+			eio::SavePng(ecpu::DatasetTargetPath(root, samples_per_pixel, v, f), srgbImage(tracer.GetColor()));
+
+			const auto& stats = tracer.GetLastStats();
+			total.primary_rays += stats.primary_rays;
+			total.shadow_rays += stats.shadow_rays;
+			total.reflection_rays += stats.reflection_rays;
+			total.budget_samples += stats.budget_samples;
+			total.build_seconds += stats.build_seconds;
+			total.trace_seconds += stats.trace_seconds;
+			frames++;
+			std::cout << "  video " << v << " frame " << f << ": " << std::fixed << std::setprecision(2) << stats.trace_seconds << " s, "
+				<< 100.0 * (1.0 - (double)stats.primary_rays / stats.budget_samples) << " % of the samples saved" << std::endl;
+		}
+	}
+
+	if (frames == 0)
+		return 0;
+	const double seconds = timer.Elapsed();
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << frames << " frames in " << seconds << " s, build " << total.build_seconds / frames << " s and trace "
+		<< total.trace_seconds / frames << " s per frame, " << total.Rays() / total.trace_seconds / 1e6 << " Mrays/s, "
+		<< 100.0 * (1.0 - (double)total.primary_rays / total.budget_samples) << " % of the samples saved" << std::endl;
+}
@@ -1,9 +1,14 @@
 #include <iostream>
+#include <fstream>
 #include "math/mat4.h"
 #include "misc/string_helpers.h"
 #include "io/mesh_io.h"
 #include "io/game_clock.h"
 #include "io/console.h"
+#include "scenes/cpu/cpu_scene.h"
+#include "network_testing.h"
+#include "aa_testing.h"
+#include "render_testing.h"
 
 namespace
 {
@@ -23,10 +28,24 @@ namespace
 int main()
 {
     //matrixTesting();
+    // A failing check fails the run before the models are converted
+    int failures = NetworkTesting() + AATesting() + RenderTesting();
+    if (failures > 0)
+    {
+        std::cout << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
     eio::GameClock clock;
     eio::Console::InitConsole2(&clock);
 
-    eio::ConvertOBJToOBJB("../Anti-Aliasing/models/sponza");
-    eio::ConvertOBJToOBJB("../Anti-Aliasing/models/knight");
-    eio::ConvertOBJToOBJB("../Anti-Aliasing/models/good-well");
+    // Bakes the models where the scenes load them, those with their sources at hand
+    const std::string models = "../Rendering/models/";
+    for (const std::string name : { "sponza", "knight", "good-well" })
+    {
+        if (std::ifstream(models + name + ".obj"))
+            eio::ConvertOBJToOBJB(models + name);
+    }
+    if (std::ifstream(models + "sponza.objb"))
+        ecpu::BakeOccluders(models + "sponza");
 }
@@ -0,0 +1,394 @@
+#include "aa_testing.h"
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include "cpu/thread_pool.h"
+#include "cpu/resample.h"
+#include "aa/cpu/cpu_taa.h"
+#include "aa/cpu/cpu_fxaa.h"
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const std::string& what)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << what << std::endl;
+			failures++;
+		}
+	}
+
+	template <typename F>
+	bool throws(F f)
+	{
+		try { f(); }
+		catch (const std::exception&) { return true; }
+		return false;
+	}
+
+	float maxDifference(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		if (a.Shape() != b.Shape())
+			return INFINITY;
+		float diff = 0.0f;
+		for (size_t i = 0; i < a.ElementCount(); i++)
+			diff = std::max(diff, std::abs(a.Data()[i] - b.Data()[i]));
+		return diff;
+	}
+
+	// Frame with a moving pattern of colors, depths and motion
+	ecpu::DLTUSFrame testFrame(int width, int height, int index)
+	{
+		ecpu::DLTUSFrame frame;
+		frame.color.Resize({ 1, height, width, 3 });
+		frame.depth.Resize({ 1, height, width, 1 });
+		frame.motion.Resize({ 1, height, width, 2 });
+		frame.jitter_x = 0.5f + 0.25f * ((index % 2) ? 1.0f : -1.0f);
+		frame.jitter_y = 0.5f + 0.25f * ((index % 4) < 2 ? 1.0f : -1.0f);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				for (int c = 0; c < 3; c++)
+					frame.color.At(0, y, x, c) = 0.5f + 0.5f * std::sin(0.7f * x + 1.3f * y + 2.0f * c + 0.4f * index);
+				frame.depth.At(0, y, x, 0) = 0.5f + 0.4f * std::cos(0.3f * x - 0.2f * y);
+				frame.motion.At(0, y, x, 0) = (x + y) % 3 == 0 ? 0.0f : -0.4f / width;
+				frame.motion.At(0, y, x, 1) = (x + y) % 3 == 0 ? 0.0f : 0.2f / height;
+			}
+		}
+		return frame;
+	}
+
+	ecpu::TAAFeatures featuresOf(int bits)
+	{
+		ecpu::TAAFeatures features;
+		features.catmull_rom = (bits & 1) != 0;
+		features.history_rectification = (bits & 2) != 0;
+		features.ycocg = (bits & 4) != 0;
+		features.clipping = (bits & 8) != 0;
+		features.dilate_mv = (bits & 16) != 0;
+		return features;
+	}
+
+	void taaTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::ThreadPool pool3(3);
+
+		// A still, constant image stays constant through every permutation. Like the shader, the
+		// upsampling paths blend refreshed pixels by beta, which is not 1, so without rectification
+		// they are only checked to stay finite
+		const int width = 13;
+		const int height = 7;
+		ecpu::DLTUSFrame flat;
+		flat.color.Resize({ 1, height, width, 3 });
+		flat.depth.Resize({ 1, height, width, 1 });
+		flat.motion.Resize({ 1, height, width, 2 });
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				flat.color.At(0, y, x, 0) = 0.2f;
+				flat.color.At(0, y, x, 1) = 0.5f;
+				flat.color.At(0, y, x, 2) = 0.8f;
+				flat.depth.At(0, y, x, 0) = 0.5f;
+				flat.motion.At(0, y, x, 0) = 0.0f;
+				flat.motion.At(0, y, x, 1) = 0.0f;
+			}
+		}
+		for (int factor : { 1, 2, 4 })
+		{
+			for (int bits = 0; bits < 32; bits++)
+			{
+				ecpu::TAAEngine taa(factor, featuresOf(bits));
+				for (int i = 0; i < 3; i++)
+					taa.Execute(flat, pool);
+				const ecpu::Tensor& out = taa.GetOutput();
+				check(out.Shape() == ecpu::TensorShape(1, height * factor, width * factor, 3), "TAA output shape");
+
+				// Borders sample zeros outside the image when upsampling, check the interior
+				float diff = 0.0f;
+				for (int y = factor; y < (height - 1) * factor; y++)
+					for (int x = factor; x < (width - 1) * factor; x++)
+						for (int c = 0; c < 3; c++)
+							diff = std::max(diff, std::abs(out.At(0, y, x, c) - flat.color.At(0, y / factor, x / factor, c)));
+				const bool exact = factor == 1 || (bits & 2) != 0;
+				check(exact ? diff < 1e-4f : std::isfinite(diff), "TAA keeps a constant image, factor " + std::to_string(factor) + " features " + std::to_string(bits));
+			}
+		}
+
+		// Without upsampling the first frame is the input, and history reprojected from outside the
+		// frame is replaced by the new sample. Dilation is off since border pixels would pick up the
+		// zero motion Load returns outside the image
+		{
+			ecpu::TAAFeatures features;
+			features.dilate_mv = false;
+			ecpu::TAAEngine taa(1, features);
+			ecpu::DLTUSFrame frame = testFrame(width, height, 0);
+			taa.Execute(frame, pool);
+			check(maxDifference(taa.GetOutput(), frame.color) < 1e-6f, "TAA first frame is the input");
+
+			ecpu::DLTUSFrame moved = testFrame(width, height, 1);
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					moved.motion.At(0, y, x, 0) = 2.0f;
+			taa.Execute(moved, pool);
+			check(maxDifference(taa.GetOutput(), moved.color) < 1e-6f, "TAA refreshes history from outside the frame");
+
+			taa.Reset();
+			taa.Execute(frame, pool);
+			check(maxDifference(taa.GetOutput(), frame.color) < 1e-6f, "TAA reset starts a new history");
+		}
+
+		// Thread count does not change the result, including rows not a multiple of the SIMD width
+		for (int factor : { 1, 2 })
+		{
+			ecpu::TAAEngine a(factor);
+			ecpu::TAAEngine b(factor);
+			const float camera[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0.01f, -0.02f, 0, 1 };
+			for (int i = 0; i < 5; i++)
+			{
+				ecpu::DLTUSFrame frame = testFrame(21, 19, i);
+				a.Execute(frame, pool, camera);
+				b.Execute(frame, pool3, camera);
+			}
+			check(maxDifference(a.GetOutput(), b.GetOutput()) == 0.0f, "TAA is independent of the thread count");
+
+			float low = INFINITY, high = -INFINITY;
+			for (size_t i = 0; i < a.GetOutput().ElementCount(); i++)
+			{
+				low = std::min(low, a.GetOutput().Data()[i]);
+				high = std::max(high, a.GetOutput().Data()[i]);
+			}
+			check(std::isfinite(low) && std::isfinite(high) && low > -0.5f && high < 1.5f, "TAA output stays in range");
+		}
+
+		check(throws([] { ecpu::TAAEngine taa(3); }), "TAA rejects unsupported upsample factors");
+	}
+
+	// Image of overlapping discs, with edges in every direction
+	ecpu::Tensor discImage(int width, int height)
+	{
+		ecpu::Tensor image(1, height, width, 3);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float color[3] = { 0.1f, 0.2f, 0.3f };
+				for (int i = 0; i < 5; i++)
+				{
+					const float cx = width * (0.15f + 0.17f * i);
+					const float cy = height * (0.3f + 0.1f * (i % 3));
+					const float r = 0.2f * height + 2.0f * i;
+					if ((x - cx) * (x - cx) + (y - cy) * (y - cy) < r * r)
+						for (int c = 0; c < 3; c++)
+							color[c] = 0.2f * i + 0.3f * c * (i % 2);
+				}
+				for (int c = 0; c < 3; c++)
+					image.At(0, y, x, c) = std::min(color[c], 1.0f);
+			}
+		}
+		return image;
+	}
+
+	void fxaaTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::ThreadPool pool3(3);
+		ecpu::FXAAEngine fxaa;
+
+		// The compacted path gives the result of running the whole shader on every pixel
+		ecpu::Tensor image = discImage(61, 37);
+		ecpu::Tensor sparse, dense, sparse3;
+		fxaa.ExecuteDense(image, dense, pool);
+		const size_t dense_edges = fxaa.GetLastStats().edge_pixels;
+		fxaa.Execute(image, sparse, pool);
+		check(maxDifference(sparse, dense) == 0.0f, "FXAA compacted matches dense");
+		check(fxaa.GetLastStats().edge_pixels == dense_edges && dense_edges > 0 && dense_edges < image.ElementCount() / 6,
+			"FXAA edge pixel count");
+		check(std::is_sorted(fxaa.GetEdgePixels().begin(), fxaa.GetEdgePixels().end()), "FXAA edge list is in scan order");
+		fxaa.Execute(image, sparse3, pool3);
+		check(maxDifference(sparse, sparse3) == 0.0f, "FXAA is independent of the thread count");
+
+		size_t changed = 0;
+		for (size_t i = 0; i < image.ElementCount(); i++)
+			changed += image.Data()[i] != sparse.Data()[i] ? 1 : 0;
+		check(changed > 0, "FXAA changes edge pixels");
+
+		// A constant image only has edges at the border, where Load returns zero like in the shader
+		ecpu::Tensor flat(1, 9, 11, 3);
+		flat.Fill(0.5f);
+		fxaa.Execute(flat, sparse, pool);
+		float interior = 0.0f;
+		for (int y = 1; y < 8; y++)
+			for (int x = 1; x < 10; x++)
+				interior = std::max(interior, std::abs(sparse.At(0, y, x, 0) - 0.5f));
+		check(fxaa.GetLastStats().edge_pixels == 2 * (9 + 11) - 4 && interior == 0.0f, "FXAA keeps a constant image");
+
+		// Straight vertical edge from black to white. The traversal finds no end, so only the
+		// subpixel offset moves the samples across it. The neighborhood average is a third away from
+		// the center on both sides, which goes through the smoothstep, squared and scaled by the
+		// subpixel quality
+		ecpu::Tensor edge(1, 12, 16, 3);
+		for (int y = 0; y < 12; y++)
+			for (int x = 0; x < 16; x++)
+				for (int c = 0; c < 3; c++)
+					edge.At(0, y, x, c) = x < 8 ? 0.0f : 1.0f;
+		fxaa.Execute(edge, sparse, pool);
+		auto subpixel = [](float v) { float s = (3.0f - 2.0f * v) * v * v; return s * s * 0.75f; };
+		check(std::abs(sparse.At(0, 6, 7, 0) - subpixel(1.0f / 3.0f)) < 1e-5f, "FXAA dark side of an edge");
+		check(std::abs(sparse.At(0, 6, 8, 1) - (1.0f - subpixel(1.0f / 3.0f))) < 1e-5f, "FXAA bright side of an edge");
+		check(sparse.At(0, 6, 4, 2) == 0.0f && sparse.At(0, 6, 12, 2) == 1.0f, "FXAA leaves pixels away from the edge");
+	}
+
+	// Half bits of v, truncating the mantissa. Test values are exact in half
+	ecpu::Half toHalf(float v)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		const uint32_t exponent = (bits >> 23) & 0xff;
+		const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+		if (exponent < 113)
+			return { sign };
+		return { (uint16_t)(sign | ((exponent - 112) << 10) | ((bits >> 13) & 0x3ff)) };
+	}
+
+	// Warp of every filter against the scalar Sample it vectorizes
+	template <typename T>
+	void checkWarp(const std::vector<T>& texels, int width, int height, int channels, const ecpu::Tensor& motion,
+		ecpu::ThreadPool& pool, const std::string& format)
+	{
+		const ecpu::ResampleFilter filters[] = { ecpu::ResampleFilter::Bilinear, ecpu::ResampleFilter::BilinearBorder,
+			ecpu::ResampleFilter::CatmullRom5, ecpu::ResampleFilter::CatmullRom9, ecpu::ResampleFilter::BicubicBorder };
+		const ecpu::ImageView<T> image(texels.data(), width, height, channels);
+		const int out_width = motion.Shape().w;
+		const int out_height = motion.Shape().h;
+		for (int f = 0; f < 5; f++)
+		{
+			for (ecpu::CubicKernel kernel : { ecpu::CubicKernel::CatmullRom, ecpu::CubicKernel::Sharp })
+			{
+				ecpu::Tensor warped;
+				ecpu::Warp(image, motion, filters[f], kernel, warped, pool);
+				float diff = 0.0f;
+				for (int y = 0; y < out_height; y++)
+				{
+					for (int x = 0; x < out_width; x++)
+					{
+						float expected[4];
+						ecpu::Sample(image, filters[f], (x + 0.5f) / out_width + motion.At(0, y, x, 0),
+							(y + 0.5f) / out_height + motion.At(0, y, x, 1), expected, kernel);
+						for (int c = 0; c < channels; c++)
+							diff = std::max(diff, std::abs(warped.At(0, y, x, c) - expected[c]));
+					}
+				}
+				check(warped.Shape() == ecpu::TensorShape(1, out_height, out_width, channels) && diff < 1e-5f,
+					"Warp matches Sample for filter " + std::to_string(f) + " on " + format);
+			}
+		}
+	}
+
+	void resampleTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::ThreadPool pool3(3);
+
+		check(ecpu::HalfToFloat({ 0x3c00 }) == 1.0f && ecpu::HalfToFloat({ 0xc000 }) == -2.0f && ecpu::HalfToFloat({ 0x3555 }) == 0.333251953125f,
+			"HalfToFloat of normal halves");
+		check(ecpu::HalfToFloat({ 0x0001 }) == std::ldexp(1.0f, -24) && ecpu::HalfToFloat({ 0x8000 }) == 0.0f && std::isinf(ecpu::HalfToFloat({ 0x7c00 })),
+			"HalfToFloat of subnormals, zero and infinity");
+
+		// Odd sizes so the last group of eight pixels is partial, and motion reaching past every border
+		const int width = 19;
+		const int height = 11;
+		ecpu::Tensor motion(1, 13, 21, 2);
+		for (int y = 0; y < 13; y++)
+		{
+			for (int x = 0; x < 21; x++)
+			{
+				motion.At(0, y, x, 0) = 0.15f * std::sin(0.9f * x + 0.4f * y);
+				motion.At(0, y, x, 1) = 0.15f * std::cos(0.5f * x - 1.1f * y);
+			}
+		}
+
+		for (int channels = 1; channels <= 4; channels++)
+		{
+			std::vector<float> floats((size_t)width * height * channels);
+			std::vector<uint8_t> bytes(floats.size());
+			std::vector<ecpu::Half> halves(floats.size());
+			for (size_t i = 0; i < floats.size(); i++)
+			{
+				bytes[i] = (uint8_t)((i * 37 + 11) % 256);
+				floats[i] = 0.5f + 0.5f * std::sin(0.37f * i);
+				// Multiples of 1/1024 in [0, 1] are exact in half
+				halves[i] = toHalf(std::floor(floats[i] * 1024.0f) / 1024.0f);
+			}
+			const std::string suffix = " with " + std::to_string(channels) + " channels";
+			checkWarp(floats, width, height, channels, motion, pool, "float" + suffix);
+			checkWarp(bytes, width, height, channels, motion, pool, "uint8" + suffix);
+			checkWarp(halves, width, height, channels, motion, pool, "half" + suffix);
+		}
+
+		// Clamp filters keep a constant image everywhere, border filters fade out past the edge
+		std::vector<float> constant((size_t)width * height * 3, 0.25f);
+		const ecpu::ImageView<float> constant_view(constant.data(), width, height, 3);
+		float clamp_diff = 0.0f;
+		for (int i = 0; i <= 20; i++)
+		{
+			const float u = -0.2f + 1.4f * i / 20.0f;
+			float out[3];
+			for (ecpu::ResampleFilter filter : { ecpu::ResampleFilter::Bilinear, ecpu::ResampleFilter::CatmullRom5, ecpu::ResampleFilter::CatmullRom9 })
+			{
+				ecpu::Sample(constant_view, filter, u, 0.5f, out);
+				clamp_diff = std::max(clamp_diff, std::abs(out[0] - 0.25f));
+			}
+		}
+		check(clamp_diff < 1e-6f, "Clamp filters keep a constant image");
+		float corner[3], outside[3];
+		ecpu::Sample<ecpu::ResampleFilter::BilinearBorder>(constant_view, 0.0f, 0.0f, corner);
+		ecpu::Sample<ecpu::ResampleFilter::BicubicBorder>(constant_view, -0.5f, 0.5f, outside);
+		check(std::abs(corner[1] - 0.0625f) < 1e-6f && outside[2] == 0.0f, "Border filters read zero outside the image");
+
+		// The cubic kernels interpolate, so texel centers come back unchanged
+		std::vector<float> ramp((size_t)width * height);
+		for (size_t i = 0; i < ramp.size(); i++)
+			ramp[i] = std::sin(0.61f * i);
+		const ecpu::ImageView<float> ramp_view(ramp.data(), width, height, 1);
+		float center_diff = 0.0f;
+		for (ecpu::CubicKernel kernel : { ecpu::CubicKernel::CatmullRom, ecpu::CubicKernel::Sharp })
+		{
+			float out;
+			ecpu::Sample<ecpu::ResampleFilter::CatmullRom9>(ramp_view, 7.5f / width, 4.5f / height, &out, kernel);
+			center_diff = std::max(center_diff, std::abs(out - ramp[4 * width + 7]));
+			ecpu::Sample<ecpu::ResampleFilter::CatmullRom5>(ramp_view, 3.5f / width, 8.5f / height, &out, kernel);
+			center_diff = std::max(center_diff, std::abs(out - ramp[8 * width + 3]));
+		}
+		check(center_diff < 1e-6f, "Cubic filters interpolate texel centers");
+
+		// Rows are independent, so the thread count does not change the result
+		const ecpu::ImageView<float> view(ramp.data(), width, height, 1);
+		ecpu::Tensor single, threaded;
+		ecpu::Warp(view, motion, ecpu::ResampleFilter::CatmullRom9, ecpu::CubicKernel::Sharp, single, pool);
+		ecpu::Warp(view, motion, ecpu::ResampleFilter::CatmullRom9, ecpu::CubicKernel::Sharp, threaded, pool3);
+		check(maxDifference(single, threaded) == 0.0f, "Warp is thread count invariant");
+
+		check(throws([&] { ecpu::Warp(ecpu::ImageView<float>(ramp.data(), 1, 1, 5), motion, ecpu::ResampleFilter::Bilinear,
+			ecpu::CubicKernel::Sharp, single, pool); }), "Warp rejects five channel images");
+		check(throws([&] { ecpu::Warp(view, ecpu::Tensor(1, 4, 4, 3), ecpu::ResampleFilter::Bilinear,
+			ecpu::CubicKernel::Sharp, single, pool); }), "Warp rejects motion without two channels");
+	}
+}
+
+int AATesting()
+{
+	failures = 0;
+	taaTesting();
+	fxaaTesting();
+	resampleTesting();
+	std::cout << "AA testing: " << (failures == 0 ? "all checks passed" : std::to_string(failures) + " checks failed") << std::endl;
+	return failures;
+}
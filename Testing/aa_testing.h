@@ -0,0 +1,4 @@
+#pragma once
+
+// Tests of the CPU anti-aliasing code that need no GPU, returns the number of failed checks
+int AATesting();
@@ -0,0 +1,900 @@
+#include "network_testing.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include "cpu/thread_pool.h"
+#include "deep_learning/cpu/network_graph.h"
+#include "deep_learning/cpu/buffer_planner.h"
+#include "deep_learning/cpu/cpu_master_net.h"
+#include "deep_learning/cpu/tiled_executor.h"
+#include "deep_learning/cpu/batched_evaluator.h"
+#include "deep_learning/cpu/incremental_executor.h"
+#include "deep_learning/cpu/dataset_reader.h"
+#include "deep_learning/cpu/conv_autotuner.h"
+#include "deep_learning/float16_compressor.h"
+#include "cpu/image_metrics.h"
+#include "cpu/layout.h"
+#include "io/npy.h"
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool condition, const std::string& what)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << what << std::endl;
+			failures++;
+		}
+	}
+
+	template <typename F>
+	bool throws(F f)
+	{
+		try { f(); }
+		catch (const std::exception&) { return true; }
+		return false;
+	}
+
+	// Graph text in the format of utils.SaveNetworkGraph with the given residual block count and width.
+	// inner is the channel count between the two convolutions of a block, like utils.PruneMasterModel leaves
+	std::string residualGraph(int blocks, int width, int inner = -1)
+	{
+		inner = inner < 0 ? width : inner;
+		std::ostringstream s;
+		s << "# Test network\n";
+		s << "input x channels=128\n";
+		s << "conv down x weights=down.0 channels=" << width << " size=1 unshuffle=4\n";
+		std::string x = "down";
+		for (int i = 1; i <= blocks; i++)
+		{
+			std::string name = "cnn" + std::to_string(i);
+			s << "conv " << name << "_0 " << x << " weights=" << name << ".0 channels=" << inner << " size=3 relu replicate\n";
+			s << "conv " << name << "_2 " << name << "_0 weights=" << name << ".2 channels=" << width << " size=3 replicate\n";
+			s << "add " << name << " " << x << " " << name << "_2\n";
+			x = name;
+		}
+		s << "output " << x << "\n";
+		return s.str();
+	}
+
+	ecpu::NetworkGraph parse(const std::string& text)
+	{
+		std::istringstream stream(text);
+		return ecpu::NetworkGraph::Parse(stream);
+	}
+
+	void fillInput(ecpu::Tensor& input)
+	{
+		for (size_t i = 0; i < input.ElementCount(); i++)
+			input.Data()[i] = (float)((i * 7919) % 1000) / 1000.0f;
+	}
+
+	bool identical(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		if (a.Shape() != b.Shape())
+			return false;
+		for (size_t i = 0; i < a.ElementCount(); i++)
+			if (a.Data()[i] != b.Data()[i])
+				return false;
+		return true;
+	}
+
+	// Small deterministic weights so activations stay in a sane range through the blocks
+	ecpu::WeightMap randomWeights(const ecpu::NetworkGraph& graph)
+	{
+		unsigned int state = 777u;
+		auto next = [&]() { state = state * 1664525u + 1013904223u; return ((float)(state >> 8) / (float)(1 << 24) - 0.5f) * 0.1f; };
+
+		ecpu::WeightMap weights;
+		const auto& tensors = graph.Tensors();
+		for (const auto& layer : graph.Layers())
+		{
+			if (layer.type != ecpu::GraphLayer::Type::Conv)
+				continue;
+			size_t count = (size_t)tensors[layer.output].channels * tensors[layer.inputs[0]].channels * layer.filter_size * layer.filter_size;
+			auto& w = weights[layer.weights + ".weight"];
+			auto& b = weights[layer.weights + ".bias"];
+			for (size_t i = 0; i < count; i++)
+				w.push_back(next());
+			for (int i = 0; i < tensors[layer.output].channels; i++)
+				b.push_back(next());
+		}
+		return weights;
+	}
+
+	void graphParsingTesting()
+	{
+		auto graph = parse(residualGraph(4, 32));
+		check(graph.Layers().size() == 13, "MasterNet graph has 13 layers");
+		check(graph.Tensors().size() == 14, "MasterNet graph has 14 tensors");
+		check(graph.Tensors()[graph.OutputTensor()].name == "cnn4", "output tensor is the last block");
+		check(graph.Layers()[0].unshuffle == 4 && graph.Layers()[1].relu && !graph.Layers()[2].relu, "layer options are parsed");
+		check(!graph.Layers()[0].replicate && graph.Layers()[1].replicate && graph.Layers()[2].replicate, "padding modes are parsed");
+
+		auto shapes = graph.InferShapes(ecpu::TensorShape(1, 270, 480, 128));
+		check(shapes[graph.OutputTensor()] == ecpu::TensorShape(1, 270, 480, 32), "output shape of 1080p input");
+
+		check(throws([] { parse("input x channels=8\nconv y z weights=a channels=8 size=3\noutput y\n"); }), "unknown tensor throws");
+		check(throws([] { parse("input x channels=8\nconv y x weights=a channels=4 size=3\nadd z x y\noutput z\n"); }), "add of different widths throws");
+		check(throws([] { parse("input x channels=8\nconv x x weights=a channels=8 size=3\noutput x\n"); }), "writing a tensor twice throws");
+		check(throws([] { parse("input x channels=8\nconv y x weights=a channels=8 size=3 dilation=2\noutput y\n"); }), "unknown option throws");
+		check(throws([] { parse(residualGraph(1, 32)).InferShapes(ecpu::TensorShape(1, 8, 8, 64)); }), "wrong input channel count throws");
+
+		check(ecpu::NetworkGraph::SidecarPath("../Network/MasterNet4x4/nn_weights_200.bin") == "../Network/MasterNet4x4/nn_weights_200.graph", "sidecar path replaces the extension");
+		check(ecpu::NetworkGraph::SidecarPath("../v1.2/weights") == "../v1.2/weights.graph", "sidecar path without extension");
+
+		// Every weight file of the repository can be selected, so each needs its graph
+		const char* weight_files[] = {
+			"nn_weights.bin", "nn_weights-200.bin", "nn_weights_bias4.bin", "nn_weights_bias4-200.bin", "nn_weights_bias4_st-200.bin",
+			"nn_weights_st2_10.bin", "nn_weights_st2_50.bin", "nn_weights_st2_90.bin" };
+		for (const char* file : weight_files)
+		{
+			const std::string path = std::string("../Network/MasterNet2x2/") + file;
+			check(!throws([&] { ecpu::MasterNet net(path); }), path + " loads with its graph");
+		}
+		const char* weight_files_4x4[] = { "nn_weights.bin", "nn_weights_200.bin", "nn_weights_na.bin", "nn_weights_na-200.bin", "nn_weights_st90.bin", "nn_weights_st90-200.bin" };
+		for (const char* file : weight_files_4x4)
+		{
+			const std::string path = std::string("../Network/MasterNet4x4/") + file;
+			check(!throws([&] { ecpu::MasterNet net(path); }), path + " loads with its graph");
+		}
+	}
+
+	void bufferPlannerTesting()
+	{
+		// Hand made intervals: 0 and 2 never overlap and share, 1 overlaps both
+		std::vector<ecpu::TensorLifetime> lifetimes(3);
+		lifetimes[0].first = 0; lifetimes[0].last = 3; lifetimes[0].bytes = 100;
+		lifetimes[1].first = 2; lifetimes[1].last = 6; lifetimes[1].bytes = 50;
+		lifetimes[2].first = 4; lifetimes[2].last = 8; lifetimes[2].bytes = 80;
+		auto plan = ecpu::PlanBuffers(lifetimes);
+		check(plan.buffer_sizes.size() == 2, "two buffers for three tensors");
+		check(plan.tensor_buffers[0] == plan.tensor_buffers[2], "tensors with disjoint lifetimes share a buffer");
+		check(plan.tensor_buffers[0] != plan.tensor_buffers[1], "tensors with overlapping lifetimes get different buffers");
+		check(plan.TotalBytes() == 150, "shared buffer takes the size of its largest tensor");
+		check(ecpu::PeakLiveBytes(lifetimes) == 150, "peak live bytes");
+
+		// Element wise steps may write over an input read for the last time, convolutions may not
+		std::vector<ecpu::PlanStep> steps(2);
+		steps[0].inputs = { 0 }; steps[0].output = 1;
+		steps[1].inputs = { 1, 0 }; steps[1].output = 2; steps[1].elementwise = true;
+		auto elementwise = ecpu::ComputeLifetimes(steps, { 64, 64, 64 });
+		check(!elementwise[1].Overlaps(elementwise[2]), "element wise output does not overlap its inputs");
+		steps[1].elementwise = false;
+		auto conv = ecpu::ComputeLifetimes(steps, { 64, 64, 64 });
+		check(conv[1].Overlaps(conv[2]), "convolution output overlaps its input");
+
+		// External tensors are left out of the plan
+		elementwise[0].external = true;
+		auto external_plan = ecpu::PlanBuffers(elementwise);
+		check(external_plan.tensor_buffers[0] == -1, "external tensor gets no buffer");
+
+		// The MasterNet graph needs the three intermediate buffers egx::MasterNet used to allocate by hand
+		auto graph = parse(residualGraph(4, 32));
+		auto shapes = graph.InferShapes(ecpu::TensorShape(1, 270, 480, 128));
+		std::vector<size_t> bytes;
+		for (const auto& s : shapes)
+			bytes.push_back(s.ByteSize());
+		auto net_lifetimes = ecpu::ComputeLifetimes(graph.PlanSteps(), bytes);
+		net_lifetimes[graph.InputTensor()].external = true;
+		net_lifetimes[graph.OutputTensor()].external = true;
+		auto net_plan = ecpu::PlanBuffers(net_lifetimes);
+		check(net_plan.buffer_sizes.size() == 3, "MasterNet plan uses three intermediate buffers");
+		check(net_plan.TotalBytes() == ecpu::PeakLiveBytes(net_lifetimes), "MasterNet plan reaches the lower bound");
+
+		// Every pair of tensors sharing a buffer must have disjoint lifetimes
+		bool valid = true;
+		for (size_t a = 0; a < net_lifetimes.size(); a++)
+			for (size_t b = a + 1; b < net_lifetimes.size(); b++)
+				if (net_plan.tensor_buffers[a] >= 0 && net_plan.tensor_buffers[a] == net_plan.tensor_buffers[b])
+					valid = valid && !net_lifetimes[a].Overlaps(net_lifetimes[b]);
+		check(valid, "MasterNet plan never shares a buffer between live tensors");
+	}
+
+	// Networks of other depths and widths run from their graph without code changes
+	void graphExecutionTesting()
+	{
+		ecpu::ThreadPool pool;
+		const int shapes[][2] = { { 2, 16 }, { 6, 24 } };
+		for (const auto& s : shapes)
+		{
+			auto graph = parse(residualGraph(s[0], s[1]));
+			ecpu::MasterNet net(graph, randomWeights(graph));
+
+			ecpu::Tensor input(1, 19, 27, 128);
+			fillInput(input);
+
+			ecpu::Tensor layer_output, fused_output;
+			net.Execute(input, layer_output, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+			size_t layer_bytes = net.GetLastStats().buffer_bytes;
+			net.Execute(input, fused_output, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+			size_t fused_bytes = net.GetLastStats().buffer_bytes;
+
+			std::string name = std::to_string(s[0]) + " blocks of width " + std::to_string(s[1]);
+			check(layer_output.Shape() == ecpu::TensorShape(1, 19, 27, s[1]), name + ": output shape");
+			check(identical(layer_output, fused_output), name + ": fused and layer by layer schedules agree");
+			check(layer_bytes == 3 * (size_t)19 * 27 * s[1] * sizeof(float), name + ": layer by layer needs three buffers");
+			check(fused_bytes == 2 * (size_t)19 * 27 * s[1] * sizeof(float), name + ": fused schedule needs two buffers");
+		}
+	}
+
+	// Stitched tiles must match the full frame run bit for bit, also for tiles smaller than the halo
+	void tiledExecutionTesting()
+	{
+		// Fixed thread count so the memory cap checks do not depend on the machine
+		ecpu::ThreadPool pool(2);
+		auto graph = parse(residualGraph(4, 32));
+		ecpu::MasterNet net(graph, randomWeights(graph));
+
+		ecpu::Tensor input(2, 37, 53, 128);
+		fillInput(input);
+		ecpu::Tensor reference;
+		net.Execute(input, reference, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+
+		for (int tile_size : { 5, 16, 64 })
+		{
+			ecpu::TiledExecutor tiled(net, (size_t)1 << 30, tile_size);
+			ecpu::Tensor output;
+			tiled.Execute(input, output, pool);
+			check(identical(reference, output), "tiles of size " + std::to_string(tile_size) + " match the full frame");
+		}
+
+		ecpu::TiledExecutor capped(net, 2 << 20);
+		ecpu::Tensor output;
+		capped.Execute(input, output, pool);
+		check(capped.Halo() == 8, "MasterNet receptive field reaches 8 pixels past a tile");
+		check(capped.WorkingSetBytes() <= (2 << 20), "tile buffers stay below the memory cap");
+		check(capped.TileCount() > 2, "memory cap splits the frame into tiles");
+		check(identical(reference, output), "tiles chosen from the memory cap match the full frame");
+
+		check(throws([&] { ecpu::TiledExecutor tiny(net, 1024); tiny.Execute(input, output, pool); }), "memory cap below one tile throws");
+	}
+
+	// Unchanged tiles are reused, changed ones recomputed exactly like a full run
+	void incrementalExecutionTesting()
+	{
+		ecpu::ThreadPool pool(2);
+		auto graph = parse(residualGraph(2, 32));
+		ecpu::MasterNet net(graph, randomWeights(graph));
+
+		ecpu::Tensor input(1, 40, 56, 128);
+		fillInput(input);
+		ecpu::Tensor reference;
+		net.Execute(input, reference, pool);
+
+		ecpu::IncrementalExecutor exact(net, 0.0f, 8);
+		check(identical(exact.Execute(input, pool), reference), "first incremental frame matches the full run");
+		check(exact.GetLastStats().computed_tiles == exact.GetLastStats().tiles, "first incremental frame computes every tile");
+		check(identical(exact.Execute(input, pool), reference), "unchanged frame keeps the output");
+		check(exact.GetLastStats().computed_tiles == 0 && exact.GetLastStats().SkippedRatio() == 1.0, "unchanged frame computes nothing");
+
+		input.At(0, 2, 2, 5) += 0.05f;
+		net.Execute(input, reference, pool);
+		check(identical(exact.Execute(input, pool), reference), "changed frame matches the full run");
+		const auto& stats = exact.GetLastStats();
+		check(stats.computed_tiles > 0 && stats.computed_tiles < stats.tiles, "only tiles near the change are computed, " +
+			std::to_string(stats.computed_tiles) + " of " + std::to_string(stats.tiles));
+
+		ecpu::IncrementalExecutor coarse(net, 0.1f, 8);
+		coarse.Execute(input, pool);
+		input.At(0, 2, 2, 5) += 0.05f;
+		coarse.Execute(input, pool);
+		check(coarse.GetLastStats().computed_tiles == 0, "changes below the threshold are skipped");
+		input.At(0, 2, 2, 5) += 0.06f;
+		coarse.Execute(input, pool);
+		check(coarse.GetLastStats().computed_tiles > 0, "small changes adding up past the threshold are computed");
+	}
+
+	float maxDifference(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		float diff = 0.0f;
+		for (size_t i = 0; i < a.ElementCount(); i++)
+			diff = std::max(diff, std::abs(a.Data()[i] - b.Data()[i]));
+		return diff;
+	}
+
+	// Pruned blocks with odd channel counts between their convolutions run in every schedule
+	void prunedGraphTesting()
+	{
+		ecpu::ThreadPool pool(2);
+		for (int inner : { 13, 5 })
+		{
+			auto graph = parse(residualGraph(3, 32, inner));
+			ecpu::MasterNet net(graph, randomWeights(graph));
+			std::string name = "blocks pruned to " + std::to_string(inner) + " channels";
+			check(net.GetLayerWeights(1).OutputChannels() == inner && net.GetLayerWeights(2).InputChannels() == inner, name + ": layer widths");
+
+			ecpu::Tensor input(1, 21, 30, 128);
+			fillInput(input);
+			ecpu::Tensor layer_output, fused_output, tiled_output;
+			net.Execute(input, layer_output, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+			net.Execute(input, fused_output, pool, ecpu::MasterNet::Schedule::FusedResidualBlocks);
+			ecpu::TiledExecutor tiled(net, (size_t)1 << 30, 8);
+			tiled.Execute(input, tiled_output, pool);
+			check(layer_output.Shape() == ecpu::TensorShape(1, 21, 30, 32), name + ": output shape");
+			check(identical(layer_output, fused_output), name + ": fused and layer by layer schedules agree");
+			check(identical(layer_output, tiled_output), name + ": tiles match the full frame");
+		}
+	}
+
+	// Every algorithm gives the direct result up to rounding, including odd sizes and channel
+	// counts, with both padding modes
+	void convAlgorithmTesting()
+	{
+		ecpu::ThreadPool pool(2);
+		struct Case { int cout, cin, size, stride, h, w; };
+		const Case cases[] = { { 32, 32, 3, 1, 13, 17 }, { 12, 16, 3, 1, 6, 9 }, { 32, 13, 3, 1, 8, 7 }, { 32, 128, 1, 1, 7, 11 }, { 20, 3, 3, 2, 9, 10 } };
+		for (const auto& c : cases)
+		{
+			unsigned int state = 99u;
+			auto next = [&]() { state = state * 1664525u + 1013904223u; return ((float)(state >> 8) / (float)(1 << 24) - 0.5f) * 0.2f; };
+			std::vector<float> weights((size_t)c.cout * c.cin * c.size * c.size), bias(c.cout);
+			for (auto& v : weights) v = next();
+			for (auto& v : bias) v = next();
+
+			ecpu::Tensor input(2, c.h, c.w, c.cin);
+			fillInput(input);
+			for (bool replicate : { false, true })
+			{
+				ecpu::ConvWeights w(weights, bias, c.cout, c.cin, c.size, c.stride, -1, replicate);
+				ecpu::Tensor reference, output;
+				ecpu::Convolve(input, w, true, reference, pool);
+
+				std::string name = std::to_string(c.size) + "x" + std::to_string(c.size) + " " + std::to_string(c.cin) + " -> " + std::to_string(c.cout) +
+					(replicate ? " replicate" : "");
+				check(w.SupportsWinograd() == (c.size == 3 && c.stride == 1), name + ": Winograd support");
+				for (const auto& config : ecpu::ConvAutotuner::Candidates(w))
+				{
+					ecpu::Convolve(input, w, true, output, pool, config);
+					check(output.Shape() == reference.Shape() && maxDifference(output, reference) < 1e-4f,
+						name + ": " + ecpu::ConvAlgorithmName(config.algorithm) + " with " + std::to_string(config.rows_per_task) + " rows per task");
+				}
+				if (!w.SupportsWinograd())
+				{
+					ecpu::ConvConfig winograd;
+					winograd.algorithm = ecpu::ConvAlgorithm::Winograd;
+					check(throws([&] { ecpu::Convolve(input, w, true, output, pool, winograd); }), name + ": unsupported Winograd throws");
+				}
+
+				// Replicate padding is an unpadded convolution over the input extended by its edge pixels
+				if (replicate)
+				{
+					const int p = w.Padding();
+					ecpu::Tensor extended(2, c.h + 2 * p, c.w + 2 * p, c.cin);
+					for (int n = 0; n < 2; n++)
+						for (int y = 0; y < c.h + 2 * p; y++)
+							for (int x = 0; x < c.w + 2 * p; x++)
+								for (int ch = 0; ch < c.cin; ch++)
+									extended.At(n, y, x, ch) = input.At(n, std::min(std::max(y - p, 0), c.h - 1), std::min(std::max(x - p, 0), c.w - 1), ch);
+					ecpu::ConvWeights unpadded(weights, bias, c.cout, c.cin, c.size, c.stride, 0);
+					ecpu::Convolve(extended, unpadded, true, output, pool);
+					check(output.Shape() == reference.Shape() && maxDifference(output, reference) < 1e-5f, name + ": pads with the edge pixels");
+				}
+			}
+		}
+	}
+
+	// Winners are measured once, saved, and picked up again by a new autotuner
+	void convAutotunerTesting()
+	{
+		ecpu::ThreadPool pool(2);
+		const std::string cache_path = "conv_tuning_test.txt";
+		std::remove(cache_path.c_str());
+		{
+			// Another machine's entry must survive our saves
+			std::ofstream foreign(cache_path);
+			foreign << "Other CPU\t1 32 8 8 32 3 3 1 2\twinograd 8 10\n";
+		}
+
+		auto graph = parse(residualGraph(2, 16));
+		ecpu::MasterNet net(graph, randomWeights(graph));
+		ecpu::Tensor input(1, 12, 20, 128);
+		fillInput(input);
+		ecpu::Tensor reference, output;
+		net.Execute(input, reference, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+
+		ecpu::ConvAutotuner tuner(cache_path);
+		net.SetAutotuner(&tuner);
+		net.Execute(input, output, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+		check(tuner.TunedShapes() == 2 && tuner.CacheHits() == 3, "autotuner measures each distinct layer shape once, " +
+			std::to_string(tuner.TunedShapes()) + " tuned and " + std::to_string(tuner.CacheHits()) + " hits");
+		check(maxDifference(output, reference) < 1e-4f, "tuned network matches the default configuration");
+
+		ecpu::ConvAutotuner cached(cache_path);
+		net.SetAutotuner(&cached);
+		net.Execute(input, output, pool, ecpu::MasterNet::Schedule::LayerByLayer);
+		check(cached.TunedShapes() == 0 && cached.CacheHits() == 5, "cached winners are reused on the next start");
+		const auto& w = net.GetLayerWeights(1);
+		check(cached.Tune(w, true, ecpu::TensorShape(1, 12, 20, 16), pool) == tuner.Tune(w, true, ecpu::TensorShape(1, 12, 20, 16), pool),
+			"cached winner is the measured one");
+
+		std::ifstream file(cache_path);
+		std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		check(text.find("Other CPU\t") != std::string::npos, "cache keeps the entries of other CPUs");
+		file.close();
+		net.SetAutotuner(nullptr);
+		std::remove(cache_path.c_str());
+	}
+
+	// Moving gradient with a per sequence offset, so every sequence and frame differs
+	void syntheticFrame(int sequence, int frame, ecpu::DLTUSFrame& out)
+	{
+		const int width = 12;
+		const int height = 8;
+		out.color.Resize(ecpu::TensorShape(1, height, width, 3));
+		out.depth.Resize(ecpu::TensorShape(1, height, width, 1));
+		out.motion.Resize(ecpu::TensorShape(1, height, width, 2));
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				for (int c = 0; c < 3; c++)
+					out.color.At(0, y, x, c) = (float)((x + 2 * frame + 3 * sequence + c * 5) % width) / width;
+				out.depth.At(0, y, x, 0) = 0.5f + 0.01f * y;
+				out.motion.At(0, y, x, 0) = -2.0f / width;
+				out.motion.At(0, y, x, 1) = 0.0f;
+			}
+		}
+		out.jitter_x = 0.125f + 0.25f * (frame % 4);
+		out.jitter_y = 0.125f + 0.25f * ((frame / 4) % 4);
+	}
+
+	// Sequences must not leak into each other, so every batch size gives the same frames
+	void batchedEvaluationTesting()
+	{
+		ecpu::ThreadPool pool(2);
+		auto graph = parse(residualGraph(2, 32));
+		ecpu::MasterNet net(graph, randomWeights(graph));
+
+		const int sequences = 3;
+		const int frames = 3;
+		std::vector<std::vector<ecpu::Tensor>> results[3];
+		const int batch_sizes[] = { 1, 2, 3 };
+		for (int b = 0; b < 3; b++)
+		{
+			auto& result = results[b];
+			result.assign(sequences, std::vector<ecpu::Tensor>(frames));
+			ecpu::BatchedEvaluator evaluator(net, 4, batch_sizes[b]);
+			auto stats = evaluator.Run(sequences, frames, syntheticFrame,
+				[&](int s, int f, const ecpu::Tensor& image)
+				{
+					result[s][f].Resize(image.Shape());
+					std::copy(image.Data(), image.Data() + image.ElementCount(), result[s][f].Data());
+				},
+				pool);
+			check(stats.frames == sequences * frames, "batch size " + std::to_string(batch_sizes[b]) + ": every frame is evaluated");
+		}
+
+		bool same = true;
+		for (int s = 0; s < sequences; s++)
+			for (int f = 0; f < frames; f++)
+				same = same && identical(results[0][s][f], results[1][s][f]) && identical(results[0][s][f], results[2][s][f]);
+		check(results[0][0][0].Shape() == ecpu::TensorShape(1, 32, 48, 4), "upsampled frame shape");
+		check(same, "batched sequences match sequences run one at a time");
+		check(!identical(results[0][0][2], results[0][1][2]), "sequences keep separate histories");
+	}
+
+	// Pass formulas on values where the result is known
+	void dltusPassesTesting()
+	{
+		// A constant frame upsamples to the same constant with alpha 1 for any jitter
+		ecpu::Tensor color(1, 4, 6, 3);
+		color.Fill(0.25f);
+		ecpu::Tensor jau(1, 4, 6, 64);
+		ecpu::JitterAlignedUpsample(color, 0.3f, 0.8f, 4, jau, 0, 0, 4);
+		bool constant = true;
+		for (int y = 0; y < 4; y++)
+			for (int x = 0; x < 6; x++)
+				for (int c = 0; c < 64; c++)
+					constant = constant && std::abs(jau.At(0, y, x, c) - (c < 48 ? 0.25f : 1.0f)) < 1e-6f;
+		check(constant, "jitter aligned upsample of a constant frame");
+
+		// Alpha 1 keeps the upsampled frame, alpha 0 the reprojected history, and depth_res scales alpha
+		ecpu::Tensor input(1, 1, 1, 128);
+		ecpu::Tensor output(1, 1, 1, 32);
+		ecpu::Tensor history(1, 4, 4, 4);
+		for (int c = 0; c < 64; c++)
+		{
+			jau.At(0, 0, 0, c) = 0.75f;
+			input.At(0, 0, 0, 64 + c) = 0.25f;
+		}
+		for (int k = 0; k < 16; k++)
+		{
+			output.At(0, 0, 0, k) = k < 8 ? 1.0f : -3.0f;
+			output.At(0, 0, 0, 16 + k) = 0.5f;
+		}
+		ecpu::FinalizeNetworkOutput(input, output, jau, 0, history, 0, 1);
+		check(history.At(0, 0, 0, 0) == 0.75f && history.At(0, 1, 3, 2) == 0.75f, "finalize with alpha 1 keeps the upsampled frame");
+		check(history.At(0, 2, 0, 1) == 0.25f && history.At(0, 3, 3, 0) == 0.25f, "finalize with clamped alpha 0 keeps the history");
+		check(history.At(0, 0, 2, 3) == 0.375f && history.At(0, 3, 1, 3) == 0.125f, "finalize scales alpha by depth_res");
+
+		// A linear frame formatted by the pipeline matches the same frame already gamma encoded
+		ecpu::ThreadPool pool(2);
+		auto graph = parse(residualGraph(1, 32));
+		ecpu::MasterNet net(graph, randomWeights(graph));
+		ecpu::DLTUSFrame linear, encoded;
+		syntheticFrame(0, 0, encoded);
+		syntheticFrame(0, 0, linear);
+		for (size_t i = 0; i < encoded.color.ElementCount(); i++)
+		{
+			float v = std::round(encoded.color.Data()[i] * 255.0f) / 255.0f;
+			encoded.color.Data()[i] = v;
+			linear.color.Data()[i] = std::pow(v, 2.2f);
+		}
+		linear.linear_color = true;
+		ecpu::DLTUSPipeline a(net, 4), b(net, 4);
+		a.Execute(&linear, 1, pool);
+		b.Execute(&encoded, 1, pool);
+		check(identical(a.GetOutput(0), b.GetOutput(0)), "pipeline formats linear color like the renderer target");
+		check(throws([&] { ecpu::DLTUSFrame frames[2] = { linear, encoded }; a.Execute(frames, 2, pool); }), "mixed color spaces throw");
+	}
+
+	// Strided views against their index rules, and the copies and convolutions that consume them
+	void layoutTesting()
+	{
+		ecpu::ThreadPool pool(3);
+
+		// Odd sizes exercise the scalar edges of the 8x8 blocks and the tile boundaries
+		const int sizes[][2] = { { 13, 29 }, { 8, 8 }, { 67, 40 }, { 1, 17 } };
+		for (const auto& size : sizes)
+		{
+			const int rows = size[0], cols = size[1];
+			std::vector<float> src((size_t)rows * (cols + 3)), dst((size_t)cols * (rows + 5), -1.0f);
+			for (size_t i = 0; i < src.size(); i++)
+				src[i] = (float)i;
+			ecpu::Transpose(src.data(), cols + 3, dst.data(), rows + 5, rows, cols);
+			bool transposed = true;
+			for (int i = 0; i < rows; i++)
+				for (int j = 0; j < cols; j++)
+					transposed = transposed && dst[(size_t)j * (rows + 5) + i] == src[(size_t)i * (cols + 3) + j];
+			check(transposed && dst[rows] == -1.0f, "transpose of " + std::to_string(rows) + "x" + std::to_string(cols));
+		}
+
+		// NCHW data read as NHWC, copied back out unchanged
+		const ecpu::TensorShape shape(2, 12, 20, 11);
+		std::vector<float> nchw(shape.ElementCount());
+		for (size_t i = 0; i < nchw.size(); i++)
+			nchw[i] = (float)((i * 7919) % 1000);
+		ecpu::LayoutView nchw_view = ecpu::NCHWView(nchw.data(), shape);
+		ecpu::Tensor nhwc;
+		ecpu::Materialize(nchw_view, nhwc, pool);
+		bool matches = nhwc.Shape() == shape;
+		for (int n = 0; n < shape.n && matches; n++)
+			for (int y = 0; y < shape.h; y++)
+				for (int x = 0; x < shape.w; x++)
+					for (int c = 0; c < shape.c; c++)
+						matches = matches && nhwc.At(n, y, x, c) == nchw[(((size_t)n * shape.c + c) * shape.h + y) * shape.w + x]
+							&& nchw_view.At(n, y, x, c) == nhwc.At(n, y, x, c);
+		check(matches, "NCHW view and copy");
+		std::vector<float> back(nchw.size());
+		ecpu::StoreNCHW(nhwc, back.data(), pool);
+		check(back == nchw, "NHWC stored as NCHW");
+		check(!nchw_view.IsPlane() && throws([&] { nchw_view.Plane(0); }), "NCHW views are not planes");
+
+		// Unshuffle follows the channel rule of the shaders, and shuffle undoes it for both source layouts
+		ecpu::Tensor image(2, 8, 12, 3);
+		fillInput(image);
+		ecpu::LayoutView unshuffled = ecpu::PixelUnshuffleView(ecpu::NHWCView(image), 4);
+		check(unshuffled.shape == ecpu::TensorShape(2, 2, 3, 48) && unshuffled.At(1, 1, 2, 2 * 16 + 3 * 4 + 1) == image.At(1, 7, 9, 2),
+			"pixel unshuffle view");
+		ecpu::Tensor copy, restored;
+		ecpu::Materialize(unshuffled, copy, pool);
+		bool unshuffle_matches = true;
+		for (int n = 0; n < 2; n++)
+			for (int y = 0; y < 2; y++)
+				for (int x = 0; x < 3; x++)
+					for (int c = 0; c < 48; c++)
+						unshuffle_matches = unshuffle_matches && copy.At(n, y, x, c) == unshuffled.At(n, y, x, c);
+		check(unshuffle_matches, "pixel unshuffle copy");
+		ecpu::Materialize(ecpu::PixelShuffleView(ecpu::NHWCView(copy), 4), restored, pool);
+		check(identical(restored, image), "pixel shuffle undoes pixel unshuffle");
+
+		ecpu::Tensor nchw_copy;
+		ecpu::Materialize(ecpu::PixelUnshuffleView(nchw_view, 2), copy, pool);
+		ecpu::Materialize(ecpu::PixelUnshuffleView(ecpu::NHWCView(nhwc), 2), nchw_copy, pool);
+		check(identical(copy, nchw_copy), "pixel unshuffle of an NCHW view");
+		std::vector<float> unshuffled_nchw(copy.ElementCount());
+		ecpu::StoreNCHW(copy, unshuffled_nchw.data(), pool);
+		ecpu::Materialize(ecpu::PixelShuffleView(ecpu::NCHWView(unshuffled_nchw.data(), copy.Shape()), 2), restored, pool);
+		check(identical(restored, nhwc), "pixel shuffle of an NCHW view");
+		check(throws([&] { ecpu::PixelUnshuffleView(ecpu::NHWCView(image), 5); }) && throws([&] { ecpu::PixelShuffleView(unshuffled, 4); }),
+			"invalid shuffles throw");
+
+		// A convolution over unshuffled channels runs on the image itself with the shuffled filter
+		for (int size : { 1, 3 })
+		{
+			unsigned int state = 5u;
+			auto next = [&]() { state = state * 1664525u + 1013904223u; return ((float)(state >> 8) / (float)(1 << 24) - 0.5f) * 0.2f; };
+			std::vector<float> weights((size_t)16 * 48 * size * size), bias(16);
+			for (auto& v : weights) v = next();
+			for (auto& v : bias) v = next();
+			ecpu::ConvWeights unshuffled_weights(weights, bias, 16, 48, size);
+			ecpu::ConvWeights shuffled_weights(ecpu::PixelShuffleFilter(weights, 16, 48, size, 4), bias, 16, 3, size * 4, 4,
+				ecpu::ConvPadding(size, 1) * 4);
+			ecpu::Tensor reference, output;
+			ecpu::Convolve(unshuffled, unshuffled_weights, true, reference, pool);
+			ecpu::Convolve(image, shuffled_weights, true, output, pool);
+			check(output.Shape() == reference.Shape() && maxDifference(output, reference) < 1e-5f,
+				std::to_string(size) + "x" + std::to_string(size) + " convolution on the image with the pixel shuffled filter");
+			check(ecpu::PixelUnshuffleFilter(ecpu::PixelShuffleFilter(weights, 16, 48, size, 4), 16, 3, size * 4, 4) == weights,
+				std::to_string(size) + "x" + std::to_string(size) + " pixel shuffle filter round trip");
+		}
+	}
+
+	// PNG round trip and the packed depth and motion vector buffers of the dataset
+	void datasetReadingTesting()
+	{
+		eio::PngImage image;
+		image.width = 5;
+		image.height = 3;
+		image.channels = 3;
+		for (int i = 0; i < 45; i++)
+			image.pixels.push_back((uint8_t)(i * 37));
+		eio::PngImage decoded = eio::DecodePng(eio::EncodePng(image));
+		check(decoded.width == 5 && decoded.height == 3 && decoded.channels == 3 && decoded.pixels == image.pixels, "PNG round trip");
+
+		// Smooth gradients with repeated rows compress, noise falls back to literals, both round trip
+		eio::PngImage smooth;
+		smooth.width = 300;
+		smooth.height = 200;
+		smooth.channels = 4;
+		eio::PngImage noise = smooth;
+		uint32_t seed = 7;
+		for (int y = 0; y < smooth.height; y++)
+		{
+			for (int x = 0; x < smooth.width * smooth.channels; x++)
+			{
+				smooth.pixels.push_back((uint8_t)(x / 3 + (y / 8) * 5));
+				seed = seed * 1664525u + 1013904223u;
+				noise.pixels.push_back((uint8_t)(seed >> 24));
+			}
+		}
+		const std::vector<uint8_t> smooth_file = eio::EncodePng(smooth);
+		check(eio::DecodePng(smooth_file).pixels == smooth.pixels && smooth_file.size() * 20 < smooth.pixels.size(), "PNG compression");
+		const std::vector<uint8_t> noise_file = eio::EncodePng(noise);
+		check(eio::DecodePng(noise_file).pixels == noise.pixels && noise_file.size() < noise.pixels.size() * 9 / 8, "PNG of noise");
+
+		ecpu::Tensor tensor;
+		ecpu::ImageToTensor(image, 3, tensor);
+		check(ecpu::TensorToImage(tensor).pixels == image.pixels, "image tensor round trip");
+		check(throws([&] { ecpu::ImageToTensor(image, 4, tensor); }), "missing channels throw");
+
+		// One pixel of depth 0.75 and motion (0.5, -0.25), little endian like the GPU buffers
+		eio::PngImage packed;
+		packed.width = 4;
+		packed.height = 1;
+		packed.channels = 1;
+		float depth = 0.75f;
+		const uint8_t* bytes = (const uint8_t*)&depth;
+		packed.pixels.assign(bytes, bytes + 4);
+		ecpu::DecodeDepth(packed, tensor);
+		check(tensor.Shape() == ecpu::TensorShape(1, 1, 1, 1) && tensor.At(0, 0, 0, 0) == 0.75f, "depth decoding");
+
+		uint16_t u = Float16Compressor::compress(0.5f);
+		uint16_t v = Float16Compressor::compress(-0.25f);
+		packed.pixels = { (uint8_t)u, (uint8_t)(u >> 8), (uint8_t)v, (uint8_t)(v >> 8) };
+		ecpu::DecodeMotion(packed, tensor);
+		check(tensor.Shape() == ecpu::TensorShape(1, 1, 1, 2) && tensor.At(0, 0, 0, 0) == 0.5f && tensor.At(0, 0, 0, 1) == -0.25f, "motion vector decoding");
+
+		ecpu::Tensor encoded(1, 3, 2, 2);
+		for (size_t i = 0; i < encoded.ElementCount(); i++)
+			encoded.Data()[i] = 0.125f * i - 0.5f;
+		ecpu::DecodeMotion(eio::DecodePng(eio::EncodePng(ecpu::EncodeMotion(encoded))), tensor);
+		check(maxDifference(tensor, encoded) == 0.0f, "motion vector encoding");
+		ecpu::Tensor depth_image(1, 3, 2, 1);
+		for (size_t i = 0; i < depth_image.ElementCount(); i++)
+			depth_image.Data()[i] = 0.9f + 0.01234f * i;
+		ecpu::DecodeDepth(ecpu::EncodeDepth(depth_image), tensor);
+		check(maxDifference(tensor, depth_image) == 0.0f, "depth encoding");
+
+		// Scene textures stored as 1 bit gray and as palette images
+		eio::PngImage chain_mask = eio::LoadPng("../Rendering/textures/sponza/chain_texture_mask.png");
+		check(chain_mask.channels == 1 && chain_mask.width == 256 && chain_mask.height == 1024 &&
+			std::all_of(chain_mask.pixels.begin(), chain_mask.pixels.end(), [](uint8_t v) { return v == 0 || v == 255; }) &&
+			std::count(chain_mask.pixels.begin(), chain_mask.pixels.end(), 255) > 0, "1 bit gray PNG decoding");
+		eio::PngImage palette = eio::LoadPng("../Rendering/textures/knight/Knight_spec.png");
+		check(palette.channels == 3 && palette.width == 1024 && palette.pixels.size() == 1024 * 1024 * 3, "palette PNG decoding");
+
+		check(ecpu::DatasetImagePath("data", 4, 2, 7) == "data/us4/images/video2/image_us4_v2_f7.png", "dataset image path");
+		check(ecpu::DatasetTargetPath("data", 16, 2, 7) == "data/spp16/video2/spp16_v2_f7.png", "dataset target path");
+	}
+
+	// SSIM of metrics._ssim written out directly: full 2D window, zero padding, double sums
+	double referenceSSIM(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		const ecpu::TensorShape& s = a.Shape();
+		double g[11], g_sum = 0.0;
+		for (int i = 0; i < 11; i++)
+			g_sum += g[i] = std::exp(-(i - 5) * (i - 5) / (2.0 * 1.5 * 1.5));
+		double sum = 0.0;
+		for (int y = 0; y < s.h; y++)
+		{
+			for (int x = 0; x < s.w; x++)
+			{
+				for (int c = 0; c < s.c; c++)
+				{
+					double mu1 = 0.0, mu2 = 0.0, e11 = 0.0, e22 = 0.0, e12 = 0.0;
+					for (int dy = -5; dy <= 5; dy++)
+					{
+						for (int dx = -5; dx <= 5; dx++)
+						{
+							if (y + dy < 0 || y + dy >= s.h || x + dx < 0 || x + dx >= s.w)
+								continue;
+							const double w = g[dy + 5] * g[dx + 5] / (g_sum * g_sum);
+							const double va = a.At(0, y + dy, x + dx, c);
+							const double vb = b.At(0, y + dy, x + dx, c);
+							mu1 += w * va;
+							mu2 += w * vb;
+							e11 += w * va * va;
+							e22 += w * vb * vb;
+							e12 += w * va * vb;
+						}
+					}
+					const double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03;
+					sum += ((2 * mu1 * mu2 + c1) * (2 * (e12 - mu1 * mu2) + c2)) /
+						((mu1 * mu1 + mu2 * mu2 + c1) * (e11 - mu1 * mu1 + e22 - mu2 * mu2 + c2));
+				}
+			}
+		}
+		return sum / a.ElementCount();
+	}
+
+	// Metrics of metrics.py and the npy files they are saved in
+	void imageMetricsTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::ThreadPool pool3(3);
+
+		ecpu::Tensor a(1, 37, 29, 3), b(1, 37, 29, 3);
+		fillInput(a);
+		for (size_t i = 0; i < b.ElementCount(); i++)
+			b.Data()[i] = std::min(1.0f, std::max(0.0f, a.Data()[i] + 0.1f * (float)((i * 31) % 7) / 7.0f - 0.05f));
+
+		ecpu::Tensor c(1, 37, 29, 3), d(1, 37, 29, 3);
+		c.Fill(0.25f);
+		d.Fill(0.35f);
+		check(std::abs(ecpu::PSNR(c, d, pool) - 20.0) < 1e-4, "PSNR of a constant difference");
+		check(std::abs(ecpu::SSIM(a, a, pool) - 1.0) < 1e-6, "SSIM of identical images");
+		const double ssim = ecpu::SSIM(a, b, pool);
+		check(std::abs(ssim - referenceSSIM(a, b)) < 1e-5, "SSIM matches the 2D window");
+		check(ssim == ecpu::SSIM(a, b, pool3), "SSIM is independent of the thread count");
+		check(ecpu::PSNR(a, b, pool) == ecpu::PSNR(a, b, pool3), "PSNR is independent of the thread count");
+
+		// Sequences that change like their targets have no temporal error
+		check(std::isinf(ecpu::TemporalPSNR(b, a, b, a, pool)), "TPSNR of matching changes");
+		check(std::abs(ecpu::TemporalPSNR(d, c, c, c, pool) - 20.0) < 1e-4, "TPSNR of a constant change");
+		check(std::abs(ecpu::SpatioTemporalError(d, d, c, c, 0.0f, pool) - 0.2) < 1e-6 &&
+			std::abs(ecpu::SpatioTemporalError(d, d, c, c, 1.0f, pool)) < 1e-6, "spatio temporal error");
+		check(throws([&] { ecpu::SSIM(a, ecpu::Tensor(1, 37, 28, 3), pool); }), "metrics of different shapes throw");
+
+		// np.save pads the header so the data is 64 byte aligned
+		const std::string path = "metrics_test.npy";
+		const std::vector<double> values = { 35.5, 0.0, -1.25, 1e-9 };
+		eio::SaveNpy(path, values);
+		check(eio::LoadNpy(path) == values, "npy round trip");
+		std::ifstream file(path, std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		check(bytes.size() == 128 + values.size() * 8 && bytes[127] == '\n', "npy header alignment");
+		file.close();
+		std::remove(path.c_str());
+		check(throws([] { eio::LoadNpy("missing.npy"); }), "missing npy file throws");
+	}
+
+	// Largest difference of a tensor from a reference, relative to the reference's magnitude
+	float relativeError(const float* values, const std::vector<float>& reference)
+	{
+		float error = 0.0f;
+		float scale = 1.0f;
+		for (size_t i = 0; i < reference.size(); i++)
+		{
+			error = std::max(error, std::abs(values[i] - reference[i]));
+			scale = std::max(scale, std::abs(reference[i]));
+		}
+		return error / scale;
+	}
+
+	// Compares every layer with golden tensors of the exported weights. The committed files are
+	// written by Network/golden_reference.py, a double precision numpy reference, and
+	// utils.SaveGoldenTensors writes the same layout from the PyTorch model. The tolerance is
+	// half precision, what the DirectML path computes in
+	void goldenTensorTesting(const std::string& golden_path)
+	{
+		check((bool)std::ifstream(golden_path), "golden tensors exist at " + golden_path);
+		if (!std::ifstream(golden_path))
+			return;
+		const float tolerance = 1e-3f;
+
+		ecpu::ThreadPool pool;
+		ecpu::MasterNet net(golden_path);
+		ecpu::WeightMap golden = ecpu::LoadWeightFile(golden_path);
+		const auto& s = ecpu::GetWeights(golden, "golden.input.shape");
+		check(s.size() == 4, golden_path + ": input shape");
+		if (s.size() != 4)
+			return;
+		ecpu::Tensor input(ecpu::TensorShape((int)s[0], (int)s[1], (int)s[2], (int)s[3]));
+		const auto& input_values = ecpu::GetWeights(golden, "golden.input");
+		check(input_values.size() == input.ElementCount(), golden_path + ": input size");
+		if (input_values.size() != input.ElementCount())
+			return;
+		std::copy(input_values.begin(), input_values.end(), input.Data());
+
+		const ecpu::NetworkGraph& graph = net.GetGraph();
+		std::vector<ecpu::Tensor> tensors;
+		net.ExecuteLayers(input, tensors, pool);
+		for (int t = 0; t < (int)tensors.size(); t++)
+		{
+			if (t == graph.InputTensor())
+				continue;
+			const std::string& name = graph.Tensors()[t].name;
+			const auto& reference = ecpu::GetWeights(golden, "golden." + name);
+			const std::string what = golden_path + ": layer " + name;
+			check(reference.size() == tensors[t].ElementCount(), what + " size");
+			if (reference.size() == tensors[t].ElementCount())
+			{
+				float error = relativeError(tensors[t].Data(), reference);
+				check(error <= tolerance, what + " relative error " + std::to_string(error));
+			}
+		}
+
+		// Both schedules, read through the pixel shuffle of finalize_network_ps.hlsl
+		const auto& shuffled = ecpu::GetWeights(golden, "golden.shuffled");
+		const ecpu::MasterNet::Schedule schedules[] = { ecpu::MasterNet::Schedule::LayerByLayer, ecpu::MasterNet::Schedule::FusedResidualBlocks };
+		for (auto schedule : schedules)
+		{
+			ecpu::Tensor output;
+			net.Execute(input, output, pool, schedule);
+			const ecpu::TensorShape& o = output.Shape();
+			const int height = o.h * 4;
+			const int width = o.w * 4;
+			const int channels = o.c / 16;
+			check(shuffled.size() == (size_t)height * width * channels, golden_path + ": shuffled output size");
+			if (shuffled.size() != (size_t)height * width * channels)
+				continue;
+
+			std::vector<float> values(shuffled.size());
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+					for (int c = 0; c < channels; c++)
+						values[((size_t)y * width + x) * channels + c] = output.At(0, y / 4, x / 4, c * 16 + (y % 4) * 4 + x % 4);
+			float error = relativeError(values.data(), shuffled);
+			check(error <= tolerance, golden_path + ": " + (schedule == ecpu::MasterNet::Schedule::LayerByLayer ? "layer by layer" : "fused") +
+				" shuffled output relative error " + std::to_string(error));
+		}
+	}
+
+	// Golden files are exported next to the weights they were made from and committed with them
+	std::string goldenPath(int upsample_factor)
+	{
+		std::string weights = ecpu::MasterNet::DefaultWeightPath(upsample_factor);
+		return weights.substr(0, weights.find_last_of('/') + 1) + "nn_weights_golden.bin";
+	}
+}
+
+int NetworkTesting()
+{
+	failures = 0;
+	graphParsingTesting();
+	bufferPlannerTesting();
+	graphExecutionTesting();
+	tiledExecutionTesting();
+	incrementalExecutionTesting();
+	prunedGraphTesting();
+	convAlgorithmTesting();
+	convAutotunerTesting();
+	batchedEvaluationTesting();
+	dltusPassesTesting();
+	layoutTesting();
+	datasetReadingTesting();
+	imageMetricsTesting();
+	goldenTensorTesting(goldenPath(2));
+	goldenTensorTesting(goldenPath(4));
+	std::cout << "Network testing: " << (failures == 0 ? "all checks passed" : std::to_string(failures) + " checks failed") << std::endl;
+	return failures;
+}
@@ -0,0 +1,1125 @@
+#include "render_testing.h"
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include "cpu/thread_pool.h"
+#include "cpu/matrix4.h"
+#include "cpu/bvh.h"
+#include "cpu/frustum.h"
+#include "cpu/transform_hierarchy.h"
+#include "io/objb.h"
+#include "aa/taa/jitter_points.h"
+#include "deferred_rendering/cpu/cpu_rasterizer.h"
+#include "deferred_rendering/cpu/draw_batcher.h"
+#include "ray_tracer/cpu/cpu_ray_tracer.h"
+#include "scenes/cpu/cpu_scene.h"
+#include "scenes/cpu/stress_scene.h"
+
+namespace
+{
+	int failures = 0;
+
+	// Test views are 64x64 with a 90 degree field of view, so a view space point (x, y, z)
+	// lands on pixel ((x / z + 1) * 32, (1 - y / z) * 32)
+	const int view_size = 64;
+	const float view_fov = 3.14159265f / 2.0f;
+
+	void check(bool condition, const std::string& what)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << what << std::endl;
+			failures++;
+		}
+	}
+
+	template <typename F>
+	bool throws(F f)
+	{
+		try { f(); }
+		catch (const std::exception&) { return true; }
+		return false;
+	}
+
+	float maxDifference(const ecpu::Tensor& a, const ecpu::Tensor& b)
+	{
+		if (a.Shape() != b.Shape())
+			return INFINITY;
+		float diff = 0.0f;
+		for (size_t i = 0; i < a.ElementCount(); i++)
+			diff = std::max(diff, std::abs(a.Data()[i] - b.Data()[i]));
+		return diff;
+	}
+
+	bool near(float a, float b, float tolerance = 1e-5f)
+	{
+		return std::abs(a - b) <= tolerance;
+	}
+
+	// View space position of a point on screen at depth z
+	ecpu::Vector3 screenPoint(float sx, float sy, float z)
+	{
+		const float half = 0.5f * view_size;
+		return ecpu::Vector3((sx / half - 1.0f) * z, (1.0f - sy / half) * z, z);
+	}
+
+	eio::ObjbMesh makeMesh(const std::vector<ecpu::Vector3>& positions, const std::vector<uint32_t>& indices)
+	{
+		eio::ObjbMesh mesh;
+		for (const auto& p : positions)
+		{
+			eio::ObjbVertex v = { { p.x, p.y, p.z }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { p.x, p.y } };
+			mesh.vertices.push_back(v);
+		}
+		mesh.indices = indices;
+		return mesh;
+	}
+
+	// Quad between two screen corners at depth z, split along the top-left to bottom-right
+	// diagonal and wound clockwise on screen unless flipped
+	eio::ObjbMesh screenQuad(float x0, float y0, float x1, float y1, float z, bool flip = false)
+	{
+		std::vector<ecpu::Vector3> corners = { screenPoint(x0, y0, z), screenPoint(x1, y0, z), screenPoint(x1, y1, z), screenPoint(x0, y1, z) };
+		if (flip)
+			return makeMesh(corners, { 0, 2, 1, 0, 3, 2 });
+		return makeMesh(corners, { 0, 1, 2, 0, 2, 3 });
+	}
+
+	ecpu::RasterMaterial colorMaterial(float r, float g, float b)
+	{
+		ecpu::RasterMaterial material;
+		material.diffuse_color[0] = r;
+		material.diffuse_color[1] = g;
+		material.diffuse_color[2] = b;
+		return material;
+	}
+
+	ecpu::RasterDraw makeDraw(const eio::ObjbMesh& mesh, const ecpu::RasterMaterial& material)
+	{
+		ecpu::RasterDraw draw;
+		draw.mesh = &mesh;
+		draw.material = &material;
+		return draw;
+	}
+
+	const float* pixel(const ecpu::Tensor& image, int y, int x)
+	{
+		return image.Data() + ((size_t)y * image.Shape().w + x) * image.Shape().c;
+	}
+
+	int coveredPixels(const ecpu::SoftwareRasterizer& rasterizer)
+	{
+		const ecpu::Tensor& depth = rasterizer.GetDepth();
+		int count = 0;
+		for (size_t i = 0; i < depth.ElementCount(); i++)
+			count += depth.Data()[i] < 1.0f ? 1 : 0;
+		return count;
+	}
+
+	bool allFinite(const ecpu::Tensor& t)
+	{
+		for (size_t i = 0; i < t.ElementCount(); i++)
+			if (!std::isfinite(t.Data()[i]))
+				return false;
+		return true;
+	}
+
+	void matrixTesting()
+	{
+		using ecpu::Matrix4;
+		using ecpu::Vector3;
+		// Yaw turns the forward axis towards x, like ema::mat4::RollPitchYaw with (0, 0, pi / 2)
+		Vector3 forward = Matrix4::RollPitchYaw(Vector3(0.0f, 0.0f, 1.5707963f)).TransformDirection(Vector3(0.0f, 0.0f, 1.0f));
+		check(near(forward.x, 1.0f) && near(forward.y, 0.0f) && near(forward.z, 0.0f), "yaw rotation");
+		Vector3 up = Matrix4::RollPitchYaw(Vector3(0.0f, 1.5707963f, 0.0f)).TransformDirection(Vector3(0.0f, 1.0f, 0.0f));
+		check(near(up.x, 0.0f) && near(up.y, 0.0f) && near(up.z, 1.0f), "pitch rotation");
+
+		// Model world matrices scale, rotate and then translates
+		ecpu::Vector4 p = Matrix4::World(Vector3(0.0f, 0.0f, 3.0f), Vector3(), Vector3(2.0f, 2.0f, 2.0f)).Transform(Vector3(1.0f, 0.0f, 0.0f));
+		check(near(p.x, 2.0f) && near(p.z, 3.0f) && near(p.w, 1.0f), "world matrix");
+
+		const Matrix4 view = Matrix4::LookAt(Vector3(1.0f, 2.0f, 3.0f), Vector3(1.0f, 2.0f, 4.0f), Vector3(0.0f, 1.0f, 0.0f));
+		p = view.Transform(Vector3(2.0f, 2.0f, 5.0f));
+		check(near(p.x, 1.0f) && near(p.y, 0.0f) && near(p.z, 2.0f), "look at");
+
+		// Depth maps the near plane to 0 and the far plane to 1, jitter shifts ndc by -offset
+		const Matrix4 projection = Matrix4::ProjectionOffset(0.1f, 100.0f, 0.1f, 0.1f, 0.0f, 0.0f);
+		p = projection.Transform(Vector3(0.0f, 0.0f, 0.1f));
+		check(near(p.z / p.w, 0.0f), "near plane depth");
+		p = projection.Transform(Vector3(0.0f, 0.0f, 100.0f));
+		check(near(p.z / p.w, 1.0f), "far plane depth");
+		p = Matrix4::ProjectionOffset(0.1f, 100.0f, 0.1f, 0.1f, 0.25f, -0.5f).Transform(Vector3(1.0f, 1.0f, 2.0f));
+		check(near(p.x / p.w, 0.25f) && near(p.y / p.w, 1.0f), "projection offset");
+		p = Matrix4::Orthographic(40.0f, 20.0f, 1.0f, 101.0f).Transform(Vector3(20.0f, -10.0f, 51.0f));
+		check(near(p.x, 1.0f) && near(p.y, -1.0f) && near(p.z, 0.5f) && near(p.w, 1.0f), "orthographic projection");
+
+		bool identity = true;
+		for (const Matrix4& product : { projection * projection.Inverse(), view.Inverse() * view })
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++)
+					identity = identity && near(product.m[i][j], i == j ? 1.0f : 0.0f, 1e-4f);
+		check(identity, "matrix inverse");
+	}
+
+	void jitterTesting()
+	{
+		for (int factor : { 2, 4 })
+		{
+			auto points = CustomJitterPoints(factor);
+			bool inside = points.size() == 16;
+			std::vector<int> cells(factor * factor, 0);
+			for (const auto& p : points)
+			{
+				inside = inside && p.x >= 0.0f && p.x < 1.0f && p.y >= 0.0f && p.y < 1.0f;
+				cells[(int)(p.y * factor) * factor + (int)(p.x * factor)]++;
+			}
+			check(inside, "jitter points inside the pixel, factor " + std::to_string(factor));
+			check(std::all_of(cells.begin(), cells.end(), [&](int c) { return c == 16 / (factor * factor); }),
+				"jitter covers every high resolution pixel evenly, factor " + std::to_string(factor));
+		}
+		check(throws([] { CustomJitterPoints(3); }), "unsupported jitter factor throws");
+	}
+
+	void objbTesting()
+	{
+		eio::ObjbMesh mesh = screenQuad(1.0f, 2.0f, 3.0f, 4.0f, 5.0f);
+		mesh.material_index = 1;
+		std::vector<eio::ObjbMesh> meshes = { mesh, eio::ObjbMesh() };
+		const std::string name = "render_testing_model";
+		eio::SaveObjb(name, meshes);
+		auto loaded = eio::LoadObjb(name);
+		std::remove((name + ".objb").c_str());
+		check(loaded.size() == 2 && loaded[0].indices == mesh.indices && loaded[0].material_index == 1 && loaded[1].vertices.empty(), "objb round trip");
+		check(loaded.size() == 2 && loaded[0].vertices.size() == 4 && loaded[0].vertices[2].position[1] == mesh.vertices[2].position[1], "objb vertices");
+		check(throws([&] { eio::LoadObjb(name); }), "missing objb throws");
+
+		// The knight baked by ConvertOBJToOBJB, one mesh per material
+		auto knight = eio::LoadObjb("../Rendering/models/knight");
+		auto materials = eio::LoadMtl("../Rendering/models/knight");
+		check(knight.size() == 2 && materials.size() == 2 && knight[0].indices.size() == 111408, "knight model");
+		check(materials.size() == 2 && materials[0].name == "Caballero" && materials[0].diffuse_map == "../Rendering/textures/knight/Knight_diffuse.png" &&
+			materials[0].diffuse_color[0] == 0.8f, "knight materials");
+	}
+
+	void coverageTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::SoftwareRasterizer rasterizer(view_size, view_size);
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		auto material = colorMaterial(1.0f, 0.0f, 0.0f);
+
+		// Edges and the diagonal run through pixel centers. The top-left rule keeps the left and
+		// top edges and drops the others, so the two triangles cover the 32x16 pixels once
+		auto quad = screenQuad(8.5f, 8.5f, 40.5f, 24.5f, 2.0f);
+		rasterizer.Render({ makeDraw(quad, material) }, camera, pool);
+		check(coveredPixels(rasterizer) == 32 * 16, "watertight quad coverage");
+		check(rasterizer.GetDepth().At(0, 8, 8, 0) < 1.0f && rasterizer.GetDepth().At(0, 8, 40, 0) == 1.0f &&
+			rasterizer.GetDepth().At(0, 24, 8, 0) == 1.0f, "top-left fill rule");
+		const float* n = pixel(rasterizer.GetNormals(), 16, 16);
+		check(near(n[0], 0.0f) && near(n[1], 0.0f) && near(n[2], -1.0f) && near(n[3], 2.0f), "view space normal and distance");
+		const float* a = pixel(rasterizer.GetAlbedo(), 16, 16);
+		check(a[0] == 1.0f && a[1] == 0.0f && a[2] == 0.0f, "material color");
+		const float* sky = pixel(rasterizer.GetAlbedo(), 40, 40);
+		check(near(sky[2], 1.0f) && near(rasterizer.GetNormals().At(0, 40, 40, 3), 100.0f), "clear values");
+		// Device depth of a point at view depth 2
+		check(near(rasterizer.GetDepth().At(0, 16, 16, 0), 100.0f / 99.9f * (1.0f - 0.1f / 2.0f)), "device depth");
+
+		// A fan of thin triangles around a point leaves no holes and covers the square once
+		std::vector<ecpu::Vector3> fan = { screenPoint(33.3f, 31.7f, 3.0f) };
+		std::vector<uint32_t> fan_indices;
+		const float corners[4][2] = { { 10.0f, 10.0f }, { 54.0f, 10.0f }, { 54.0f, 54.0f }, { 10.0f, 54.0f } };
+		const int steps = 13;
+		for (int side = 0; side < 4; side++)
+		{
+			for (int i = 0; i < steps; i++)
+			{
+				const float t = (float)i / steps;
+				const float* c0 = corners[side];
+				const float* c1 = corners[(side + 1) % 4];
+				fan.push_back(screenPoint(c0[0] + (c1[0] - c0[0]) * t, c0[1] + (c1[1] - c0[1]) * t, 3.0f));
+			}
+		}
+		const uint32_t rim = (uint32_t)fan.size() - 1;
+		for (uint32_t i = 1; i <= rim; i++)
+			fan_indices.insert(fan_indices.end(), { 0, i, i % rim + 1 });
+		auto fan_mesh = makeMesh(fan, fan_indices);
+		rasterizer.Render({ makeDraw(fan_mesh, material) }, camera, pool);
+		check(coveredPixels(rasterizer) == 44 * 44, "triangle fan coverage");
+
+		// Counter-clockwise triangles are back faces
+		auto back = screenQuad(8.5f, 8.5f, 40.5f, 24.5f, 2.0f, true);
+		rasterizer.Render({ makeDraw(back, material) }, camera, pool);
+		check(coveredPixels(rasterizer) == 0 && rasterizer.GetLastStats().rasterized_triangles == 0, "back face culling");
+
+		// Moving the sample position into the right part of the pixel uncovers the column
+		// whose center lies just left of the quad
+		auto shifted = screenQuad(8.75f, 8.5f, 40.5f, 24.5f, 2.0f);
+		rasterizer.Render({ makeDraw(shifted, material) }, camera, pool);
+		const int centered = coveredPixels(rasterizer);
+		camera.SetJitter(0.9f, 0.5f);
+		camera.Update();
+		rasterizer.Render({ makeDraw(shifted, material) }, camera, pool);
+		check(coveredPixels(rasterizer) == centered + 16, "jitter moves coverage");
+		float motion = 0.0f;
+		for (size_t i = 0; i < rasterizer.GetMotionVectors().ElementCount(); i++)
+			motion = std::max(motion, std::abs(rasterizer.GetMotionVectors().Data()[i]));
+		check(motion == 0.0f, "jitter adds no motion");
+	}
+
+	void depthTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::SoftwareRasterizer rasterizer(view_size, view_size);
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		auto red = colorMaterial(1.0f, 0.0f, 0.0f);
+		auto green = colorMaterial(0.0f, 1.0f, 0.0f);
+		auto front = screenQuad(4.0f, 4.0f, 40.0f, 40.0f, 2.0f);
+		auto behind = screenQuad(20.0f, 20.0f, 60.0f, 60.0f, 3.0f);
+
+		rasterizer.Render({ makeDraw(front, red), makeDraw(behind, green) }, camera, pool);
+		ecpu::Tensor albedo = rasterizer.GetAlbedo();
+		ecpu::Tensor depth = rasterizer.GetDepth();
+		rasterizer.Render({ makeDraw(behind, green), makeDraw(front, red) }, camera, pool);
+		check(maxDifference(albedo, rasterizer.GetAlbedo()) == 0.0f && maxDifference(depth, rasterizer.GetDepth()) == 0.0f, "draw order independence");
+		check(albedo.At(0, 30, 30, 0) == 1.0f && albedo.At(0, 50, 50, 1) == 1.0f, "nearest surface wins");
+
+		// Geometry beyond the far plane is clipped
+		auto far_quad = screenQuad(4.0f, 4.0f, 40.0f, 40.0f, 150.0f);
+		rasterizer.Render({ makeDraw(far_quad, red) }, camera, pool);
+		check(coveredPixels(rasterizer) == 0, "far plane clipping");
+
+		// A floor running from behind the camera into the distance is clipped at the near plane
+		auto floor = makeMesh({ ecpu::Vector3(-50.0f, -1.0f, -10.0f), ecpu::Vector3(-50.0f, -1.0f, 50.0f), ecpu::Vector3(50.0f, -1.0f, 50.0f),
+			ecpu::Vector3(50.0f, -1.0f, -10.0f) }, { 0, 1, 2, 0, 2, 3 });
+		rasterizer.Render({ makeDraw(floor, red) }, camera, pool);
+		bool depth_range = true;
+		for (size_t i = 0; i < rasterizer.GetDepth().ElementCount(); i++)
+			depth_range = depth_range && rasterizer.GetDepth().Data()[i] >= 0.0f && rasterizer.GetDepth().Data()[i] <= 1.0f;
+		check(coveredPixels(rasterizer) > 0 && depth_range && allFinite(rasterizer.GetNormals()) && allFinite(rasterizer.GetMotionVectors()),
+			"near plane clipping");
+		// The bottom row looks down by ndc y, reaching the floor one unit below at depth 1 / -y
+		const float bottom_depth = 1.0f / (63.5f / 32.0f - 1.0f);
+		check(near(rasterizer.GetNormals().At(0, 63, 32, 3), bottom_depth, 1e-3f), "clipped triangle interpolation");
+	}
+
+	void motionTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::SoftwareRasterizer rasterizer(view_size, view_size);
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		auto material = colorMaterial(0.5f, 0.5f, 0.5f);
+		auto wall = screenQuad(-10.0f, -10.0f, 74.0f, 74.0f, 2.0f);
+		ecpu::RasterDraw draw = makeDraw(wall, material);
+
+		// A static camera and model give no motion, whatever the jitter
+		camera.SetJitter(0.2f, 0.7f);
+		camera.Update();
+		camera.SetJitter(0.8f, 0.1f);
+		camera.Update();
+		rasterizer.Render({ draw }, camera, pool);
+		float motion = 0.0f;
+		for (size_t i = 0; i < rasterizer.GetMotionVectors().ElementCount(); i++)
+			motion = std::max(motion, std::abs(rasterizer.GetMotionVectors().Data()[i]));
+		check(coveredPixels(rasterizer) == view_size * view_size && motion == 0.0f, "static scene has no motion");
+
+		// Moving the camera right by 0.1 moves a wall at depth 2 left by 0.1 / 2 in ndc, so the
+		// uv offset back to the previous frame is 0.025 to the right
+		camera.SetPosition(ecpu::Vector3(0.1f, 0.0f, 0.0f));
+		camera.Update();
+		rasterizer.Render({ draw }, camera, pool);
+		bool camera_motion = true;
+		for (int y = 0; y < view_size; y++)
+			for (int x = 0; x < view_size; x++)
+				camera_motion = camera_motion && near(rasterizer.GetMotionVectors().At(0, y, x, 0), 0.025f) && near(rasterizer.GetMotionVectors().At(0, y, x, 1), 0.0f);
+		check(camera_motion, "camera translation motion");
+
+		// Moving the model down by 0.2 between frames gives an upwards uv offset of 0.05
+		camera.Update();
+		draw.last_world = ecpu::Matrix4::Translation(ecpu::Vector3(0.0f, 0.2f, 0.0f));
+		rasterizer.Render({ draw }, camera, pool);
+		check(near(rasterizer.GetMotionVectors().At(0, 32, 32, 0), 0.0f) && near(rasterizer.GetMotionVectors().At(0, 32, 32, 1), -0.05f), "model motion");
+	}
+
+	void maskTesting()
+	{
+		ecpu::ThreadPool pool(1);
+		ecpu::SoftwareRasterizer rasterizer(view_size, view_size);
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		const uint8_t opaque = 255;
+		const uint8_t clear = 0;
+		const uint8_t texels[4][3] = { { 255, 0, 0 }, { 255, 0, 0 }, { 255, 0, 0 }, { 255, 0, 0 } };
+		auto masked = colorMaterial(1.0f, 0.0f, 0.0f);
+		masked.mask_texture = ecpu::ImageView<uint8_t>(&clear, 1, 1, 1);
+		auto background = colorMaterial(0.0f, 0.0f, 1.0f);
+		auto front = screenQuad(0.0f, 0.0f, 64.0f, 64.0f, 2.0f);
+		auto back = screenQuad(0.0f, 0.0f, 64.0f, 64.0f, 4.0f);
+
+		rasterizer.Render({ makeDraw(front, masked), makeDraw(back, background) }, camera, pool);
+		check(rasterizer.GetAlbedo().At(0, 32, 32, 2) == 1.0f && near(rasterizer.GetNormals().At(0, 32, 32, 3), 4.0f), "masked texels are clipped");
+		masked.mask_texture = ecpu::ImageView<uint8_t>(&opaque, 1, 1, 1);
+		masked.diffuse_texture = ecpu::ImageView<uint8_t>(&texels[0][0], 2, 2, 3);
+		rasterizer.Render({ makeDraw(front, masked), makeDraw(back, background) }, camera, pool);
+		check(rasterizer.GetAlbedo().At(0, 32, 32, 0) == 1.0f && rasterizer.GetAlbedo().At(0, 32, 32, 2) == 0.0f, "opaque texels are drawn");
+	}
+
+	// Distance along the ray to a triangle, infinity on a miss
+	float rayTriangle(const ecpu::Ray& ray, const ecpu::Vector3& a, const ecpu::Vector3& b, const ecpu::Vector3& c)
+	{
+		const ecpu::Vector3 e1 = b - a;
+		const ecpu::Vector3 e2 = c - a;
+		const ecpu::Vector3 p = ray.direction.Cross(e2);
+		const float det = e1.Dot(p);
+		if (det == 0.0f)
+			return INFINITY;
+		const ecpu::Vector3 s = ray.origin - a;
+		const float u = s.Dot(p) / det;
+		const ecpu::Vector3 q = s.Cross(e1);
+		const float v = ray.direction.Dot(q) / det;
+		const float t = e2.Dot(q) / det;
+		if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < ray.t_min || t > ray.t_max)
+			return INFINITY;
+		return t;
+	}
+
+	void bvhTesting()
+	{
+		ecpu::Aabb box;
+		box.Grow(ecpu::Vector3(1.0f, 2.0f, 3.0f));
+		box.Grow(ecpu::Aabb());
+		check(box.min.x == 1.0f && box.max.z == 3.0f && box.Area() == 0.0f, "growing by an empty box");
+
+		// Random triangles of all sizes, clustered so the build has to split flat and thin groups
+		uint32_t seed = 777;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24); };
+		std::vector<ecpu::Vector3> vertices;
+		std::vector<ecpu::Aabb> bounds;
+		for (int i = 0; i < 2000; i++)
+		{
+			const ecpu::Vector3 center((random() - 0.5f) * 10.0f, random() < 0.3f ? 1.0f : (random() - 0.5f) * 10.0f, (random() - 0.5f) * 10.0f);
+			const float size = random() < 0.95f ? 0.3f : 4.0f;
+			ecpu::Aabb b;
+			for (int k = 0; k < 3; k++)
+			{
+				vertices.push_back(center + ecpu::Vector3(random() - 0.5f, (random() - 0.5f) * 0.01f, random() - 0.5f) * size);
+				b.Grow(vertices.back());
+			}
+			bounds.push_back(b);
+		}
+		ecpu::Bvh8 bvh;
+		bvh.Build(bounds);
+
+		std::vector<int> seen(bounds.size(), 0);
+		for (const auto& node : bvh.Nodes())
+			for (int i = 0; i < ecpu::Bvh8::width; i++)
+				for (uint32_t k = 0; k < node.count[i]; k++)
+					seen[bvh.Primitives()[~node.child[i] + k]]++;
+		check(std::all_of(seen.begin(), seen.end(), [](int c) { return c == 1; }), "every primitive is in one leaf");
+
+		// Closest and any hits of random rays, some along the axes, against brute force
+		size_t visited = 0;
+		auto compare = [&](int& closest_errors, int& any_errors)
+		{
+			for (int r = 0; r < 500; r++)
+			{
+				ecpu::Ray ray;
+				ray.origin = ecpu::Vector3((random() - 0.5f) * 14.0f, (random() - 0.5f) * 14.0f, (random() - 0.5f) * 14.0f);
+				ray.direction = ecpu::Vector3(random() - 0.5f, random() - 0.5f, random() - 0.5f).Normalized();
+				if (r % 10 == 0)
+					ray.direction = ecpu::Vector3(0.0f, r % 20 == 0 ? 1.0f : -1.0f, 0.0f);
+				ray.t_max = 20.0f;
+				float expected = INFINITY;
+				for (size_t i = 0; i < bounds.size(); i++)
+					expected = std::min(expected, rayTriangle(ray, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]));
+
+				ecpu::Ray closest = ray;
+				float found = INFINITY;
+				bvh.Traverse(closest, [&](uint32_t first, uint32_t count, ecpu::Ray& r)
+					{
+						for (uint32_t i = first; i < first + count; i++)
+						{
+							visited++;
+							const uint32_t p = bvh.Primitives()[i];
+							const float t = rayTriangle(r, vertices[p * 3], vertices[p * 3 + 1], vertices[p * 3 + 2]);
+							if (t < found)
+							{
+								found = t;
+								r.t_max = t;
+							}
+						}
+						return false;
+					});
+				closest_errors += found == expected ? 0 : 1;
+
+				ecpu::Ray any = ray;
+				bool hit = false;
+				bvh.Traverse(any, [&](uint32_t first, uint32_t count, ecpu::Ray& r)
+					{
+						for (uint32_t i = first; i < first + count; i++)
+						{
+							const uint32_t p = bvh.Primitives()[i];
+							hit = hit || std::isfinite(rayTriangle(r, vertices[p * 3], vertices[p * 3 + 1], vertices[p * 3 + 2]));
+						}
+						return hit;
+					});
+				any_errors += hit == std::isfinite(expected) ? 0 : 1;
+			}
+		};
+		int closest_errors = 0;
+		int any_errors = 0;
+		compare(closest_errors, any_errors);
+		check(closest_errors == 0, "bvh closest hits match brute force");
+		check(any_errors == 0, "bvh any hits match brute force");
+		check(visited < 500 * bounds.size() / 10, "bvh traversal culls most primitives");
+
+		// Every other triangle moves, the refit tree has to find them at their new place
+		for (size_t i = 0; i < bounds.size(); i += 2)
+		{
+			const ecpu::Vector3 offset(random() - 0.5f, random() - 0.5f, random() - 0.5f);
+			bounds[i] = ecpu::Aabb();
+			for (int k = 0; k < 3; k++)
+			{
+				vertices[i * 3 + k] = vertices[i * 3 + k] + offset;
+				bounds[i].Grow(vertices[i * 3 + k]);
+			}
+		}
+		bvh.Refit(bounds);
+		closest_errors = 0;
+		any_errors = 0;
+		compare(closest_errors, any_errors);
+		check(closest_errors == 0 && any_errors == 0, "refit bvh hits match brute force");
+		check(throws([&] { bvh.Refit({ ecpu::Aabb() }); }), "refit with other primitives throws");
+		check(throws([&] { ecpu::BvhBuildSettings settings; settings.bins = 1; bvh.Build(bounds, settings); }), "invalid bvh settings throw");
+
+		// Spatial splits reference clipped triangles from several leaves, the hits stay the same
+		ecpu::ThreadPool four(4);
+		std::vector<uint32_t> indices(vertices.size());
+		std::iota(indices.begin(), indices.end(), 0);
+		ecpu::BvhBuildSettings spatial;
+		spatial.spatial_splits = true;
+		bvh.BuildTriangles(vertices, indices, spatial, four);
+		std::fill(seen.begin(), seen.end(), 0);
+		for (const auto& node : bvh.Nodes())
+			for (int i = 0; i < ecpu::Bvh8::width; i++)
+				for (uint32_t k = 0; k < node.count[i]; k++)
+					seen[bvh.Primitives()[~node.child[i] + k]]++;
+		const auto& spatial_stats = bvh.GetBuildStats();
+		check(std::all_of(seen.begin(), seen.end(), [](int c) { return c >= 1; }) && spatial_stats.spatial_splits > 0 &&
+			spatial_stats.references == bvh.Primitives().size() && spatial_stats.references > bounds.size() &&
+			spatial_stats.references <= bounds.size() + (size_t)(spatial.max_duplication * bounds.size()), "spatial splits stay within the duplication budget");
+		closest_errors = 0;
+		any_errors = 0;
+		compare(closest_errors, any_errors);
+		check(closest_errors == 0 && any_errors == 0, "spatial split bvh hits match brute force");
+		bvh.Refit(bounds);
+		check(throws([&] { bvh.Build(bounds, spatial); }), "spatial splits without triangles throw");
+		check(throws([&] { bvh.BuildTriangles(vertices, { 0, 1 }, spatial, four); }), "partial triangle throws");
+		check(throws([&] { bvh.BuildTriangles(vertices, { 0, 1, (uint32_t)vertices.size() }, spatial, four); }), "triangle index out of range throws");
+
+		// A few long thin diagonal triangles through small ones overlap every object split,
+		// spatial splits cut them apart
+		std::vector<ecpu::Vector3> slivers;
+		for (int i = 0; i < 408; i++)
+		{
+			const bool diagonal = i >= 400;
+			const ecpu::Vector3 start = ecpu::Vector3(random(), random(), random()) * (diagonal ? 1.0f : 10.0f);
+			slivers.push_back(start);
+			slivers.push_back(start + (diagonal ? ecpu::Vector3(9.0f, 9.0f, 9.0f) : ecpu::Vector3(0.2f, 0.0f, 0.0f)));
+			slivers.push_back(start + (diagonal ? ecpu::Vector3(9.0f, 9.0f, 9.1f) : ecpu::Vector3(0.0f, 0.2f, 0.0f)));
+		}
+		std::vector<uint32_t> sliver_indices(slivers.size());
+		std::iota(sliver_indices.begin(), sliver_indices.end(), 0);
+		ecpu::Bvh8 object_bvh;
+		object_bvh.BuildTriangles(slivers, sliver_indices, ecpu::BvhBuildSettings(), four);
+		ecpu::Bvh8 spatial_bvh;
+		spatial_bvh.BuildTriangles(slivers, sliver_indices, spatial, four);
+		check(spatial_bvh.GetBuildStats().sah_cost < object_bvh.GetBuildStats().sah_cost && object_bvh.GetBuildStats().references == 408,
+			"spatial splits lower the sah cost of diagonal triangles");
+
+		// Large nodes are binned in parallel chunks and small ones built as parallel tasks, giving
+		// the tree of a serial build
+		std::vector<ecpu::Aabb> many(50000);
+		for (auto& b : many)
+		{
+			b = ecpu::Aabb();
+			const ecpu::Vector3 p(random() * 100.0f, random() * 10.0f, random() * 100.0f);
+			b.Grow(p);
+			b.Grow(p + ecpu::Vector3(random(), random(), random()));
+		}
+		ecpu::Bvh8 serial;
+		serial.Build(many);
+		ecpu::Bvh8 parallel;
+		parallel.Build(many, ecpu::BvhBuildSettings(), four);
+		check(serial.Nodes().size() == parallel.Nodes().size() && serial.Primitives() == parallel.Primitives() &&
+			std::memcmp(serial.Nodes().data(), parallel.Nodes().data(), serial.Nodes().size() * sizeof(ecpu::Bvh8::Node)) == 0 &&
+			serial.GetBuildStats().binary_nodes == parallel.GetBuildStats().binary_nodes, "parallel bvh build matches the serial build");
+	}
+
+	void rayTracerTesting()
+	{
+		// A lit wall below the horizon and a roof over its right half, which shadows the wall
+		// from the sun above and slightly behind the camera
+		auto wall = makeMesh({ ecpu::Vector3(-4.0f, 0.0f, 4.0f), ecpu::Vector3(4.0f, 0.0f, 4.0f), ecpu::Vector3(4.0f, -4.0f, 4.0f), ecpu::Vector3(-4.0f, -4.0f, 4.0f) },
+			{ 0, 1, 2, 0, 2, 3 });
+		auto roof = makeMesh({ ecpu::Vector3(0.0f, 1.0f, 0.0f), ecpu::Vector3(10.0f, 1.0f, 0.0f), ecpu::Vector3(10.0f, 1.0f, 10.0f), ecpu::Vector3(0.0f, 1.0f, 10.0f) },
+			{ 0, 1, 2, 0, 2, 3 });
+		const uint8_t white[3] = { 255, 255, 255 };
+		ecpu::RasterMaterial material;
+		material.diffuse_texture = ecpu::ImageView<uint8_t>(white, 1, 1, 3);
+		std::vector<ecpu::RasterDraw> draws = { makeDraw(wall, material), makeDraw(roof, material) };
+
+		ecpu::ThreadPool one(1);
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		ecpu::CPURayTracer tracer(view_size, view_size);
+		tracer.Build(draws, one);
+		tracer.Render(camera, { { 0.5f, 0.5f } }, 1, one);
+		const ecpu::Tensor& color = tracer.GetColor();
+
+		// The sky of miss.hlsl away from the sun
+		const float* sky = pixel(color, 10, 16);
+		check(near(sky[0], 0.117f) && near(sky[1], 0.565f) && near(sky[2], 1.0f), "sky color");
+		// Ambient and the diffuse term of the wall's normal towards the camera
+		const ecpu::Vector3 l = ecpu::Vector3(-0.15f, 1.0f, -0.15f).Normalized();
+		const float* lit = pixel(color, 40, 16);
+		check(near(lit[0], 0.2f - l.z, 1e-4f) && near(lit[1], lit[0]), "lit surface");
+		const float* shadowed = pixel(color, 40, 48);
+		check(near(shadowed[0], 0.2f) && near(shadowed[2], 0.2f), "shadowed surface keeps the ambient term");
+		check(tracer.GetLastStats().primary_rays == (size_t)(view_size * view_size) && tracer.GetLastStats().shadow_rays > 0, "ray counts");
+
+		// Samples are averaged per pixel, so threads only change the order of the rows
+		const ecpu::Tensor single = color;
+		ecpu::ThreadPool four(4);
+		const auto jitter = HaltonJitterPoints(2, 3, 4);
+		tracer.Render(camera, jitter, 4, one);
+		const ecpu::Tensor jittered = tracer.GetColor();
+		tracer.Render(camera, jitter, 4, four);
+		check(maxDifference(jittered, tracer.GetColor()) == 0.0f, "ray tracing does not depend on the thread count");
+		check(maxDifference(single, jittered) > 0.0f, "jitter changes the edges");
+		check(throws([&] { tracer.Render(ecpu::RasterCamera(32, 32, 0.1f, 100.0f, view_fov), jitter, 1, one); }), "ray tracer camera size mismatch throws");
+
+		// Adaptive sampling without a threshold takes every sample of the budget like Render
+		ecpu::AdaptiveSamplingSettings exhaustive;
+		exhaustive.min_samples = 2;
+		exhaustive.batch_samples = 1;
+		exhaustive.average_samples = 4;
+		exhaustive.max_samples = 4;
+		exhaustive.threshold = 0.0f;
+		tracer.RenderAdaptive(camera, jitter, exhaustive, one);
+		check(maxDifference(jittered, tracer.GetColor()) == 0.0f && tracer.GetLastStats().primary_rays == (size_t)(view_size * view_size * 4),
+			"adaptive sampling without a threshold matches the fixed render");
+
+		// Flat surfaces and the sky stop at the minimum, edges take the saved samples
+		const auto jitter64 = HaltonJitterPoints(2, 3, 64);
+		tracer.Render(camera, jitter64, 64, four);
+		const ecpu::Tensor fixed = tracer.GetColor();
+		ecpu::AdaptiveSamplingSettings adaptive;
+		adaptive.min_samples = 8;
+		adaptive.batch_samples = 4;
+		adaptive.average_samples = 16;
+		adaptive.max_samples = 64;
+		adaptive.threshold = 0.01f;
+		tracer.RenderAdaptive(camera, jitter64, adaptive, one);
+		const ecpu::Tensor adaptive_single = tracer.GetColor();
+		const auto adaptive_stats = tracer.GetLastStats();
+		const ecpu::Tensor& counts = tracer.GetSampleCounts();
+		check(counts.At(0, 10, 16, 0) == 8.0f && counts.At(0, 40, 16, 0) == 8.0f && adaptive_stats.max_pixel_samples == 64 &&
+			adaptive_stats.primary_rays < adaptive_stats.budget_samples && adaptive_stats.converged_pixels > 0, "adaptive sample counts");
+		check(maxDifference(fixed, adaptive_single) < 1e-3f, "adaptive sampling stays close to the fixed render");
+		tracer.RenderAdaptive(camera, jitter64, adaptive, four);
+		check(maxDifference(adaptive_single, tracer.GetColor()) == 0.0f && tracer.GetLastStats().primary_rays == adaptive_stats.primary_rays,
+			"adaptive sampling does not depend on the thread count");
+		adaptive.min_samples = 1;
+		check(throws([&] { tracer.RenderAdaptive(camera, jitter64, adaptive, one); }), "adaptive sampling with one minimum sample throws");
+
+		// Instances trace their meshes in model space, a half size wall scaled by two looks the same
+		auto small_wall = wall;
+		for (auto& v : small_wall.vertices)
+			for (int c = 0; c < 3; c++)
+				v.position[c] *= 0.5f;
+		std::vector<ecpu::RasterDraw> scaled = { makeDraw(small_wall, material), makeDraw(roof, material) };
+		scaled[0].world = ecpu::Matrix4::World(ecpu::Vector3(), ecpu::Vector3(), ecpu::Vector3(2.0f, 2.0f, 2.0f));
+		ecpu::CPURayTracer instanced(view_size, view_size);
+		instanced.Build(scaled, one);
+		instanced.Render(camera, { { 0.5f, 0.5f } }, 1, one);
+		check(maxDifference(single, instanced.GetColor()) < 1e-4f, "scaled instance");
+
+		// Moving an instance refits the top level and builds no new bottom levels
+		std::vector<ecpu::RasterDraw> moved = draws;
+		moved[1].world = ecpu::Matrix4::Translation(ecpu::Vector3(0.0f, 5.0f, 30.0f));
+		ecpu::CPURayTracer animated(view_size, view_size);
+		animated.Build(moved, one);
+		check(animated.GetLastStats().bottom_level_builds == 2 && !animated.GetLastStats().top_level_refit, "first build");
+		animated.Build(draws, one);
+		check(animated.GetLastStats().bottom_level_builds == 0 && animated.GetLastStats().top_level_refit && animated.GetLastStats().instances == 2,
+			"moving instances refit the top level");
+		animated.Render(camera, { { 0.5f, 0.5f } }, 1, one);
+		check(maxDifference(single, animated.GetColor()) == 0.0f, "refit top level traces like a new build");
+		animated.Build({ draws[0] }, one);
+		check(!animated.GetLastStats().top_level_refit && animated.GetLastStats().triangles == 2, "other draws rebuild the top level");
+	}
+
+	ecpu::OccluderMesh occluderOf(const eio::ObjbMesh& mesh)
+	{
+		ecpu::OccluderMesh occluder;
+		for (const auto& v : mesh.vertices)
+			occluder.vertices.push_back(ecpu::Vector3(v.position[0], v.position[1], v.position[2]));
+		occluder.indices = mesh.indices;
+		return occluder;
+	}
+
+	ecpu::Aabb boundsOf(const eio::ObjbMesh& mesh)
+	{
+		ecpu::Aabb bounds;
+		for (const auto& v : mesh.vertices)
+			bounds.Grow(ecpu::Vector3(v.position[0], v.position[1], v.position[2]));
+		return bounds;
+	}
+
+	void frustumTesting()
+	{
+		using ecpu::Vector3;
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		const ecpu::Frustum frustum = ecpu::Frustum::FromMatrix(camera.ViewMatrix() * camera.ProjectionMatrixNoJitter());
+		auto box = [](const Vector3& min, const Vector3& max) { ecpu::Aabb b; b.Grow(min); b.Grow(max); return b; };
+		// The 90 degree view sees x and y within z on either side
+		const ecpu::Aabb boxes[] = {
+			box(Vector3(-0.5f, -0.5f, 4.0f), Vector3(0.5f, 0.5f, 5.0f)),		// Visible
+			box(Vector3(-0.5f, -0.5f, -5.0f), Vector3(0.5f, 0.5f, -4.0f)),		// Behind
+			box(Vector3(-0.5f, -0.5f, 150.0f), Vector3(0.5f, 0.5f, 160.0f)),	// Beyond the far plane
+			box(Vector3(-8.0f, -0.5f, 4.0f), Vector3(-6.0f, 0.5f, 5.0f)),		// Left
+			box(Vector3(-6.0f, -0.5f, 4.0f), Vector3(-3.0f, 0.5f, 5.0f)),		// Across the left plane
+			box(Vector3(-0.5f, 6.0f, 4.0f), Vector3(0.5f, 8.0f, 5.0f)),		// Above
+			box(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f)),		// Around the camera
+			ecpu::Aabb(),
+			box(Vector3(-4.2f, -0.5f, 4.0f), Vector3(-4.1f, 0.5f, 4.0f)),		// Just left of the view
+		};
+		ecpu::BoundsSoA bounds;
+		for (const auto& b : boxes)
+			bounds.Push(b);
+		std::vector<uint32_t> visible;
+		bounds.Cull(frustum, visible);
+		check(visible == std::vector<uint32_t>{ 0, 4, 6 } && bounds.Size() == 9, "frustum culling");
+		visible.clear();
+		bounds.Cull(ecpu::Frustum::FromMatrix(camera.ViewMatrix() * camera.ProjectionMatrixNoJitter(), 0.05f), visible);
+		check(visible == std::vector<uint32_t>{ 0, 4, 6, 8 }, "frustum margin");
+
+		// World bounds of a box turned a quarter around y and moved are exact
+		bounds.Clear();
+		const ecpu::Matrix4 world = ecpu::Matrix4::World(Vector3(1.0f, 2.0f, 3.0f), Vector3(0.0f, 0.0f, 1.5707963f), Vector3(2.0f, 2.0f, 2.0f));
+		bounds.PushTransformed(box(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 2.0f, 3.0f)), world);
+		const ecpu::Aabb moved = bounds.Get(0);
+		check(bounds.Size() == 1 && near(moved.min.x, 1.0f, 1e-4f) && near(moved.max.x, 7.0f, 1e-4f) && near(moved.min.y, 2.0f, 1e-4f) &&
+			near(moved.max.y, 6.0f, 1e-4f) && near(moved.min.z, 1.0f, 1e-4f) && near(moved.max.z, 3.0f, 1e-4f), "transformed bounds");
+
+		// Random boxes culled eight at a time match testing the corners of each box
+		uint32_t seed = 777;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24); };
+		camera.SetPosition(Vector3(1.0f, 0.5f, -3.0f));
+		camera.SetRotation(Vector3(0.1f, 0.2f, 0.7f));
+		camera.Update();
+		const ecpu::Frustum turned = ecpu::Frustum::FromMatrix(camera.ViewMatrix() * camera.ProjectionMatrixNoJitter());
+		bounds.Clear();
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < 1003; i++)
+		{
+			const Vector3 center((random() - 0.5f) * 60.0f, (random() - 0.5f) * 60.0f, (random() - 0.5f) * 60.0f);
+			const Vector3 extent(random() * 4.0f, random() * 4.0f, random() * 4.0f);
+			const ecpu::Aabb b = box(center - extent, center + extent);
+			bounds.Push(b);
+			bool inside = true;
+			for (const auto& plane : turned.planes)
+			{
+				float farthest = -INFINITY;
+				for (int c = 0; c < 8; c++)
+				{
+					const Vector3 corner((c & 1) ? b.max.x : b.min.x, (c & 2) ? b.max.y : b.min.y, (c & 4) ? b.max.z : b.min.z);
+					farthest = std::max(farthest, plane[0] * corner.x + plane[1] * corner.y + plane[2] * corner.z + plane[3]);
+				}
+				inside = inside && farthest >= 0.0f;
+			}
+			if (inside)
+				expected.push_back(i);
+		}
+		visible.clear();
+		bounds.Cull(turned, visible);
+		check(!expected.empty() && expected.size() < 1003 && visible == expected, "SIMD culling matches the corner test");
+	}
+
+	bool sameMatrix(const ecpu::Matrix4& a, const ecpu::Matrix4& b, float tolerance = 1e-5f)
+	{
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				if (!near(a.m[i][j], b.m[i][j], tolerance))
+					return false;
+		return true;
+	}
+
+	void transformHierarchyTesting()
+	{
+		using ecpu::Vector3;
+		using ecpu::Matrix4;
+		ecpu::TransformHierarchy transforms;
+		check(throws([&] { transforms.Add(0); }), "transform parents come first");
+
+		// Eleven roots fill one float8 batch and part of another, then a child and a grandchild
+		uint32_t seed = 99;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24) * 4.0f - 2.0f; };
+		std::vector<Vector3> positions, rotations, scales;
+		for (int i = 0; i < 11; i++)
+		{
+			positions.push_back(Vector3(random(), random(), random()));
+			rotations.push_back(Vector3(random(), random(), random()));
+			scales.push_back(Vector3(random() + 3.0f, random() + 3.0f, random() + 3.0f));
+			const uint32_t node = transforms.Add();
+			transforms.SetPosition(node, positions.back());
+			transforms.SetRotation(node, rotations.back());
+			transforms.SetScale(node, scales.back());
+		}
+		const uint32_t child = transforms.Add(3);
+		const uint32_t grandchild = transforms.Add(child);
+		transforms.SetPosition(child, Vector3(0.0f, 1.0f, 0.0f));
+		transforms.SetRotation(grandchild, Vector3(0.0f, 0.0f, 1.0f));
+		transforms.Update();
+		bool match = true;
+		for (uint32_t i = 0; i < 11; i++)
+			match = match && sameMatrix(transforms.World(i), Matrix4::World(positions[i], rotations[i], scales[i]));
+		check(match && transforms.GetLastStats().updated == 13, "SIMD world matrices match Matrix4::World");
+		const Matrix4 child_world = Matrix4::Translation(Vector3(0.0f, 1.0f, 0.0f)) * transforms.World(3);
+		check(sameMatrix(transforms.World(child), child_world) &&
+			sameMatrix(transforms.World(grandchild), Matrix4::RollPitchYaw(Vector3(0.0f, 0.0f, 1.0f)) * child_world), "child world matrices");
+		check(sameMatrix(transforms.LastWorld(grandchild), transforms.World(grandchild), 0.0f) && transforms.Changed().size() == 13,
+			"new nodes start without motion");
+
+		// Nothing moves, nothing changes
+		transforms.ClearChanged();
+		transforms.SetPosition(5, positions[5]);
+		transforms.Update();
+		check(transforms.Changed().empty() && transforms.GetLastStats().updated == 0, "unchanged transforms stay clean");
+
+		// Moving a parent moves its descendants, then their last world matrices catch up
+		const Matrix4 old_world = transforms.World(grandchild);
+		transforms.SetPosition(3, positions[3] + Vector3(1.0f, 0.0f, 0.0f));
+		transforms.Update();
+		check(transforms.Changed() == std::vector<uint32_t>{ 3, child, grandchild } && sameMatrix(transforms.LastWorld(grandchild), old_world, 0.0f) &&
+			near(transforms.World(grandchild).m[3][0], old_world.m[3][0] + 1.0f, 1e-4f), "moved parent dirties its children");
+		transforms.ClearChanged();
+		transforms.SetScale(0, Vector3(1.0f, 1.0f, 1.0f));
+		transforms.Update();
+		check(transforms.Changed() == std::vector<uint32_t>{ 0, 3, child, grandchild } && sameMatrix(transforms.LastWorld(3), transforms.World(3), 0.0f),
+			"last world matrices catch up");
+		transforms.ClearChanged();
+		transforms.Update();
+		transforms.Update();
+		check(transforms.Changed() == std::vector<uint32_t>{ 0 }, "changes collect until cleared");
+	}
+
+	void drawBatcherTesting()
+	{
+		using ecpu::DrawKey;
+		const uint64_t key = DrawKey::Make(3, 2, 700, 40000, 0.25f);
+		check(DrawKey::Pass(key) == 3 && DrawKey::Pipeline(key) == 2 && DrawKey::Material(key) == 700 && DrawKey::Mesh(key) == 40000,
+			"draw key fields");
+		check(DrawKey::Make(0, 0, 0, 0, -1.0f) == 0 && DrawKey::Make(0, 0, 0, 0, 2.0f) == DrawKey::Make(0, 0, 0, 0, 1.0f) &&
+			DrawKey::Make(0, 0, 0, 1, 0.0f) > DrawKey::Make(0, 0, 0, 0, 1.0f), "draw key depth is clamped below the mesh");
+
+		// The radix sort matches a stable sort, equal keys keeping their order
+		uint32_t seed = 7;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+		std::vector<ecpu::DrawItem> items, scratch;
+		for (uint32_t i = 0; i < 5000; i++)
+			items.push_back({ DrawKey::Make(random() % 2, random() % 2, random() % 5, random() % 50, (float)(random() % 8) / 8.0f), i });
+		auto expected = items;
+		std::stable_sort(expected.begin(), expected.end(), [](const ecpu::DrawItem& a, const ecpu::DrawItem& b) { return a.key < b.key; });
+		ecpu::RadixSort(items, scratch);
+		bool same = true;
+		for (size_t i = 0; i < items.size(); i++)
+			same = same && items[i].key == expected[i].key && items[i].instance == expected[i].instance;
+		check(same, "radix sort is a stable sort");
+
+		// Two meshes of one material drawn alternately merge into one draw each, front to back
+		ecpu::DrawBatcher batcher;
+		const float depths[6] = { 0.9f, 0.8f, 0.3f, 0.5f, 0.1f, 0.7f };
+		for (uint32_t i = 0; i < 6; i++)
+			batcher.Add(DrawKey::Make(0, 0, 4, i % 2, depths[i]), i);
+		batcher.Add(DrawKey::Make(1, 0, 4, 1, 0.2f), 6);
+		batcher.Add(DrawKey::Make(0, 1, 0, 0, 0.0f), 7);
+		batcher.Build();
+		const auto& batches = batcher.Batches();
+		check(batches.size() == 4 && batches[0].count == 3 && batches[1].count == 3 && batches[2].count == 1 && batches[3].count == 1 &&
+			DrawKey::Mesh(batches[1].key) == 1 && DrawKey::Pipeline(batches[2].key) == 1 && DrawKey::Pass(batches[3].key) == 1, "same mesh draws merge");
+		check(batcher.Instances() == std::vector<uint32_t>{ 4, 2, 0, 3, 5, 1, 7, 6 }, "instances front to back");
+		check(batcher.FirstBatch(0) == 0 && batcher.FirstBatch(1) == 3 && batcher.FirstBatch(2) == 4, "first batch of a pass");
+		const auto& stats = batcher.GetLastStats();
+		check(stats.draws == 8 && stats.batches == 4 && stats.mesh_changes == 3 && stats.unsorted_mesh_changes == 6 &&
+			stats.pipeline_changes == 2 && stats.unsorted_pipeline_changes == 2 && stats.material_changes == 2, "batching stats");
+		batcher.Clear();
+		batcher.Build();
+		check(batcher.Batches().empty() && batcher.FirstBatch(0) == 0, "empty batcher");
+	}
+
+	void stressSceneTesting()
+	{
+		using ecpu::Vector3;
+		using ecpu::Matrix4;
+		ecpu::StressSceneDesc desc;
+		desc.instances = 50;
+		desc.materials = 3;
+		desc.dynamic_fraction = 0.3f;
+		const auto instances = ecpu::GenerateStressScene(desc, { 1.0f, 2.0f });
+		size_t dynamic = 0;
+		bool in_range = true;
+		for (const auto& instance : instances)
+		{
+			dynamic += instance.dynamic ? 1 : 0;
+			in_range = in_range && instance.prop >= 0 && instance.prop < 2 && instance.material >= 0 && instance.material < 3 &&
+				std::abs(instance.position.x) < 15.0f && std::abs(instance.position.z) < 15.0f && instance.position.y == 0.0f;
+		}
+		check(instances.size() == 50 && dynamic == 15 && in_range, "stress scene layout");
+		const auto again = ecpu::GenerateStressScene(desc, { 1.0f, 2.0f });
+		check(again[49].prop == instances[49].prop && again[49].position.x == instances[49].position.x && again[49].scale == instances[49].scale,
+			"stress scene is deterministic");
+		desc.materials = 0;
+		check(throws([&] { ecpu::GenerateStressScene(desc, { 1.0f }); }), "stress scene needs materials");
+		desc.materials = 3;
+		check(throws([&] { ecpu::GenerateStressScene(desc, {}); }), "stress scene needs props");
+
+		Vector3 position, rotation;
+		ecpu::AnimateStressInstance(instances[0], 1.0f, position, rotation);
+		const bool moved = position.z != instances[0].position.z || rotation.z != instances[0].rotation.z;
+		check(moved == instances[0].dynamic && position.x == instances[0].position.x, "only dynamic instances move");
+
+		// Props of unit boxes, the second with an alpha tested mesh
+		ecpu::Aabb unit;
+		unit.Grow(Vector3(-0.5f, 0.0f, -0.5f));
+		unit.Grow(Vector3(0.5f, 1.0f, 0.5f));
+		ecpu::StressProp box, masked_boxes;
+		box.mesh_bounds = { unit };
+		box.masked = { 0 };
+		box.bounds = unit;
+		masked_boxes.mesh_bounds = { unit, unit };
+		masked_boxes.masked = { 0, 1 };
+		masked_boxes.bounds = unit;
+		ecpu::CPUStressScene scene(desc, { box, masked_boxes });
+		size_t meshes = 0;
+		for (const auto& instance : scene.Instances())
+			meshes += instance.prop == 0 ? 1 : 2;
+
+		// The camera sees the whole grid, the shadow camera the -x half of it
+		const Matrix4 view_projection = Matrix4::LookAt(Vector3(0.0f, 40.0f, -40.0f), Vector3(), Vector3(0.0f, 1.0f, 0.0f)) *
+			Matrix4::ProjectionOffset(0.1f, 200.0f, 0.1f, 0.1f, 0.0f, 0.0f);
+		const Matrix4 shadow_view_projection = Matrix4::LookAt(Vector3(-10.0f, 50.0f, 0.0f), Vector3(-10.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f)) *
+			Matrix4::Orthographic(20.0f, 40.0f, 1.0f, 100.0f);
+		scene.Update(0.5f);
+		scene.PrepareFrame(view_projection, shadow_view_projection);
+		const ecpu::DrawCuller& culler = scene.GetDrawCuller();
+		const auto& stats = culler.GetLastStats();
+		check(culler.Size() == meshes && stats.camera_meshes == meshes && scene.GetLastStats().uploads == 50, "first frame uploads every instance");
+		size_t left_meshes = 0, right_meshes = 0;
+		for (const auto& instance : scene.Instances())
+		{
+			const size_t instance_meshes = instance.prop == 0 ? 1 : 2;
+			left_meshes += instance.position.x < -2.0f ? instance_meshes : 0;
+			right_meshes += instance.position.x > 2.0f ? instance_meshes : 0;
+		}
+		check(left_meshes > 0 && right_meshes > 0 && stats.shadow_meshes >= left_meshes && stats.shadow_meshes <= meshes - right_meshes,
+			"shadow camera culls the other half");
+
+		// Every visible mesh is in one camera pass batch and the dynamic ones in a dynamic pass batch
+		const auto& batches = culler.Batches();
+		size_t camera_instances = 0, dynamic_instances = 0;
+		bool masked_last = true, one_per_key = true;
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			(b < culler.FirstDynamicBatch() ? camera_instances : dynamic_instances) += batches[b].count;
+			if (b > 0 && ecpu::DrawKey::Pass(batches[b].key) == ecpu::DrawKey::Pass(batches[b - 1].key))
+				masked_last = masked_last && ecpu::DrawKey::Pipeline(batches[b].key) >= ecpu::DrawKey::Pipeline(batches[b - 1].key);
+			if (b > 0)
+				one_per_key = one_per_key && ecpu::DrawKey::State(batches[b].key) != ecpu::DrawKey::State(batches[b - 1].key);
+		}
+		size_t dynamic_meshes = 0;
+		for (const auto& instance : scene.Instances())
+			dynamic_meshes += instance.dynamic ? (instance.prop == 0 ? 1 : 2) : 0;
+		check(camera_instances == meshes && dynamic_instances == dynamic_meshes && masked_last && one_per_key &&
+			batches.size() - culler.FirstDynamicBatch() <= 9, "stress scene batches");
+
+		scene.Update(1.0f);
+		scene.PrepareFrame(view_projection, shadow_view_projection);
+		check(scene.GetLastStats().uploads == 15 && scene.GetTransforms().GetLastStats().updated == 15, "later frames upload the dynamic instances");
+		desc.materials = 40000;
+		check(throws([&] { ecpu::CPUStressScene(desc, { box, masked_boxes }); }), "too many materials for the draw keys throw");
+	}
+
+	void occlusionCullingTesting()
+	{
+		using ecpu::Vector3;
+		check(throws([] { ecpu::MaskedOcclusionCuller(60, 64); }), "culler resolution must be whole tiles");
+		ecpu::RasterCamera camera(view_size, view_size, 0.1f, 100.0f, view_fov);
+		const ecpu::Matrix4 view_projection = camera.ViewMatrix() * camera.ProjectionMatrixNoJitter();
+		ecpu::MaskedOcclusionCuller culler(view_size, view_size);
+		auto box = [](float x0, float x1, float z0, float z1) { ecpu::Aabb b; b.Grow(Vector3(x0, -0.5f, z0)); b.Grow(Vector3(x1, 0.5f, z1)); return b; };
+		auto deviceDepth = [](float z) { return 100.0f / 99.9f * (1.0f - 0.1f / z); };
+		check(!culler.IsOccluded(box(-0.5f, 0.5f, 3.0f, 4.0f), view_projection), "empty buffer hides nothing");
+
+		// A wall over the whole view at depth 2, in either winding
+		for (bool flip : { false, true })
+		{
+			culler.Clear();
+			culler.RenderOccluder(occluderOf(screenQuad(-10.0f, -10.0f, 74.0f, 74.0f, 2.0f, flip)), view_projection);
+			bool wall_depth = true;
+			for (int ty = 0; ty < culler.TilesY(); ty++)
+				for (int tx = 0; tx < culler.TilesX(); tx++)
+					wall_depth = wall_depth && near(culler.TileDepth(tx, ty), deviceDepth(2.0f));
+			check(wall_depth, "wall fills the tiles at its depth, flipped " + std::to_string(flip));
+			check(culler.IsOccluded(box(-0.5f, 0.5f, 3.0f, 4.0f), view_projection), "box behind the wall is hidden");
+			check(!culler.IsOccluded(box(-0.5f, 0.5f, 1.0f, 1.5f), view_projection), "box in front of the wall is visible");
+			check(!culler.IsOccluded(box(-0.5f, 0.5f, 1.5f, 3.0f), view_projection), "box through the wall is visible");
+			check(!culler.IsOccluded(box(-0.5f, 0.5f, -1.0f, 5.0f), view_projection), "box behind the camera is visible");
+			check(!culler.IsOccluded(ecpu::Aabb(), view_projection), "empty box is visible");
+		}
+		check(culler.GetStats().occluder_triangles == 2 && culler.GetStats().rasterized_triangles == 2 && culler.GetStats().tests == 5 &&
+			culler.GetStats().occluded == 1, "culling stats");
+
+		// A wall over the left half hides only boxes entirely behind it
+		culler.Clear();
+		culler.RenderOccluder(occluderOf(screenQuad(-10.0f, -10.0f, 32.0f, 74.0f, 2.0f)), view_projection);
+		check(culler.IsOccluded(box(-2.5f, -1.5f, 3.0f, 4.0f), view_projection), "box behind the half wall is hidden");
+		check(!culler.IsOccluded(box(1.5f, 2.5f, 3.0f, 4.0f), view_projection), "box beside the half wall is visible");
+		check(!culler.IsOccluded(box(-1.0f, 1.0f, 3.0f, 4.0f), view_projection), "box across the wall's edge is visible");
+
+		// Walls meeting inside tiles merge their coverage, the tiles taking the farther depth
+		culler.Clear();
+		culler.RenderOccluder(occluderOf(screenQuad(-10.0f, -10.0f, 28.0f, 74.0f, 2.0f)), view_projection);
+		culler.RenderOccluder(occluderOf(screenQuad(28.0f, -10.0f, 74.0f, 74.0f, 3.0f)), view_projection);
+		check(near(culler.TileDepth(0, 0), deviceDepth(2.0f)) && near(culler.TileDepth(3, 0), deviceDepth(3.0f)) &&
+			near(culler.TileDepth(7, 7), deviceDepth(3.0f)), "merged coverage depth");
+		check(culler.IsOccluded(box(-20.0f, 20.0f, 3.5f, 4.0f), view_projection), "box behind both walls is hidden");
+		check(!culler.IsOccluded(box(1.0f, 2.0f, 2.5f, 2.8f), view_projection), "box in front of the far wall is visible");
+
+		// Culling a scene drops the hidden quad and leaves the G-buffer unchanged
+		ecpu::ThreadPool pool(1);
+		auto material = colorMaterial(0.5f, 0.5f, 0.5f);
+		std::vector<eio::ObjbMesh> meshes = { screenQuad(-10.0f, -10.0f, 36.0f, 74.0f, 2.0f), screenQuad(10.0f, 10.0f, 20.0f, 20.0f, 4.0f),
+			screenQuad(30.0f, 30.0f, 40.0f, 40.0f, 4.0f), screenQuad(44.0f, 10.0f, 54.0f, 20.0f, 4.0f) };
+		std::vector<ecpu::Aabb> bounds;
+		for (const auto& mesh : meshes)
+			bounds.push_back(boundsOf(mesh));
+		const ecpu::OccluderMesh wall = occluderOf(meshes[0]);
+		std::vector<ecpu::RasterDraw> draws;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			draws.push_back(makeDraw(meshes[i], material));
+			draws.back().bounds = &bounds[i];
+		}
+		draws[0].occluder = &wall;
+		auto visible = ecpu::CullOccludedDraws(draws, camera, culler);
+		check(visible.size() == 3 && visible[1].mesh == &meshes[2] && culler.GetStats().occluded == 1, "hidden draw culled");
+		ecpu::SoftwareRasterizer all(view_size, view_size);
+		ecpu::SoftwareRasterizer culled(view_size, view_size);
+		all.Render(draws, camera, pool);
+		culled.Render(visible, camera, pool);
+		check(maxDifference(all.GetDepth(), culled.GetDepth()) == 0.0f && maxDifference(all.GetAlbedo(), culled.GetAlbedo()) == 0.0f,
+			"culling leaves the G-buffer unchanged");
+
+		// The draw culler of the D3D12 draw list drops the hidden mesh from the camera draws only,
+		// with the occluder moved by the world matrix like the bounds
+		ecpu::DrawCuller draw_culler;
+		const ecpu::Matrix4 world = ecpu::Matrix4::Translation(Vector3(0.0f, 0.0f, 1.0f));
+		for (size_t i = 0; i < meshes.size(); i++)
+			draw_culler.Add(bounds[i], world, 0, 0, (uint32_t)i, i == 1, i == 0 ? &wall : nullptr);
+		draw_culler.Build(view_projection, 0.0f, view_projection, &culler);
+		check(draw_culler.Instances() == std::vector<uint32_t>{ 0, 2, 3 } && draw_culler.FirstDynamicBatch() == draw_culler.Batches().size() &&
+			draw_culler.ShadowVisible().size() == 4, "draw culler drops the hidden mesh");
+		check(draw_culler.GetLastStats().camera_meshes == 3 && draw_culler.GetLastStats().occluded_meshes == 1, "draw culler occlusion stats");
+		draw_culler.Build(view_projection, 0.0f, view_projection);
+		check(draw_culler.Instances().size() == 5 && draw_culler.GetLastStats().occluded_meshes == 0, "draw culler without occlusion culling");
+		std::vector<ecpu::OccluderSource> sources(2);
+		sources[0].positions = wall.vertices;
+		sources[0].indices = wall.indices;
+		sources[1] = sources[0];
+		auto occluders = ecpu::MakeOccluders(sources, { 1 });
+		check(occluders[0].indices.empty() && occluders[1].indices == wall.indices, "occluders of the tagged meshes");
+		check(throws([&] { ecpu::MakeOccluders(sources, { 2 }); }), "tag of a missing mesh throws");
+
+		// Occluders are the large meshes without a mask texture, tagged in the .occluders file
+		std::vector<eio::ObjbMesh> model = { screenQuad(0.0f, 0.0f, 64.0f, 64.0f, 2.0f), screenQuad(0.0f, 0.0f, 1.0f, 1.0f, 2.0f),
+			screenQuad(0.0f, 0.0f, 64.0f, 64.0f, 2.0f) };
+		std::vector<eio::ObjbMaterial> model_materials(3);
+		model_materials[2].mask_map = "mask.png";
+		check(ecpu::SelectOccluderMeshes(model, model_materials) == std::vector<int>{ 0 }, "occluder selection");
+		const std::string name = "render_testing_occluders";
+		std::vector<int> tagged;
+		check(!eio::LoadOccluders(name, tagged), "untagged model has no occluders");
+		eio::SaveOccluders(name, { 0, 5 });
+		check(eio::LoadOccluders(name, tagged) && tagged == std::vector<int>{ 0, 5 }, "occluders round trip");
+		std::remove((name + ".occluders").c_str());
+	}
+
+	void threadInvarianceTesting()
+	{
+		// Random triangles of both windings, some masked, crossing many tiles and the near plane
+		uint32_t seed = 12345;
+		auto random = [&]() { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / (float)(1 << 24); };
+		std::vector<ecpu::Vector3> positions;
+		std::vector<uint32_t> indices;
+		for (int i = 0; i < 3000; i++)
+		{
+			const ecpu::Vector3 center((random() - 0.5f) * 20.0f, (random() - 0.5f) * 12.0f, random() * 20.0f - 1.0f);
+			const float size = random() < 0.9f ? 0.5f : 6.0f;
+			for (int k = 0; k < 3; k++)
+				positions.push_back(center + ecpu::Vector3(random() - 0.5f, random() - 0.5f, random() - 0.5f) * size);
+			indices.insert(indices.end(), { (uint32_t)i * 3, (uint32_t)i * 3 + 1, (uint32_t)i * 3 + 2 });
+		}
+		auto mesh = makeMesh(positions, indices);
+		const uint8_t mask[4] = { 0, 255, 255, 0 };
+		auto plain = colorMaterial(0.3f, 0.6f, 0.9f);
+		auto masked = colorMaterial(0.9f, 0.6f, 0.3f);
+		masked.mask_texture = ecpu::ImageView<uint8_t>(mask, 2, 2, 1);
+		ecpu::RasterDraw first = makeDraw(mesh, plain);
+		ecpu::RasterDraw second = makeDraw(mesh, masked);
+		second.world = ecpu::Matrix4::Translation(ecpu::Vector3(0.3f, 0.1f, 0.2f));
+
+		const int width = 300;
+		const int height = 170;
+		ecpu::RasterCamera camera(width, height, 0.1f, 100.0f, 3.14159265f / 3.0f);
+		camera.SetPosition(ecpu::Vector3(0.0f, 0.0f, -2.0f));
+		camera.Update();
+		ecpu::SoftwareRasterizer single(width, height);
+		ecpu::SoftwareRasterizer multi(width, height);
+		ecpu::ThreadPool one(1);
+		ecpu::ThreadPool four(4);
+		single.Render({ first, second }, camera, one);
+		multi.Render({ first, second }, camera, four);
+		check(coveredPixels(single) > width * height / 4, "random scene coverage");
+		check(maxDifference(single.GetDepth(), multi.GetDepth()) == 0.0f && maxDifference(single.GetNormals(), multi.GetNormals()) == 0.0f &&
+			maxDifference(single.GetAlbedo(), multi.GetAlbedo()) == 0.0f && maxDifference(single.GetMotionVectors(), multi.GetMotionVectors()) == 0.0f,
+			"results do not depend on the thread count");
+		check(allFinite(single.GetNormals()) && allFinite(single.GetMotionVectors()), "random scene is finite");
+		check(throws([&] { single.Render({ first }, ecpu::RasterCamera(64, 64, 0.1f, 100.0f, view_fov), one); }), "camera size mismatch throws");
+	}
+}
+
+int RenderTesting()
+{
+	failures = 0;
+	matrixTesting();
+	jitterTesting();
+	objbTesting();
+	coverageTesting();
+	depthTesting();
+	motionTesting();
+	maskTesting();
+	threadInvarianceTesting();
+	bvhTesting();
+	rayTracerTesting();
+	frustumTesting();
+	occlusionCullingTesting();
+	transformHierarchyTesting();
+	drawBatcherTesting();
+	stressSceneTesting();
+	std::cout << "Render testing: " << (failures == 0 ? "all checks passed" : std::to_string(failures) + " checks failed") << std::endl;
+	return failures;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Tests of the CPU rendering code that need no GPU, returns the number of failed checks
+int RenderTesting();
@@ -0,0 +1,177 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "cpu/thread_pool.h"
+#include "cpu/timer.h"
+#include "io/png.h"
+#include "deep_learning/cpu/batched_evaluator.h"
+#include "deep_learning/cpu/dataset_reader.h"
+#include "aa/cpu/cpu_taa.h"
+
+// Upsamples recorded DatasetGenerator sequences with the CPU DLTUS pipeline and writes every
+// upsampled frame as a PNG, without a GPU or a window. With --taa the sequences go through the
+// CPU TAA instead, for comparing against the network on the same frames. The --no-<feature>
+// options turn off single TAA features.
+// Usage: Upscaler <dataset root> <output folder> [upsample factor] [video count] [batch size] [weight file]
+//        [--taa] [--no-catmull-rom] [--no-rectification] [--no-ycocg] [--no-clipping] [--no-dilation]
+namespace
+{
+	const char* usage = "Usage: Upscaler <dataset root> <output folder> [upsample factor] [video count] [batch size] [weight file]\n"
+		"       [--taa] [--no-catmull-rom] [--no-rectification] [--no-ycocg] [--no-clipping] [--no-dilation]";
+
+	void makeDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	std::string videoDirectory(const std::string& output, int video)
+	{
+		return output + "/video" + std::to_string(video);
+	}
+
+	std::string framePath(const std::string& output, const std::string& prefix, int upsample_factor, int video, int frame)
+	{
+		return videoDirectory(output, video) + "/" + prefix + "_us" + std::to_string(upsample_factor) +
+			"_v" + std::to_string(video) + "_f" + std::to_string(frame) + ".png";
+	}
+
+	// Frames of a video depend on each other through the history, so videos run one after another
+	// and each frame is split over the threads
+	void runTAA(const std::string& root, const std::string& output, int upsample_factor, int video_count, int frame_count,
+		const ecpu::TAAFeatures& features, ecpu::ThreadPool& pool)
+	{
+		ecpu::TAAEngine taa(upsample_factor, features);
+		std::cout << "Running TAA on " << video_count << " videos of " << frame_count << " frames at upsample factor "
+			<< upsample_factor << " on " << pool.ThreadCount() << " threads" << std::endl;
+
+		ecpu::DLTUSFrame frame;
+		double taa_seconds = 0.0;
+		ecpu::Timer timer;
+		for (int v = 0; v < video_count; v++)
+		{
+			taa.Reset();
+			for (int f = 0; f < frame_count; f++)
+			{
+				ecpu::LoadDatasetFrame(root, upsample_factor, v, f, frame);
+				taa.Execute(frame, pool);
+				taa_seconds += taa.GetLastSeconds();
+				eio::SavePng(framePath(output, "taa", upsample_factor, v, f), ecpu::TensorToImage(taa.GetOutput()));
+			}
+		}
+
+		const double seconds = timer.Elapsed();
+		const int frames = video_count * frame_count;
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "  " << frames << " frames in " << seconds << " s, " << frames / seconds << " fps" << std::endl;
+		std::cout << "  per frame: taa " << taa_seconds * 1000.0 / frames << " ms, loading and writing "
+			<< (seconds - taa_seconds) * 1000.0 / frames << " ms" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// Options may be given anywhere, the remaining arguments are positional
+	bool use_taa = false;
+	ecpu::TAAFeatures features;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--taa")
+			use_taa = true;
+		else if (arg == "--no-catmull-rom")
+			features.catmull_rom = false;
+		else if (arg == "--no-rectification")
+			features.history_rectification = false;
+		else if (arg == "--no-ycocg")
+			features.ycocg = false;
+		else if (arg == "--no-clipping")
+			features.clipping = false;
+		else if (arg == "--no-dilation")
+			features.dilate_mv = false;
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "Unknown option " << arg << std::endl << usage << std::endl;
+			return 1;
+		}
+		else
+			args.push_back(arg);
+	}
+
+	if (args.size() < 2)
+	{
+		std::cout << usage << std::endl;
+		return 1;
+	}
+	const std::string root = args[0];
+	const std::string output = args[1];
+	const int upsample_factor = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 4;
+	int video_count = args.size() > 3 ? std::atoi(args[3].c_str()) : 0;
+	const int batch_size = args.size() > 4 ? std::max(1, std::atoi(args[4].c_str())) : 1;
+	const std::string weight_path = args.size() > 5 ? args[5] : ecpu::MasterNet::DefaultWeightPath(upsample_factor);
+
+	// Without a video count every recorded video is upsampled. Batches advance in lockstep, so
+	// only the frames every video has are used
+	if (video_count <= 0)
+	{
+		video_count = 0;
+		while (ecpu::DatasetFrameCount(root, upsample_factor, video_count) > 0)
+			video_count++;
+	}
+	int frame_count = video_count > 0 ? ecpu::DatasetFrameCount(root, upsample_factor, 0) : 0;
+	for (int v = 1; v < video_count; v++)
+		frame_count = std::min(frame_count, ecpu::DatasetFrameCount(root, upsample_factor, v));
+	if (video_count == 0 || frame_count == 0)
+	{
+		std::cout << "No frames found in " << root << "/us" << upsample_factor << std::endl;
+		return 1;
+	}
+
+	makeDirectory(output);
+	for (int v = 0; v < video_count; v++)
+		makeDirectory(videoDirectory(output, v));
+
+	ecpu::ThreadPool pool;
+	if (use_taa)
+	{
+		runTAA(root, output, upsample_factor, video_count, frame_count, features, pool);
+		return 0;
+	}
+
+	ecpu::MasterNet net(weight_path);
+	ecpu::BatchedEvaluator evaluator(net, upsample_factor, batch_size);
+	std::cout << "Upsampling " << video_count << " videos of " << frame_count << " frames by " << upsample_factor
+		<< ", " << batch_size << " at a time on " << pool.ThreadCount() << " threads" << std::endl;
+
+	auto stats = evaluator.Run(video_count, frame_count,
+		[&](int video, int frame, ecpu::DLTUSFrame& out)
+		{
+			ecpu::LoadDatasetFrame(root, upsample_factor, video, frame, out);
+		},
+		[&](int video, int frame, const ecpu::Tensor& image)
+		{
+			eio::SavePng(framePath(output, "upscaled", upsample_factor, video, frame), ecpu::TensorToImage(image));
+		},
+		pool);
+
+	const auto& stages = stats.stages;
+	const double per_frame = 1000.0 / stats.frames;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  " << stats.frames << " frames in " << stats.seconds << " s, " << stats.FramesPerSecond() << " fps" << std::endl;
+	std::cout << "  per frame: format " << stages.format_seconds * per_frame << " ms, upsample " << stages.upsample_seconds * per_frame
+		<< " ms, init " << stages.init_seconds * per_frame << " ms, network " << stages.network_seconds * per_frame
+		<< " ms, finalize " << stages.finalize_seconds * per_frame << " ms" << std::endl;
+	std::cout << "  loading and writing: " << (stats.seconds - stages.TotalSeconds()) * per_frame << " ms" << std::endl;
+}